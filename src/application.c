@@ -28,6 +28,7 @@
 #include "easytag.h"
 #include "log.h"
 #include "misc.h"
+#include "profile.h"
 #include "setting.h"
 
 typedef struct
@@ -164,6 +165,11 @@ common_init (EtApplication *self)
     /* Load Config */
     Init_Config_Variables ();
 
+    /* Timing of loading and saving files, to find out why they are slow. */
+    et_profile_init (g_getenv ("EASYTAG_PROFILE") != NULL
+                     || g_settings_get_boolean (MainSettings, "log-timings"),
+                     g_getenv ("EASYTAG_PROFILE_TRACE"));
+
     /* Initialization */
     ET_Core_Create ();
     Main_Stop_Button_Pressed = FALSE;
@@ -507,6 +513,7 @@ static void
 et_application_shutdown (GApplication *application)
 {
     Charset_Insert_Locales_Destroy ();
+    et_profile_shutdown ();
 
     G_APPLICATION_CLASS (et_application_parent_class)->shutdown (application);
 }
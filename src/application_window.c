@@ -25,9 +25,11 @@
 #include "browser.h"
 #include "cddb_dialog.h"
 #include "charset.h"
+#include "dir_prefetch.h"
 #include "easytag.h"
 #include "file_area.h"
 #include "file_list.h"
+#include "file_monitor.h"
 #ifdef ENABLE_FLAC
 #include "flac_header.h"
 #endif
@@ -814,6 +816,7 @@ on_undo_last_changes (GSimpleAction *action,
 {
     EtApplicationWindow *self;
     ET_File *ETFile;
+    guint n_files;
 
     self = ET_APPLICATION_WINDOW (user_data);
 
@@ -821,14 +824,22 @@ on_undo_last_changes (GSimpleAction *action,
 
     et_application_window_update_et_file_from_ui (self);
 
-    ETFile = ET_Undo_History_File_Data ();
+    ETFile = ET_Undo_History_File_Data (&n_files);
 
     if (ETFile)
     {
         et_application_window_display_et_file (self, ETFile);
         et_application_window_browser_select_file_by_et_file (self, ETFile,
                                                               TRUE);
-        et_application_window_browser_refresh_file_in_list (self, ETFile);
+
+        if (n_files > 1)
+        {
+            et_application_window_browser_refresh_list (self);
+        }
+        else
+        {
+            et_application_window_browser_refresh_file_in_list (self, ETFile);
+        }
     }
 
     et_application_window_update_actions (self);
@@ -841,6 +852,7 @@ on_redo_last_changes (GSimpleAction *action,
 {
     EtApplicationWindow *self;
     ET_File *ETFile;
+    guint n_files;
 
     self = ET_APPLICATION_WINDOW (user_data);
 
@@ -848,14 +860,22 @@ on_redo_last_changes (GSimpleAction *action,
 
     et_application_window_update_et_file_from_ui (self);
 
-    ETFile = ET_Redo_History_File_Data ();
+    ETFile = ET_Redo_History_File_Data (&n_files);
 
     if (ETFile)
     {
         et_application_window_display_et_file (self, ETFile);
         et_application_window_browser_select_file_by_et_file (self, ETFile,
                                                               TRUE);
-        et_application_window_browser_refresh_file_in_list (self, ETFile);
+
+        if (n_files > 1)
+        {
+            et_application_window_browser_refresh_list (self);
+        }
+        else
+        {
+            et_application_window_browser_refresh_file_in_list (self, ETFile);
+        }
     }
 
     et_application_window_update_actions (self);
@@ -1559,6 +1579,9 @@ et_application_window_dispose (GObject *object)
 
     save_state (self);
 
+    et_file_monitor_stop ();
+    et_dir_prefetch_stop ();
+
     if (ETCore)
     {
         ET_Core_Free ();
@@ -2918,17 +2941,19 @@ et_application_window_browser_select_file_by_et_file2 (EtApplicationWindow *self
                                                file, select, start_path);
 }
 
-ET_File *
-et_application_window_browser_select_file_by_dlm (EtApplicationWindow *self,
-                                                  const gchar *string,
-                                                  gboolean select)
+void
+et_application_window_browser_select_files_by_dlm (EtApplicationWindow *self,
+                                                   const gchar * const *strings,
+                                                   gsize n_strings,
+                                                   ET_File **files,
+                                                   gboolean select)
 {
     EtApplicationWindowPrivate *priv;
 
     priv = et_application_window_get_instance_private (self);
 
-    return et_browser_select_file_by_dlm (ET_BROWSER (priv->browser), string,
-                                          select);
+    et_browser_select_files_by_dlm (ET_BROWSER (priv->browser), strings,
+                                    n_strings, files, select);
 }
 
 void
@@ -2956,6 +2981,19 @@ et_application_window_browser_refresh_list (EtApplicationWindow *self)
     et_browser_refresh_list (ET_BROWSER (priv->browser));
 }
 
+void
+et_application_window_browser_remove_file (EtApplicationWindow *self,
+                                           const ET_File *file)
+{
+    EtApplicationWindowPrivate *priv;
+
+    g_return_if_fail (ET_APPLICATION_WINDOW (self));
+
+    priv = et_application_window_get_instance_private (self);
+
+    et_browser_remove_file (ET_BROWSER (priv->browser), file);
+}
+
 void
 et_application_window_browser_refresh_file_in_list (EtApplicationWindow *self,
                                                     const ET_File *file)
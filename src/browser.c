@@ -44,6 +44,7 @@
 #include "scan_dialog.h"
 #include "log.h"
 #include "misc.h"
+#include "profile.h"
 #include "setting.h"
 
 #include "win32/win32dep.h"
@@ -59,6 +60,7 @@ typedef struct
     GtkWidget *directory_album_artist_notebook;
 
     GtkListStore *file_model;
+    GHashTable *file_rows; /* ET_File to its GtkTreeIter in file_model. */
     GtkWidget *file_view;
     GtkWidget *file_menu;
     guint file_selected_handler;
@@ -185,8 +187,7 @@ static void Browser_Tree_Handle_Rename (EtBrowser *self,
                                         const gchar *new_path);
 
 static void Browser_List_Set_Row_Appearance (EtBrowser *self, GtkTreeIter *iter);
-static gint Browser_List_Sort_Func (GtkTreeModel *model, GtkTreeIter *a,
-                                    GtkTreeIter *b, gpointer data);
+static void Browser_List_Sort_Row (EtBrowser *self, GtkTreeIter *iter);
 static void Browser_List_Select_File_By_Iter (EtBrowser *self,
                                               GtkTreeIter *iter,
                                               gboolean select_it);
@@ -1293,6 +1294,7 @@ et_browser_clear_file_model (EtBrowser *self)
     g_signal_handler_block (selection, priv->file_selected_handler);
 
     gtk_list_store_clear (priv->file_model);
+    g_hash_table_remove_all (priv->file_rows);
     gtk_tree_view_columns_autosize (GTK_TREE_VIEW (priv->file_view));
 
     g_signal_handler_unblock (selection, priv->file_selected_handler);
@@ -1312,11 +1314,13 @@ et_browser_load_file_list (EtBrowser *self,
     GList *l;
     gboolean activate_bg_color = 0;
     GtkTreeIter rowIter;
+    gint64 span;
 
     g_return_if_fail (ET_BROWSER (self));
 
     priv = et_browser_get_instance_private (self);
 
+    span = et_profile_span_begin ();
     et_browser_clear_file_model (self);
 
     for (l = g_list_first (etfilelist); l != NULL; l = g_list_next (l))
@@ -1382,6 +1386,10 @@ et_browser_load_file_list (EtBrowser *self,
         g_free(track);
         g_free (disc);
 
+        /* The iters of a list store persist while the rows are reordered. */
+        g_hash_table_insert (priv->file_rows, l->data,
+                             gtk_tree_iter_copy (&rowIter));
+
         if (etfile_to_select == l->data)
         {
             Browser_List_Select_File_By_Iter (self, &rowIter, TRUE);
@@ -1391,89 +1399,188 @@ et_browser_load_file_list (EtBrowser *self,
         /* Set appearance of the row. */
         Browser_List_Set_Row_Appearance (self, &rowIter);
     }
+
+    /* Rows are appended in the order of the list, which is usually already
+     * sorted. */
+    et_browser_refresh_sort (self);
+
+    et_profile_span_end (ET_PROFILE_PHASE_BROWSER_FILL, span);
 }
 
 
+/*
+ * et_browser_update_row:
+ * @self: the browser
+ * @iter: the row of @ETFile in the file list
+ * @ETFile: the file displayed in the row
+ * @changes: the #EtFileChange flags of what changed in @ETFile
+ *
+ * Update only the columns of the row which display what changed, in a single
+ * change of the row, then the appearance of the row.
+ */
+static void
+et_browser_update_row (EtBrowser *self,
+                       GtkTreeIter *iter,
+                       const ET_File *ETFile,
+                       guint changes)
+{
+    static const struct
+    {
+        EtFileTagField field;
+        gint column;
+    } tag_columns[] =
+    {
+        { ET_FILE_TAG_FIELD_TITLE, LIST_FILE_TITLE },
+        { ET_FILE_TAG_FIELD_ARTIST, LIST_FILE_ARTIST },
+        { ET_FILE_TAG_FIELD_ALBUM_ARTIST, LIST_FILE_ALBUM_ARTIST },
+        { ET_FILE_TAG_FIELD_ALBUM, LIST_FILE_ALBUM },
+        { ET_FILE_TAG_FIELD_YEAR, LIST_FILE_YEAR },
+        { ET_FILE_TAG_FIELD_GENRE, LIST_FILE_GENRE },
+        { ET_FILE_TAG_FIELD_COMMENT, LIST_FILE_COMMENT },
+        { ET_FILE_TAG_FIELD_COMPOSER, LIST_FILE_COMPOSER },
+        { ET_FILE_TAG_FIELD_ORIG_ARTIST, LIST_FILE_ORIG_ARTIST },
+        { ET_FILE_TAG_FIELD_COPYRIGHT, LIST_FILE_COPYRIGHT },
+        { ET_FILE_TAG_FIELD_URL, LIST_FILE_URL },
+        { ET_FILE_TAG_FIELD_ENCODED_BY, LIST_FILE_ENCODED_BY }
+    };
+    EtBrowserPrivate *priv;
+    const File_Tag *FileTag;
+    /* The tag columns, and the name, disc and track columns. */
+    gint columns[G_N_ELEMENTS (tag_columns) + 3];
+    GValue values[G_N_ELEMENTS (tag_columns) + 3] = { G_VALUE_INIT };
+    gint n_values = 0;
+    gsize i;
+
+    priv = et_browser_get_instance_private (self);
+
+    FileTag = (File_Tag *)ETFile->FileTag->data;
+
+    if (changes & ET_FILE_CHANGE_FILENAME)
+    {
+        const File_Name *FileName = (File_Name *)ETFile->FileNameCur->data;
+
+        columns[n_values] = LIST_FILE_NAME;
+        g_value_init (&values[n_values], G_TYPE_STRING);
+        g_value_take_string (&values[n_values],
+                             g_path_get_basename (FileName->value_utf8));
+        n_values++;
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (tag_columns); i++)
+    {
+        if (changes & tag_columns[i].field)
+        {
+            columns[n_values] = tag_columns[i].column;
+            g_value_init (&values[n_values], G_TYPE_STRING);
+            g_value_set_static_string (&values[n_values],
+                                       et_file_tag_get_field_value (FileTag,
+                                                                    tag_columns[i].field));
+            n_values++;
+        }
+    }
+
+    if (changes & (ET_FILE_TAG_FIELD_DISC_NUMBER | ET_FILE_TAG_FIELD_DISC_TOTAL))
+    {
+        columns[n_values] = LIST_FILE_DISCNO;
+        g_value_init (&values[n_values], G_TYPE_STRING);
+        g_value_take_string (&values[n_values],
+                             g_strconcat (FileTag->disc_number ? FileTag->disc_number : "",
+                                          FileTag->disc_total ? "/" : NULL,
+                                          FileTag->disc_total, NULL));
+        n_values++;
+    }
+
+    if (changes & (ET_FILE_TAG_FIELD_TRACK_NUMBER | ET_FILE_TAG_FIELD_TRACK_TOTAL))
+    {
+        columns[n_values] = LIST_FILE_TRACK;
+        g_value_init (&values[n_values], G_TYPE_STRING);
+        g_value_take_string (&values[n_values],
+                             g_strconcat (FileTag->track ? FileTag->track : "",
+                                          FileTag->track_total ? "/" : NULL,
+                                          FileTag->track_total, NULL));
+        n_values++;
+    }
+
+    if (n_values > 0)
+    {
+        gtk_list_store_set_valuesv (priv->file_model, iter, columns, values,
+                                    n_values);
+    }
+
+    for (i = 0; i < (gsize)n_values; i++)
+    {
+        g_value_unset (&values[i]);
+    }
+
+    Browser_List_Set_Row_Appearance (self, iter);
+}
+
 /*
  * Update state of files in the list after changes (without clearing the list model!)
  *  - Refresh 'filename' is file saved,
  *  - Change color is something changed on the file
+ * Only the rows of the files which were marked as changed since the last
+ * refresh are updated, see et_file_list_mark_changed().
  */
 void
 et_browser_refresh_list (EtBrowser *self)
 {
     EtBrowserPrivate *priv;
-    //GtkTreeIter iter;
     GtkTreePath *currentPath = NULL;
     GtkTreeIter iter;
     gint row;
-    gchar *current_basename_utf8;
-    gchar *track;
-    gchar *disc;
-    gboolean valid;
+    GHashTable *changes;
+    GHashTableIter changes_iter;
+    gpointer key;
+    gpointer value;
+    guint n_updated = 0;
     GVariant *variant;
 
     g_return_if_fail (ET_BROWSER (self));
 
     priv = et_browser_get_instance_private (self);
 
+    /* The rows of the files which are not displayed are filled again when
+     * the files are loaded into the list, so their changes are dropped. */
+    changes = et_file_list_take_changes ();
+
+    if (changes == NULL)
+    {
+        return;
+    }
+
     if (!ETCore->ETFileDisplayedList || !priv->file_view
     ||  gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL) == 0)
     {
+        g_hash_table_destroy (changes);
         return;
     }
 
-    // Browse the full list for changes
-    //gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->file_model), &iter);
-    //    g_print("above worked %d rows\n", gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL));
+    g_hash_table_iter_init (&changes_iter, changes);
 
-    currentPath = gtk_tree_path_new_first();
-
-    valid = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->file_model), &iter, currentPath);
-    while (valid)
+    while (g_hash_table_iter_next (&changes_iter, &key, &value))
     {
-        const ET_File *ETFile;
-        const File_Tag *FileTag;
-        const File_Name *FileName;
-        // Refresh filename and other fields
-        gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &iter,
-                           LIST_FILE_POINTER, &ETFile, -1);
+        GtkTreeIter *file_row;
 
-        FileName = (File_Name *)ETFile->FileNameCur->data;
-        FileTag  = (File_Tag *)ETFile->FileTag->data;
-
-        current_basename_utf8 = g_path_get_basename(FileName->value_utf8);
-        track = g_strconcat(FileTag->track ? FileTag->track : "",FileTag->track_total ? "/" : NULL,FileTag->track_total,NULL);
-        disc  = g_strconcat (FileTag->disc_number ? FileTag->disc_number : "",
-                             FileTag->disc_total ? "/" : NULL,
-                             FileTag->disc_total, NULL);
+        file_row = g_hash_table_lookup (priv->file_rows, key);
 
-        gtk_list_store_set(priv->file_model, &iter,
-                           LIST_FILE_NAME,          current_basename_utf8,
-                           LIST_FILE_TITLE,         FileTag->title,
-                           LIST_FILE_ARTIST,        FileTag->artist,
-                           LIST_FILE_ALBUM_ARTIST,  FileTag->album_artist,
-						   LIST_FILE_ALBUM,         FileTag->album,
-                           LIST_FILE_YEAR,          FileTag->year,
-                           LIST_FILE_DISCNO, disc,
-                           LIST_FILE_TRACK,         track,
-                           LIST_FILE_GENRE,         FileTag->genre,
-                           LIST_FILE_COMMENT,       FileTag->comment,
-                           LIST_FILE_COMPOSER,      FileTag->composer,
-                           LIST_FILE_ORIG_ARTIST,   FileTag->orig_artist,
-                           LIST_FILE_COPYRIGHT,     FileTag->copyright,
-                           LIST_FILE_URL,           FileTag->url,
-                           LIST_FILE_ENCODED_BY,    FileTag->encoded_by,
-                           -1);
-        g_free(current_basename_utf8);
-        g_free(track);
-        g_free (disc);
+        if (file_row != NULL)
+        {
+            et_browser_update_row (self, file_row, key,
+                                   GPOINTER_TO_UINT (value));
+            n_updated++;
+        }
+    }
 
-        Browser_List_Set_Row_Appearance (self, &iter);
+    g_hash_table_destroy (changes);
 
-        valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->file_model), &iter);
+    if (n_updated == 0)
+    {
+        return;
     }
-    gtk_tree_path_free(currentPath);
+
+    /* Filenames and tags may have changed, so sort the list again. */
+    et_browser_refresh_sort (self);
 
     variant = g_action_group_get_action_state (G_ACTION_GROUP (MainWindow),
                                                "file-artist-view");
@@ -1522,17 +1629,9 @@ et_browser_refresh_file_in_list (EtBrowser *self,
                                  const ET_File *ETFile)
 {
     EtBrowserPrivate *priv;
-    GList *selectedRow = NULL;
     GVariant *variant;
-    GtkTreeSelection *selection;
+    GtkTreeIter *file_row;
     GtkTreeIter selectedIter;
-    const ET_File *etfile;
-    const File_Tag *FileTag;
-    const File_Name *FileName;
-    gboolean row_found = FALSE;
-    gchar *current_basename_utf8;
-    gchar *track;
-    gchar *disc;
     gboolean valid;
     gchar *artist, *album;
 
@@ -1546,101 +1645,21 @@ et_browser_refresh_file_in_list (EtBrowser *self,
         return;
     }
 
-    // Search the row of the modified file to update it (when found: row_found=TRUE)
-    // 1/3. Get position of ETFile in ETFileList
-    if (row_found == FALSE)
-    {
-        valid = gtk_tree_model_iter_nth_child (GTK_TREE_MODEL(priv->file_model), &selectedIter, NULL, ETFile->IndexKey-1);
-        if (valid)
-        {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                           LIST_FILE_POINTER, &etfile, -1);
-            if (ETFile->ETFileKey == etfile->ETFileKey)
-            {
-                row_found = TRUE;
-            }
-        }
-    }
-
-    // 2/3. Try with the selected file in list (works only if we select the same file)
-    if (row_found == FALSE)
-    {
-        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view));
-        selectedRow = gtk_tree_selection_get_selected_rows(selection, NULL);
-        if (selectedRow && selectedRow->data != NULL)
-        {
-            valid = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                                    (GtkTreePath*) selectedRow->data);
-            if (valid)
-            {
-                gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                                   LIST_FILE_POINTER, &etfile, -1);
-                if (ETFile->ETFileKey == etfile->ETFileKey)
-                {
-                    row_found = TRUE;
-                }
-            }
-        }
-
-        g_list_free_full (selectedRow, (GDestroyNotify)gtk_tree_path_free);
-    }
-
-    // 3/3. Fails, now we browse the full list to find it
-    if (row_found == FALSE)
-    {
-        valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(priv->file_model), &selectedIter);
-        while (valid)
-        {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &selectedIter,
-                               LIST_FILE_POINTER, &etfile, -1);
-            if (ETFile->ETFileKey == etfile->ETFileKey)
-            {
-                row_found = TRUE;
-                break;
-            } else
-            {
-                valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->file_model), &selectedIter);
-            }
-        }
-    }
+    file_row = g_hash_table_lookup (priv->file_rows, ETFile);
 
     // Error somewhere...
-    if (row_found == FALSE)
+    if (file_row == NULL)
         return;
 
-    // Displayed the filename and refresh other fields
-    FileName = (File_Name *)etfile->FileNameCur->data;
-    FileTag  = (File_Tag *)etfile->FileTag->data;
-
-    current_basename_utf8 = g_path_get_basename(FileName->value_utf8);
-    track = g_strconcat(FileTag->track ? FileTag->track : "",FileTag->track_total ? "/" : NULL,FileTag->track_total,NULL);
-    disc  = g_strconcat (FileTag->disc_number ? FileTag->disc_number : "",
-                         FileTag->disc_total ? "/" : NULL, FileTag->disc_total,
-                         NULL);
-
-    gtk_list_store_set(priv->file_model, &selectedIter,
-                       LIST_FILE_NAME,          current_basename_utf8,
-                       LIST_FILE_TITLE,         FileTag->title,
-                       LIST_FILE_ARTIST,        FileTag->artist,
-                       LIST_FILE_ALBUM_ARTIST,  FileTag->album_artist,
-					   LIST_FILE_ALBUM,         FileTag->album,
-                       LIST_FILE_YEAR,          FileTag->year,
-                       LIST_FILE_DISCNO, disc,
-                       LIST_FILE_TRACK,         track,
-                       LIST_FILE_GENRE,         FileTag->genre,
-                       LIST_FILE_COMMENT,       FileTag->comment,
-                       LIST_FILE_COMPOSER,      FileTag->composer,
-                       LIST_FILE_ORIG_ARTIST,   FileTag->orig_artist,
-                       LIST_FILE_COPYRIGHT,     FileTag->copyright,
-                       LIST_FILE_URL,           FileTag->url,
-                       LIST_FILE_ENCODED_BY,    FileTag->encoded_by,
-                       -1);
-    g_free(current_basename_utf8);
-    g_free(track);
-    g_free (disc);
+    /* Displayed the filename and refresh other fields, and change appearance
+     * (line to red) if filename changed. */
+    et_browser_update_row (self, file_row, ETFile,
+                           ET_FILE_CHANGE_TAG | ET_FILE_CHANGE_FILENAME
+                           | ET_FILE_CHANGE_STATE);
+    et_file_list_unmark_changed (ETFile);
 
-    /* Change appearance (line to red) if filename changed. */
-    Browser_List_Set_Row_Appearance (self, &selectedIter);
+    /* The filename or tag may have changed the place of the file. */
+    Browser_List_Sort_Row (self, file_row);
 
     variant = g_action_group_get_action_state (G_ACTION_GROUP (MainWindow),
                                                "file-artist-view");
@@ -1805,40 +1824,20 @@ et_browser_remove_file (EtBrowser *self,
                         const ET_File *searchETFile)
 {
     EtBrowserPrivate *priv;
-    gint row;
-    GtkTreePath *currentPath = NULL;
-    GtkTreeIter currentIter;
-    ET_File *currentETFile;
-    gboolean valid;
+    GtkTreeIter *currentIter;
 
     if (searchETFile == NULL)
         return;
 
     priv = et_browser_get_instance_private (self);
 
-    // Go through the file list until it is found
-    for (row=0; row < gtk_tree_model_iter_n_children(GTK_TREE_MODEL(priv->file_model), NULL); row++)
-    {
-        if (row == 0)
-            currentPath = gtk_tree_path_new_first();
-        else
-            gtk_tree_path_next(currentPath);
+    currentIter = g_hash_table_lookup (priv->file_rows, searchETFile);
 
-        valid = gtk_tree_model_get_iter(GTK_TREE_MODEL(priv->file_model), &currentIter, currentPath);
-        if (valid)
-        {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &currentIter,
-                               LIST_FILE_POINTER, &currentETFile, -1);
-
-            if (currentETFile == searchETFile)
-            {
-                gtk_list_store_remove(priv->file_model, &currentIter);
-                break;
-            }
-        }
+    if (currentIter != NULL)
+    {
+        gtk_list_store_remove (priv->file_model, currentIter);
+        g_hash_table_remove (priv->file_rows, searchETFile);
     }
-
-    gtk_tree_path_free (currentPath);
 }
 
 /*
@@ -2031,61 +2030,131 @@ et_browser_select_file_by_iter_string (EtBrowser *self,
 }
 
 /*
- * Select the specified file in the list, by fuzzy string matching based on
- * the Damerau-Levenshtein Metric (patch from Santtu Lakkala - 23/08/2004)
+ * et_browser_select_files_by_dlm:
+ * @self: the browser
+ * @strings: the strings to match against the files of the list
+ * @n_strings: the number of @strings
+ * @files: (out caller-allocates): an array of @n_strings files
+ * @select_it: whether to select the matching files
+ *
+ * Find the file of the list which best matches each of @strings, by fuzzy
+ * string matching based on the Damerau-Levenshtein Metric (patch from Santtu
+ * Lakkala - 23/08/2004). The titles of the files are collected, and matched
+ * against all of @strings, only once. The matching file, or %NULL if no file
+ * matches at all, is stored in @files.
  */
-ET_File *
-et_browser_select_file_by_dlm (EtBrowser *self,
-                               const gchar* string,
-                               gboolean select_it)
+void
+et_browser_select_files_by_dlm (EtBrowser *self,
+                                const gchar * const *strings,
+                                gsize n_strings,
+                                ET_File **files,
+                                gboolean select_it)
 {
     EtBrowserPrivate *priv;
     GtkTreeIter iter;
-    GtkTreeIter iter2;
-    GtkTreeSelection *selection;
-    ET_File *current_etfile = NULL, *retval = NULL;
-    gchar *current_filename = NULL, *current_title = NULL;
-    int max = 0, this;
+    GtkTreeSelection *selection = NULL;
+    GArray *iters;
+    GPtrArray *candidates;
+    GPtrArray *etfiles;
+    gssize *best;
+    gsize i;
 
     priv = et_browser_get_instance_private (self);
 
-    g_return_val_if_fail (priv->file_model != NULL || priv->file_view != NULL, NULL);
+    g_return_if_fail (priv->file_model != NULL || priv->file_view != NULL);
+    g_return_if_fail (strings != NULL || n_strings == 0);
+    g_return_if_fail (files != NULL || n_strings == 0);
 
-    if (gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->file_model),
-                                       &iter))
+    if (n_strings == 0)
     {
-        do
+        return;
+    }
+
+    if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->file_model),
+                                        &iter))
+    {
+        for (i = 0; i < n_strings; i++)
         {
-            gtk_tree_model_get(GTK_TREE_MODEL(priv->file_model), &iter,
-                               LIST_FILE_NAME,    &current_filename,
-                               LIST_FILE_POINTER, &current_etfile, -1);
-            current_title = ((File_Tag *)current_etfile->FileTag->data)->title;
+            files[i] = NULL;
+        }
 
-            if ((this = dlm((current_title ? current_title : current_filename), string)) > max) // See "dlm.c"
-            {
-                max = this;
-                iter2 = iter;
-                retval = current_etfile;
-            }
+        return;
+    }
 
-            g_free (current_filename);
-        } while (gtk_tree_model_iter_next(GTK_TREE_MODEL(priv->file_model), &iter));
+    iters = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+    candidates = g_ptr_array_new ();
+    etfiles = g_ptr_array_new ();
 
-        if (select_it)
+    /* Match against the title, or the basename of the file if there is no
+     * title. The strings are owned by the files, so nothing is copied. */
+    do
+    {
+        ET_File *current_etfile;
+        const gchar *current_title;
+
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->file_model), &iter,
+                            LIST_FILE_POINTER, &current_etfile, -1);
+        current_title = ((File_Tag *)current_etfile->FileTag->data)->title;
+
+        if (current_title == NULL)
         {
-            selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(priv->file_view));
-            if (selection)
-            {
-                g_signal_handler_block (selection,
-                                        priv->file_selected_handler);
-                gtk_tree_selection_select_iter(selection, &iter2);
-                g_signal_handler_unblock (selection,
-                                          priv->file_selected_handler);
-            }
+            const gchar *filename;
+
+            filename = ((File_Name *)current_etfile->FileNameCur->data)->value_utf8;
+            current_title = strrchr (filename, G_DIR_SEPARATOR);
+            current_title = current_title ? current_title + 1 : filename;
+        }
+
+        g_array_append_val (iters, iter);
+        g_ptr_array_add (candidates, (gpointer)current_title);
+        g_ptr_array_add (etfiles, current_etfile);
+    } while (gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->file_model),
+                                       &iter));
+
+    /* See "dlm.c". */
+    best = g_new (gssize, n_strings);
+    et_dlm_find_best_matches (strings, n_strings,
+                              (const gchar * const *)candidates->pdata,
+                              candidates->len, best, NULL);
+
+    if (select_it)
+    {
+        selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view));
+    }
+
+    if (selection)
+    {
+        g_signal_handler_block (selection, priv->file_selected_handler);
+    }
+
+    for (i = 0; i < n_strings; i++)
+    {
+        if (best[i] < 0)
+        {
+            files[i] = NULL;
+            continue;
+        }
+
+        iter = g_array_index (iters, GtkTreeIter, best[i]);
+        files[i] = g_ptr_array_index (etfiles, best[i]);
+
+        if (selection)
+        {
+            gtk_tree_selection_select_iter (selection, &iter);
         }
-        et_browser_set_row_visible (self, &iter2);
+
+        et_browser_set_row_visible (self, &iter);
     }
-    return retval;
+
+    if (selection)
+    {
+        g_signal_handler_unblock (selection, priv->file_selected_handler);
+    }
+
+    g_free (best);
+    g_ptr_array_free (etfiles, TRUE);
+    g_ptr_array_free (candidates, TRUE);
+    g_array_free (iters, TRUE);
 }
 
 /*
@@ -2101,175 +2170,188 @@ et_browser_clear (EtBrowser *self)
     et_browser_clear_album_model (self);
 }
 
+/*
+ * EtBrowserSortRow:
+ * @file: the file displayed in the row
+ * @position: the position of the row before sorting
+ *
+ * An entry of the permutation which is applied to the file list to sort it.
+ */
+typedef struct
+{
+    const ET_File *file;
+    gint position;
+} EtBrowserSortRow;
+
+/*
+ * Compare two rows of the file list with the comparison function of the sort
+ * mode, keeping the current order of rows which compare equal.
+ */
+static gint
+compare_sort_rows (gconstpointer a,
+                   gconstpointer b,
+                   gpointer user_data)
+{
+    const EtBrowserSortRow *row1 = a;
+    const EtBrowserSortRow *row2 = b;
+    const GCompareFunc compare = *(const GCompareFunc *)user_data;
+    gint result;
+
+    result = compare (row1->file, row2->file);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    return row1->position - row2->position;
+}
+
 /*
  * Refresh the list sorting (call me after sort-mode has changed)
+ *
+ * The comparison function for the sort mode is chosen once, the files are
+ * sorted outside of the model and the resulting permutation is applied with a
+ * single reorder of the list store.
  */
 void
 et_browser_refresh_sort (EtBrowser *self)
 {
     EtBrowserPrivate *priv;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    GCompareFunc compare;
+    EtBrowserSortRow *rows;
+    gint *new_order;
+    gint n_rows;
+    gint i;
+    gboolean valid;
+    gboolean changed = FALSE;
 
     g_return_if_fail (ET_BROWSER (self));
 
     priv = et_browser_get_instance_private (self);
+    model = GTK_TREE_MODEL (priv->file_model);
+    n_rows = gtk_tree_model_iter_n_children (model, NULL);
+
+    if (n_rows < 2)
+    {
+        return;
+    }
+
+    compare = et_file_list_get_sort_func (priv->file_sort_mode);
+    rows = g_new (EtBrowserSortRow, n_rows);
+
+    for (i = 0, valid = gtk_tree_model_get_iter_first (model, &iter);
+         valid && i < n_rows;
+         i++, valid = gtk_tree_model_iter_next (model, &iter))
+    {
+        gtk_tree_model_get (model, &iter, LIST_FILE_POINTER, &rows[i].file,
+                            -1);
+        rows[i].position = i;
+    }
+
+    g_qsort_with_data (rows, n_rows, sizeof (EtBrowserSortRow),
+                       compare_sort_rows, &compare);
+
+    new_order = g_new (gint, n_rows);
+
+    for (i = 0; i < n_rows; i++)
+    {
+        new_order[i] = rows[i].position;
+
+        if (new_order[i] != i)
+        {
+            changed = TRUE;
+        }
+    }
+
+    /* Avoid emitting "rows-reordered" if the list is already sorted. */
+    if (changed)
+    {
+        gtk_list_store_reorder (priv->file_model, new_order);
+    }
 
-    gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (priv->file_model), 0,
-                                     Browser_List_Sort_Func, NULL, NULL);
+    g_free (new_order);
+    g_free (rows);
 }
 
 /*
- * Intelligently sort the file list based on the current sorting method
- * see also 'ET_Sort_File_List'
+ * Move the row at @iter to its place in the sorted file list, after the file
+ * which it displays was changed. Only the other rows visited by a binary
+ * search are compared, instead of sorting the whole list again.
  */
-static gint
-Browser_List_Sort_Func (GtkTreeModel *model, GtkTreeIter *a, GtkTreeIter *b,
-                        gpointer data)
+static void
+Browser_List_Sort_Row (EtBrowser *self, GtkTreeIter *iter)
 {
-    ET_File *ETFile1;
-    ET_File *ETFile2;
-    gint result = 0;
+    EtBrowserPrivate *priv;
+    GtkTreeModel *model;
+    GtkTreePath *path;
+    GtkTreeIter other;
+    GCompareFunc compare;
+    const ET_File *file;
+    gint position;
+    gint n_others;
+    gint low;
+    gint high;
 
-    gtk_tree_model_get(model, a, LIST_FILE_POINTER, &ETFile1, -1);
-    gtk_tree_model_get(model, b, LIST_FILE_POINTER, &ETFile2, -1);
+    priv = et_browser_get_instance_private (self);
+    model = GTK_TREE_MODEL (priv->file_model);
+    n_others = gtk_tree_model_iter_n_children (model, NULL) - 1;
 
-    switch (g_settings_get_enum (MainSettings, "sort-mode"))
+    if (n_others < 1)
     {
-        case ET_SORT_MODE_ASCENDING_FILENAME:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Filename(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILENAME:
-            result = ET_Comp_Func_Sort_File_By_Descending_Filename(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_TITLE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Title(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_TITLE:
-            result = ET_Comp_Func_Sort_File_By_Descending_Title(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Descending_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_ALBUM_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Album_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_ALBUM_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Descending_Album_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_ALBUM:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Album(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_ALBUM:
-            result = ET_Comp_Func_Sort_File_By_Descending_Album(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_YEAR:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Year(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_YEAR:
-            result = ET_Comp_Func_Sort_File_By_Descending_Year(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_DISC_NUMBER:
-            result = et_comp_func_sort_file_by_ascending_disc_number (ETFile1,
-                                                                      ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_DISC_NUMBER:
-            result = et_comp_func_sort_file_by_descending_disc_number (ETFile1,
-                                                                       ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_TRACK_NUMBER:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Track_Number (ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_TRACK_NUMBER:
-            result = ET_Comp_Func_Sort_File_By_Descending_Track_Number (ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_GENRE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Genre(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_GENRE:
-            result = ET_Comp_Func_Sort_File_By_Descending_Genre(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_COMMENT:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Comment(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_COMMENT:
-            result = ET_Comp_Func_Sort_File_By_Descending_Comment(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_COMPOSER:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Composer(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_COMPOSER:
-            result = ET_Comp_Func_Sort_File_By_Descending_Composer(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_ORIG_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Orig_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_ORIG_ARTIST:
-            result = ET_Comp_Func_Sort_File_By_Descending_Orig_Artist(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_COPYRIGHT:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Copyright(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_COPYRIGHT:
-            result = ET_Comp_Func_Sort_File_By_Descending_Copyright(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_URL:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Url(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_URL:
-            result = ET_Comp_Func_Sort_File_By_Descending_Url(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_ENCODED_BY:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Encoded_By(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_ENCODED_BY:
-            result = ET_Comp_Func_Sort_File_By_Descending_Encoded_By(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_CREATION_DATE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_Creation_Date (ETFile1,
-                                                                        ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_CREATION_DATE:
-            result = ET_Comp_Func_Sort_File_By_Descending_Creation_Date (ETFile1,
-                                                                         ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_TYPE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_File_Type(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_TYPE:
-            result = ET_Comp_Func_Sort_File_By_Descending_File_Type(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_SIZE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_File_Size(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_SIZE:
-            result = ET_Comp_Func_Sort_File_By_Descending_File_Size(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_DURATION:
-            result = ET_Comp_Func_Sort_File_By_Ascending_File_Duration(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_DURATION:
-            result = ET_Comp_Func_Sort_File_By_Descending_File_Duration(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_BITRATE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_File_Bitrate(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_BITRATE:
-            result = ET_Comp_Func_Sort_File_By_Descending_File_Bitrate(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_SAMPLERATE:
-            result = ET_Comp_Func_Sort_File_By_Ascending_File_Samplerate(ETFile1, ETFile2);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_SAMPLERATE:
-            result = ET_Comp_Func_Sort_File_By_Descending_File_Samplerate(ETFile1, ETFile2);
-            break;
-        default:
-            g_assert_not_reached ();
-            break;
+        return;
     }
 
-    return result;
+    compare = et_file_list_get_sort_func (priv->file_sort_mode);
+    gtk_tree_model_get (model, iter, LIST_FILE_POINTER, &file, -1);
+
+    path = gtk_tree_model_get_path (model, iter);
+    position = gtk_tree_path_get_indices (path)[0];
+    gtk_tree_path_free (path);
+
+    /* Find the first of the other rows which sorts after the file, skipping
+     * over the row of the file itself. */
+    low = 0;
+    high = n_others;
+
+    while (low < high)
+    {
+        const gint middle = low + (high - low) / 2;
+        const ET_File *other_file;
+
+        gtk_tree_model_iter_nth_child (model, &other, NULL,
+                                       middle < position ? middle
+                                                         : middle + 1);
+        gtk_tree_model_get (model, &other, LIST_FILE_POINTER, &other_file,
+                            -1);
+
+        if (compare (file, other_file) < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    if (low == position)
+    {
+        return;
+    }
+
+    if (low == n_others)
+    {
+        gtk_list_store_move_before (priv->file_model, iter, NULL);
+    }
+    else
+    {
+        gtk_tree_model_iter_nth_child (model, &other, NULL,
+                                       low < position ? low : low + 1);
+        gtk_list_store_move_before (priv->file_model, iter, &other);
+    }
 }
 
 /*
@@ -3763,6 +3845,32 @@ collapse_cb (EtBrowser *self, GtkTreeIter *iter, GtkTreePath *treePath, GtkTreeV
     g_object_unref (icon);
 }
 
+/*
+ * The appearance of the changed files depends on the setting, so it is
+ * updated in all the rows.
+ */
+static void
+on_file_changed_bold_changed (EtBrowser *self,
+                              gchar *key,
+                              GSettings *settings)
+{
+    EtBrowserPrivate *priv;
+    GtkTreeIter iter;
+    gboolean valid;
+
+    priv = et_browser_get_instance_private (self);
+
+    valid = gtk_tree_model_get_iter_first (GTK_TREE_MODEL (priv->file_model),
+                                           &iter);
+
+    while (valid)
+    {
+        Browser_List_Set_Row_Appearance (self, &iter);
+        valid = gtk_tree_model_iter_next (GTK_TREE_MODEL (priv->file_model),
+                                          &iter);
+    }
+}
+
 static void
 on_sort_mode_changed (EtBrowser *self, gchar *key, GSettings *settings)
 {
@@ -3971,14 +4079,18 @@ create_browser (EtBrowser *self)
                           GINT_TO_POINTER (ascending_sort));
     }
 
+    /* The file list is not a sorted model, but is reordered by
+     * et_browser_refresh_sort() with the comparison function of the cached
+     * sort mode. */
+    priv->file_sort_mode = g_settings_get_enum (MainSettings, "sort-mode");
     g_signal_connect_swapped (MainSettings, "changed::sort-mode",
                               G_CALLBACK (on_sort_mode_changed), self);
-    // To sort list
-    gtk_tree_sortable_set_sort_func (GTK_TREE_SORTABLE (priv->file_model), 0,
-                                      Browser_List_Sort_Func, NULL, NULL);
-    et_browser_refresh_sort (self);
-    gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (priv->file_model),
-                                          0, GTK_SORT_ASCENDING);
+
+    /* The rows are found by file when only some of them are updated. */
+    priv->file_rows = g_hash_table_new_full (NULL, NULL, NULL,
+                                             (GDestroyNotify)gtk_tree_iter_free);
+    g_signal_connect_swapped (MainSettings, "changed::file-changed-bold",
+                              G_CALLBACK (on_file_changed_bold_changed), self);
 
     priv->file_selected_handler = g_signal_connect_swapped (gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->file_view)),
                                                             "changed",
@@ -4977,6 +5089,7 @@ et_browser_finalize (GObject *object)
 
     g_clear_object (&priv->current_path);
     g_clear_object (&priv->run_program_model);
+    g_clear_pointer (&priv->file_rows, g_hash_table_destroy);
 
     G_OBJECT_CLASS (et_browser_parent_class)->finalize (object);
 }
@@ -80,7 +80,7 @@ void et_browser_clear (EtBrowser *self);
 void et_browser_select_file_by_et_file (EtBrowser *self, const ET_File *ETFile, gboolean select_it);
 GtkTreePath * et_browser_select_file_by_et_file2 (EtBrowser *self, const ET_File *searchETFile, gboolean select_it, GtkTreePath *startPath);
 void et_browser_select_file_by_iter_string (EtBrowser *self, const gchar* stringiter, gboolean select_it);
-ET_File *et_browser_select_file_by_dlm (EtBrowser *self, const gchar* string, gboolean select_it);
+void et_browser_select_files_by_dlm (EtBrowser *self, const gchar * const *strings, gsize n_strings, ET_File **files, gboolean select_it);
 void et_browser_refresh_sort (EtBrowser *self);
 void et_browser_select_all (EtBrowser *self);
 void et_browser_unselect_all (EtBrowser *self);
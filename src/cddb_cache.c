@@ -0,0 +1,697 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "cddb_cache.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/*
+ * The cache keeps each response in a file, named by the SHA-1 checksum of the
+ * request URI. The file starts with the URI on a line of its own, so that a
+ * response is never returned for another request, followed by the response
+ * body. The modification time of the file is the time at which the response
+ * was received.
+ */
+struct _EtCddbCache
+{
+    gchar *path;
+    gint64 lifetime;
+};
+
+/*
+ * EtCddbPrefetch:
+ * @cache: a copy of the cache, as the prefetch may outlive the original
+ * @session: the session with which to send the requests
+ * @uris: the URIs for which a request has not yet been sent
+ * @max_requests: the maximum number of requests to have in flight
+ * @n_active: the number of requests in flight
+ * @n_fetched: the number of responses which were added to the cache
+ *
+ * The state of a prefetch, attached to its #GTask.
+ */
+typedef struct
+{
+    EtCddbCache *cache;
+    SoupSession *session;
+    GQueue uris;
+    guint max_requests;
+    guint n_active;
+    guint n_fetched;
+} EtCddbPrefetch;
+
+/*
+ * EtCddbPrefetchRequest:
+ * @task: the prefetch that the request is part of
+ * @message: the request
+ * @key: the key under which to store the response
+ * @ostream: the stream into which the response is read
+ *
+ * A single request of a prefetch.
+ */
+typedef struct
+{
+    GTask *task;
+    SoupMessage *message;
+    gchar *key;
+    GOutputStream *ostream;
+} EtCddbPrefetchRequest;
+
+/*
+ * et_cddb_cache_new:
+ * @path: the directory in which to store the responses
+ * @lifetime: the time in seconds after which a response expires
+ *
+ * Create a cache of CDDB responses. The directory is only created when the
+ * first response is stored.
+ *
+ * Returns: a new cache, to be freed with et_cddb_cache_free()
+ */
+EtCddbCache *
+et_cddb_cache_new (const gchar *path,
+                   gint64 lifetime)
+{
+    EtCddbCache *cache;
+
+    g_return_val_if_fail (path != NULL, NULL);
+    g_return_val_if_fail (lifetime > 0, NULL);
+
+    cache = g_slice_new (EtCddbCache);
+    cache->path = g_strdup (path);
+    cache->lifetime = lifetime;
+
+    return cache;
+}
+
+/*
+ * et_cddb_cache_free:
+ * @cache: (allow-none): a cache, or %NULL
+ *
+ * Free the cache. The stored responses are kept on disk.
+ */
+void
+et_cddb_cache_free (EtCddbCache *cache)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+
+    g_free (cache->path);
+    g_slice_free (EtCddbCache, cache);
+}
+
+/*
+ * et_cddb_cache_get_lifetime:
+ * @cache: a cache
+ *
+ * Returns: the time in seconds after which a response expires
+ */
+gint64
+et_cddb_cache_get_lifetime (const EtCddbCache *cache)
+{
+    g_return_val_if_fail (cache != NULL, 0);
+
+    return cache->lifetime;
+}
+
+static gchar *
+get_cache_filename (const EtCddbCache *cache,
+                    const gchar *key)
+{
+    gchar *checksum;
+    gchar *filename;
+
+    checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+    filename = g_build_filename (cache->path, checksum, NULL);
+    g_free (checksum);
+
+    return filename;
+}
+
+static gboolean
+is_expired (const EtCddbCache *cache,
+            const GStatBuf *statbuf)
+{
+    const gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+    return now - (gint64)statbuf->st_mtime >= cache->lifetime;
+}
+
+/*
+ * is_cacheable:
+ * @bytes: the body of a successful response
+ *
+ * Check whether a response should be stored. CDDB errors are sent with a
+ * successful HTTP status, and a 4xx or 5xx code on the first line of the
+ * body, and may be temporary.
+ *
+ * Returns: %TRUE if the response should be stored, %FALSE otherwise
+ */
+static gboolean
+is_cacheable (GBytes *bytes)
+{
+    gsize size;
+    const gchar *data = g_bytes_get_data (bytes, &size);
+
+    return size > 0 && data[0] != '4' && data[0] != '5';
+}
+
+/*
+ * et_cddb_cache_lookup:
+ * @cache: a cache
+ * @key: the URI of the request
+ *
+ * Look up the response to a request. Expired responses are removed.
+ *
+ * Returns: the body of the response, or %NULL if the response is not in the
+ *          cache or has expired
+ */
+GBytes *
+et_cddb_cache_lookup (const EtCddbCache *cache,
+                      const gchar *key)
+{
+    gchar *filename;
+    GStatBuf statbuf;
+    gchar *contents;
+    gsize length;
+    gsize key_length;
+    GBytes *file_bytes;
+    GBytes *bytes;
+
+    g_return_val_if_fail (cache != NULL, NULL);
+    g_return_val_if_fail (key != NULL, NULL);
+
+    filename = get_cache_filename (cache, key);
+
+    if (g_stat (filename, &statbuf) != 0)
+    {
+        g_free (filename);
+        return NULL;
+    }
+
+    if (is_expired (cache, &statbuf))
+    {
+        g_unlink (filename);
+        g_free (filename);
+        return NULL;
+    }
+
+    if (!g_file_get_contents (filename, &contents, &length, NULL))
+    {
+        g_free (filename);
+        return NULL;
+    }
+
+    g_free (filename);
+    key_length = strlen (key);
+
+    if (length <= key_length || memcmp (contents, key, key_length) != 0
+        || contents[key_length] != '\n')
+    {
+        g_free (contents);
+        return NULL;
+    }
+
+    file_bytes = g_bytes_new_take (contents, length);
+    bytes = g_bytes_new_from_bytes (file_bytes, key_length + 1,
+                                    length - key_length - 1);
+    g_bytes_unref (file_bytes);
+
+    return bytes;
+}
+
+/*
+ * et_cddb_cache_store:
+ * @cache: a cache
+ * @key: the URI of the request
+ * @bytes: the body of the response
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Store the response to a request, replacing any previous response.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set on failure
+ */
+gboolean
+et_cddb_cache_store (const EtCddbCache *cache,
+                     const gchar *key,
+                     GBytes *bytes,
+                     GError **error)
+{
+    gchar *filename;
+    GString *contents;
+    gconstpointer data;
+    gsize size;
+    gboolean success;
+
+    g_return_val_if_fail (cache != NULL, FALSE);
+    g_return_val_if_fail (key != NULL && strchr (key, '\n') == NULL, FALSE);
+    g_return_val_if_fail (bytes != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    if (g_mkdir_with_parents (cache->path, 0700) != 0)
+    {
+        const gint saved_errno = errno;
+
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (saved_errno),
+                     _("Error creating directory ‘%s’: %s"), cache->path,
+                     g_strerror (saved_errno));
+        return FALSE;
+    }
+
+    data = g_bytes_get_data (bytes, &size);
+    contents = g_string_sized_new (strlen (key) + 1 + size);
+    g_string_append (contents, key);
+    g_string_append_c (contents, '\n');
+    g_string_append_len (contents, data, size);
+
+    filename = get_cache_filename (cache, key);
+    success = g_file_set_contents (filename, contents->str, contents->len,
+                                   error);
+
+    g_free (filename);
+    g_string_free (contents, TRUE);
+
+    return success;
+}
+
+/*
+ * et_cddb_cache_purge:
+ * @cache: a cache
+ *
+ * Remove the expired responses from the cache directory.
+ *
+ * Returns: the number of responses which were removed
+ */
+guint
+et_cddb_cache_purge (const EtCddbCache *cache)
+{
+    GDir *dir;
+    const gchar *name;
+    guint n_removed = 0;
+
+    g_return_val_if_fail (cache != NULL, 0);
+
+    if ((dir = g_dir_open (cache->path, 0, NULL)) == NULL)
+    {
+        return 0;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        gchar *filename = g_build_filename (cache->path, name, NULL);
+        GStatBuf statbuf;
+
+        if (g_stat (filename, &statbuf) == 0 && S_ISREG (statbuf.st_mode)
+            && is_expired (cache, &statbuf) && g_unlink (filename) == 0)
+        {
+            n_removed++;
+        }
+
+        g_free (filename);
+    }
+
+    g_dir_close (dir);
+
+    return n_removed;
+}
+
+static gchar *
+get_message_key (SoupMessage *message)
+{
+    return soup_uri_to_string (soup_message_get_uri (message), FALSE);
+}
+
+static gboolean
+store_response (const EtCddbCache *cache,
+                const gchar *key,
+                GBytes *bytes)
+{
+    GError *error = NULL;
+
+    if (!is_cacheable (bytes))
+    {
+        return FALSE;
+    }
+
+    if (!et_cddb_cache_store (cache, key, bytes, &error))
+    {
+        g_debug ("Error storing CDDB response in cache: %s", error->message);
+        g_error_free (error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * et_cddb_cache_fetch:
+ * @cache: (allow-none): a cache, or %NULL to always send the request
+ * @session: the session with which to send the request
+ * @message: a GET request
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Get the response to a request from the cache, or send the request and read
+ * the whole response, storing it in the cache. The request is only sent if
+ * the response was not in the cache, so the status of @message should only be
+ * checked on failure.
+ *
+ * Returns: the body of the response, or %NULL and with @error set if the
+ *          request failed
+ */
+GBytes *
+et_cddb_cache_fetch (const EtCddbCache *cache,
+                     SoupSession *session,
+                     SoupMessage *message,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+    gchar *key = NULL;
+    GInputStream *istream;
+    GOutputStream *ostream;
+    GBytes *bytes = NULL;
+
+    g_return_val_if_fail (SOUP_IS_SESSION (session), NULL);
+    g_return_val_if_fail (SOUP_IS_MESSAGE (message), NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    if (cache != NULL)
+    {
+        key = get_message_key (message);
+
+        if ((bytes = et_cddb_cache_lookup (cache, key)) != NULL)
+        {
+            g_free (key);
+            return bytes;
+        }
+    }
+
+    istream = soup_session_send (session, message, cancellable, error);
+
+    if (istream == NULL)
+    {
+        g_free (key);
+        return NULL;
+    }
+
+    if (message->status_code != SOUP_STATUS_OK)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                             message->reason_phrase);
+        g_object_unref (istream);
+        g_free (key);
+        return NULL;
+    }
+
+    ostream = g_memory_output_stream_new_resizable ();
+
+    if (g_output_stream_splice (ostream, istream,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE
+                                | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                cancellable, error) != -1)
+    {
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (ostream));
+
+        if (cache != NULL)
+        {
+            store_response (cache, key, bytes);
+        }
+    }
+
+    g_object_unref (ostream);
+    g_object_unref (istream);
+    g_free (key);
+
+    return bytes;
+}
+
+static void
+et_cddb_prefetch_free (EtCddbPrefetch *prefetch)
+{
+    et_cddb_cache_free (prefetch->cache);
+    g_object_unref (prefetch->session);
+    g_queue_foreach (&prefetch->uris, (GFunc)g_free, NULL);
+    g_queue_clear (&prefetch->uris);
+    g_slice_free (EtCddbPrefetch, prefetch);
+}
+
+static void on_prefetch_sent (GObject *source, GAsyncResult *result,
+                              gpointer user_data);
+
+/*
+ * prefetch_next:
+ * @task: a prefetch
+ *
+ * Send requests until the limit of requests in flight is reached, skipping
+ * those already in the cache, and complete the prefetch once there are no
+ * more requests.
+ */
+static void
+prefetch_next (GTask *task)
+{
+    EtCddbPrefetch *prefetch;
+    GCancellable *cancellable;
+    gchar *uri;
+
+    prefetch = g_task_get_task_data (task);
+    cancellable = g_task_get_cancellable (task);
+
+    while (prefetch->n_active < prefetch->max_requests
+           && (uri = g_queue_pop_head (&prefetch->uris)) != NULL)
+    {
+        EtCddbPrefetchRequest *request;
+        SoupMessage *message;
+        GBytes *bytes;
+        gchar *key;
+
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            g_free (uri);
+            continue;
+        }
+
+        message = soup_message_new (SOUP_METHOD_GET, uri);
+
+        if (message == NULL)
+        {
+            g_debug ("Invalid CDDB request URI: %s", uri);
+            g_free (uri);
+            continue;
+        }
+
+        g_free (uri);
+        key = get_message_key (message);
+
+        if ((bytes = et_cddb_cache_lookup (prefetch->cache, key)) != NULL)
+        {
+            g_bytes_unref (bytes);
+            g_object_unref (message);
+            g_free (key);
+            continue;
+        }
+
+        request = g_slice_new0 (EtCddbPrefetchRequest);
+        request->task = g_object_ref (task);
+        request->message = message;
+        request->key = key;
+
+        prefetch->n_active++;
+        soup_session_send_async (prefetch->session, message, cancellable,
+                                 on_prefetch_sent, request);
+    }
+
+    if (prefetch->n_active == 0)
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+}
+
+static void
+prefetch_request_done (EtCddbPrefetchRequest *request)
+{
+    GTask *task = request->task;
+    EtCddbPrefetch *prefetch = g_task_get_task_data (task);
+
+    g_object_unref (request->message);
+    g_clear_object (&request->ostream);
+    g_free (request->key);
+    g_slice_free (EtCddbPrefetchRequest, request);
+
+    prefetch->n_active--;
+    prefetch_next (task);
+    g_object_unref (task);
+}
+
+static void
+on_prefetch_spliced (GObject *source,
+                     GAsyncResult *result,
+                     gpointer user_data)
+{
+    EtCddbPrefetchRequest *request = user_data;
+    GError *error = NULL;
+
+    if (g_output_stream_splice_finish (G_OUTPUT_STREAM (source), result,
+                                       &error) == -1)
+    {
+        g_debug ("Error reading prefetched CDDB response: %s",
+                 error->message);
+        g_error_free (error);
+    }
+    else
+    {
+        EtCddbPrefetch *prefetch = g_task_get_task_data (request->task);
+        GBytes *bytes;
+
+        bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (source));
+        if (store_response (prefetch->cache, request->key, bytes))
+        {
+            prefetch->n_fetched++;
+        }
+
+        g_bytes_unref (bytes);
+    }
+
+    prefetch_request_done (request);
+}
+
+static void
+on_prefetch_sent (GObject *source,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+    EtCddbPrefetchRequest *request = user_data;
+    GInputStream *istream;
+    GError *error = NULL;
+
+    istream = soup_session_send_finish (SOUP_SESSION (source), result, &error);
+
+    if (istream == NULL)
+    {
+        g_debug ("Error prefetching CDDB response: %s", error->message);
+        g_error_free (error);
+        prefetch_request_done (request);
+        return;
+    }
+
+    if (request->message->status_code != SOUP_STATUS_OK)
+    {
+        g_debug ("Error prefetching CDDB response: %s",
+                 request->message->reason_phrase);
+        g_object_unref (istream);
+        prefetch_request_done (request);
+        return;
+    }
+
+    request->ostream = g_memory_output_stream_new_resizable ();
+    g_output_stream_splice_async (request->ostream, istream,
+                                  G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE
+                                  | G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                  G_PRIORITY_DEFAULT,
+                                  g_task_get_cancellable (request->task),
+                                  on_prefetch_spliced, request);
+    g_object_unref (istream);
+}
+
+/*
+ * et_cddb_cache_prefetch_async:
+ * @cache: a cache
+ * @session: the session with which to send the requests
+ * @uris: a %NULL-terminated array of URIs to fetch
+ * @max_requests: the maximum number of requests to have in flight
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (allow-none): a callback to call when the prefetch is complete
+ * @user_data: user data to pass to @callback
+ *
+ * Fetch the responses to GET requests of @uris which are not yet in the cache,
+ * concurrently, in the order given, and store them in the cache. Failed
+ * requests are skipped, as the request is sent again when the response is
+ * needed.
+ */
+void
+et_cddb_cache_prefetch_async (const EtCddbCache *cache,
+                              SoupSession *session,
+                              const gchar * const *uris,
+                              guint max_requests,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback,
+                              gpointer user_data)
+{
+    EtCddbPrefetch *prefetch;
+    GTask *task;
+    gsize i;
+
+    g_return_if_fail (cache != NULL);
+    g_return_if_fail (SOUP_IS_SESSION (session));
+    g_return_if_fail (uris != NULL);
+    g_return_if_fail (max_requests > 0);
+
+    prefetch = g_slice_new0 (EtCddbPrefetch);
+    prefetch->cache = et_cddb_cache_new (cache->path, cache->lifetime);
+    prefetch->session = g_object_ref (session);
+    g_queue_init (&prefetch->uris);
+    prefetch->max_requests = max_requests;
+
+    for (i = 0; uris[i] != NULL; i++)
+    {
+        g_queue_push_tail (&prefetch->uris, g_strdup (uris[i]));
+    }
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, et_cddb_cache_prefetch_async);
+    g_task_set_task_data (task, prefetch,
+                          (GDestroyNotify)et_cddb_prefetch_free);
+
+    prefetch_next (task);
+    g_object_unref (task);
+}
+
+/*
+ * et_cddb_cache_prefetch_finish:
+ * @result: the result passed to the callback of the prefetch
+ * @n_fetched: (allow-none): a location to store the number of responses which
+ *             were added to the cache, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Returns: %TRUE if the prefetch ran to completion, %FALSE and with @error set
+ *          if it was cancelled
+ */
+gboolean
+et_cddb_cache_prefetch_finish (GAsyncResult *result,
+                               guint *n_fetched,
+                               GError **error)
+{
+    EtCddbPrefetch *prefetch;
+
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result))
+                          == et_cddb_cache_prefetch_async, FALSE);
+
+    prefetch = g_task_get_task_data (G_TASK (result));
+
+    if (n_fetched != NULL)
+    {
+        *n_fetched = prefetch->n_fetched;
+    }
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
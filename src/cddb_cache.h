@@ -0,0 +1,43 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_CDDB_CACHE_H_
+#define ET_CDDB_CACHE_H_
+
+#include <gio/gio.h>
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef struct _EtCddbCache EtCddbCache;
+
+EtCddbCache * et_cddb_cache_new (const gchar *path, gint64 lifetime);
+void et_cddb_cache_free (EtCddbCache *cache);
+
+gint64 et_cddb_cache_get_lifetime (const EtCddbCache *cache);
+GBytes * et_cddb_cache_lookup (const EtCddbCache *cache, const gchar *key);
+gboolean et_cddb_cache_store (const EtCddbCache *cache, const gchar *key, GBytes *bytes, GError **error);
+guint et_cddb_cache_purge (const EtCddbCache *cache);
+
+GBytes * et_cddb_cache_fetch (const EtCddbCache *cache, SoupSession *session, SoupMessage *message, GCancellable *cancellable, GError **error);
+void et_cddb_cache_prefetch_async (const EtCddbCache *cache, SoupSession *session, const gchar * const *uris, guint max_requests, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean et_cddb_cache_prefetch_finish (GAsyncResult *result, guint *n_fetched, GError **error);
+
+G_END_DECLS
+
+#endif /* !ET_CDDB_CACHE_H_ */
@@ -0,0 +1,1449 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "cddb_database.h"
+
+#include <gio/gio.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "charset.h"
+
+/*
+ * The index is a single file, written in native byte order and mapped into
+ * memory when opened. It contains, in order:
+ *    - the entries of the dump, as NUL-terminated text, with the comments
+ *      which are not needed to read the track list removed
+ *    - a pool of NUL-terminated strings: categories, disc titles and words
+ *    - the records, one for each entry
+ *    - the disc IDs of all entries, sorted, as an entry may have several
+ *    - the words of the disc titles, sorted, each with a list of records
+ *    - the record lists of the words
+ *    - the trailer, which locates the sections
+ * The trailer is written last, so that it can be filled in after the entries
+ * have been streamed to the file. Only the trailer is checked when the index
+ * is opened, against its checksum, so that opening does not depend on the
+ * size of the dump; the offsets read from the sections are checked as they
+ * are used.
+ */
+
+#define INDEX_MAGIC "ETCDDBX"
+#define INDEX_VERSION 2
+#define INDEX_BYTE_ORDER 0x01020304
+
+/* Maximum length of the file of an entry. */
+#define MAX_ENTRY_LENGTH (1 << 20)
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 version;
+    guint32 byte_order;
+    gint64 dump_mtime;
+    guint32 n_records;
+    guint32 n_disc_ids;
+    guint32 n_words;
+    guint32 n_postings;
+    guint64 strings_offset;
+    guint64 strings_length;
+    guint64 records_offset;
+    guint64 disc_ids_offset;
+    guint64 words_offset;
+    guint64 postings_offset;
+    guint64 checksum;
+} EtCddbIndexTrailer;
+
+/*
+ * EtCddbIndexRecord:
+ * @data_offset: the offset of the text of the entry in the index
+ * @data_length: the length of the text of the entry, without the nul
+ * @category: the offset of the category in the string pool
+ * @title: the offset of the disc title in the string pool
+ * @disc_id: the disc ID of the entry, from its file name
+ */
+typedef struct
+{
+    guint64 data_offset;
+    guint32 data_length;
+    guint32 category;
+    guint32 title;
+    guint32 disc_id;
+} EtCddbIndexRecord;
+
+typedef struct
+{
+    guint32 disc_id;
+    guint32 record;
+} EtCddbIndexDiscId;
+
+/*
+ * EtCddbIndexWord:
+ * @word: the offset of the casefolded word in the string pool
+ * @first_posting: the index of the first record number of the word
+ * @n_postings: the number of records containing the word
+ */
+typedef struct
+{
+    guint32 word;
+    guint32 first_posting;
+    guint32 n_postings;
+} EtCddbIndexWord;
+
+struct _EtCddbDatabase
+{
+    GMappedFile *file;
+    const gchar *strings;
+    const EtCddbIndexTrailer *trailer;
+    const EtCddbIndexRecord *records;
+    const EtCddbIndexDiscId *disc_ids;
+    const EtCddbIndexWord *words;
+    const guint32 *postings;
+};
+
+/*
+ * EtCddbImport:
+ * The state of an import, with the tables which are kept in memory until the
+ * entries have been written.
+ */
+typedef struct
+{
+    GOutputStream *ostream;
+    guint64 offset;
+    GString *strings;
+    GHashTable *categories;
+    GArray *records;
+    GArray *disc_ids;
+    GHashTable *words;
+} EtCddbImport;
+
+/*
+ * et_cddb_database_error_quark:
+ *
+ * To get EtCddbDatabaseError domain.
+ *
+ * Returns: GQuark for EtCddbDatabaseError domain
+ */
+GQuark
+et_cddb_database_error_quark (void)
+{
+    return g_quark_from_static_string ("et-cddb-database-error-quark");
+}
+
+/*
+ * get_trailer_checksum:
+ * @trailer: a trailer
+ *
+ * Compute the checksum of all the fields of the trailer before the checksum
+ * itself.
+ *
+ * Returns: the first 8 bytes of the SHA-1 digest of the trailer
+ */
+static guint64
+get_trailer_checksum (const EtCddbIndexTrailer *trailer)
+{
+    GChecksum *checksum;
+    guint8 digest[20];
+    gsize digest_length = sizeof (digest);
+    guint64 result;
+
+    checksum = g_checksum_new (G_CHECKSUM_SHA1);
+    g_checksum_update (checksum, (const guchar *)trailer,
+                       G_STRUCT_OFFSET (EtCddbIndexTrailer, checksum));
+    g_checksum_get_digest (checksum, digest, &digest_length);
+    g_checksum_free (checksum);
+
+    memcpy (&result, digest, sizeof (result));
+
+    return result;
+}
+
+/*
+ * get_dump_mtime:
+ * @dump_path: the directory of a freedb dump
+ *
+ * Find the latest modification time of the dump directory and its category
+ * directories, which changes whenever an entry is added or removed.
+ *
+ * Returns: the modification time, or 0 if the dump could not be read
+ */
+static gint64
+get_dump_mtime (const gchar *dump_path)
+{
+    GStatBuf statbuf;
+    GDir *dir;
+    const gchar *name;
+    gint64 mtime;
+
+    if (g_stat (dump_path, &statbuf) != 0)
+    {
+        return 0;
+    }
+
+    mtime = statbuf.st_mtime;
+
+    if ((dir = g_dir_open (dump_path, 0, NULL)) == NULL)
+    {
+        return 0;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        gchar *path = g_build_filename (dump_path, name, NULL);
+
+        if (g_stat (path, &statbuf) == 0 && S_ISDIR (statbuf.st_mode))
+        {
+            mtime = MAX (mtime, (gint64)statbuf.st_mtime);
+        }
+
+        g_free (path);
+    }
+
+    g_dir_close (dir);
+
+    return mtime;
+}
+
+static gboolean
+is_disc_id (const gchar *string)
+{
+    gsize i;
+
+    for (i = 0; i < 8; i++)
+    {
+        if (!g_ascii_isxdigit (string[i]))
+        {
+            return FALSE;
+        }
+    }
+
+    return string[8] == '\0';
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+    return strcmp (*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+static gint
+compare_disc_ids (gconstpointer a,
+                  gconstpointer b)
+{
+    const EtCddbIndexDiscId *id_a = a;
+    const EtCddbIndexDiscId *id_b = b;
+
+    if (id_a->disc_id != id_b->disc_id)
+    {
+        return id_a->disc_id < id_b->disc_id ? -1 : 1;
+    }
+
+    return id_a->record < id_b->record ? -1 : id_a->record > id_b->record;
+}
+
+static guint32
+import_add_string (EtCddbImport *import,
+                   const gchar *string)
+{
+    const guint32 offset = import->strings->len;
+
+    g_string_append_len (import->strings, string, strlen (string) + 1);
+
+    return offset;
+}
+
+/*
+ * tokenize_title:
+ * @title: a disc title
+ *
+ * Split @title into casefolded words, which are runs of alphanumeric
+ * characters. The same words are produced for the index and for searches.
+ *
+ * Returns: a %NULL-terminated array of words, free with g_strfreev()
+ */
+static gchar **
+tokenize_title (const gchar *title)
+{
+    GPtrArray *words;
+    gchar *folded;
+    const gchar *p;
+    const gchar *start = NULL;
+
+    words = g_ptr_array_new ();
+    folded = g_utf8_casefold (title, -1);
+
+    for (p = folded;; p = g_utf8_next_char (p))
+    {
+        const gunichar c = g_utf8_get_char (p);
+
+        if (c != 0 && g_unichar_isalnum (c))
+        {
+            if (start == NULL)
+            {
+                start = p;
+            }
+        }
+        else
+        {
+            if (start != NULL)
+            {
+                g_ptr_array_add (words, g_strndup (start, p - start));
+                start = NULL;
+            }
+
+            if (c == 0)
+            {
+                break;
+            }
+        }
+    }
+
+    g_free (folded);
+    g_ptr_array_add (words, NULL);
+
+    return (gchar **)g_ptr_array_free (words, FALSE);
+}
+
+/*
+ * import_entry:
+ * @import: the state of the import
+ * @category: the category directory of the entry
+ * @disc_id: the disc ID from the file name of the entry
+ * @contents: the UTF-8 text of the entry
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Write the text of an entry to the index, without the comments other than
+ * the track frame offsets and the disc length, and add its disc IDs and the
+ * words of its title to the tables.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set otherwise
+ */
+static gboolean
+import_entry (EtCddbImport *import,
+              const gchar *category,
+              guint32 disc_id,
+              const gchar *contents,
+              GError **error)
+{
+    EtCddbIndexRecord record;
+    EtCddbIndexDiscId id;
+    GString *data;
+    GString *title;
+    gchar **lines;
+    gchar **words;
+    gsize i;
+    gboolean read_track_offset = FALSE;
+    gpointer category_offset;
+    const guint32 record_number = import->records->len;
+
+    if (import->records->len == G_MAXUINT32)
+    {
+        g_set_error (error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_TOO_LARGE, "%s",
+                     _("Too many entries in the CDDB dump"));
+        return FALSE;
+    }
+
+    data = g_string_sized_new (strlen (contents) + 1);
+    title = g_string_new (NULL);
+    lines = g_strsplit (contents, "\n", -1);
+
+    id.record = record_number;
+    id.disc_id = disc_id;
+    g_array_append_val (import->disc_ids, id);
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        gchar *line = lines[i];
+        const gsize length = strlen (line);
+
+        if (length > 0 && line[length - 1] == '\r')
+        {
+            line[length - 1] = '\0';
+        }
+
+        if (line[0] == '#')
+        {
+            if (strstr (line, "Track frame offsets") != NULL)
+            {
+                read_track_offset = TRUE;
+            }
+            else if (read_track_offset && strtoul (line + 1, NULL, 10) > 0)
+            {
+                /* Keep the offset. */
+            }
+            else if (read_track_offset)
+            {
+                /* Keep the line after the offsets, which ends them when the
+                 * entry is read. */
+                read_track_offset = FALSE;
+            }
+            else if (strstr (line, "Disc length: ") == NULL)
+            {
+                continue;
+            }
+        }
+        else if (strncmp (line, "DTITLE=", 7) == 0)
+        {
+            /* Long titles continue on several lines. */
+            g_string_append (title, line + 7);
+        }
+        else if (strncmp (line, "DISCID=", 7) == 0)
+        {
+            gchar **ids = g_strsplit (line + 7, ",", -1);
+            gsize j;
+
+            for (j = 0; ids[j] != NULL; j++)
+            {
+                g_strstrip (ids[j]);
+
+                if (is_disc_id (ids[j]))
+                {
+                    id.disc_id = strtoul (ids[j], NULL, 16);
+
+                    if (id.disc_id != disc_id)
+                    {
+                        g_array_append_val (import->disc_ids, id);
+                    }
+                }
+            }
+
+            g_strfreev (ids);
+        }
+        else if (line[0] == '\0')
+        {
+            continue;
+        }
+
+        g_string_append (data, line);
+        g_string_append_c (data, '\n');
+    }
+
+    g_strfreev (lines);
+
+    record.data_offset = import->offset;
+    record.data_length = data->len;
+    record.disc_id = disc_id;
+
+    if (!g_hash_table_lookup_extended (import->categories, category, NULL,
+                                       &category_offset))
+    {
+        category_offset = GUINT_TO_POINTER (import_add_string (import,
+                                                               category));
+        g_hash_table_insert (import->categories, g_strdup (category),
+                             category_offset);
+    }
+
+    record.category = GPOINTER_TO_UINT (category_offset);
+    record.title = import_add_string (import, title->str);
+    g_array_append_val (import->records, record);
+
+    words = tokenize_title (title->str);
+
+    for (i = 0; words[i] != NULL; i++)
+    {
+        GArray *postings = g_hash_table_lookup (import->words, words[i]);
+
+        if (postings == NULL)
+        {
+            postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+            g_hash_table_insert (import->words, g_strdup (words[i]),
+                                 postings);
+        }
+
+        /* Records are added in order, so only the last needs checking for a
+         * word which occurs twice in a title. */
+        if (postings->len == 0
+            || g_array_index (postings, guint32, postings->len - 1)
+               != record_number)
+        {
+            g_array_append_val (postings, record_number);
+        }
+    }
+
+    g_strfreev (words);
+    g_string_free (title, TRUE);
+
+    if (!g_output_stream_write_all (import->ostream, data->str, data->len + 1,
+                                    NULL, NULL, error))
+    {
+        g_string_free (data, TRUE);
+        return FALSE;
+    }
+
+    import->offset += data->len + 1;
+    g_string_free (data, TRUE);
+
+    return TRUE;
+}
+
+/*
+ * import_category:
+ * @import: the state of the import
+ * @dump_path: the directory of the dump
+ * @category: the name of a category directory in the dump
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Import all the entries of a category, which are stored in files named by
+ * their disc IDs. Other files are ignored.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set otherwise
+ */
+static gboolean
+import_category (EtCddbImport *import,
+                 const gchar *dump_path,
+                 const gchar *category,
+                 GCancellable *cancellable,
+                 GError **error)
+{
+    gchar *path;
+    GDir *dir;
+    GPtrArray *names;
+    const gchar *name;
+    gsize i;
+    gboolean success = TRUE;
+
+    path = g_build_filename (dump_path, category, NULL);
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir == NULL)
+    {
+        g_free (path);
+        return TRUE;
+    }
+
+    names = g_ptr_array_new_with_free_func (g_free);
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        if (is_disc_id (name))
+        {
+            g_ptr_array_add (names, g_ascii_strdown (name, -1));
+        }
+    }
+
+    g_dir_close (dir);
+
+    /* Sort the entries, so that the index does not depend on the order of
+     * the directory. */
+    g_ptr_array_sort (names, compare_strings);
+
+    for (i = 0; success && i < names->len; i++)
+    {
+        gchar *filename;
+        gchar *contents;
+        gsize length;
+
+        if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+            success = FALSE;
+            break;
+        }
+
+        name = g_ptr_array_index (names, i);
+        filename = g_build_filename (path, name, NULL);
+
+        if (g_file_get_contents (filename, &contents, &length, NULL))
+        {
+            /* Old entries are in ISO-8859-1, rather than UTF-8. */
+            if (!g_utf8_validate (contents, length, NULL))
+            {
+                gchar *converted = et_charset_convert (contents, length,
+                                                       "UTF-8",
+                                                       "ISO-8859-1", NULL,
+                                                       NULL, NULL);
+                g_free (contents);
+                contents = converted;
+            }
+
+            /* Skip entries which are too long to be genuine. */
+            if (contents != NULL && length < MAX_ENTRY_LENGTH)
+            {
+                success = import_entry (import, category,
+                                        strtoul (name, NULL, 16), contents,
+                                        error);
+            }
+
+            g_free (contents);
+        }
+
+        g_free (filename);
+    }
+
+    g_ptr_array_unref (names);
+    g_free (path);
+
+    return success;
+}
+
+static gboolean
+write_padding (EtCddbImport *import,
+               GError **error)
+{
+    static const gchar padding[8] = { 0 };
+    const gsize length = (8 - import->offset % 8) % 8;
+
+    if (!g_output_stream_write_all (import->ostream, padding, length, NULL,
+                                    NULL, error))
+    {
+        return FALSE;
+    }
+
+    import->offset += length;
+
+    return TRUE;
+}
+
+static gboolean
+write_section (EtCddbImport *import,
+               gconstpointer data,
+               gsize length,
+               guint64 *offset,
+               GError **error)
+{
+    if (!write_padding (import, error))
+    {
+        return FALSE;
+    }
+
+    *offset = import->offset;
+
+    if (!g_output_stream_write_all (import->ostream, data, length, NULL, NULL,
+                                    error))
+    {
+        return FALSE;
+    }
+
+    import->offset += length;
+
+    return TRUE;
+}
+
+/*
+ * write_tables:
+ * @import: the state of the import, with all the entries written
+ * @trailer: the trailer to fill in with the locations of the tables
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Sort the disc IDs and words, and write them, the records and the string
+ * pool after the entries.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set otherwise
+ */
+static gboolean
+write_tables (EtCddbImport *import,
+              EtCddbIndexTrailer *trailer,
+              GError **error)
+{
+    GPtrArray *sorted_words;
+    GArray *words;
+    GArray *postings;
+    GHashTableIter iter;
+    gpointer key;
+    gsize i;
+    gboolean success = FALSE;
+
+    g_array_sort (import->disc_ids, compare_disc_ids);
+
+    sorted_words = g_ptr_array_sized_new (g_hash_table_size (import->words));
+    g_hash_table_iter_init (&iter, import->words);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        g_ptr_array_add (sorted_words, key);
+    }
+
+    g_ptr_array_sort (sorted_words, compare_strings);
+
+    words = g_array_sized_new (FALSE, FALSE, sizeof (EtCddbIndexWord),
+                               sorted_words->len);
+    postings = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+    for (i = 0; i < sorted_words->len; i++)
+    {
+        const gchar *word = g_ptr_array_index (sorted_words, i);
+        const GArray *word_postings = g_hash_table_lookup (import->words,
+                                                           word);
+        EtCddbIndexWord entry;
+
+        entry.word = import_add_string (import, word);
+        entry.first_posting = postings->len;
+        entry.n_postings = word_postings->len;
+        g_array_append_vals (postings, word_postings->data,
+                             word_postings->len);
+        g_array_append_val (words, entry);
+    }
+
+    if (import->strings->len >= G_MAXUINT32)
+    {
+        g_set_error (error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_TOO_LARGE, "%s",
+                     _("Too many entries in the CDDB dump"));
+        goto out;
+    }
+
+    trailer->n_records = import->records->len;
+    trailer->n_disc_ids = import->disc_ids->len;
+    trailer->n_words = words->len;
+    trailer->n_postings = postings->len;
+    trailer->strings_length = import->strings->len;
+
+    if (write_section (import, import->strings->str, import->strings->len,
+                       &trailer->strings_offset, error)
+        && write_section (import, import->records->data,
+                          import->records->len * sizeof (EtCddbIndexRecord),
+                          &trailer->records_offset, error)
+        && write_section (import, import->disc_ids->data,
+                          import->disc_ids->len * sizeof (EtCddbIndexDiscId),
+                          &trailer->disc_ids_offset, error)
+        && write_section (import, words->data,
+                          words->len * sizeof (EtCddbIndexWord),
+                          &trailer->words_offset, error)
+        && write_section (import, postings->data,
+                          postings->len * sizeof (guint32),
+                          &trailer->postings_offset, error))
+    {
+        success = TRUE;
+    }
+
+out:
+    g_array_free (postings, TRUE);
+    g_array_free (words, TRUE);
+    g_ptr_array_free (sorted_words, TRUE);
+
+    return success;
+}
+
+/*
+ * et_cddb_database_import:
+ * @dump_path: the directory of an extracted freedb dump, with a directory for
+ *             each category
+ * @index_path: the file to write the index to
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Import all the entries of a freedb dump into an index file, which can then
+ * be opened with et_cddb_database_open(). The index replaces @index_path
+ * atomically, so that an existing index remains usable until the import is
+ * complete.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set otherwise
+ */
+gboolean
+et_cddb_database_import (const gchar *dump_path,
+                         const gchar *index_path,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+    EtCddbImport import;
+    EtCddbIndexTrailer trailer;
+    GFile *file;
+    GFileOutputStream *file_ostream;
+    GDir *dir;
+    GPtrArray *categories;
+    const gchar *name;
+    gchar *index_dir;
+    gsize i;
+    gboolean success = TRUE;
+
+    g_return_val_if_fail (dump_path != NULL && index_path != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    memset (&trailer, 0, sizeof (trailer));
+    trailer.dump_mtime = get_dump_mtime (dump_path);
+
+    dir = g_dir_open (dump_path, 0, error);
+
+    if (dir == NULL)
+    {
+        return FALSE;
+    }
+
+    categories = g_ptr_array_new_with_free_func (g_free);
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        g_ptr_array_add (categories, g_strdup (name));
+    }
+
+    g_dir_close (dir);
+    g_ptr_array_sort (categories, compare_strings);
+
+    index_dir = g_path_get_dirname (index_path);
+    g_mkdir_with_parents (index_dir, 0700);
+    g_free (index_dir);
+
+    file = g_file_new_for_path (index_path);
+    file_ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE,
+                                   NULL, error);
+    g_object_unref (file);
+
+    if (!file_ostream)
+    {
+        g_ptr_array_unref (categories);
+        return FALSE;
+    }
+
+    import.ostream = g_buffered_output_stream_new_sized (G_OUTPUT_STREAM (file_ostream),
+                                                         1 << 16);
+    import.offset = 0;
+    import.strings = g_string_sized_new (1 << 16);
+    import.categories = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, NULL);
+    import.records = g_array_new (FALSE, FALSE, sizeof (EtCddbIndexRecord));
+    import.disc_ids = g_array_new (FALSE, FALSE, sizeof (EtCddbIndexDiscId));
+    import.words = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)g_array_unref);
+
+    for (i = 0; success && i < categories->len; i++)
+    {
+        success = import_category (&import, dump_path,
+                                   g_ptr_array_index (categories, i),
+                                   cancellable, error);
+    }
+
+    if (success && import.records->len == 0)
+    {
+        g_set_error (error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_EMPTY,
+                     _("No CDDB entries found in ‘%s’"), dump_path);
+        success = FALSE;
+    }
+
+    if (success)
+    {
+        memcpy (trailer.magic, INDEX_MAGIC, sizeof (trailer.magic));
+        trailer.version = INDEX_VERSION;
+        trailer.byte_order = INDEX_BYTE_ORDER;
+
+        success = write_tables (&import, &trailer, error)
+                  && write_padding (&import, error);
+
+        trailer.checksum = get_trailer_checksum (&trailer);
+
+        success = success
+                  && g_output_stream_write_all (import.ostream, &trailer,
+                                                sizeof (trailer), NULL, NULL,
+                                                error)
+                  && g_output_stream_close (import.ostream, NULL, error);
+    }
+
+    if (!success)
+    {
+        GCancellable *cancellable;
+
+        /* Closing a cancelled replacement leaves the original file. */
+        cancellable = g_cancellable_new ();
+        g_cancellable_cancel (cancellable);
+        g_output_stream_close (G_OUTPUT_STREAM (file_ostream), cancellable,
+                               NULL);
+        g_object_unref (cancellable);
+    }
+
+    g_hash_table_unref (import.words);
+    g_array_free (import.disc_ids, TRUE);
+    g_array_free (import.records, TRUE);
+    g_hash_table_unref (import.categories);
+    g_string_free (import.strings, TRUE);
+    g_object_unref (import.ostream);
+    g_object_unref (file_ostream);
+    g_ptr_array_unref (categories);
+
+    return success;
+}
+
+static gboolean
+check_section (const EtCddbIndexTrailer *trailer,
+               gsize file_length,
+               guint64 offset,
+               guint64 n_elements,
+               gsize element_size)
+{
+    const guint64 end = (guint64)file_length - sizeof (*trailer);
+
+    return offset % 8 == 0 && offset <= end
+           && n_elements <= (end - offset) / element_size;
+}
+
+/*
+ * check_index:
+ * @database: a database with the file mapped and the trailer located
+ *
+ * Check the trailer against its checksum, and that the sections which it
+ * locates are within the file. The records, disc IDs, words and postings are
+ * not read, and are instead checked when they are used.
+ *
+ * Returns: %TRUE if the index is valid, %FALSE otherwise
+ */
+static gboolean
+check_index (EtCddbDatabase *database)
+{
+    const EtCddbIndexTrailer *trailer = database->trailer;
+    const gsize length = g_mapped_file_get_length (database->file);
+    const gchar *contents = g_mapped_file_get_contents (database->file);
+
+    if (memcmp (trailer->magic, INDEX_MAGIC, sizeof (trailer->magic)) != 0
+        || trailer->version != INDEX_VERSION
+        || trailer->byte_order != INDEX_BYTE_ORDER
+        || trailer->checksum != get_trailer_checksum (trailer)
+        || !check_section (trailer, length, trailer->strings_offset,
+                           trailer->strings_length, 1)
+        || trailer->strings_length == 0
+        || !check_section (trailer, length, trailer->records_offset,
+                           trailer->n_records, sizeof (EtCddbIndexRecord))
+        || !check_section (trailer, length, trailer->disc_ids_offset,
+                           trailer->n_disc_ids, sizeof (EtCddbIndexDiscId))
+        || !check_section (trailer, length, trailer->words_offset,
+                           trailer->n_words, sizeof (EtCddbIndexWord))
+        || !check_section (trailer, length, trailer->postings_offset,
+                           trailer->n_postings, sizeof (guint32)))
+    {
+        return FALSE;
+    }
+
+    database->strings = contents + trailer->strings_offset;
+    database->records = (const EtCddbIndexRecord *)(contents
+                                                    + trailer->records_offset);
+    database->disc_ids = (const EtCddbIndexDiscId *)(contents
+                                                     + trailer->disc_ids_offset);
+    database->words = (const EtCddbIndexWord *)(contents
+                                                + trailer->words_offset);
+    database->postings = (const guint32 *)(contents
+                                           + trailer->postings_offset);
+
+    /* So that any offset within the pool is a terminated string. */
+    return database->strings[trailer->strings_length - 1] == '\0';
+}
+
+static EtCddbDatabase *
+open_index (const gchar *index_path,
+            GError **error)
+{
+    EtCddbDatabase *database;
+    GMappedFile *file;
+    gsize length;
+
+    file = g_mapped_file_new (index_path, FALSE, error);
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    length = g_mapped_file_get_length (file);
+
+    /* The trailer is aligned, as all sections are padded to 8 bytes. */
+    if (length < sizeof (EtCddbIndexTrailer)
+        || (length - sizeof (EtCddbIndexTrailer)) % 8 != 0)
+    {
+        g_set_error (error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_INVALID,
+                     _("Invalid CDDB index ‘%s’"), index_path);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    database = g_slice_new0 (EtCddbDatabase);
+    database->file = file;
+    database->trailer = (const EtCddbIndexTrailer *)(g_mapped_file_get_contents (file)
+                                                     + length
+                                                     - sizeof (EtCddbIndexTrailer));
+
+    if (!check_index (database))
+    {
+        g_set_error (error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_INVALID,
+                     _("Invalid CDDB index ‘%s’"), index_path);
+        et_cddb_database_free (database);
+        return NULL;
+    }
+
+    return database;
+}
+
+/*
+ * et_cddb_database_open:
+ * @index_path: the index file of the database
+ * @dump_path: (allow-none): the directory of the freedb dump, or %NULL
+ * @cancellable: (allow-none): a #GCancellable to cancel the import, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Open the index of a local CDDB database, and map it into memory. If
+ * @dump_path is given, the index is first imported from the dump if it is
+ * missing, invalid or older than the dump.
+ *
+ * Returns: the database, to be freed with et_cddb_database_free(), or %NULL
+ *          and with @error set on failure
+ */
+EtCddbDatabase *
+et_cddb_database_open (const gchar *index_path,
+                       const gchar *dump_path,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+    EtCddbDatabase *database;
+    GError *open_error = NULL;
+
+    g_return_val_if_fail (index_path != NULL, NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    database = open_index (index_path, &open_error);
+
+    if (database != NULL && dump_path != NULL
+        && database->trailer->dump_mtime != get_dump_mtime (dump_path))
+    {
+        et_cddb_database_free (database);
+        database = NULL;
+        g_set_error (&open_error, ET_CDDB_DATABASE_ERROR,
+                     ET_CDDB_DATABASE_ERROR_STALE,
+                     _("The CDDB index ‘%s’ is out of date"), index_path);
+    }
+
+    if (database == NULL)
+    {
+        if (dump_path == NULL)
+        {
+            g_propagate_error (error, open_error);
+            return NULL;
+        }
+
+        g_debug ("Importing CDDB dump: %s", open_error->message);
+        g_error_free (open_error);
+
+        if (!et_cddb_database_import (dump_path, index_path, cancellable,
+                                      error))
+        {
+            return NULL;
+        }
+
+        database = open_index (index_path, error);
+    }
+
+    return database;
+}
+
+/*
+ * et_cddb_database_free:
+ * @database: (allow-none): a database, or %NULL
+ *
+ * Unmap and free the database.
+ */
+void
+et_cddb_database_free (EtCddbDatabase *database)
+{
+    if (database == NULL)
+    {
+        return;
+    }
+
+    g_mapped_file_unref (database->file);
+    g_slice_free (EtCddbDatabase, database);
+}
+
+/*
+ * et_cddb_database_get_n_entries:
+ * @database: a database
+ *
+ * Returns: the number of entries in the database
+ */
+guint
+et_cddb_database_get_n_entries (const EtCddbDatabase *database)
+{
+    g_return_val_if_fail (database != NULL, 0);
+
+    return database->trailer->n_records;
+}
+
+/*
+ * get_record:
+ * @database: a database
+ * @record_number: the number of a record, as read from the index
+ *
+ * Returns: the record, or %NULL if it is not in the index or its strings are
+ *          not in the string pool
+ */
+static const EtCddbIndexRecord *
+get_record (const EtCddbDatabase *database,
+            guint32 record_number)
+{
+    const EtCddbIndexTrailer *trailer = database->trailer;
+    const EtCddbIndexRecord *record;
+
+    if (record_number >= trailer->n_records)
+    {
+        return NULL;
+    }
+
+    record = &database->records[record_number];
+
+    if (record->category >= trailer->strings_length
+        || record->title >= trailer->strings_length)
+    {
+        return NULL;
+    }
+
+    return record;
+}
+
+/*
+ * get_word_postings:
+ * @database: a database
+ * @word: a word from the words section of the index
+ *
+ * Returns: the record numbers of @word, or %NULL if they are not in the index
+ */
+static const guint32 *
+get_word_postings (const EtCddbDatabase *database,
+                   const EtCddbIndexWord *word)
+{
+    const guint32 n_postings = database->trailer->n_postings;
+
+    if (word->first_posting > n_postings
+        || word->n_postings > n_postings - word->first_posting)
+    {
+        return NULL;
+    }
+
+    return database->postings + word->first_posting;
+}
+
+static void
+append_entry (const EtCddbDatabase *database,
+              GArray *entries,
+              guint32 record_number)
+{
+    const EtCddbIndexRecord *record = get_record (database, record_number);
+    EtCddbDatabaseEntry entry;
+
+    if (record == NULL)
+    {
+        return;
+    }
+
+    entry.category = database->strings + record->category;
+    entry.disc_id = record->disc_id;
+    entry.title = database->strings + record->title;
+    g_array_append_val (entries, entry);
+}
+
+/*
+ * find_disc_id:
+ * @database: a database
+ * @disc_id: a disc ID
+ *
+ * Returns: the position of the first entry in the disc ID table which is not
+ *          less than @disc_id
+ */
+static gsize
+find_disc_id (const EtCddbDatabase *database,
+              guint32 disc_id)
+{
+    gsize low = 0;
+    gsize high = database->trailer->n_disc_ids;
+
+    while (low < high)
+    {
+        const gsize middle = low + (high - low) / 2;
+
+        if (database->disc_ids[middle].disc_id < disc_id)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+/*
+ * et_cddb_database_lookup:
+ * @database: a database
+ * @disc_id: the disc ID computed from the tracks of a disc
+ *
+ * Find the entries for a disc ID, including entries which list it as one of
+ * several disc IDs.
+ *
+ * Returns: an array of #EtCddbDatabaseEntry, free with g_array_unref()
+ */
+GArray *
+et_cddb_database_lookup (const EtCddbDatabase *database,
+                         guint32 disc_id)
+{
+    GArray *entries;
+    gsize i;
+
+    g_return_val_if_fail (database != NULL, NULL);
+
+    entries = g_array_new (FALSE, FALSE, sizeof (EtCddbDatabaseEntry));
+
+    for (i = find_disc_id (database, disc_id);
+         i < database->trailer->n_disc_ids
+         && database->disc_ids[i].disc_id == disc_id; i++)
+    {
+        append_entry (database, entries, database->disc_ids[i].record);
+    }
+
+    return entries;
+}
+
+static const EtCddbIndexWord *
+find_word (const EtCddbDatabase *database,
+           const gchar *word)
+{
+    gsize low = 0;
+    gsize high = database->trailer->n_words;
+
+    while (low < high)
+    {
+        const gsize middle = low + (high - low) / 2;
+        const EtCddbIndexWord *entry = &database->words[middle];
+        gint cmp;
+
+        if (entry->word >= database->trailer->strings_length)
+        {
+            return NULL;
+        }
+
+        cmp = strcmp (word, database->strings + entry->word);
+
+        if (cmp == 0)
+        {
+            return get_word_postings (database, entry) != NULL ? entry
+                                                              : NULL;
+        }
+        else if (cmp < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return NULL;
+}
+
+static gint
+compare_words_by_postings (gconstpointer a,
+                           gconstpointer b)
+{
+    const EtCddbIndexWord *word_a = *(const EtCddbIndexWord * const *)a;
+    const EtCddbIndexWord *word_b = *(const EtCddbIndexWord * const *)b;
+
+    return word_a->n_postings < word_b->n_postings ? -1
+           : word_a->n_postings > word_b->n_postings;
+}
+
+static gboolean
+has_posting (const EtCddbDatabase *database,
+             const EtCddbIndexWord *word,
+             guint32 record)
+{
+    const guint32 *postings = database->postings + word->first_posting;
+    gsize low = 0;
+    gsize high = word->n_postings;
+
+    while (low < high)
+    {
+        const gsize middle = low + (high - low) / 2;
+
+        if (postings[middle] == record)
+        {
+            return TRUE;
+        }
+        else if (postings[middle] < record)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+has_category (const gchar * const *categories,
+              const gchar *category)
+{
+    gsize i;
+
+    for (i = 0; categories[i] != NULL; i++)
+    {
+        if (strcmp (categories[i], category) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * et_cddb_database_search:
+ * @database: a database
+ * @words: the words to search for, separated by spaces or punctuation
+ * @categories: (allow-none): a %NULL-terminated array of categories to
+ *              search, or %NULL to search all categories
+ * @max_results: the maximum number of entries to return
+ *
+ * Find the entries whose disc title, that is the artist and album, contains
+ * all of @words, ignoring case. The record lists of the words are
+ * intersected, starting from the shortest.
+ *
+ * Returns: an array of #EtCddbDatabaseEntry, in the order of the dump, free
+ *          with g_array_unref()
+ */
+GArray *
+et_cddb_database_search (const EtCddbDatabase *database,
+                         const gchar *words,
+                         const gchar * const *categories,
+                         guint max_results)
+{
+    GArray *entries;
+    GPtrArray *found;
+    gchar **tokens;
+    gsize i;
+
+    g_return_val_if_fail (database != NULL && words != NULL, NULL);
+
+    entries = g_array_new (FALSE, FALSE, sizeof (EtCddbDatabaseEntry));
+    tokens = tokenize_title (words);
+    found = g_ptr_array_new ();
+
+    for (i = 0; tokens[i] != NULL; i++)
+    {
+        const EtCddbIndexWord *word = find_word (database, tokens[i]);
+
+        if (word == NULL)
+        {
+            /* No entry contains all the words. */
+            g_ptr_array_set_size (found, 0);
+            break;
+        }
+
+        g_ptr_array_add (found, (gpointer)word);
+    }
+
+    if (found->len > 0)
+    {
+        const EtCddbIndexWord *shortest;
+
+        g_ptr_array_sort (found, compare_words_by_postings);
+        shortest = g_ptr_array_index (found, 0);
+
+        for (i = 0; i < shortest->n_postings && entries->len < max_results;
+             i++)
+        {
+            const guint32 record = database->postings[shortest->first_posting
+                                                      + i];
+            gsize j;
+
+            for (j = 1; j < found->len; j++)
+            {
+                if (!has_posting (database, g_ptr_array_index (found, j),
+                                  record))
+                {
+                    break;
+                }
+            }
+
+            if (j < found->len)
+            {
+                continue;
+            }
+
+            if (categories != NULL)
+            {
+                const EtCddbIndexRecord *entry = get_record (database,
+                                                             record);
+
+                if (entry == NULL
+                    || !has_category (categories,
+                                      database->strings + entry->category))
+                {
+                    continue;
+                }
+            }
+
+            append_entry (database, entries, record);
+        }
+    }
+
+    g_ptr_array_free (found, TRUE);
+    g_strfreev (tokens);
+
+    return entries;
+}
+
+/*
+ * et_cddb_database_read_entry:
+ * @database: a database
+ * @category: the category of the entry
+ * @disc_id: the disc ID of the entry, as returned by a lookup or search
+ *
+ * Read the text of an entry, in the format of the CDDB "read" command,
+ * without the response code.
+ *
+ * Returns: the text of the entry, or %NULL if there is no such entry. Free
+ *          with g_free()
+ */
+gchar *
+et_cddb_database_read_entry (const EtCddbDatabase *database,
+                             const gchar *category,
+                             guint32 disc_id)
+{
+    const gchar *contents;
+    gsize i;
+
+    g_return_val_if_fail (database != NULL && category != NULL, NULL);
+
+    contents = g_mapped_file_get_contents (database->file);
+
+    for (i = find_disc_id (database, disc_id);
+         i < database->trailer->n_disc_ids
+         && database->disc_ids[i].disc_id == disc_id; i++)
+    {
+        const EtCddbIndexRecord *record;
+
+        record = get_record (database, database->disc_ids[i].record);
+
+        if (record != NULL && record->disc_id == disc_id
+            && strcmp (database->strings + record->category, category) == 0
+            && record->data_offset < database->trailer->strings_offset
+            && record->data_length
+               < database->trailer->strings_offset - record->data_offset)
+        {
+            return g_strndup (contents + record->data_offset,
+                              record->data_length);
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,80 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_CDDB_DATABASE_H_
+#define ET_CDDB_DATABASE_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Error domain and codes for errors with the local CDDB database.
+ */
+GQuark et_cddb_database_error_quark (void);
+
+#define ET_CDDB_DATABASE_ERROR et_cddb_database_error_quark ()
+
+/*
+ * EtCddbDatabaseError:
+ * @ET_CDDB_DATABASE_ERROR_INVALID: the index file is truncated, corrupt or
+ *                                  was written by an incompatible version
+ * @ET_CDDB_DATABASE_ERROR_STALE: the index file is older than the dump
+ * @ET_CDDB_DATABASE_ERROR_EMPTY: the dump does not contain any entries
+ * @ET_CDDB_DATABASE_ERROR_TOO_LARGE: the dump is too large to be indexed
+ *
+ * Errors that can occur when importing or opening a local CDDB database.
+ */
+typedef enum
+{
+    ET_CDDB_DATABASE_ERROR_INVALID,
+    ET_CDDB_DATABASE_ERROR_STALE,
+    ET_CDDB_DATABASE_ERROR_EMPTY,
+    ET_CDDB_DATABASE_ERROR_TOO_LARGE
+} EtCddbDatabaseError;
+
+typedef struct _EtCddbDatabase EtCddbDatabase;
+
+/*
+ * EtCddbDatabaseEntry:
+ * @category: the CDDB category of the entry, such as "rock"
+ * @disc_id: the disc ID of the entry
+ * @title: the disc title of the entry, as "Artist / Album"
+ *
+ * An entry of the local CDDB database, as returned by a lookup or search. The
+ * strings point into the index and are valid until the database is freed.
+ */
+typedef struct
+{
+    const gchar *category;
+    guint32 disc_id;
+    const gchar *title;
+} EtCddbDatabaseEntry;
+
+gboolean et_cddb_database_import (const gchar *dump_path, const gchar *index_path, GCancellable *cancellable, GError **error);
+EtCddbDatabase * et_cddb_database_open (const gchar *index_path, const gchar *dump_path, GCancellable *cancellable, GError **error);
+void et_cddb_database_free (EtCddbDatabase *database);
+
+guint et_cddb_database_get_n_entries (const EtCddbDatabase *database);
+GArray * et_cddb_database_lookup (const EtCddbDatabase *database, guint32 disc_id);
+GArray * et_cddb_database_search (const EtCddbDatabase *database, const gchar *words, const gchar * const *categories, guint max_results);
+gchar * et_cddb_database_read_entry (const EtCddbDatabase *database, const gchar *category, guint32 disc_id);
+
+G_END_DECLS
+
+#endif /* !ET_CDDB_DATABASE_H_ */
@@ -34,6 +34,8 @@
 #include <errno.h>
 
 #include "application_window.h"
+#include "cddb_cache.h"
+#include "cddb_database.h"
 #include "easytag.h"
 #include "enums.h"
 #include "et_core.h"
@@ -46,6 +48,17 @@
 #include "setting.h"
 #include "charset.h"
 
+/*
+ * EtCddbLocalSearch:
+ * @self: the CDDB dialog
+ *
+ * A search which uses the local CDDB database, and which is run again once
+ * the database has been opened.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+typedef gboolean (*EtCddbLocalSearch) (EtCDDBDialog *self);
+
 typedef struct
 {
     GtkWidget *album_list_view;
@@ -97,6 +110,14 @@ typedef struct
     GtkWidget *dlm_check;
 
     SoupSession *session;
+    EtCddbCache *cache;
+    GCancellable *prefetch_cancellable;
+
+    EtCddbDatabase *local_database;
+    gchar *local_database_path;
+    gboolean local_database_failed;
+    GCancellable *local_database_cancellable;
+    EtCddbLocalSearch local_database_search;
 } EtCDDBDialogPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (EtCDDBDialog, et_cddb_dialog, GTK_TYPE_DIALOG)
@@ -196,6 +217,31 @@ static const gchar *cddb_genre_vs_id3_genre [][2] =
 
 static const guint MAX_STRING_LEN = 1024;
 
+/* Number of albums in the search results for which to prefetch the track
+ * list. */
+static const guint MAX_PREFETCH_ALBUMS = 10;
+
+/* Maximum number of requests in flight when prefetching track lists. */
+static const guint MAX_PREFETCH_REQUESTS = 4;
+
+/* Maximum number of albums found by a search of the local database. */
+static const guint MAX_LOCAL_RESULTS = 1000;
+
+/* The CDDB categories, in the order of the EtCddbSearchCategory flags. */
+static const gchar * const cddb_search_categories[] =
+{
+    "blues",
+    "classical",
+    "country",
+    "folk",
+    "jazz",
+    "misc",
+    "newage",
+    "reggae",
+    "rock",
+    "soundtrack"
+};
+
 
 /**************
  * Prototypes *
@@ -246,6 +292,7 @@ update_search_button_sensitivity (EtCDDBDialog *self)
     priv = et_cddb_dialog_get_instance_private (self);
 
     if (priv->manual_search_button
+        && priv->local_database_cancellable == NULL
         && *(gtk_entry_get_text (GTK_ENTRY (priv->search_entry)))
         && (g_settings_get_flags (MainSettings, "cddb-search-fields") != 0)
         && (g_settings_get_flags (MainSettings, "cddb-search-categories") != 0))
@@ -322,37 +369,67 @@ Cddb_Track_List_Row_Selected (EtCDDBDialog *self, GtkTreeSelection *selection)
     /* Unselect files in the main list before re-selecting them... */
     et_application_window_browser_unselect_all (ET_APPLICATION_WINDOW (MainWindow));
 
-    for (l = selectedRows; l != NULL; l = g_list_next (l))
+    if (g_settings_get_boolean (MainSettings, "cddb-dlm-enabled"))
     {
-        GtkTreeIter currentFile;
-        gchar *text_path;
+        GArray *iters;
+        GPtrArray *titles;
+        ET_File **etfiles;
+        guint i;
 
-        if (gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->track_list_model),
-                                     &currentFile, (GtkTreePath*)l->data))
+        iters = g_array_new (FALSE, FALSE, sizeof (GtkTreeIter));
+        titles = g_ptr_array_new_with_free_func (g_free);
+
+        for (l = selectedRows; l != NULL; l = g_list_next (l))
         {
-            if (g_settings_get_boolean (MainSettings, "cddb-dlm-enabled"))
-            {
-                ET_File *etfile;
+            GtkTreeIter currentFile;
+            gchar *title;
 
+            if (gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->track_list_model),
+                                         &currentFile, (GtkTreePath*)l->data))
+            {
                 gtk_tree_model_get (GTK_TREE_MODEL (priv->track_list_model),
                                     &currentFile, CDDB_TRACK_LIST_NAME,
-                                    &text_path, -1);
-                etfile = et_application_window_browser_select_file_by_dlm (ET_APPLICATION_WINDOW (MainWindow),
-                                                                            text_path,
-                                                                            TRUE);
-                gtk_list_store_set (priv->track_list_model, &currentFile,
-                                    CDDB_TRACK_LIST_ETFILE, etfile, -1);
+                                    &title, -1);
+                g_array_append_val (iters, currentFile);
+                g_ptr_array_add (titles, title);
             }
-            else
+        }
+
+        /* Match all the selected tracks against the file list at once. */
+        etfiles = g_new (ET_File *, titles->len);
+        et_application_window_browser_select_files_by_dlm (ET_APPLICATION_WINDOW (MainWindow),
+                                                           (const gchar * const *)titles->pdata,
+                                                           titles->len,
+                                                           etfiles, TRUE);
+
+        for (i = 0; i < titles->len; i++)
+        {
+            gtk_list_store_set (priv->track_list_model,
+                                &g_array_index (iters, GtkTreeIter, i),
+                                CDDB_TRACK_LIST_ETFILE, etfiles[i], -1);
+        }
+
+        g_free (etfiles);
+        g_ptr_array_free (titles, TRUE);
+        g_array_free (iters, TRUE);
+    }
+    else
+    {
+        for (l = selectedRows; l != NULL; l = g_list_next (l))
+        {
+            GtkTreeIter currentFile;
+            gchar *text_path;
+
+            if (gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->track_list_model),
+                                         &currentFile, (GtkTreePath*)l->data))
             {
                 text_path = gtk_tree_model_get_string_from_iter (GTK_TREE_MODEL (priv->track_list_model),
                                                                  &currentFile);
                 et_application_window_browser_select_file_by_iter_string (ET_APPLICATION_WINDOW (MainWindow),
                                                                           text_path,
                                                                           TRUE);
+                g_free (text_path);
             }
-
-            g_free (text_path);
         }
     }
 
@@ -574,21 +651,6 @@ cddb_track_frame_offset_free (CddbTrackFrameOffset *offset)
     g_slice_free (CddbTrackFrameOffset, offset);
 }
 
-/*
- * check_message_successful:
- * @message: the message on which to check for success
- *
- * Check the result of @message to see whether it was a success. Soup handles
- * redirects, so that the result code is that of the final request.
- *
- * Returns: %TRUE if the request was successful, %FALSE otherwise
- */
-static gboolean
-check_message_successful (SoupMessage *message)
-{
-    return message->status_code == SOUP_STATUS_OK;
-}
-
 /*
  * read_cddb_result_line:
  * @dstream: a #GDataInputStream corresponding to a CDDB result, with the line
@@ -730,6 +792,435 @@ log_message_from_request_error (SoupMessage *message,
     return msg;
 }
 
+/*
+ * get_cache:
+ * @self: the CDDB dialog
+ *
+ * Get the cache of server responses, in which responses are kept for the
+ * number of days in the "cddb-cache-days" key. Expired responses are removed
+ * when the cache is first used.
+ *
+ * Returns: the cache, or %NULL if responses should not be cached
+ */
+static EtCddbCache *
+get_cache (EtCDDBDialog *self)
+{
+    EtCDDBDialogPrivate *priv;
+    guint days;
+    gint64 lifetime;
+    gchar *path;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    days = g_settings_get_uint (MainSettings, "cddb-cache-days");
+    lifetime = (gint64)days * 24 * 60 * 60;
+
+    if (priv->cache && et_cddb_cache_get_lifetime (priv->cache) == lifetime)
+    {
+        return priv->cache;
+    }
+
+    et_cddb_cache_free (priv->cache);
+    priv->cache = NULL;
+
+    if (days == 0)
+    {
+        return NULL;
+    }
+
+    path = g_build_filename (g_get_user_cache_dir (), PACKAGE_TARNAME, "cddb",
+                             NULL);
+    priv->cache = et_cddb_cache_new (path, lifetime);
+    et_cddb_cache_purge (priv->cache);
+    g_free (path);
+
+    return priv->cache;
+}
+
+/*
+ * send_cddb_request:
+ * @self: the CDDB dialog
+ * @message: the request to send
+ * @cancellable: a #GCancellable for the operation
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Get the response to @message from the cache, or send it and wait for the
+ * whole response.
+ *
+ * Returns: a stream of the response body, or %NULL and with @error set if the
+ *          request failed, in which case the status of @message is set
+ */
+static GInputStream *
+send_cddb_request (EtCDDBDialog *self,
+                   SoupMessage *message,
+                   GCancellable *cancellable,
+                   GError **error)
+{
+    EtCDDBDialogPrivate *priv;
+    GBytes *bytes;
+    GInputStream *istream;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    bytes = et_cddb_cache_fetch (get_cache (self), priv->session, message,
+                                 cancellable, error);
+
+    if (bytes == NULL)
+    {
+        return NULL;
+    }
+
+    istream = g_memory_input_stream_new_from_bytes (bytes);
+    g_bytes_unref (bytes);
+
+    return istream;
+}
+
+/*
+ * cddb_album_get_read_uri:
+ * @cddbalbum: an album found on a server
+ *
+ * Returns: the URI of the request for the track list of the album
+ */
+static gchar *
+cddb_album_get_read_uri (const CddbAlbum *cddbalbum)
+{
+    if (strstr (cddbalbum->server_name, "gnudb") != NULL)
+    {
+        /* For gnudb. */
+        return g_strdup_printf ("http://%s:%u/gnudb/%s/%s",
+                                cddbalbum->server_name,
+                                cddbalbum->server_port, cddbalbum->category,
+                                cddbalbum->id);
+    }
+    else
+    {
+        /* CDDB Request (ex: GET /~cddb/cddb.cgi?cmd=cddb+read+jazz+0200a401&hello=noname+localhost+EasyTAG+0.31&proto=1 HTTP/1.1\r\nHost: freedb.freedb.org:80\r\nConnection: close). */
+        return g_strdup_printf ("http://%s:%u%s?cmd=cddb+read+%s+%s&hello=noname+localhost+%s+%s&proto=6",
+                                cddbalbum->server_name,
+                                cddbalbum->server_port,
+                                cddbalbum->server_cgi_path,
+                                cddbalbum->category, cddbalbum->id,
+                                PACKAGE_NAME, PACKAGE_VERSION);
+    }
+}
+
+/*
+ * prefetch_album_tracks:
+ * @self: the CDDB dialog
+ *
+ * Fetch the track lists of the first albums of the album list into the cache,
+ * concurrently and in the background, so that they can be shown as soon as an
+ * album is selected. Any previous prefetch is cancelled.
+ */
+static void
+prefetch_album_tracks (EtCDDBDialog *self)
+{
+    EtCDDBDialogPrivate *priv;
+    EtCddbCache *cache;
+    GPtrArray *uris;
+    GList *l;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    if (priv->prefetch_cancellable)
+    {
+        g_cancellable_cancel (priv->prefetch_cancellable);
+        g_clear_object (&priv->prefetch_cancellable);
+    }
+
+    if ((cache = get_cache (self)) == NULL)
+    {
+        return;
+    }
+
+    uris = g_ptr_array_new_with_free_func (g_free);
+
+    for (l = priv->album_list; l != NULL && uris->len < MAX_PREFETCH_ALBUMS;
+         l = g_list_next (l))
+    {
+        const CddbAlbum *cddbalbum = l->data;
+
+        /* Albums from the local database are read from the index. */
+        if (cddbalbum->server_name != NULL && cddbalbum->track_list == NULL)
+        {
+            g_ptr_array_add (uris, cddb_album_get_read_uri (cddbalbum));
+        }
+    }
+
+    g_ptr_array_add (uris, NULL);
+
+    if (uris->len > 1)
+    {
+        priv->prefetch_cancellable = g_cancellable_new ();
+        et_cddb_cache_prefetch_async (cache, priv->session,
+                                      (const gchar * const *)uris->pdata,
+                                      MAX_PREFETCH_REQUESTS,
+                                      priv->prefetch_cancellable, NULL, NULL);
+    }
+
+    g_ptr_array_free (uris, TRUE);
+}
+
+static void
+open_local_database_thread (GTask *task,
+                            gpointer source_object,
+                            gpointer task_data,
+                            GCancellable *cancellable)
+{
+    const gchar *dump_path = task_data;
+    gchar *index_path;
+    EtCddbDatabase *database;
+    GError *error = NULL;
+
+    index_path = g_build_filename (g_get_user_cache_dir (), PACKAGE_TARNAME,
+                                   "cddb.index", NULL);
+    database = et_cddb_database_open (index_path, dump_path, cancellable,
+                                      &error);
+    g_free (index_path);
+
+    if (database == NULL)
+    {
+        g_task_return_error (task, error);
+    }
+    else
+    {
+        g_task_return_pointer (task, database,
+                               (GDestroyNotify)et_cddb_database_free);
+    }
+}
+
+static void
+set_search_widgets_sensitive (EtCDDBDialog *self,
+                              gboolean sensitive)
+{
+    EtCDDBDialogPrivate *priv;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    gtk_widget_set_sensitive (priv->search_entry, sensitive);
+    gtk_widget_set_sensitive (priv->automatic_search_button, sensitive);
+
+    if (sensitive)
+    {
+        update_search_button_sensitivity (self);
+    }
+    else
+    {
+        gtk_widget_set_sensitive (priv->manual_search_button, FALSE);
+    }
+}
+
+static void
+on_local_database_opened (GObject *source_object,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+    EtCDDBDialog *self;
+    EtCDDBDialogPrivate *priv;
+    EtCddbDatabase *database;
+    EtCddbLocalSearch search;
+    GError *error = NULL;
+
+    database = g_task_propagate_pointer (G_TASK (result), &error);
+
+    /* The dialog has been disposed of, so do not touch it. */
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        g_error_free (error);
+        return;
+    }
+
+    self = ET_CDDB_DIALOG (source_object);
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    g_clear_object (&priv->local_database_cancellable);
+    search = priv->local_database_search;
+    priv->local_database_search = NULL;
+    set_search_widgets_sensitive (self, TRUE);
+
+    if (database == NULL)
+    {
+        gchar *msg;
+
+        msg = g_strdup_printf (_("Cannot open local CDDB database ‘%s’: %s"),
+                               priv->local_database_path, error->message);
+        gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
+                            priv->status_bar_context, msg);
+        Log_Print (LOG_ERROR, "%s", msg);
+        g_free (msg);
+        g_error_free (error);
+
+        /* Search without the local database, rather than failing again,
+         * until its path is changed. */
+        priv->local_database_failed = TRUE;
+    }
+    else
+    {
+        priv->local_database = database;
+    }
+
+    if (search != NULL)
+    {
+        search (self);
+    }
+}
+
+/*
+ * get_local_database:
+ * @self: the CDDB dialog
+ * @search: the search to run again once the database has been opened
+ * @database: (out): return location for the local database, which is %NULL
+ *            if there is none
+ *
+ * Get the local CDDB database, which is a freedb dump in the directory set in
+ * the "cddb-local-path" key. If the database is not open yet, it is opened in
+ * a thread, building its index if it is missing or out of date, which takes a
+ * while for a full dump. The search widgets are insensitive until it is open,
+ * and then @search is called.
+ *
+ * Returns: %TRUE if @database was set, %FALSE if the database is being opened
+ */
+static gboolean
+get_local_database (EtCDDBDialog *self,
+                    EtCddbLocalSearch search,
+                    EtCddbDatabase **database)
+{
+    EtCDDBDialogPrivate *priv;
+    GTask *task;
+    gchar *dump_path;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    *database = NULL;
+
+    if (priv->local_database_cancellable != NULL)
+    {
+        priv->local_database_search = search;
+        return FALSE;
+    }
+
+    dump_path = g_settings_get_string (MainSettings, "cddb-local-path");
+
+    if (g_strcmp0 (dump_path, priv->local_database_path) == 0
+        && (priv->local_database != NULL || priv->local_database_failed))
+    {
+        g_free (dump_path);
+        *database = priv->local_database;
+        return TRUE;
+    }
+
+    et_cddb_database_free (priv->local_database);
+    priv->local_database = NULL;
+    priv->local_database_failed = FALSE;
+    g_free (priv->local_database_path);
+    priv->local_database_path = NULL;
+
+    if (et_str_empty (dump_path))
+    {
+        g_free (dump_path);
+        return TRUE;
+    }
+
+    gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
+                        priv->status_bar_context,
+                        _("Loading local CDDB database…"));
+
+    priv->local_database_path = dump_path;
+    priv->local_database_search = search;
+    priv->local_database_cancellable = g_cancellable_new ();
+    set_search_widgets_sensitive (self, FALSE);
+
+    task = g_task_new (self, priv->local_database_cancellable,
+                       on_local_database_opened, NULL);
+    g_task_set_source_tag (task, get_local_database);
+    g_task_set_task_data (task, g_strdup (dump_path), g_free);
+    g_task_run_in_thread (task, open_local_database_thread);
+    g_object_unref (task);
+
+    return FALSE;
+}
+
+/*
+ * add_local_albums:
+ * @self: the CDDB dialog
+ * @entries: an array of #EtCddbDatabaseEntry from the local database
+ *
+ * Add the entries to the album list. Albums from the local database have no
+ * server.
+ */
+static void
+add_local_albums (EtCDDBDialog *self,
+                  const GArray *entries)
+{
+    EtCDDBDialogPrivate *priv;
+    GList *albums = NULL;
+    guint i;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    for (i = 0; i < entries->len; i++)
+    {
+        const EtCddbDatabaseEntry *entry;
+        CddbAlbum *cddbalbum;
+
+        entry = &g_array_index (entries, EtCddbDatabaseEntry, i);
+        cddbalbum = g_slice_new0 (CddbAlbum);
+        cddbalbum->category = g_strdup (entry->category);
+        cddbalbum->id = g_strdup_printf ("%08x", entry->disc_id);
+        cddbalbum->artist_album = g_strdup (entry->title);
+
+        albums = g_list_prepend (albums, cddbalbum);
+    }
+
+    priv->album_list = g_list_concat (priv->album_list,
+                                      g_list_reverse (albums));
+}
+
+/*
+ * read_local_cddb_entry:
+ * @self: the CDDB dialog
+ * @cddbalbum: an album found in the local database
+ *
+ * Read the entry of an album from the local database, in place of sending a
+ * read request to a server.
+ *
+ * Returns: a stream of the entry, or %NULL if it could not be read
+ */
+static GInputStream *
+read_local_cddb_entry (EtCDDBDialog *self,
+                       const CddbAlbum *cddbalbum)
+{
+    EtCDDBDialogPrivate *priv;
+    gchar *entry = NULL;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    /* The album was found in the database, so it is already open. */
+    if (priv->local_database != NULL)
+    {
+        entry = et_cddb_database_read_entry (priv->local_database,
+                                             cddbalbum->category,
+                                             strtoul (cddbalbum->id, NULL,
+                                                      16));
+    }
+
+    if (entry == NULL)
+    {
+        gchar *msg;
+
+        msg = g_strdup_printf (_("Cannot find album ‘%s’ in the local CDDB database"),
+                               cddbalbum->id);
+        gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
+                            priv->status_bar_context, msg);
+        Log_Print (LOG_ERROR, "%s", msg);
+        g_free (msg);
+        return NULL;
+    }
+
+    return g_memory_input_stream_new_from_data (entry, -1, g_free);
+}
+
 /*
  * Look up a specific album in freedb, and save to a CddbAlbum structure
  */
@@ -743,8 +1234,6 @@ Cddb_Get_Album_Tracks_List (EtCDDBDialog *self, GtkTreeSelection* selection)
     gchar *cddb_out = NULL;
     gchar *msg, *copy, *valid;
     gchar     *cddb_server_name;
-    guint cddb_server_port;
-    gchar     *cddb_server_cgi_path;
     gboolean   read_track_offset = FALSE;
     GtkTreeIter row;
     SoupMessage *message;
@@ -774,59 +1263,57 @@ Cddb_Get_Album_Tracks_List (EtCDDBDialog *self, GtkTreeSelection* selection)
 
     // Parameters of the server used
     cddb_server_name     = cddbalbum->server_name;
-    cddb_server_port     = cddbalbum->server_port;
-    cddb_server_cgi_path = cddbalbum->server_cgi_path;
 
 
-    /* Connection to the server. */
-    if (strstr (cddb_server_name, "gnudb") != NULL)
+    if (cddb_server_name == NULL)
     {
-        /* For gnudb. */
-        uri = g_strdup_printf ("http://%s:%u/gnudb/%s/%s", cddb_server_name,
-                               cddb_server_port, cddbalbum->category,
-                               cddbalbum->id);
+        /* Local access. */
+        if ((istream = read_local_cddb_entry (self, cddbalbum)) == NULL)
+        {
+            return FALSE;
+        }
+
+        message = NULL;
+        cancellable = g_cancellable_new ();
     }
     else
     {
-        /* CDDB Request (ex: GET /~cddb/cddb.cgi?cmd=cddb+read+jazz+0200a401&hello=noname+localhost+EasyTAG+0.31&proto=1 HTTP/1.1\r\nHost: freedb.freedb.org:80\r\nConnection: close). */
-        uri = g_strdup_printf ("http://%s:%u%s?cmd=cddb+read+%s+%s&hello=noname+localhost+%s+%s&proto=6",
-                               cddb_server_name, cddb_server_port,
-                               cddb_server_cgi_path, cddbalbum->category,
-                               cddbalbum->id, PACKAGE_NAME, PACKAGE_VERSION);
-    }
+        /* Connection to the server. */
+        uri = cddb_album_get_read_uri (cddbalbum);
 
-    /* Send the request. */
-    gtk_statusbar_push(GTK_STATUSBAR(priv->status_bar),priv->status_bar_context,_("Sending request…"));
-    while (gtk_events_pending()) gtk_main_iteration();
+        /* Send the request. */
+        gtk_statusbar_push(GTK_STATUSBAR(priv->status_bar),priv->status_bar_context,_("Sending request…"));
+        while (gtk_events_pending()) gtk_main_iteration();
 
-    /* Write result in a file. */
-    message = soup_message_new (SOUP_METHOD_GET, uri);
+        /* Write result in a file. */
+        message = soup_message_new (SOUP_METHOD_GET, uri);
 
-    if (!message)
-    {
-        g_critical ("Invalid CDDB request URI: %s", uri);
-        g_free (uri);
-        return FALSE;
-    }
+        if (!message)
+        {
+            g_critical ("Invalid CDDB request URI: %s", uri);
+            g_free (uri);
+            return FALSE;
+        }
 
-    g_free (uri);
+        g_free (uri);
 
-    cancellable = g_cancellable_new ();
-    istream = soup_session_send (priv->session, message, cancellable,
-                                 &error);
+        cancellable = g_cancellable_new ();
+        istream = send_cddb_request (self, message, cancellable,
+                                     &error);
 
-    if (!check_message_successful (message))
-    {
-        msg = log_message_from_request_error (message, error);
-        gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
-                            priv->status_bar_context, msg);
-        Log_Print (LOG_ERROR, "%s", msg);
-        g_free (msg);
-        g_error_free (error);
-        g_object_unref (cancellable);
-        g_object_unref (message);
-        gtk_widget_set_sensitive (GTK_WIDGET (priv->stop_search_button),FALSE);
-        return FALSE;
+        if (istream == NULL)
+        {
+            msg = log_message_from_request_error (message, error);
+            gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
+                                priv->status_bar_context, msg);
+            Log_Print (LOG_ERROR, "%s", msg);
+            g_free (msg);
+            g_error_free (error);
+            g_object_unref (cancellable);
+            g_object_unref (message);
+            gtk_widget_set_sensitive (GTK_WIDGET (priv->stop_search_button),FALSE);
+            return FALSE;
+        }
     }
 
     dstream = g_data_input_stream_new (istream);
@@ -835,7 +1322,7 @@ Cddb_Get_Album_Tracks_List (EtCDDBDialog *self, GtkTreeSelection* selection)
                                           G_DATA_STREAM_NEWLINE_TYPE_ANY);
 
     /* Parse server answer: Check CDDB Header (freedb only). */
-    if (strstr (cddb_server_name, "gnudb") == NULL)
+    if (cddb_server_name != NULL && strstr (cddb_server_name, "gnudb") == NULL)
     {
         /* For freedb. */
         if (!read_cddb_header_line (dstream, cancellable, &cddb_out))
@@ -848,7 +1335,7 @@ Cddb_Get_Album_Tracks_List (EtCDDBDialog *self, GtkTreeSelection* selection)
 
             g_object_unref (dstream);
             g_object_unref (cancellable);
-            g_object_unref (message);
+            g_clear_object (&message);
             g_free (msg);
             g_free (cddb_out);
 
@@ -1024,11 +1511,10 @@ Cddb_Get_Album_Tracks_List (EtCDDBDialog *self, GtkTreeSelection* selection)
         g_free(cddb_out);
     }
 
-    /* Remote access. */
     /* Close connection */
     g_object_unref (dstream);
     g_object_unref (cancellable);
-    g_object_unref (message);
+    g_clear_object (&message);
 
     /* Set color of the selected row (without reloading the whole list) */
     Cddb_Album_List_Set_Row_Appearance (self, &row);
@@ -1147,7 +1633,7 @@ Cddb_Free_Album_List (EtCDDBDialog *self)
         {
             g_free(cddbalbum->server_name);
             g_free (cddbalbum->server_cgi_path);
-            g_object_unref(cddbalbum->bitmap);
+            g_clear_object (&cddbalbum->bitmap);
 
             g_free(cddbalbum->artist_album);
             g_free(cddbalbum->category);
@@ -1345,16 +1831,26 @@ Cddb_Search_Album_List_From_String_Freedb (EtCDDBDialog *self)
 
     g_free(string);
     g_free(tmp);
+
+    if (!message)
+    {
+        g_critical ("Invalid CDDB request URI: %s", cddb_in);
+        g_free (cddb_in);
+        g_free (cddb_server_name);
+        g_free (cddb_server_cgi_path);
+        return FALSE;
+    }
+
     g_free (cddb_in);
     //g_print("Request Cddb_Search_Album_List_From_String_Freedb : '%s'\n", cddb_in);
 
     /* Send the request. */
-    cancellable = g_cancellable_new ();
-    istream = soup_session_send (priv->session, message, cancellable, &error);
     gtk_statusbar_push(GTK_STATUSBAR(priv->status_bar),priv->status_bar_context,_("Sending request…"));
     while (gtk_events_pending()) gtk_main_iteration();
+    cancellable = g_cancellable_new ();
+    istream = send_cddb_request (self, message, cancellable, &error);
 
-    if (!check_message_successful (message))
+    if (istream == NULL)
     {
         msg = log_message_from_request_error (message, error);
         gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
@@ -1532,6 +2028,7 @@ Cddb_Search_Album_List_From_String_Freedb (EtCDDBDialog *self)
 
     /* Load the albums found in the list. */
     Cddb_Load_Album_List (self, FALSE);
+    prefetch_album_tracks (self);
 
     return TRUE;
 }
@@ -1643,10 +2140,10 @@ Cddb_Search_Album_List_From_String_Gnudb (EtCDDBDialog *self)
         while (gtk_events_pending()) gtk_main_iteration();
 
         cancellable = g_cancellable_new ();
-        istream = soup_session_send (priv->session, message, cancellable,
+        istream = send_cddb_request (self, message, cancellable,
                                      &error);
 
-        if (!check_message_successful (message))
+        if (istream == NULL)
         {
             msg = log_message_from_request_error (message, error);
             gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
@@ -1858,6 +2355,82 @@ Cddb_Search_Album_List_From_String_Gnudb (EtCDDBDialog *self)
     gtk_statusbar_push(GTK_STATUSBAR(priv->status_bar),priv->status_bar_context,msg);
     g_free(msg);
 
+    /* Load the albums found in the list. */
+    Cddb_Load_Album_List (self, FALSE);
+    prefetch_album_tracks (self);
+
+    return TRUE;
+}
+
+/*
+ * Local database - Manual Search
+ * Search the artist and album names of the local database for the words, in
+ * the selected categories. Returns FALSE if no album was found.
+ */
+static gboolean
+Cddb_Search_Album_List_From_String_Local (EtCDDBDialog *self,
+                                          EtCddbDatabase *database)
+{
+    EtCDDBDialogPrivate *priv;
+    const gchar *categories[G_N_ELEMENTS (cddb_search_categories) + 1];
+    const gchar *words;
+    guint search_categories;
+    GArray *entries;
+    gsize i;
+    gsize n_categories = 0;
+    gchar *msg;
+
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    words = gtk_entry_get_text (GTK_ENTRY (priv->search_entry));
+
+    if (et_str_empty (words))
+    {
+        return FALSE;
+    }
+
+    search_categories = g_settings_get_flags (MainSettings,
+                                              "cddb-search-categories");
+
+    for (i = 0; i < G_N_ELEMENTS (cddb_search_categories); i++)
+    {
+        if (search_categories & (1 << i))
+        {
+            categories[n_categories++] = cddb_search_categories[i];
+        }
+    }
+
+    categories[n_categories] = NULL;
+
+    entries = et_cddb_database_search (database, words, categories,
+                                       MAX_LOCAL_RESULTS);
+
+    if (entries->len == 0)
+    {
+        g_array_unref (entries);
+        return FALSE;
+    }
+
+    /* Delete previous album list. */
+    cddb_album_model_clear (self);
+    cddb_track_model_clear (self);
+
+    if (priv->album_list)
+    {
+        Cddb_Free_Album_List (self);
+    }
+
+    add_local_albums (self, entries);
+    g_array_unref (entries);
+
+    msg = g_strdup_printf (ngettext ("Found one matching album",
+                                     "Found %u matching albums",
+                                     g_list_length (priv->album_list)),
+                           g_list_length (priv->album_list));
+    gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
+                        priv->status_bar_context, msg);
+    g_free (msg);
+
     /* Load the albums found in the list. */
     Cddb_Load_Album_List (self, FALSE);
 
@@ -1866,14 +2439,31 @@ Cddb_Search_Album_List_From_String_Gnudb (EtCDDBDialog *self)
 
 /*
  * Select the function to use according the server adress for the manual search
+ *      - the local database, if there is one and it has matching albums
  *      - freedb.freedb.org
  *      - gnudb.gnudb.org
  */
 static gboolean
 Cddb_Search_Album_List_From_String (EtCDDBDialog *self)
 {
-    gchar *hostname = g_settings_get_string (MainSettings,
-                                             "cddb-manual-search-hostname");
+    EtCddbDatabase *database;
+    gchar *hostname;
+
+    if (!get_local_database (self, Cddb_Search_Album_List_From_String,
+                             &database))
+    {
+        /* The search is run again once the database is open. */
+        return TRUE;
+    }
+
+    if (database != NULL
+        && Cddb_Search_Album_List_From_String_Local (self, database))
+    {
+        return TRUE;
+    }
+
+    hostname = g_settings_get_string (MainSettings,
+                                      "cddb-manual-search-hostname");
 
     if (strstr (hostname, "gnudb") != NULL)
     {
@@ -1891,95 +2481,94 @@ Cddb_Search_Album_List_From_String (EtCDDBDialog *self)
 
 /*
  * set_et_file_from_cddb_album:
+ * @edit: the change of the tags of the files
  * @etfile: an ET_File on which to set values
  * @cddbtrackalbum: a CddbTrackAlbum from which to take values
  * @set_fields: flags value for the fields to set
  * @list_length: length of the CDDB album data (in tracks)
  *
  * Set the values obtained from CDDB and stored in @cddbtrackalbum to the
- * given @etfile.
+ * given @etfile. The tag fields are added to @edit, and the filename is
+ * changed immediately.
  */
 static void
-set_et_file_from_cddb_album (ET_File * etfile,
+set_et_file_from_cddb_album (EtFileTagEdit *edit,
+                             ET_File * etfile,
                              CddbTrackAlbum *cddbtrackalbum,
                              guint set_fields,
                              guint list_length)
 {
-    File_Tag *FileTag = NULL;
     File_Name *FileName = NULL;
 
     g_return_if_fail (etfile != NULL);
     g_return_if_fail (cddbtrackalbum != NULL);
 
-    if (set_fields != 0)
+    if (set_fields & ET_CDDB_SET_FIELD_TITLE)
     {
-        /* Allocation of a new FileTag. */
-        FileTag = et_file_tag_new ();
-        et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-
-        if (set_fields & ET_CDDB_SET_FIELD_TITLE)
-        {
-            et_file_tag_set_title (FileTag,
-                                   cddbtrackalbum->track_name);
-        }
+        et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_TITLE,
+                                    cddbtrackalbum->track_name);
+    }
 
-        if ((set_fields & ET_CDDB_SET_FIELD_ARTIST)
-            && cddbtrackalbum->cddbalbum->artist)
-        {
-            et_file_tag_set_artist (FileTag,
+    if ((set_fields & ET_CDDB_SET_FIELD_ARTIST)
+        && cddbtrackalbum->cddbalbum->artist)
+    {
+        et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_ARTIST,
                                     cddbtrackalbum->cddbalbum->artist);
-        }
+    }
 
-        if ((set_fields & ET_CDDB_SET_FIELD_ALBUM)
-            && cddbtrackalbum->cddbalbum->album)
-        {
-            et_file_tag_set_album (FileTag,
-                                   cddbtrackalbum->cddbalbum->album);
-        }
+    if ((set_fields & ET_CDDB_SET_FIELD_ALBUM)
+        && cddbtrackalbum->cddbalbum->album)
+    {
+        et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_ALBUM,
+                                    cddbtrackalbum->cddbalbum->album);
+    }
 
-        if ((set_fields & ET_CDDB_SET_FIELD_YEAR)
-            && cddbtrackalbum->cddbalbum->year)
-        {
-            et_file_tag_set_year (FileTag,
-                                  cddbtrackalbum->cddbalbum->year);
-        }
+    if ((set_fields & ET_CDDB_SET_FIELD_YEAR)
+        && cddbtrackalbum->cddbalbum->year)
+    {
+        et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_YEAR,
+                                    cddbtrackalbum->cddbalbum->year);
+    }
 
-        if (set_fields & ET_CDDB_SET_FIELD_TRACK)
-        {
-            gchar *track_number;
+    if (set_fields & ET_CDDB_SET_FIELD_TRACK)
+    {
+        gchar *track_number;
 
-            track_number = et_track_number_to_string (cddbtrackalbum->track_number);
+        track_number = et_track_number_to_string (cddbtrackalbum->track_number);
 
-            et_file_tag_set_track_number (FileTag, track_number);
+        et_file_tag_edit_set_field (edit, etfile,
+                                    ET_FILE_TAG_FIELD_TRACK_NUMBER,
+                                    track_number);
 
-            g_free (track_number);
-        }
+        g_free (track_number);
+    }
 
-        if (set_fields & ET_CDDB_SET_FIELD_TRACK_TOTAL)
-        {
-            gchar *track_total;
+    if (set_fields & ET_CDDB_SET_FIELD_TRACK_TOTAL)
+    {
+        gchar *track_total;
 
-            track_total = et_track_number_to_string (list_length);
+        track_total = et_track_number_to_string (list_length);
 
-            et_file_tag_set_track_total (FileTag, track_total);
+        et_file_tag_edit_set_field (edit, etfile,
+                                    ET_FILE_TAG_FIELD_TRACK_TOTAL,
+                                    track_total);
 
-            g_free (track_total);
-        }
+        g_free (track_total);
+    }
 
-        if ((set_fields & ET_CDDB_SET_FIELD_GENRE)
-            && (cddbtrackalbum->cddbalbum->genre
-                || cddbtrackalbum->cddbalbum->category))
+    if ((set_fields & ET_CDDB_SET_FIELD_GENRE)
+        && (cddbtrackalbum->cddbalbum->genre
+            || cddbtrackalbum->cddbalbum->category))
+    {
+        if (!et_str_empty (cddbtrackalbum->cddbalbum->genre))
         {
-            if (!et_str_empty (cddbtrackalbum->cddbalbum->genre))
-            {
-                et_file_tag_set_genre (FileTag,
-                                       Cddb_Get_Id3_Genre_From_Cddb_Genre (cddbtrackalbum->cddbalbum->genre));
-            }
-            else
-            {
-                et_file_tag_set_genre (FileTag,
-                                       Cddb_Get_Id3_Genre_From_Cddb_Genre (cddbtrackalbum->cddbalbum->category));
-            }
+            et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_GENRE,
+                                        Cddb_Get_Id3_Genre_From_Cddb_Genre (cddbtrackalbum->cddbalbum->genre));
+        }
+        else
+        {
+            et_file_tag_edit_set_field (edit, etfile, ET_FILE_TAG_FIELD_GENRE,
+                                        Cddb_Get_Id3_Genre_From_Cddb_Genre (cddbtrackalbum->cddbalbum->category));
         }
     }
 
@@ -2010,21 +2599,8 @@ set_et_file_from_cddb_album (ET_File * etfile,
         g_free (track_number);
         g_free(filename_generated_utf8);
         g_free(filename_new_utf8);
-    }
-
-    ET_Manage_Changes_Of_File_Data (etfile, FileName, FileTag);
 
-    /* Then run current scanner if requested. */
-    if (g_settings_get_boolean (MainSettings, "cddb-run-scanner"))
-    {
-        EtScanDialog *dialog;
-
-        dialog = ET_SCAN_DIALOG (et_application_window_get_scan_dialog (ET_APPLICATION_WINDOW (MainWindow)));
-
-        if (dialog)
-        {
-            Scan_Select_Mode_And_Run_Scanner (dialog, etfile);
-        }
+        et_file_tag_edit_set_filename (edit, etfile, FileName);
     }
 }
 /*
@@ -2043,6 +2619,10 @@ Cddb_Set_Track_Infos_To_File_List (EtCDDBDialog *self)
     GList *file_iterlist = NULL;
     GList *file_selectedrows;
     GList *selectedrows = NULL;
+    GList *changed_files = NULL;
+    EtFileTagEdit *edit;
+    GArray *track_iters;
+    ET_File **dlm_etfiles;
     gboolean CddbTrackList_Line_Selected;
     CddbTrackAlbum *cddbtrackalbum = NULL;
     GtkTreeSelection *selection = NULL;
@@ -2157,6 +2737,10 @@ Cddb_Set_Track_Infos_To_File_List (EtCDDBDialog *self)
     file_iterlist = g_list_reverse (file_iterlist);
     //ET_Debug_Print_File_List (NULL, __FILE__, __LINE__, __FUNCTION__);
 
+    /* Collect the rows of the track list to set into the files. */
+    track_iters = g_array_sized_new (FALSE, FALSE, sizeof (GtkTreeIter),
+                                     rows_to_loop);
+
     for (row=0; row < rows_to_loop; row++)
     {
         if (CddbTrackList_Line_Selected == FALSE)
@@ -2180,60 +2764,137 @@ Cddb_Set_Track_Infos_To_File_List (EtCDDBDialog *self)
         if (gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->track_list_model),
                                      &currentIter, currentPath))
         {
-            gtk_tree_model_get (GTK_TREE_MODEL (priv->track_list_model),
-                                &currentIter, CDDB_TRACK_LIST_DATA,
-                                &cddbtrackalbum, -1);
+            g_array_append_val (track_iters, currentIter);
         }
         else
         {
             g_warning ("Iter not found matching path in CDDB track list model");
         }
+    }
+
+    if (CddbTrackList_Line_Selected == FALSE && currentPath)
+    {
+        gtk_tree_path_free (currentPath);
+    }
 
-        /* Set values in the ETFile. */
-        if (g_settings_get_boolean (MainSettings, "cddb-dlm-enabled"))
+    /* Match the tracks which were not already matched to a file, by
+     * selecting them in the track list, against the file list at once. */
+    dlm_etfiles = g_new0 (ET_File *, track_iters->len);
+
+    if (g_settings_get_boolean (MainSettings, "cddb-dlm-enabled"))
+    {
+        GPtrArray *titles;
+        GArray *title_rows;
+
+        titles = g_ptr_array_new_with_free_func (g_free);
+        title_rows = g_array_new (FALSE, FALSE, sizeof (guint));
+
+        for (row = 0; row < track_iters->len; row++)
         {
-            ET_File *etfile = NULL;
-            guint set_fields;
+            gchar *title;
 
             gtk_tree_model_get (GTK_TREE_MODEL (priv->track_list_model),
-                                &currentIter, CDDB_TRACK_LIST_ETFILE, &etfile,
-                                -1);
+                                &g_array_index (track_iters, GtkTreeIter, row),
+                                CDDB_TRACK_LIST_NAME, &title,
+                                CDDB_TRACK_LIST_ETFILE, &dlm_etfiles[row], -1);
 
-            /* If the row in the model does not already have an ET_File
-             * associated with it, take one from the browser selection. */
-            if (!etfile)
+            if (dlm_etfiles[row] == NULL)
             {
-                fileIter = (GtkTreeIter*) file_iterlist->data;
-                etfile = et_application_window_browser_get_et_file_from_iter (ET_APPLICATION_WINDOW (MainWindow),
-                                                                              fileIter);
+                g_ptr_array_add (titles, title);
+                g_array_append_val (title_rows, row);
             }
+            else
+            {
+                g_free (title);
+            }
+        }
 
-            /* Tag fields. */
-            set_fields = g_settings_get_flags (MainSettings, "cddb-set-fields");
+        if (titles->len > 0)
+        {
+            ET_File **matches;
+            guint i;
+
+            matches = g_new (ET_File *, titles->len);
+            et_application_window_browser_select_files_by_dlm (ET_APPLICATION_WINDOW (MainWindow),
+                                                               (const gchar * const *)titles->pdata,
+                                                               titles->len,
+                                                               matches, FALSE);
+
+            for (i = 0; i < titles->len; i++)
+            {
+                dlm_etfiles[g_array_index (title_rows, guint, i)] = matches[i];
+            }
 
-            set_et_file_from_cddb_album (etfile, cddbtrackalbum, set_fields,
-                                         list_length);
+            g_free (matches);
         }
-        else if (cddbtrackalbum)
-        {
-            ET_File *etfile;
-            guint set_fields;
 
+        g_array_free (title_rows, TRUE);
+        g_ptr_array_free (titles, TRUE);
+    }
+
+    /* The tags of all the files are undone at once. */
+    edit = et_file_tag_edit_new ();
+
+    for (row = 0; row < track_iters->len; row++)
+    {
+        ET_File *etfile;
+        guint set_fields;
+
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->track_list_model),
+                            &g_array_index (track_iters, GtkTreeIter, row),
+                            CDDB_TRACK_LIST_DATA, &cddbtrackalbum, -1);
+
+        /* Set values in the ETFile. If the track was not matched to a file,
+         * take one from the browser selection. */
+        etfile = dlm_etfiles[row];
+
+        if (!etfile)
+        {
             fileIter = (GtkTreeIter*) file_iterlist->data;
             etfile = et_application_window_browser_get_et_file_from_iter (ET_APPLICATION_WINDOW (MainWindow),
                                                                           fileIter);
+        }
 
+        if (cddbtrackalbum)
+        {
             /* Tag fields. */
             set_fields = g_settings_get_flags (MainSettings, "cddb-set-fields");
 
-            set_et_file_from_cddb_album (etfile, cddbtrackalbum, set_fields,
-                                         list_length);
+            set_et_file_from_cddb_album (edit, etfile, cddbtrackalbum,
+                                         set_fields, list_length);
+            changed_files = g_list_prepend (changed_files, etfile);
         }
 
         if(!file_iterlist->next) break;
         file_iterlist = file_iterlist->next;
     }
 
+    g_free (dlm_etfiles);
+    g_array_free (track_iters, TRUE);
+
+    et_file_tag_edit_commit (edit);
+
+    /* Then run current scanner if requested, on the new tags. */
+    if (g_settings_get_boolean (MainSettings, "cddb-run-scanner"))
+    {
+        EtScanDialog *dialog;
+
+        dialog = ET_SCAN_DIALOG (et_application_window_get_scan_dialog (ET_APPLICATION_WINDOW (MainWindow)));
+
+        if (dialog)
+        {
+            GList *l;
+
+            changed_files = g_list_reverse (changed_files);
+
+            for (l = changed_files; l != NULL; l = g_list_next (l))
+            {
+                Scan_Select_Mode_And_Run_Scanner (dialog, (ET_File *)l->data);
+            }
+        }
+    }
+
+    g_list_free (changed_files);
     g_list_free_full (g_list_first (file_iterlist), (GDestroyNotify)g_free);
     g_list_free_full (g_list_first (selectedrows),
                       (GDestroyNotify)gtk_tree_path_free);
@@ -2253,6 +2914,12 @@ stop_search (EtCDDBDialog *self)
     priv = et_cddb_dialog_get_instance_private (self);
 
     priv->stop_searching = TRUE;
+
+    if (priv->prefetch_cancellable)
+    {
+        g_cancellable_cancel (priv->prefetch_cancellable);
+        g_clear_object (&priv->prefetch_cancellable);
+    }
 }
 
 /*
@@ -2463,10 +3130,13 @@ create_cddb_dialog (EtCDDBDialog *self)
     priv->stop_searching = FALSE;
 
     /* The User-Agent header is not used by the CDDB protocol over HTTP, but it
-     * is still good practice to set it appropriately. */
+     * is still good practice to set it appropriately. A connection is left
+     * free for a request from the user while track lists are prefetched. */
     /* FIXME: Enable a SoupLogger with g_parse_debug_string(). */
     priv->session = soup_session_new_with_options (SOUP_SESSION_USER_AGENT,
                                                    PACKAGE_NAME " " PACKAGE_VERSION,
+                                                   SOUP_SESSION_MAX_CONNS_PER_HOST,
+                                                   MAX_PREFETCH_REQUESTS + 1,
                                                    NULL);
 }
 
@@ -2563,6 +3233,8 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
     gint   server_try = 0;
     GString *query_string;
     gchar *cddb_discid;
+    guint32 disc_id;
+    EtCddbDatabase *local_database;
 
     guint total_frames = 150;   /* First offset is (almost) always 150 */
     guint disc_length  = 2;     /* and 2s elapsed before first track */
@@ -2577,6 +3249,13 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
 
     priv = et_cddb_dialog_get_instance_private (self);
 
+    if (!get_local_database (self, et_cddb_dialog_search_from_selection,
+                             &local_database))
+    {
+        /* The search is run again once the database is open. */
+        return TRUE;
+    }
+
     /* Number of selected files. */
     /* FIXME: Hack! */
     file_selection = et_application_window_browser_get_selection (ET_APPLICATION_WINDOW (MainWindow));
@@ -2672,8 +3351,8 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
     g_list_free (filelist);
 
     /* Compute CddbId. */
-    cddb_discid = g_strdup_printf ("%08x", (guint)(((total_id % 0xFF) << 24) |
-                                           (disc_length << 8) | num_tracks));
+    disc_id = ((total_id % 0xFF) << 24) | (disc_length << 8) | num_tracks;
+    cddb_discid = g_strdup_printf ("%08x", disc_id);
 
 
     /* Delete previous album list. */
@@ -2686,7 +3365,18 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
     }
     gtk_widget_set_sensitive(GTK_WIDGET(priv->stop_search_button),TRUE);
 
+    /* Look up the disc in the local database first, which also works
+     * offline, and only ask the servers if it is not found there. */
+    if (local_database != NULL)
+    {
+        GArray *entries;
 
+        entries = et_cddb_database_lookup (local_database, disc_id);
+        add_local_albums (self, entries);
+        g_array_unref (entries);
+    }
+
+    if (priv->album_list == NULL)
     {
         /*
          * Remote cddb acces
@@ -2763,10 +3453,10 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
                 gtk_main_iteration();
 
             cancellable = g_cancellable_new ();
-            istream = soup_session_send (priv->session, message, cancellable,
+            istream = send_cddb_request (self, message, cancellable,
                                          &error);
 
-            if (!check_message_successful (message))
+            if (istream == NULL)
             {
                 msg = log_message_from_request_error (message, error);
                 gtk_statusbar_push (GTK_STATUSBAR (priv->status_bar),
@@ -2888,6 +3578,7 @@ et_cddb_dialog_search_from_selection (EtCDDBDialog *self)
 
     /* Load the albums found in the list. */
     Cddb_Load_Album_List (self, FALSE);
+    prefetch_album_tracks (self);
 
     return TRUE;
 }
@@ -2934,6 +3625,24 @@ Cddb_Get_Pixbuf_From_Server_Name (const gchar *server_name)
         return NULL;
 }
 
+static void
+et_cddb_dialog_dispose (GObject *object)
+{
+    EtCDDBDialog *self;
+    EtCDDBDialogPrivate *priv;
+
+    self = ET_CDDB_DIALOG (object);
+    priv = et_cddb_dialog_get_instance_private (self);
+
+    if (priv->local_database_cancellable)
+    {
+        g_cancellable_cancel (priv->local_database_cancellable);
+        g_clear_object (&priv->local_database_cancellable);
+    }
+
+    G_OBJECT_CLASS (et_cddb_dialog_parent_class)->dispose (object);
+}
+
 static void
 et_cddb_dialog_finalize (GObject *object)
 {
@@ -2948,7 +3657,16 @@ et_cddb_dialog_finalize (GObject *object)
         Cddb_Free_Album_List (self);
     }
 
+    if (priv->prefetch_cancellable)
+    {
+        g_cancellable_cancel (priv->prefetch_cancellable);
+        g_object_unref (priv->prefetch_cancellable);
+    }
+
     g_object_unref (priv->session);
+    et_cddb_cache_free (priv->cache);
+    et_cddb_database_free (priv->local_database);
+    g_free (priv->local_database_path);
 
     G_OBJECT_CLASS (et_cddb_dialog_parent_class)->finalize (object);
 }
@@ -2965,6 +3683,7 @@ et_cddb_dialog_class_init (EtCDDBDialogClass *klass)
 {
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+    G_OBJECT_CLASS (klass)->dispose = et_cddb_dialog_dispose;
     G_OBJECT_CLASS (klass)->finalize = et_cddb_dialog_finalize;
 
     gtk_widget_class_set_template_from_resource (widget_class,
@@ -25,6 +25,7 @@
 #include "charset.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <glib/gi18n.h>
 
 #ifdef HAVE_LANGINFO_CODESET
@@ -137,6 +138,33 @@ static const CharsetInfo charset_trans_array[] = {
 
 static GHashTable *encodings;
 
+/* Character sets in which text in ASCII is encoded as the same bytes. */
+static const gchar * const ascii_compatible_charsets[] =
+{
+    "UTF-8",
+    "UTF8",
+    "US-ASCII",
+    "ASCII",
+    "ANSI_X3.4-1968",
+    "ISO-8859-",
+    "ISO8859-",
+    "ISO_8859-",
+    "windows-125",
+    "CP125",
+    "KOI8-",
+    "EUC-JP",
+    "EUC-KR",
+    "GB2312",
+    "gb18030",
+    "Big5",
+    "TIS-620"
+};
+
+static void iconv_cache_free (gpointer data);
+
+/* Conversion descriptors of each thread, by the pair of character sets. */
+static GPrivate iconv_cache_key = G_PRIVATE_INIT (iconv_cache_free);
+
 
 /* stolen from gnome-desktop-item.c */
 static gboolean
@@ -394,6 +422,174 @@ const gchar *get_locale (void)
 
 
 
+static void
+iconv_cache_close (gpointer data)
+{
+    GIConv cd = data;
+
+    if (cd != (GIConv)-1)
+    {
+        g_iconv_close (cd);
+    }
+}
+
+static void
+iconv_cache_free (gpointer data)
+{
+    g_hash_table_destroy (data);
+}
+
+/*
+ * get_converter:
+ * @to_codeset: the character set to convert to
+ * @from_codeset: the character set to convert from
+ *
+ * Get a conversion descriptor from the cache of the current thread, opening
+ * it on first use. The descriptor is reset to its initial state, as the
+ * previous conversion may have stopped part way through.
+ *
+ * Returns: a conversion descriptor owned by the cache, or (GIConv)-1 if the
+ * conversion is not supported
+ */
+static GIConv
+get_converter (const gchar *to_codeset,
+               const gchar *from_codeset)
+{
+    GHashTable *cache;
+    gchar key[128];
+    gpointer cd;
+
+    cache = g_private_get (&iconv_cache_key);
+
+    if (cache == NULL)
+    {
+        cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       iconv_cache_close);
+        g_private_set (&iconv_cache_key, cache);
+    }
+
+    if (g_snprintf (key, sizeof (key), "%s\n%s", to_codeset, from_codeset)
+        >= (gint)sizeof (key))
+    {
+        /* Not worth caching such unusual names. */
+        return (GIConv)-1;
+    }
+
+    if (!g_hash_table_lookup_extended (cache, key, NULL, &cd))
+    {
+        cd = g_iconv_open (to_codeset, from_codeset);
+        g_hash_table_insert (cache, g_strdup (key), cd);
+    }
+    else if (cd != (GIConv)-1)
+    {
+        g_iconv (cd, NULL, NULL, NULL, NULL);
+    }
+
+    return cd;
+}
+
+static gboolean
+charset_is_ascii_compatible (const gchar *codeset)
+{
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS (ascii_compatible_charsets); i++)
+    {
+        const gchar *charset = ascii_compatible_charsets[i];
+
+        if (g_ascii_strncasecmp (codeset, charset, strlen (charset)) == 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/*
+ * et_charset_convert:
+ * @string: the string to convert
+ * @length: the length of @string in bytes, or -1 if it is nul-terminated
+ * @to_codeset: the character set to convert to
+ * @from_codeset: the character set of @string
+ * @bytes_read: location to store the number of bytes of @string converted,
+ *              or %NULL
+ * @bytes_written: location to store the length of the result, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * A replacement for g_convert(), which reuses the conversion descriptors of
+ * the current thread instead of opening new ones for every string, and which
+ * copies strings in ASCII between character sets which encode ASCII in the
+ * same way.
+ *
+ * Returns: the converted string, or %NULL on error
+ */
+gchar *
+et_charset_convert (const gchar *string,
+                    gssize length,
+                    const gchar *to_codeset,
+                    const gchar *from_codeset,
+                    gsize *bytes_read,
+                    gsize *bytes_written,
+                    GError **error)
+{
+    gsize i;
+    GIConv cd;
+
+    g_return_val_if_fail (string != NULL, NULL);
+    g_return_val_if_fail (to_codeset != NULL, NULL);
+    g_return_val_if_fail (from_codeset != NULL, NULL);
+
+    if (length < 0)
+    {
+        length = strlen (string);
+    }
+
+    for (i = 0; i < (gsize)length; i++)
+    {
+        if ((guchar)string[i] >= 0x80)
+        {
+            break;
+        }
+    }
+
+    if (i == (gsize)length && charset_is_ascii_compatible (to_codeset)
+        && charset_is_ascii_compatible (from_codeset))
+    {
+        gchar *result;
+
+        /* Terminated in the same way as by g_convert(), which is enough for
+         * any encoding. */
+        result = g_malloc (length + 4);
+        memcpy (result, string, length);
+        memset (result + length, 0, 4);
+
+        if (bytes_read)
+        {
+            *bytes_read = length;
+        }
+
+        if (bytes_written)
+        {
+            *bytes_written = length;
+        }
+
+        return result;
+    }
+
+    cd = get_converter (to_codeset, from_codeset);
+
+    if (cd == (GIConv)-1)
+    {
+        /* Let GLib report the error. */
+        return g_convert (string, length, to_codeset, from_codeset, bytes_read,
+                          bytes_written, error);
+    }
+
+    return g_convert_with_iconv (string, length, cd, bytes_read,
+                                 bytes_written, error);
+}
+
 /*
  * convert_string : (don't use with UTF-16 strings)
  *  - display_error : if TRUE, may return an escaped string and display an error
@@ -417,7 +613,8 @@ convert_string_1 (const gchar *string, gssize length, const gchar *from_codeset,
 
     g_return_val_if_fail (string != NULL, NULL);
 
-    output = g_convert(string, length, to_codeset, from_codeset, NULL, &bytes_written, &error);
+    output = et_charset_convert (string, length, to_codeset, from_codeset, NULL,
+                                 &bytes_written, &error);
     //output = g_convert_with_fallback(string, length, to_codeset, from_codeset, "?", NULL, &bytes_written, &error);
 
     if (output == NULL)
@@ -515,7 +712,8 @@ filename_from_display (const gchar *string)
                  * be silently discarded.
                  */
                 gchar *enc = g_strconcat (*filename_encodings, "//IGNORE", NULL);
-                ret = g_convert (string, -1, enc, "UTF-8", NULL, NULL, &error);
+                ret = et_charset_convert (string, -1, enc, "UTF-8", NULL, NULL,
+                                          &error);
 
                 if (!ret)
                 {
@@ -540,8 +738,8 @@ filename_from_display (const gchar *string)
         /* Guess the legacy (pre-Unicode) filesystem encoding from the locale.
          * For example, fr_FR.UTF-8 => fr_FR => ISO-8859-1. */
         legacy_encoding = get_encoding_from_locale (get_locale ());
-        ret = g_convert (string, -1, legacy_encoding, "UTF-8", NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, legacy_encoding, "UTF-8", NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -554,8 +752,8 @@ filename_from_display (const gchar *string)
     if (!ret)
     {
         /* Failing that, try ISO-8859-1. */
-        ret = g_convert (string, -1, "ISO-8859-1", "UTF-8", NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, "ISO-8859-1", "UTF-8", NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -612,8 +810,8 @@ Try_To_Validate_Utf8_String (const gchar *string)
         /* Guess the legacy (pre-Unicode) encoding associated with the locale.
          * For example, fr_FR.UTF-8 => fr_FR => ISO-8859-1. */
         legacy_encoding = get_encoding_from_locale (get_locale ());
-        ret = g_convert (string, -1, "UTF-8", legacy_encoding, NULL, NULL,
-                         &error);
+        ret = et_charset_convert (string, -1, "UTF-8", legacy_encoding, NULL,
+                                  NULL, &error);
 
         if (!ret)
         {
@@ -621,8 +819,8 @@ Try_To_Validate_Utf8_String (const gchar *string)
             g_debug ("Error converting string to legacy encoding '%s': %s",
                      legacy_encoding, error->message);
             g_clear_error (&error);
-            ret = g_convert (string, -1, "UTF-8", "ISO-8859-1", NULL, NULL,
-                             &error);
+            ret = et_charset_convert (string, -1, "UTF-8", "ISO-8859-1",
+                                      NULL, NULL, &error);
         }
 
         if (!ret)
@@ -29,6 +29,7 @@ const gchar *get_locale               (void);
 
 gchar *convert_string   (const gchar *string, const gchar *from_codeset, const gchar *to_codeset, const gboolean display_error);
 gchar *convert_string_1 (const gchar *string, gssize length, const gchar *from_codeset, const gchar *to_codeset, const gboolean display_error);
+gchar * et_charset_convert (const gchar *string, gssize length, const gchar *to_codeset, const gchar *from_codeset, gsize *bytes_read, gsize *bytes_written, GError **error);
 
 gchar *filename_from_display (const gchar *string);
 
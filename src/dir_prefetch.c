@@ -0,0 +1,589 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "dir_prefetch.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* __linux__ */
+
+#include "file_description.h"
+#include "setting.h"
+
+/*
+ * The budget of a prefetch. The sibling directories are only read on the
+ * chance that they are browsed next, so the prefetch stops long before it
+ * could compete with other work for the disk.
+ */
+#define PREFETCH_DIRECTORIES 2
+#define PREFETCH_FILES 500
+#define PREFETCH_BYTES (64 * 1024 * 1024)
+#define PREFETCH_TIME (10 * G_TIME_SPAN_SECOND)
+
+/* The regions of a file which are read. The tags of most formats are at the
+ * start of the file, but ID3v1 and APEv2 tags are at the end. */
+#define PREFETCH_HEAD_SIZE (128 * 1024)
+#define PREFETCH_TAIL_SIZE (64 * 1024)
+
+/* There is no wrapper for ioprio_set() in the C library. */
+#if defined __linux__ && defined SYS_ioprio_set && defined SYS_ioprio_get
+#define HAVE_IOPRIO
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_WHO_PROCESS 1
+#endif /* __linux__ && SYS_ioprio_set && SYS_ioprio_get */
+
+/*
+ * EtDirPrefetch:
+ * @directory: the directory which was read
+ * @recurse: whether to read the subdirectories of the siblings
+ * @show_hidden: whether to read hidden files and directories
+ * @deadline: the monotonic time at which to stop
+ * @n_bytes: the number of bytes which were read
+ * @n_files: the number of files which were read
+ *
+ * The state of a prefetch, attached to its #GTask.
+ */
+typedef struct
+{
+    GFile *directory;
+    gboolean recurse;
+    gboolean show_hidden;
+    gint64 deadline;
+    guint64 n_bytes;
+    guint n_files;
+} EtDirPrefetch;
+
+/*
+ * EtDirPrefetchSibling:
+ * @key: the collation key of the display name
+ * @name: the name in the filesystem encoding
+ */
+typedef struct
+{
+    gchar *key;
+    gchar *name;
+} EtDirPrefetchSibling;
+
+/* The prefetch started after the last directory was read. */
+static GCancellable *prefetch_cancellable = NULL;
+
+static void
+et_dir_prefetch_free (EtDirPrefetch *prefetch)
+{
+    g_object_unref (prefetch->directory);
+    g_slice_free (EtDirPrefetch, prefetch);
+}
+
+/*
+ * set_io_priority_idle:
+ *
+ * Only use the disk for the current thread when no other program needs it,
+ * where supported.
+ *
+ * Returns: the previous I/O priority of the thread, to pass to
+ *          restore_io_priority(), or -1 if it was not changed
+ */
+static gint
+set_io_priority_idle (void)
+{
+#ifdef HAVE_IOPRIO
+    glong priority;
+
+    priority = syscall (SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+
+    if (priority == -1
+        || syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                    IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == -1)
+    {
+        return -1;
+    }
+
+    return priority;
+#else /* !HAVE_IOPRIO */
+    return -1;
+#endif /* !HAVE_IOPRIO */
+}
+
+/*
+ * restore_io_priority:
+ * @priority: the priority returned by set_io_priority_idle()
+ *
+ * Restore the I/O priority of the current thread, as the threads of #GTask
+ * are shared with other tasks.
+ */
+static void
+restore_io_priority (gint priority)
+{
+#ifdef HAVE_IOPRIO
+    if (priority != -1)
+    {
+        syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, priority);
+    }
+#endif /* HAVE_IOPRIO */
+}
+
+static gboolean
+prefetch_can_continue (const EtDirPrefetch *prefetch,
+                       GCancellable *cancellable)
+{
+    return prefetch->n_files < PREFETCH_FILES
+           && prefetch->n_bytes < PREFETCH_BYTES
+           && g_get_monotonic_time () < prefetch->deadline
+           && !g_cancellable_is_cancelled (cancellable);
+}
+
+static gboolean
+file_info_is_browsable (const EtDirPrefetch *prefetch,
+                        GFileInfo *info)
+{
+    return prefetch->show_hidden || !g_file_info_get_is_hidden (info);
+}
+
+static gint
+compare_siblings (gconstpointer a,
+                  gconstpointer b)
+{
+    const EtDirPrefetchSibling *sibling1 = a;
+    const EtDirPrefetchSibling *sibling2 = b;
+
+    return strcmp (sibling1->key, sibling2->key);
+}
+
+/*
+ * get_siblings:
+ * @prefetch: a prefetch
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Find the directories next to the directory of @prefetch, in the order of
+ * the directory browser, nearest first.
+ *
+ * Returns: (transfer full) (element-type GFile): the sibling directories
+ */
+static GList *
+get_siblings (const EtDirPrefetch *prefetch,
+              GCancellable *cancellable)
+{
+    GFile *parent;
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+    GArray *siblings;
+    GList *result = NULL;
+    gchar *basename;
+    guint n_result = 0;
+    guint index;
+    guint i;
+
+    parent = g_file_get_parent (prefetch->directory);
+
+    if (parent == NULL)
+    {
+        return NULL;
+    }
+
+    enumerator = g_file_enumerate_children (parent,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+                                            G_FILE_QUERY_INFO_NONE,
+                                            cancellable, NULL);
+
+    if (enumerator == NULL)
+    {
+        g_object_unref (parent);
+        return NULL;
+    }
+
+    siblings = g_array_new (FALSE, FALSE, sizeof (EtDirPrefetchSibling));
+
+    while ((info = g_file_enumerator_next_file (enumerator, cancellable,
+                                                NULL)) != NULL)
+    {
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY
+            && file_info_is_browsable (prefetch, info))
+        {
+            EtDirPrefetchSibling sibling;
+            gchar *display_name;
+
+            /* Sorted by display name, as in the directory browser. */
+            sibling.name = g_strdup (g_file_info_get_name (info));
+            display_name = g_filename_display_name (sibling.name);
+            sibling.key = g_utf8_collate_key (display_name, -1);
+            g_free (display_name);
+
+            g_array_append_val (siblings, sibling);
+        }
+
+        g_object_unref (info);
+    }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+
+    g_array_sort (siblings, compare_siblings);
+    basename = g_file_get_basename (prefetch->directory);
+
+    for (index = 0; index < siblings->len; index++)
+    {
+        if (strcmp (g_array_index (siblings, EtDirPrefetchSibling,
+                                   index).name, basename) == 0)
+        {
+            break;
+        }
+    }
+
+    /* Alternate between the next and the previous directories. */
+    for (i = 1; index < siblings->len && n_result < PREFETCH_DIRECTORIES
+         && (index + i < siblings->len || i <= index); i++)
+    {
+        const EtDirPrefetchSibling *sibling;
+
+        if (index + i < siblings->len)
+        {
+            sibling = &g_array_index (siblings, EtDirPrefetchSibling,
+                                      index + i);
+            result = g_list_prepend (result,
+                                     g_file_get_child (parent, sibling->name));
+            n_result++;
+        }
+
+        if (i <= index && n_result < PREFETCH_DIRECTORIES)
+        {
+            sibling = &g_array_index (siblings, EtDirPrefetchSibling,
+                                      index - i);
+            result = g_list_prepend (result,
+                                     g_file_get_child (parent, sibling->name));
+            n_result++;
+        }
+    }
+
+    for (i = 0; i < siblings->len; i++)
+    {
+        EtDirPrefetchSibling *sibling = &g_array_index (siblings,
+                                                        EtDirPrefetchSibling,
+                                                        i);
+
+        g_free (sibling->key);
+        g_free (sibling->name);
+    }
+
+    g_array_free (siblings, TRUE);
+    g_free (basename);
+    g_object_unref (parent);
+
+    return g_list_reverse (result);
+}
+
+/*
+ * prefetch_file:
+ * @prefetch: a prefetch
+ * @file: the file to read
+ * @size: the size of @file
+ * @buffer: a buffer of %PREFETCH_HEAD_SIZE bytes
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Read the regions of @file which hold the tags, so that they are in the
+ * page cache when the directory is read. Errors are ignored, as they are
+ * reported when the file is read by the user.
+ */
+static void
+prefetch_file (EtDirPrefetch *prefetch,
+               GFile *file,
+               goffset size,
+               guchar *buffer,
+               GCancellable *cancellable)
+{
+    GFileInputStream *istream;
+    gsize bytes_read;
+
+    istream = g_file_read (file, cancellable, NULL);
+
+    if (istream == NULL)
+    {
+        return;
+    }
+
+    g_input_stream_read_all (G_INPUT_STREAM (istream), buffer,
+                             MIN (size, PREFETCH_HEAD_SIZE), &bytes_read,
+                             cancellable, NULL);
+    prefetch->n_bytes += bytes_read;
+
+    if (size > PREFETCH_HEAD_SIZE)
+    {
+        goffset offset = MAX (PREFETCH_HEAD_SIZE, size - PREFETCH_TAIL_SIZE);
+
+        if (g_seekable_seek (G_SEEKABLE (istream), offset, G_SEEK_SET,
+                             cancellable, NULL))
+        {
+            g_input_stream_read_all (G_INPUT_STREAM (istream), buffer,
+                                     size - offset, &bytes_read, cancellable,
+                                     NULL);
+            prefetch->n_bytes += bytes_read;
+        }
+    }
+
+    prefetch->n_files++;
+    g_object_unref (istream);
+}
+
+/*
+ * prefetch_directory:
+ * @prefetch: a prefetch
+ * @directory: the directory to read
+ * @buffer: a buffer of %PREFETCH_HEAD_SIZE bytes
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ *
+ * Read the supported files of @directory, in the same way as
+ * Read_Directory(), until the budget of @prefetch is used up.
+ */
+static void
+prefetch_directory (EtDirPrefetch *prefetch,
+                    GFile *directory,
+                    guchar *buffer,
+                    GCancellable *cancellable)
+{
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+
+    enumerator = g_file_enumerate_children (directory,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+                                            G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                            G_FILE_QUERY_INFO_NONE,
+                                            cancellable, NULL);
+
+    if (enumerator == NULL)
+    {
+        return;
+    }
+
+    while (prefetch_can_continue (prefetch, cancellable)
+           && (info = g_file_enumerator_next_file (enumerator, cancellable,
+                                                   NULL)) != NULL)
+    {
+        if (file_info_is_browsable (prefetch, info))
+        {
+            GFileType type = g_file_info_get_file_type (info);
+
+            if (type == G_FILE_TYPE_DIRECTORY && prefetch->recurse)
+            {
+                GFile *child = g_file_enumerator_get_child (enumerator, info);
+
+                prefetch_directory (prefetch, child, buffer, cancellable);
+                g_object_unref (child);
+            }
+            else if (type == G_FILE_TYPE_REGULAR
+                     && et_file_is_supported (g_file_info_get_name (info)))
+            {
+                GFile *child = g_file_enumerator_get_child (enumerator, info);
+
+                prefetch_file (prefetch, child, g_file_info_get_size (info),
+                               buffer, cancellable);
+                g_object_unref (child);
+            }
+        }
+
+        g_object_unref (info);
+    }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+}
+
+static void
+prefetch_thread_func (GTask *task,
+                      gpointer source_object,
+                      gpointer task_data,
+                      GCancellable *cancellable)
+{
+    EtDirPrefetch *prefetch = task_data;
+    GList *siblings;
+    GList *l;
+    guchar *buffer;
+    gint io_priority;
+
+    io_priority = set_io_priority_idle ();
+    prefetch->deadline = g_get_monotonic_time () + PREFETCH_TIME;
+    buffer = g_malloc (PREFETCH_HEAD_SIZE);
+
+    siblings = get_siblings (prefetch, cancellable);
+
+    for (l = siblings; l != NULL && prefetch_can_continue (prefetch,
+                                                           cancellable);
+         l = g_list_next (l))
+    {
+        prefetch_directory (prefetch, l->data, buffer, cancellable);
+    }
+
+    g_list_free_full (siblings, g_object_unref);
+    g_free (buffer);
+    restore_io_priority (io_priority);
+
+    if (!g_task_return_error_if_cancelled (task))
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+}
+
+/*
+ * et_dir_prefetch_async:
+ * @directory: the directory which was read
+ * @recurse: whether to read the subdirectories of the sibling directories
+ * @show_hidden: whether to read hidden files and directories
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @callback: (allow-none): a callback to call when the prefetch is complete
+ * @user_data: user data to pass to @callback
+ *
+ * In a thread, at idle I/O priority where supported, read the tags of the
+ * supported files in the directories next to @directory, so that they are
+ * read quickly from the page cache if the user browses to one of them. The
+ * prefetch stops early once it has read a limited number of files or bytes,
+ * or has run for a limited time.
+ */
+void
+et_dir_prefetch_async (GFile *directory,
+                       gboolean recurse,
+                       gboolean show_hidden,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+    EtDirPrefetch *prefetch;
+    GTask *task;
+
+    g_return_if_fail (G_IS_FILE (directory));
+
+    prefetch = g_slice_new0 (EtDirPrefetch);
+    prefetch->directory = g_object_ref (directory);
+    prefetch->recurse = recurse;
+    prefetch->show_hidden = show_hidden;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, et_dir_prefetch_async);
+    g_task_set_task_data (task, prefetch,
+                          (GDestroyNotify)et_dir_prefetch_free);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_run_in_thread (task, prefetch_thread_func);
+    g_object_unref (task);
+}
+
+/*
+ * et_dir_prefetch_finish:
+ * @result: the result passed to the callback of the prefetch
+ * @n_files: (allow-none): a location to store the number of files which were
+ *           read, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Returns: %TRUE if the prefetch ran to completion or used up its budget,
+ *          %FALSE and with @error set if it was cancelled
+ */
+gboolean
+et_dir_prefetch_finish (GAsyncResult *result,
+                        guint *n_files,
+                        GError **error)
+{
+    EtDirPrefetch *prefetch;
+
+    g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+    g_return_val_if_fail (g_task_get_source_tag (G_TASK (result))
+                          == et_dir_prefetch_async, FALSE);
+
+    prefetch = g_task_get_task_data (G_TASK (result));
+
+    if (n_files != NULL)
+    {
+        *n_files = prefetch->n_files;
+    }
+
+    return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+on_prefetch_done (GObject *source_object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+    guint n_files;
+    GError *error = NULL;
+
+    if (!et_dir_prefetch_finish (result, &n_files, &error))
+    {
+        g_error_free (error);
+        return;
+    }
+
+    g_debug ("Prefetched %u files in the sibling directories", n_files);
+}
+
+/*
+ * et_dir_prefetch_start:
+ * @path: the directory which was read, in the filesystem encoding
+ *
+ * Start to prefetch the directories next to @path in the background, if
+ * enabled in the settings. Any previous prefetch is stopped.
+ */
+void
+et_dir_prefetch_start (const gchar *path)
+{
+    GFile *directory;
+
+    g_return_if_fail (path != NULL);
+
+    et_dir_prefetch_stop ();
+
+    if (!g_settings_get_boolean (MainSettings, "browse-prefetch-siblings"))
+    {
+        return;
+    }
+
+    prefetch_cancellable = g_cancellable_new ();
+    directory = g_file_new_for_path (path);
+
+    et_dir_prefetch_async (directory,
+                           g_settings_get_boolean (MainSettings,
+                                                   "browse-subdir"),
+                           g_settings_get_boolean (MainSettings,
+                                                   "browse-show-hidden"),
+                           prefetch_cancellable, on_prefetch_done, NULL);
+
+    g_object_unref (directory);
+}
+
+/*
+ * et_dir_prefetch_stop:
+ *
+ * Stop the prefetch started by et_dir_prefetch_start(), so that it does not
+ * compete with reading a directory.
+ */
+void
+et_dir_prefetch_stop (void)
+{
+    if (prefetch_cancellable == NULL)
+    {
+        return;
+    }
+
+    g_cancellable_cancel (prefetch_cancellable);
+    g_clear_object (&prefetch_cancellable);
+}
@@ -0,0 +1,34 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_DIR_PREFETCH_H_
+#define ET_DIR_PREFETCH_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+void et_dir_prefetch_async (GFile *directory, gboolean recurse, gboolean show_hidden, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+gboolean et_dir_prefetch_finish (GAsyncResult *result, guint *n_files, GError **error);
+
+void et_dir_prefetch_start (const gchar *path);
+void et_dir_prefetch_stop (void);
+
+G_END_DECLS
+
+#endif /* !ET_DIR_PREFETCH_H_ */
@@ -1,4 +1,5 @@
 /* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
  * Copyright (C) 2004  Santtu Lakkala <inz@inz.fi>
  *
  * This program is free software; you can redistribute it and/or modify it
@@ -20,97 +21,398 @@
 
 #include "dlm.h"
 
-static int dlm_cost    (const gchar, const gchar);
-static int dlm_minimum (int a, int b, int c, int d);
+/* Number of pattern characters handled by each word of the bit vectors. */
+#define DLM_WORD_BITS 64
 
 /*
- * Compute the Damerau-Levenshtein Distance between utf-8 strings ds and dt.
+ * EtDlmScratch:
+ * @peq: for each block of 64 pattern bytes, a bitmask of the positions of each
+ *       of the 256 byte values
+ * @columns: the VP, VN and D0 bit vectors of each block
+ * @folded: buffers for the casefolded strings
+ *
+ * Per-thread buffers for the distance computation, which are grown as
+ * required and reused between calls. Only the entries of @peq which were set
+ * for the current pattern are cleared again afterwards.
  */
-gint
-dlm (const gchar *ds, const gchar *dt)
+typedef struct
 {
-    gsize n;
-    gsize m;
+    GArray *peq;
+    GArray *columns;
+    GString *folded[2];
+} EtDlmScratch;
+
+static void
+dlm_scratch_free (gpointer data)
+{
+    EtDlmScratch *scratch = data;
+
+    g_array_free (scratch->peq, TRUE);
+    g_array_free (scratch->columns, TRUE);
+    g_string_free (scratch->folded[0], TRUE);
+    g_string_free (scratch->folded[1], TRUE);
+    g_slice_free (EtDlmScratch, scratch);
+}
 
-    /* Casefold for better matching of the strings. */
-    gchar *s = g_utf8_casefold(ds, -1);
-    gchar *t = g_utf8_casefold(dt, -1);
+static GPrivate dlm_scratch_key = G_PRIVATE_INIT (dlm_scratch_free);
 
-    n = strlen(s);
-    m = strlen(t);
+static EtDlmScratch *
+get_dlm_scratch (void)
+{
+    EtDlmScratch *scratch = g_private_get (&dlm_scratch_key);
 
-    if (n && m)
+    if (scratch == NULL)
     {
-        gint *d;
-        gsize i;
-        gsize j;
-        gint metric;
+        scratch = g_slice_new (EtDlmScratch);
+        scratch->peq = g_array_new (FALSE, TRUE, sizeof (guint64));
+        scratch->columns = g_array_new (FALSE, FALSE, sizeof (guint64));
+        scratch->folded[0] = g_string_sized_new (64);
+        scratch->folded[1] = g_string_sized_new (64);
+        g_private_set (&dlm_scratch_key, scratch);
+    }
 
-        n++;
-        m++;
+    return scratch;
+}
 
-        d = (gint *)g_malloc0 (sizeof (gint) * m * n);
+/*
+ * dlm_casefold:
+ * @result: the string to store the casefolded string in
+ * @str: a UTF-8 string
+ *
+ * Casefold @str for better matching of the strings. ASCII strings, which are
+ * by far the most common, are folded in place without allocating.
+ */
+static void
+dlm_casefold (GString *result,
+              const gchar *str)
+{
+    gsize i;
 
-        for (i = 0; i < m; i++)
-            d[i * n] = i;
+    for (i = 0; str[i] != '\0'; i++)
+    {
+        if ((guchar)str[i] >= 0x80)
+        {
+            gchar *folded = g_utf8_casefold (str, -1);
+            g_string_assign (result, folded);
+            g_free (folded);
+            return;
+        }
+    }
+
+    g_string_set_size (result, i);
+
+    for (i = 0; i < result->len; i++)
+    {
+        result->str[i] = g_ascii_tolower (str[i]);
+    }
+}
+
+static void
+dlm_set_pattern (EtDlmScratch *scratch,
+                 const guchar *pattern,
+                 gsize length)
+{
+    const gsize n_blocks = (length + DLM_WORD_BITS - 1) / DLM_WORD_BITS;
+    guint64 *peq;
+    gsize i;
+
+    if (scratch->peq->len < n_blocks * 256)
+    {
+        g_array_set_size (scratch->peq, n_blocks * 256);
+    }
+
+    if (scratch->columns->len < n_blocks * 3)
+    {
+        g_array_set_size (scratch->columns, n_blocks * 3);
+    }
+
+    peq = (guint64 *)scratch->peq->data;
+
+    for (i = 0; i < length; i++)
+    {
+        peq[(i / DLM_WORD_BITS) * 256 + pattern[i]]
+            |= G_GUINT64_CONSTANT (1) << (i % DLM_WORD_BITS);
+    }
+}
+
+static void
+dlm_clear_pattern (EtDlmScratch *scratch,
+                   const guchar *pattern,
+                   gsize length)
+{
+    guint64 *peq = (guint64 *)scratch->peq->data;
+    gsize i;
+
+    for (i = 0; i < length; i++)
+    {
+        peq[(i / DLM_WORD_BITS) * 256 + pattern[i]] = 0;
+    }
+}
+
+/*
+ * dlm_distance:
+ * @scratch: the scratch buffers, with the pattern set by dlm_set_pattern()
+ * @pattern_length: the length of the pattern, in bytes
+ * @text: the string to compare with the pattern
+ * @text_length: the length of @text, in bytes
+ *
+ * Compute the Damerau-Levenshtein distance (restricted to transpositions of
+ * adjacent characters which are not edited further) between the pattern and
+ * @text, with the bit-parallel algorithm of Myers, extended to transpositions
+ * by Hyyrö. Each column of the distance matrix is kept as vectors of vertical
+ * differences, 64 pattern bytes per word, with the carries propagated between
+ * the words of longer patterns.
+ *
+ * Returns: the distance, in bytes
+ */
+static gsize
+dlm_distance (EtDlmScratch *scratch,
+              gsize pattern_length,
+              const guchar *text,
+              gsize text_length)
+{
+    const gsize n_blocks = (pattern_length + DLM_WORD_BITS - 1)
+                           / DLM_WORD_BITS;
+    const guint64 last = G_GUINT64_CONSTANT (1)
+                         << ((pattern_length - 1) % DLM_WORD_BITS);
+    const guint64 *peq = (const guint64 *)scratch->peq->data;
+    guint64 *vp = (guint64 *)scratch->columns->data;
+    guint64 *vn = vp + n_blocks;
+    guint64 *d0 = vn + n_blocks;
+    gsize score = pattern_length;
+    gsize b;
+    gsize j;
+
+    for (b = 0; b < n_blocks; b++)
+    {
+        vp[b] = ~G_GUINT64_CONSTANT (0);
+        vn[b] = 0;
+        d0[b] = 0;
+    }
+
+    for (j = 0; j < text_length; j++)
+    {
+        const guint64 *pm_row = peq + text[j];
+        const guint64 *previous_row = j > 0 ? peq + text[j - 1] : NULL;
+        guint64 add_carry = 0;
+        guint64 hp_carry = 1;
+        guint64 hn_carry = 0;
+        guint64 transposition_carry = 0;
 
-        for (i = 1; i < n; i++)
+        for (b = 0; b < n_blocks; b++)
         {
-            d[i] = i;
-            for (j = 1; j < m; j++)
+            const guint64 pm = pm_row[b * 256];
+            const guint64 previous_pm = previous_row ? previous_row[b * 256]
+                                                     : 0;
+            guint64 x;
+            guint64 transposition;
+            guint64 sum;
+            guint64 d;
+            guint64 hp;
+            guint64 hn;
+
+            /* Transpositions of the previous and current text characters. */
+            x = ~d0[b] & pm;
+            transposition = ((x << 1) | transposition_carry) & previous_pm;
+            transposition_carry = x >> 63;
+
+            x = pm & vp[b];
+            sum = x + vp[b];
+            d = sum < x;
+            sum += add_carry;
+            add_carry = d | (sum < add_carry);
+
+            d = (sum ^ vp[b]) | pm | vn[b] | transposition;
+            hp = vn[b] | ~(d | vp[b]);
+            hn = d & vp[b];
+
+            if (b == n_blocks - 1)
             {
-                d[j * n + i] = dlm_minimum(
-                    d[(j - 1) * n + i] + 1,
-                    d[j * n + i - 1] + 1,
-                    d[(j - 1) * n + i - 1] + dlm_cost(s[i - 1], t[j - 1]),
-                    (j>1 && i>1 ?
-                         d[(j - 2) * n + i - 2] + dlm_cost(s[i - 1], t[j])
-                        + dlm_cost(s[i], t[j - 1])
-                    : 0x7fff)
-                );
+                if (hp & last)
+                {
+                    score++;
+                }
+                else if (hn & last)
+                {
+                    score--;
+                }
             }
-        }
-        metric = d[n * m - 1];
-        g_free(d);
-
-        /* Count a "similarity value" */
-        /* Subtract the extra byte added to each string length earlier. */
-        metric = 1000 - (1000 * (metric * 2)) / (m + n - 2);
 
-        g_free(t);
-        g_free(s);
-        return metric;
+            x = (hp << 1) | hp_carry;
+            hp_carry = hp >> 63;
+            vn[b] = x & d;
+            vp[b] = ((hn << 1) | hn_carry) | ~(x | d);
+            hn_carry = hn >> 63;
+            d0[b] = d;
+        }
     }
-    g_free(t);
-    g_free(s);
 
-    /* Return value of -1 indicates an error */
-    return -1;
+    return score;
 }
 
-/* "Cost" of changing from a to b. */
-static int
-dlm_cost (const char a, const char b)
+/* Count a "similarity value" from the distance and the lengths. */
+static gint
+dlm_metric (gsize distance,
+            gsize length_s,
+            gsize length_t)
 {
-    return a == b ? 0 : 1;
+    return 1000 - (gint)((1000 * (distance * 2)) / (length_s + length_t));
 }
 
-/* Return the smallest of four integers. */
-static int
-dlm_minimum (int a, int b, int c, int d)
+/*
+ * dlm:
+ * @ds: a UTF-8 string
+ * @dt: a UTF-8 string to compare with @ds
+ *
+ * Compute the Damerau-Levenshtein distance between the casefolded strings,
+ * and scale it to a similarity value.
+ *
+ * Returns: the similarity, from 0 for completely different strings to 1000
+ *          for equal strings, or -1 if either string is empty
+ */
+gint
+dlm (const gchar *ds, const gchar *dt)
 {
-    int min = a;
-    if (b < min)
+    EtDlmScratch *scratch;
+    const GString *pattern;
+    const GString *text;
+    gsize distance;
+
+    scratch = get_dlm_scratch ();
+    dlm_casefold (scratch->folded[0], ds);
+    dlm_casefold (scratch->folded[1], dt);
+
+    /* Return value of -1 indicates an error */
+    if (scratch->folded[0]->len == 0 || scratch->folded[1]->len == 0)
     {
-        min = b;
+        return -1;
     }
-    if (c < min)
+
+    /* The distance is symmetric, so use the shorter string as the pattern. */
+    if (scratch->folded[0]->len <= scratch->folded[1]->len)
     {
-        min = c;
+        pattern = scratch->folded[0];
+        text = scratch->folded[1];
     }
-    if (d < min)
+    else
     {
-        min = d;
+        pattern = scratch->folded[1];
+        text = scratch->folded[0];
     }
-    return min;
+
+    dlm_set_pattern (scratch, (const guchar *)pattern->str, pattern->len);
+    distance = dlm_distance (scratch, pattern->len, (const guchar *)text->str,
+                             text->len);
+    dlm_clear_pattern (scratch, (const guchar *)pattern->str, pattern->len);
+
+    return dlm_metric (distance, pattern->len, text->len);
+}
+
+/*
+ * et_dlm_find_best_matches:
+ * @queries: the strings to find matches for
+ * @n_queries: the number of @queries
+ * @candidates: the strings to match against
+ * @n_candidates: the number of @candidates
+ * @best_candidates: (out caller-allocates): an array of @n_queries indices
+ * @best_metrics: (out caller-allocates) (allow-none): an array of @n_queries
+ *                similarity values
+ *
+ * Find the most similar of @candidates for each of @queries, as with dlm().
+ * The candidates are casefolded only once, and the bit vectors of each query
+ * are reused for every candidate. Candidates which cannot beat the best match
+ * so far, because of the difference in length alone, are skipped.
+ *
+ * For each query, the index of the first candidate with the greatest
+ * similarity is stored in @best_candidates, or -1 if no candidate is at all
+ * similar to the query. The similarity of that candidate, or 0, is stored in
+ * @best_metrics.
+ */
+void
+et_dlm_find_best_matches (const gchar * const *queries,
+                          gsize n_queries,
+                          const gchar * const *candidates,
+                          gsize n_candidates,
+                          gssize *best_candidates,
+                          gint *best_metrics)
+{
+    EtDlmScratch *scratch;
+    GString *folded;
+    gsize *offsets;
+    gsize i;
+    gsize j;
+
+    g_return_if_fail (queries != NULL || n_queries == 0);
+    g_return_if_fail (candidates != NULL || n_candidates == 0);
+    g_return_if_fail (best_candidates != NULL || n_queries == 0);
+
+    scratch = get_dlm_scratch ();
+
+    /* Casefold all the candidates into a single buffer. */
+    folded = g_string_sized_new (n_candidates * 32);
+    offsets = g_new (gsize, n_candidates + 1);
+
+    for (j = 0; j < n_candidates; j++)
+    {
+        offsets[j] = folded->len;
+        dlm_casefold (scratch->folded[1], candidates[j]);
+        g_string_append_len (folded, scratch->folded[1]->str,
+                             scratch->folded[1]->len);
+    }
+
+    offsets[n_candidates] = folded->len;
+
+    for (i = 0; i < n_queries; i++)
+    {
+        const GString *query = scratch->folded[0];
+        gssize best = -1;
+        gint best_metric = 0;
+
+        dlm_casefold (scratch->folded[0], queries[i]);
+
+        if (query->len > 0)
+        {
+            dlm_set_pattern (scratch, (const guchar *)query->str, query->len);
+
+            for (j = 0; j < n_candidates; j++)
+            {
+                const gsize length = offsets[j + 1] - offsets[j];
+                const gsize difference = length > query->len
+                                         ? length - query->len
+                                         : query->len - length;
+                gint metric;
+
+                if (length == 0
+                    || dlm_metric (difference, query->len, length)
+                       <= best_metric)
+                {
+                    continue;
+                }
+
+                metric = dlm_metric (dlm_distance (scratch, query->len,
+                                                   (const guchar *)folded->str
+                                                   + offsets[j], length),
+                                     query->len, length);
+
+                if (metric > best_metric)
+                {
+                    best = j;
+                    best_metric = metric;
+                }
+            }
+
+            dlm_clear_pattern (scratch, (const guchar *)query->str,
+                               query->len);
+        }
+
+        best_candidates[i] = best;
+
+        if (best_metrics)
+        {
+            best_metrics[i] = best_metric;
+        }
+    }
+
+    g_free (offsets);
+    g_string_free (folded, TRUE);
 }
@@ -24,6 +24,10 @@
 G_BEGIN_DECLS
 
 gint dlm (const gchar *s, const gchar *t);
+void et_dlm_find_best_matches (const gchar * const *queries, gsize n_queries,
+                               const gchar * const *candidates,
+                               gsize n_candidates, gssize *best_candidates,
+                               gint *best_metrics);
 
 G_END_DECLS
 
@@ -27,11 +27,15 @@
 
 #include "application_window.h"
 #include "browser.h"
+#include "dir_prefetch.h"
 #include "file_description.h"
 #include "file_list.h"
+#include "file_monitor.h"
 #include "id3_tag.h"
 #include "log.h"
 #include "misc.h"
+#include "profile.h"
+#include "rename_plan.h"
 #include "cddb_dialog.h"
 #include "setting.h"
 #include "scan_dialog.h"
@@ -55,6 +59,10 @@ static gint SF_ButtonPressed_Write_Tag;
 static gboolean SF_HideMsgbox_Rename_File;
 /* To remember which button was pressed when renaming file */
 static gint SF_ButtonPressed_Rename_File;
+/* Renames which are executed together, once all the files are saved */
+static EtRenamePlan *SF_Rename_Plan;
+/* Files whose rename was added to SF_Rename_Plan */
+static GList *SF_Renamed_Files;
 
 static gboolean Write_File_Tag (ET_File *ETFile, gboolean hide_msgbox);
 static gint Save_File (ET_File *ETFile, gboolean multiple_files,
@@ -63,9 +71,12 @@ static gint Save_Selected_Files_With_Answer (gboolean force_saving_files);
 static gint Save_List_Of_Files (GList *etfilelist,
                                 gboolean force_saving_files);
 
+static void execute_rename_plan (void);
+static void log_profile_summary (void);
 static GList *read_directory_recursively (GList *file_list,
                                           GFileEnumerator *dir_enumerator,
-                                          gboolean recurse);
+                                          gboolean recurse,
+                                          GList **dir_list);
 static void Open_Quit_Recursion_Function_Window (void);
 static void Destroy_Quit_Recursion_Function_Window (void);
 static void et_on_quit_recursion_response (GtkDialog *dialog, gint response_id,
@@ -140,6 +151,8 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
 
     g_return_val_if_fail (ETCore != NULL, FALSE);
 
+    et_profile_operation_begin (_("Saving files"));
+
     window = ET_APPLICATION_WINDOW (MainWindow);
 
     /* Save the current position in the list */
@@ -153,45 +166,24 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     /* Count the number of files to save */
     /* Count the number of files changed by an external program */
     nb_files_to_save = 0;
-    nb_files_changed_by_ext_program = 0;
 
     for (l = etfilelist; l != NULL; l = g_list_next (l))
     {
-        GFile *file;
-        GFileInfo *fileinfo;
-
         const ET_File *ETFile = (ET_File *)l->data;
         const File_Tag *file_tag  = (File_Tag *)ETFile->FileTag->data;
         const File_Name *FileName = (File_Name *)ETFile->FileNameNew->data;
-        const gchar *filename_cur = ((File_Name *)ETFile->FileNameCur->data)->value;
-        const gchar *filename_cur_utf8 = ((File_Name *)ETFile->FileNameCur->data)->value_utf8;
-        gchar *basename_cur_utf8 = g_path_get_basename(filename_cur_utf8);
 
         // Count only the changed files or all files if force_saving_files==TRUE
         if (force_saving_files
             || (FileName && FileName->saved == FALSE)
             || (file_tag && file_tag->saved == FALSE))
             nb_files_to_save++;
-
-        file = g_file_new_for_path (filename_cur);
-        fileinfo = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                      G_FILE_QUERY_INFO_NONE, NULL, NULL);
-        g_object_unref (file);
-
-        if (fileinfo)
-        {
-            if (ETFile->FileModificationTime
-                != g_file_info_get_attribute_uint64 (fileinfo,
-                                                     G_FILE_ATTRIBUTE_TIME_MODIFIED))
-            {
-                nb_files_changed_by_ext_program++;
-            }
-
-            g_object_unref (fileinfo);
-        }
-        g_free(basename_cur_utf8);
     }
 
+    /* Only the files which are going to be saved are checked. */
+    nb_files_changed_by_ext_program = et_file_list_count_modified_externally (etfilelist,
+                                                                              force_saving_files);
+
     /* Initialize status bar */
     et_application_window_progress_set_fraction (window, 0.0);
     progress_bar_index = 0;
@@ -208,7 +200,15 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     SF_HideMsgbox_Write_Tag = FALSE;
     SF_HideMsgbox_Rename_File = FALSE;
 
+    /* Rename the files together once all the tags are written, so that a file
+     * can take the old name of another file of the list. */
+    if (nb_files_to_save > 1)
+    {
+        SF_Rename_Plan = et_rename_plan_new ();
+    }
+
     Main_Stop_Button_Pressed = FALSE;
+    et_file_save_batch_begin ();
     /* Activate the stop button. */
     action = g_action_map_lookup_action (G_ACTION_MAP (MainWindow), "stop");
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action), FALSE);
@@ -292,6 +292,10 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
 
             if (saving_answer == -1)
             {
+                /* The files which were accepted are still renamed. */
+                execute_rename_plan ();
+                et_file_save_batch_end ();
+
                 /* Stop saving files + reinit progress bar */
                 et_application_window_progress_set_text (window, "");
                 et_application_window_progress_set_fraction (window, 0.0);
@@ -308,6 +312,8 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
                 {
                     gtk_tree_path_free (currentPath);
                 }
+
+                log_profile_summary ();
                 return -1; /* We stop all actions */
             }
         }
@@ -316,6 +322,9 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     if (currentPath)
         gtk_tree_path_free(currentPath);
 
+    execute_rename_plan ();
+    et_file_save_batch_end ();
+
     if (Main_Stop_Button_Pressed)
         msg = g_strdup (_("Saving files was stopped"));
     else
@@ -358,6 +367,7 @@ Save_List_Of_Files (GList *etfilelist, gboolean force_saving_files)
     et_application_window_status_bar_message (window, msg, TRUE);
     g_free(msg);
     et_application_window_browser_refresh_list (window);
+    log_profile_summary ();
     return TRUE;
 }
 
@@ -629,6 +639,17 @@ Save_File (ET_File *ETFile, gboolean multiple_files,
                 GError *error = NULL;
                 const gchar *cur_filename = ((File_Name *)ETFile->FileNameCur->data)->value;
                 const gchar *new_filename = ((File_Name *)ETFile->FileNameNew->data)->value;
+
+                /* Renamed with the other files by execute_rename_plan(). */
+                if (SF_Rename_Plan)
+                {
+                    et_rename_plan_add (SF_Rename_Plan, cur_filename,
+                                        new_filename);
+                    SF_Renamed_Files = g_list_prepend (SF_Renamed_Files,
+                                                       ETFile);
+                    break;
+                }
+
                 rc = et_rename_file (cur_filename, new_filename, &error);
 
                 // if 'SF_HideMsgbox_Rename_File is TRUE', then errors are displayed only in log
@@ -706,6 +727,97 @@ Save_File (ET_File *ETFile, gboolean multiple_files,
     return 1;
 }
 
+/*
+ * Rename the files which were saved by Save_List_Of_Files(), all at once. If
+ * a rename fails, none of the files are renamed.
+ */
+static void
+execute_rename_plan (void)
+{
+    GError *error = NULL;
+    GList *l;
+    gint64 span;
+    gboolean success;
+
+    if (SF_Rename_Plan == NULL)
+    {
+        return;
+    }
+
+    span = et_profile_span_begin ();
+    success = et_rename_plan_execute (SF_Rename_Plan, &error);
+    et_profile_span_end (ET_PROFILE_PHASE_RENAME, span);
+
+    if (success)
+    {
+        for (l = SF_Renamed_Files; l != NULL; l = g_list_next (l))
+        {
+            ET_File *ETFile = (ET_File *)l->data;
+
+            /* Mark after renaming files. */
+            ETFile->FileNameCur = ETFile->FileNameNew;
+            ET_Mark_File_Name_As_Saved (ETFile);
+        }
+    }
+    else
+    {
+        if (!SF_HideMsgbox_Rename_File)
+        {
+            GtkWidget *msgdialog;
+
+            msgdialog = gtk_message_dialog_new (GTK_WINDOW (MainWindow),
+                                                GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                                GTK_MESSAGE_ERROR,
+                                                GTK_BUTTONS_CLOSE,
+                                                "%s",
+                                                _("Cannot rename files"));
+            gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
+                                                      "%s", error->message);
+            gtk_window_set_title (GTK_WINDOW (msgdialog),
+                                  _("Rename File Error"));
+
+            gtk_dialog_run (GTK_DIALOG (msgdialog));
+            gtk_widget_destroy (msgdialog);
+        }
+
+        Log_Print (LOG_ERROR, _("Cannot rename files: %s"), error->message);
+        et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                                  _("File(s) not renamed"),
+                                                  TRUE);
+        g_error_free (error);
+    }
+
+    et_rename_plan_free (SF_Rename_Plan);
+    SF_Rename_Plan = NULL;
+    g_list_free (SF_Renamed_Files);
+    SF_Renamed_Files = NULL;
+}
+
+/*
+ * Log the timing of the operation which has just finished, if timing is
+ * enabled.
+ */
+static void
+log_profile_summary (void)
+{
+    gchar **lines;
+    gsize i;
+
+    lines = et_profile_operation_end ();
+
+    if (lines == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        Log_Print (LOG_INFO, "%s", lines[i]);
+    }
+
+    g_strfreev (lines);
+}
+
 /*
  * Write tag of the ETFile
  * Return TRUE => OK
@@ -814,14 +926,22 @@ Read_Directory (const gchar *path_real)
     guint  nbrfile = 0;
     double fraction;
     GList *FileList = NULL;
+    GList *DirList = NULL;
     GList *l;
+    gboolean recurse;
     gint   progress_bar_index = 0;
     GAction *action;
     EtApplicationWindow *window;
+    gint64 span;
 
     g_return_val_if_fail (path_real != NULL, FALSE);
 
     ReadingDirectory = TRUE;    /* A flag to avoid to start another reading */
+    et_profile_operation_begin (_("Reading directory"));
+
+    /* The old file list is freed, so stop applying changes to it. */
+    et_file_monitor_stop ();
+    et_dir_prefetch_stop ();
 
     /* Initialize file list */
     ET_Core_Free ();
@@ -872,6 +992,7 @@ Read_Directory (const gchar *path_real)
         et_application_window_browser_set_sensitive (window, TRUE);
         g_object_unref (dir);
         g_error_free (error);
+        log_profile_summary ();
         return FALSE;
     }
 
@@ -887,12 +1008,14 @@ Read_Directory (const gchar *path_real)
     et_application_window_status_bar_message (window, msg, FALSE);
     g_free (msg);
     /* Search the supported files. */
-    FileList = read_directory_recursively (FileList, dir_enumerator,
-                                           g_settings_get_boolean (MainSettings,
-                                                                   "browse-subdir"));
+    recurse = g_settings_get_boolean (MainSettings, "browse-subdir");
+    DirList = g_list_prepend (DirList, dir);
+    span = et_profile_span_begin ();
+    FileList = read_directory_recursively (FileList, dir_enumerator, recurse,
+                                           &DirList);
     g_file_enumerator_close (dir_enumerator, NULL, &error);
     g_object_unref (dir_enumerator);
-    g_object_unref (dir);
+    et_profile_span_end (ET_PROFILE_PHASE_ENUMERATE, span);
 
     nbrfile = g_list_length(FileList);
 
@@ -929,6 +1052,10 @@ Read_Directory (const gchar *path_real)
     g_list_free_full (FileList, g_object_unref);
     et_application_window_progress_set_text (window, "");
 
+    /* Apply later changes to the directories incrementally. */
+    et_file_monitor_start (DirList, recurse);
+    g_list_free_full (DirList, g_object_unref);
+
     /* Close window to quit recursion */
     Destroy_Quit_Recursion_Function_Window();
     Main_Stop_Button_Pressed = FALSE;
@@ -995,6 +1122,11 @@ Read_Directory (const gchar *path_real)
     et_application_window_set_normal_cursor (window);
     ReadingDirectory = FALSE;
 
+    log_profile_summary ();
+
+    /* Read ahead the directories which are likely to be browsed next. */
+    et_dir_prefetch_start (path_real);
+
     return TRUE;
 }
 
@@ -1002,10 +1134,11 @@ Read_Directory (const gchar *path_real)
 
 /*
  * Recurse the path to create a list of files. Return a GList of the files found.
+ * The subdirectories which were read are prepended to @dir_list.
  */
 static GList *
 read_directory_recursively (GList *file_list, GFileEnumerator *dir_enumerator,
-                            gboolean recurse)
+                            gboolean recurse, GList **dir_list)
 {
     GError *error = NULL;
     GFileInfo *info;
@@ -1069,8 +1202,9 @@ read_directory_recursively (GList *file_list, GFileEnumerator *dir_enumerator,
                     }
                     file_list = read_directory_recursively (file_list,
                                                             childdir_enumerator,
-                                                            recurse);
-                    g_object_unref (child_dir);
+                                                            recurse,
+                                                            dir_list);
+                    *dir_list = g_list_prepend (*dir_list, child_dir);
                     g_file_enumerator_close (childdir_enumerator, NULL,
                                              &error);
                     g_object_unref (childdir_enumerator);
@@ -57,10 +57,12 @@ ET_Core_Free (void)
         ETCore->ETFileDisplayedList = NULL;
     }
 
-    if (ETCore->ETHistoryFileList)
+    et_history_list_clear ();
+
+    if (ETCore->ETFileChanges)
     {
-        et_history_file_list_free (ETCore->ETHistoryFileList);
-        ETCore->ETHistoryFileList = NULL;
+        g_hash_table_destroy (ETCore->ETFileChanges);
+        ETCore->ETFileChanges = NULL;
     }
 
     if (ETCore->ETArtistAlbumFileList)
@@ -55,7 +55,13 @@ typedef struct
 
 
     // History list
-    GList *ETHistoryFileList;           // History list of files changes for undo/redo actions
+    GList *ETHistoryFileList;           // History list of files changes for undo/redo actions (points to the current change)
+    GList *ETHistoryFileListFirst;      // First item of the history list, which does not refer to a file
+    guint ETHistoryFileListLength;      // Number of changes in the history list
+    gsize ETHistoryFileListSize;        // Estimated memory used by the undo data of the changes in the history list (in bytes)
+
+    // Changed files
+    GHashTable *ETFileChanges;          // Files changed since the browser was last refreshed, with the EtFileChange flags of what changed (may be NULL)
 } ET_Core;
 
 extern ET_Core *ETCore; /* Main pointer to structure needed by EasyTAG. */
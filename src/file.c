@@ -36,6 +36,7 @@
 #   include "id3_tag.h"
 #endif
 #include "picture.h"
+#include "profile.h"
 #include "ape_tag.h"
 #ifdef ENABLE_OGG
 #include "ogg_tag.h"
@@ -954,16 +955,14 @@ ET_Free_File_List_Item (ET_File *ETFile)
         {
             ET_Free_File_Tag_List (ETFile->FileTagList);
         }
-        if (ETFile->FileTagListBak)
-        {
-            ET_Free_File_Tag_List (ETFile->FileTagListBak);
-        }
         /* Frees infos of ETFileInfo */
         if (ETFile->ETFileInfo)
         {
             et_file_info_free (ETFile->ETFileInfo);
         }
 
+        et_file_list_unmark_changed (ETFile);
+
         g_free(ETFile->ETFileExtension);
         g_slice_free (ET_File, ETFile);
     }
@@ -1270,6 +1269,64 @@ ET_Save_File_Tag_Internal (ET_File *ETFile, File_Tag *FileTag)
 }
 
 
+/* Parent directories of the files saved in the current batch, or %NULL if
+ * no batch was started. */
+static GHashTable *save_batch_directories = NULL;
+
+/*
+ * et_file_save_batch_begin:
+ *
+ * Start saving several files. The changes to the parent directories of the
+ * files, which do not depend on each file, are delayed until
+ * et_file_save_batch_end() is called.
+ */
+void
+et_file_save_batch_begin (void)
+{
+    g_return_if_fail (save_batch_directories == NULL);
+
+    save_batch_directories = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, NULL);
+}
+
+/*
+ * et_file_save_batch_end:
+ *
+ * Finish saving several files, started with et_file_save_batch_begin(). The
+ * modification time of each parent directory of the saved files is updated
+ * once, if requested in the settings.
+ *
+ * Returns: the number of directories which were updated
+ */
+guint
+et_file_save_batch_end (void)
+{
+    GHashTableIter iter;
+    gpointer path;
+    guint n_directories = 0;
+    gint64 span;
+
+    g_return_val_if_fail (save_batch_directories != NULL, 0);
+
+    span = et_profile_span_begin ();
+    g_hash_table_iter_init (&iter, save_batch_directories);
+
+    while (g_hash_table_iter_next (&iter, &path, NULL))
+    {
+        if (g_utime (path, NULL) == 0)
+        {
+            n_directories++;
+        }
+    }
+
+    et_profile_span_end (ET_PROFILE_PHASE_TIMESTAMPS, span);
+
+    g_hash_table_destroy (save_batch_directories);
+    save_batch_directories = NULL;
+
+    return n_directories;
+}
+
 /*
  * Save data contained into File_Tag structure to the file on hard disk.
  */
@@ -1280,8 +1337,11 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
     const gchar *cur_filename;
     const gchar *cur_filename_utf8;
     gboolean state;
+    gboolean preserve_time;
+    gboolean time_preserved = FALSE;
     GFile *file;
-    GFileInfo *fileinfo;
+    GFileInfo *fileinfo = NULL;
+    gint64 span;
 
     g_return_val_if_fail (ETFile != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
@@ -1291,10 +1351,27 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
 
     description = ETFile->ETFileDescription;
 
-    /* Store the file timestamps (in case they are to be preserved) */
+    /* Store the file timestamps, only if they are to be preserved. */
+    span = et_profile_span_begin ();
     file = g_file_new_for_path (cur_filename);
-    fileinfo = g_file_query_info (file, "time::*", G_FILE_QUERY_INFO_NONE,
-                                  NULL, NULL);
+    preserve_time = g_settings_get_boolean (MainSettings,
+                                            "file-preserve-modification-time");
+
+    if (preserve_time)
+    {
+        /* Only the times which can be set, so that failing to set them
+         * means that they were not restored. */
+        fileinfo = g_file_query_info (file,
+                                      G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+                                      G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+                                      G_FILE_ATTRIBUTE_TIME_ACCESS ","
+                                      G_FILE_ATTRIBUTE_TIME_ACCESS_USEC,
+                                      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    }
+
+    et_profile_span_end (ET_PROFILE_PHASE_TIMESTAMPS, span);
+
+    span = et_profile_span_begin ();
 
     switch (description->TagType)
     {
@@ -1358,31 +1435,41 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
             break;
     }
 
+    et_profile_span_end (ET_PROFILE_PHASE_WRITE_TAG, span);
+
     /* Update properties for the file. */
+    span = et_profile_span_begin ();
+
     if (fileinfo)
     {
-        if (g_settings_get_boolean (MainSettings,
-                                    "file-preserve-modification-time"))
+        time_preserved = g_file_set_attributes_from_info (file, fileinfo,
+                                                          G_FILE_QUERY_INFO_NONE,
+                                                          NULL, NULL);
+
+        /* Update the stored file modification time to prevent EasyTAG from
+         * warning that an external program has changed the file. The time
+         * which was restored is already known. */
+        if (time_preserved)
         {
-            g_file_set_attributes_from_info (file, fileinfo,
-                                             G_FILE_QUERY_INFO_NONE,
-                                             NULL, NULL);
+            ETFile->FileModificationTime = g_file_info_get_attribute_uint64 (fileinfo,
+                                                                             G_FILE_ATTRIBUTE_TIME_MODIFIED);
         }
 
         g_object_unref (fileinfo);
     }
 
-    /* Update the stored file modification time to prevent EasyTAG from warning
-     * that an external program has changed the file. */
-    fileinfo = g_file_query_info (file,
-                                  G_FILE_ATTRIBUTE_TIME_MODIFIED,
-                                  G_FILE_QUERY_INFO_NONE, NULL, NULL);
-
-    if (fileinfo)
+    if (!time_preserved)
     {
-        ETFile->FileModificationTime = g_file_info_get_attribute_uint64 (fileinfo,
-                                                                         G_FILE_ATTRIBUTE_TIME_MODIFIED);
-        g_object_unref (fileinfo);
+        fileinfo = g_file_query_info (file,
+                                      G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+        if (fileinfo)
+        {
+            ETFile->FileModificationTime = g_file_info_get_attribute_uint64 (fileinfo,
+                                                                             G_FILE_ATTRIBUTE_TIME_MODIFIED);
+            g_object_unref (fileinfo);
+        }
     }
 
     g_object_unref (file);
@@ -1399,21 +1486,73 @@ ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error)
                                     "file-update-parent-modification-time"))
         {
             gchar *path = g_path_get_dirname (cur_filename);
-            g_utime (path, NULL);
-            g_free (path);
+
+            /* Within a batch, each directory is only updated once, by
+             * et_file_save_batch_end(). */
+            if (save_batch_directories)
+            {
+                g_hash_table_add (save_batch_directories, path);
+            }
+            else
+            {
+                g_utime (path, NULL);
+                g_free (path);
+            }
         }
 
+        et_profile_span_end (ET_PROFILE_PHASE_TIMESTAMPS, span);
+        et_profile_count_file ();
+
         ET_Mark_File_Tag_As_Saved(ETFile);
         return TRUE;
     }
     else
     {
+        et_profile_span_end (ET_PROFILE_PHASE_TIMESTAMPS, span);
         g_assert (error == NULL || *error != NULL);
 
         return FALSE;
     }
 }
 
+/* The limits of the main undo list, read from the settings once and then
+ * updated when they change, as the list is trimmed after each change. */
+static gboolean history_limits_read = FALSE;
+static guint history_max_length;
+static gsize history_max_size;
+
+static void
+on_history_limits_changed (GSettings *settings,
+                           const gchar *key,
+                           gpointer user_data)
+{
+    history_max_length = g_settings_get_uint (settings,
+                                              "undo-history-length");
+    history_max_size = (gsize)g_settings_get_uint (settings,
+                                                   "undo-history-size")
+                       * 1024 * 1024;
+}
+
+/*
+ * Forget the oldest changes of the main undo list, to keep it within the
+ * limits of the settings.
+ */
+static void
+et_file_trim_history (void)
+{
+    if (!history_limits_read)
+    {
+        on_history_limits_changed (MainSettings, NULL, NULL);
+        g_signal_connect (MainSettings, "changed::undo-history-length",
+                          G_CALLBACK (on_history_limits_changed), NULL);
+        g_signal_connect (MainSettings, "changed::undo-history-size",
+                          G_CALLBACK (on_history_limits_changed), NULL);
+        history_limits_read = TRUE;
+    }
+
+    et_history_list_trim (history_max_length, history_max_size);
+}
+
 /*
  * Check if 'FileName' and 'FileTag' differ with those of 'ETFile'.
  * Manage undo feature for the ETFile and the main undo list.
@@ -1424,6 +1563,7 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
                                 File_Tag *FileTag)
 {
     gboolean undo_added = FALSE;
+    gsize undo_size = 0;
 
     g_return_val_if_fail (ETFile != NULL, FALSE);
 
@@ -1437,6 +1577,7 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
                                                FileName) == TRUE)
         {
             ET_Add_File_Name_To_List(ETFile,FileName);
+            undo_size += et_file_name_get_size ((File_Name *)ETFile->FileNameNew->prev->data);
             undo_added |= TRUE;
         }else
         {
@@ -1454,6 +1595,7 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
                                               FileTag) == TRUE)
         {
             ET_Add_File_Tag_To_List(ETFile,FileTag);
+            undo_size += et_file_tag_get_size ((File_Tag *)ETFile->FileTag->prev->data);
             undo_added |= TRUE;
         }
         else
@@ -1467,14 +1609,382 @@ ET_Manage_Changes_Of_File_Data (ET_File *ETFile,
      */
     if (undo_added)
     {
-        ETCore->ETHistoryFileList = et_history_list_add (ETCore->ETHistoryFileList,
-                                                         ETFile);
+        et_history_list_add (ETFile, undo_size);
+        et_file_trim_history ();
     }
 
     //return TRUE;
     return undo_added;
 }
 
+typedef struct
+{
+    ET_File *ETFile;
+    File_Tag *FileTag;   /* New values of the changed fields only */
+    guint fields;        /* EtFileTagField flags of the changed fields */
+    File_Name *FileName; /* New filename, or NULL if it is not changed */
+} EtFileTagEditItem;
+
+struct _EtFileTagEdit
+{
+    GArray *items;        /* EtFileTagEditItem, in the order of the first change of each file */
+    GHashTable *indices;  /* ET_File to its index in items, plus one */
+};
+
+/*
+ * et_file_tag_edit_new:
+ *
+ * Start a change of the tags of several files, which is only applied by
+ * et_file_tag_edit_commit().
+ *
+ * Returns: a new #EtFileTagEdit
+ */
+EtFileTagEdit *
+et_file_tag_edit_new (void)
+{
+    EtFileTagEdit *edit;
+
+    edit = g_slice_new (EtFileTagEdit);
+    edit->items = g_array_new (FALSE, FALSE, sizeof (EtFileTagEditItem));
+    edit->indices = g_hash_table_new (NULL, NULL);
+
+    return edit;
+}
+
+static EtFileTagEditItem *
+et_file_tag_edit_lookup (const EtFileTagEdit *edit,
+                         const ET_File *ETFile)
+{
+    guint index;
+
+    index = GPOINTER_TO_UINT (g_hash_table_lookup (edit->indices, ETFile));
+
+    if (index == 0)
+    {
+        return NULL;
+    }
+
+    return &g_array_index (edit->items, EtFileTagEditItem, index - 1);
+}
+
+static EtFileTagEditItem *
+et_file_tag_edit_get_item (EtFileTagEdit *edit,
+                           ET_File *ETFile)
+{
+    EtFileTagEditItem *item;
+    EtFileTagEditItem new_item;
+
+    item = et_file_tag_edit_lookup (edit, ETFile);
+
+    if (item)
+    {
+        return item;
+    }
+
+    new_item.ETFile = ETFile;
+    new_item.FileTag = et_file_tag_new ();
+    new_item.fields = 0;
+    new_item.FileName = NULL;
+    g_array_append_val (edit->items, new_item);
+    g_hash_table_insert (edit->indices, ETFile,
+                         GUINT_TO_POINTER (edit->items->len));
+
+    return &g_array_index (edit->items, EtFileTagEditItem,
+                           edit->items->len - 1);
+}
+
+/*
+ * et_file_tag_edit_set_field:
+ * @edit: the change to which to add the field
+ * @ETFile: the file to change
+ * @field: a single string field
+ * @value: (allow-none): the new value, or %NULL or an empty string to remove
+ *         the field
+ *
+ * Set a field of the tag of @ETFile. The value is only compared with the same
+ * field of the current tag, and only copied if it differs, so that setting a
+ * common value on many files is cheap for the files which already have it.
+ */
+void
+et_file_tag_edit_set_field (EtFileTagEdit *edit,
+                            ET_File *ETFile,
+                            EtFileTagField field,
+                            const gchar *value)
+{
+    EtFileTagEditItem *item;
+    const File_Tag *current;
+
+    g_return_if_fail (edit != NULL);
+    g_return_if_fail (ETFile != NULL && ETFile->FileTag != NULL);
+
+    if (value && *value == '\0')
+    {
+        value = NULL;
+    }
+
+    current = (File_Tag *)ETFile->FileTag->data;
+
+    if (et_normalized_strcmp0 (et_file_tag_get_field_value (current, field),
+                               value) == 0)
+    {
+        /* Setting the current value again cancels an earlier change. */
+        item = et_file_tag_edit_lookup (edit, ETFile);
+
+        if (item && (item->fields & field))
+        {
+            et_file_tag_set_field_value (item->FileTag, field, NULL);
+            item->fields &= ~field;
+        }
+
+        return;
+    }
+
+    item = et_file_tag_edit_get_item (edit, ETFile);
+    et_file_tag_set_field_value (item->FileTag, field, value);
+    item->fields |= field;
+}
+
+/*
+ * et_file_tag_edit_get_field:
+ * @edit: a change of the tags of several files
+ * @ETFile: a file
+ * @field: a single string field
+ *
+ * Returns: (transfer none): the value of @field for @ETFile, with the changes
+ *          of @edit which were not committed yet
+ */
+const gchar *
+et_file_tag_edit_get_field (const EtFileTagEdit *edit,
+                            const ET_File *ETFile,
+                            EtFileTagField field)
+{
+    const EtFileTagEditItem *item;
+
+    g_return_val_if_fail (edit != NULL, NULL);
+    g_return_val_if_fail (ETFile != NULL && ETFile->FileTag != NULL, NULL);
+
+    item = et_file_tag_edit_lookup (edit, ETFile);
+
+    if (item && (item->fields & field))
+    {
+        return et_file_tag_get_field_value (item->FileTag, field);
+    }
+
+    return et_file_tag_get_field_value ((File_Tag *)ETFile->FileTag->data,
+                                        field);
+}
+
+static gboolean
+et_file_pictures_differ (const EtPicture *pic1,
+                         const EtPicture *pic2)
+{
+    while (pic1 || pic2)
+    {
+        if (et_picture_detect_difference (pic1, pic2))
+        {
+            return TRUE;
+        }
+
+        pic1 = pic1->next;
+        pic2 = pic2->next;
+    }
+
+    return FALSE;
+}
+
+/*
+ * et_file_tag_edit_set_picture:
+ * @edit: the change to which to add the pictures
+ * @ETFile: the file to change
+ * @pic: (allow-none): the new pictures, copied only if they differ from those
+ *       of the current tag of @ETFile
+ *
+ * Set the pictures of the tag of @ETFile.
+ */
+void
+et_file_tag_edit_set_picture (EtFileTagEdit *edit,
+                              ET_File *ETFile,
+                              const EtPicture *pic)
+{
+    EtFileTagEditItem *item;
+    const File_Tag *current;
+
+    g_return_if_fail (edit != NULL);
+    g_return_if_fail (ETFile != NULL && ETFile->FileTag != NULL);
+
+    current = (File_Tag *)ETFile->FileTag->data;
+
+    if (!et_file_pictures_differ (current->picture, pic))
+    {
+        item = et_file_tag_edit_lookup (edit, ETFile);
+
+        if (item && (item->fields & ET_FILE_TAG_FIELD_PICTURE))
+        {
+            et_file_tag_set_picture (item->FileTag, NULL);
+            item->fields &= ~ET_FILE_TAG_FIELD_PICTURE;
+        }
+
+        return;
+    }
+
+    item = et_file_tag_edit_get_item (edit, ETFile);
+    et_file_tag_set_picture (item->FileTag, pic);
+    item->fields |= ET_FILE_TAG_FIELD_PICTURE;
+}
+
+/*
+ * et_file_tag_edit_set_filename:
+ * @edit: the change to which to add the filename
+ * @ETFile: the file to rename
+ * @FileName: (transfer full): the new filename
+ *
+ * Set the filename of @ETFile, so that the renaming is undone together with
+ * the changes of the tags. @FileName is freed if it does not differ from the
+ * current filename.
+ */
+void
+et_file_tag_edit_set_filename (EtFileTagEdit *edit,
+                               ET_File *ETFile,
+                               File_Name *FileName)
+{
+    EtFileTagEditItem *item;
+
+    g_return_if_fail (edit != NULL);
+    g_return_if_fail (ETFile != NULL && ETFile->FileNameNew != NULL);
+    g_return_if_fail (FileName != NULL);
+
+    if (!et_file_name_detect_difference ((File_Name *)ETFile->FileNameNew->data,
+                                         FileName))
+    {
+        et_file_name_free (FileName);
+        item = et_file_tag_edit_lookup (edit, ETFile);
+
+        if (item && item->FileName)
+        {
+            et_file_name_free (item->FileName);
+            item->FileName = NULL;
+        }
+
+        return;
+    }
+
+    item = et_file_tag_edit_get_item (edit, ETFile);
+
+    if (item->FileName)
+    {
+        et_file_name_free (item->FileName);
+    }
+
+    item->FileName = FileName;
+}
+
+/*
+ * et_file_tag_edit_commit:
+ * @edit: (transfer full): the change to apply
+ *
+ * Apply the change to the tags and the filenames of the files, and add it to
+ * the main undo list as a single change, which undoes or redoes the tags and
+ * the filenames of all the files at once. The fields which were not changed
+ * are moved from the current tags rather than copied. Frees @edit.
+ *
+ * Returns: the number of files which were changed
+ */
+guint
+et_file_tag_edit_commit (EtFileTagEdit *edit)
+{
+    GPtrArray *files;
+    gsize undo_size = 0;
+    guint n_files;
+    guint i;
+
+    g_return_val_if_fail (edit != NULL, 0);
+
+    files = g_ptr_array_sized_new (edit->items->len);
+
+    for (i = 0; i < edit->items->len; i++)
+    {
+        EtFileTagEditItem *item = &g_array_index (edit->items,
+                                                  EtFileTagEditItem, i);
+        guint key;
+
+        if (item->fields == 0 && item->FileName == NULL)
+        {
+            et_file_tag_free (item->FileTag);
+            continue;
+        }
+
+        /* The changes of the files were started in any order, but are
+         * committed together. The tag and the filename of a file share the
+         * key, so that they are undone together. */
+        key = et_undo_key_new ();
+
+        if (item->fields != 0)
+        {
+            File_Tag *current = (File_Tag *)item->ETFile->FileTag->data;
+
+            et_file_tag_take_unchanged (item->FileTag, current, item->fields);
+            item->FileTag->key = key;
+            ET_Add_File_Tag_To_List (item->ETFile, item->FileTag);
+            undo_size += et_file_tag_get_size (current);
+        }
+        else
+        {
+            et_file_tag_free (item->FileTag);
+        }
+
+        if (item->FileName)
+        {
+            item->FileName->key = key;
+            ET_Add_File_Name_To_List (item->ETFile, item->FileName);
+            undo_size += et_file_name_get_size ((File_Name *)item->ETFile->FileNameNew->prev->data);
+        }
+
+        g_ptr_array_add (files, item->ETFile);
+    }
+
+    n_files = files->len;
+
+    if (n_files > 0)
+    {
+        et_history_list_add_files (files, undo_size);
+        et_file_trim_history ();
+    }
+    else
+    {
+        g_ptr_array_unref (files);
+    }
+
+    g_hash_table_destroy (edit->indices);
+    g_array_free (edit->items, TRUE);
+    g_slice_free (EtFileTagEdit, edit);
+
+    return n_files;
+}
+
+/*
+ * Frees the items of FileNameListBak, except the one of the filename on the
+ * hard disk, which is still needed after some 'undo'.
+ */
+static void
+ET_Prune_File_Name_List_Bak (ET_File *ETFile)
+{
+    GList *l = ETFile->FileNameListBak;
+
+    while (l != NULL)
+    {
+        GList *next = g_list_next (l);
+
+        if (l != ETFile->FileNameCur)
+        {
+            et_file_name_free ((File_Name *)l->data);
+            ETFile->FileNameListBak = g_list_delete_link (ETFile->FileNameListBak,
+                                                          l);
+        }
+
+        l = next;
+    }
+}
+
 /*
  * Add a FileName item to the history list of ETFile
  */
@@ -1500,9 +2010,11 @@ ET_Add_File_Name_To_List (ET_File *ETFile, File_Name *FileName)
     ETFile->FileNameList = g_list_append(ETFile->FileNameList,FileName);
     /* Set the current item to use */
     ETFile->FileNameNew  = g_list_last(ETFile->FileNameList);
-    /* Backup list */
-    /* FIX ME! Keep only the saved item */
+    /* Backup list, which only needs to keep the saved item. */
     ETFile->FileNameListBak = g_list_concat(ETFile->FileNameListBak,cut_list);
+    ET_Prune_File_Name_List_Bak (ETFile);
+
+    et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_STATE);
 
     return TRUE;
 }
@@ -1522,15 +2034,36 @@ ET_Add_File_Tag_To_List (ET_File *ETFile, File_Tag *FileTag)
         cut_list = ETFile->FileTag->next; // Cut after the current item...
         ETFile->FileTag->next = NULL;
     }
+
+    /* The items removed by 'undo' can no longer be reached, and the saved
+     * state of the tag is only read from the current item. */
     if (cut_list)
+    {
         cut_list->prev = NULL;
+        ET_Free_File_Tag_List (cut_list);
+    }
 
     /* Add the new item to the list */
     ETFile->FileTagList = g_list_append(ETFile->FileTagList,FileTag);
     /* Set the current item to use */
     ETFile->FileTag     = g_list_last(ETFile->FileTagList);
-    /* Backup list */
-    ETFile->FileTagListBak = g_list_concat(ETFile->FileTagListBak,cut_list);
+
+    /* Keep only the differences with the new item in the previous one. */
+    if (ETFile->FileTag->prev)
+    {
+        File_Tag *prev = (File_Tag *)ETFile->FileTag->prev->data;
+
+        et_file_list_mark_changed (ETFile,
+                                   et_file_tag_get_changed_fields (prev,
+                                                                   FileTag)
+                                   | ET_FILE_CHANGE_STATE);
+        et_file_tag_delta_encode (prev, FileTag);
+    }
+    else
+    {
+        et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_TAG
+                                           | ET_FILE_CHANGE_STATE);
+    }
 
     return TRUE;
 }
@@ -1571,8 +2104,20 @@ gboolean ET_Undo_File_Data (ET_File *ETFile)
     if (ETFile->FileTag->prev && ETFile->FileTag->data
     && (undo_key==((File_Tag *)ETFile->FileTag->data)->key))
     {
+        et_file_tag_delta_swap ((File_Tag *)ETFile->FileTag->prev->data,
+                                (File_Tag *)ETFile->FileTag->data);
         ETFile->FileTag = ETFile->FileTag->prev;
         has_filetag_undo_data  = TRUE;
+
+        /* The undone item now only keeps the fields which differ. */
+        et_file_list_mark_changed (ETFile,
+                                   et_file_tag_get_changed_fields ((File_Tag *)ETFile->FileTag->data,
+                                                                   (File_Tag *)ETFile->FileTag->next->data));
+    }
+
+    if (has_filename_undo_data | has_filetag_undo_data)
+    {
+        et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_STATE);
     }
 
     return has_filename_undo_data | has_filetag_undo_data;
@@ -1632,8 +2177,19 @@ gboolean ET_Redo_File_Data (ET_File *ETFile)
     if (ETFile->FileTag->next && ETFile->FileTag->next->data
     && (undo_key==((File_Tag *)ETFile->FileTag->next->data)->key))
     {
+        et_file_tag_delta_swap ((File_Tag *)ETFile->FileTag->next->data,
+                                (File_Tag *)ETFile->FileTag->data);
         ETFile->FileTag = ETFile->FileTag->next;
         has_filetag_redo_data  = TRUE;
+
+        et_file_list_mark_changed (ETFile,
+                                   et_file_tag_get_changed_fields ((File_Tag *)ETFile->FileTag->data,
+                                                                   (File_Tag *)ETFile->FileTag->prev->data));
+    }
+
+    if (has_filename_redo_data | has_filetag_redo_data)
+    {
+        et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_STATE);
     }
 
     return has_filename_redo_data | has_filetag_redo_data;
@@ -1657,6 +2213,68 @@ ET_File_Data_Has_Redo_Data (const ET_File *ETFile)
     return has_filename_redo_data | has_filetag_redo_data;
 }
 
+/*
+ * et_file_forget_oldest_undo_data:
+ * @ETFile: a file
+ *
+ * Forget the oldest change of the filename or of the tag of @ETFile, so that
+ * it can no longer be undone. The current and the saved filenames, and the
+ * current tag, are always kept.
+ *
+ * Returns: the estimated memory which was freed, in bytes
+ */
+gsize
+et_file_forget_oldest_undo_data (ET_File *ETFile)
+{
+    GList *oldest;
+    guint filename_key;
+    guint filetag_key;
+    guint undo_key;
+    gsize size = 0;
+
+    g_return_val_if_fail (ETFile != NULL, 0);
+
+    /* Find the key of the oldest change, as in ET_Undo_File_Data(). */
+    if (ETFile->FileNameList && ETFile->FileNameList->next)
+        filename_key = ((File_Name *)ETFile->FileNameList->next->data)->key;
+    else
+        filename_key = (guint)~0;
+    if (ETFile->FileTagList && ETFile->FileTagList->next)
+        filetag_key = ((File_Tag *)ETFile->FileTagList->next->data)->key;
+    else
+        filetag_key = (guint)~0;
+    undo_key = MIN (filename_key, filetag_key);
+
+    if (undo_key == (guint)~0)
+    {
+        return 0;
+    }
+
+    oldest = ETFile->FileNameList;
+
+    if (filename_key == undo_key && oldest != ETFile->FileNameNew
+        && oldest != ETFile->FileNameCur)
+    {
+        size += et_file_name_get_size ((File_Name *)oldest->data);
+        et_file_name_free ((File_Name *)oldest->data);
+        ETFile->FileNameList = g_list_delete_link (ETFile->FileNameList,
+                                                   oldest);
+    }
+
+    /* The oldest tag is delta-encoded against the next one, and no other item
+     * depends on it. */
+    oldest = ETFile->FileTagList;
+
+    if (filetag_key == undo_key && oldest != ETFile->FileTag)
+    {
+        size += et_file_tag_get_size ((File_Tag *)oldest->data);
+        et_file_tag_free ((File_Tag *)oldest->data);
+        ETFile->FileTagList = g_list_delete_link (ETFile->FileTagList, oldest);
+    }
+
+    return size;
+}
+
 /*
  * Checks if the current files had been changed but not saved.
  * Returns TRUE if the file has been saved.
@@ -1724,6 +2342,8 @@ ET_Mark_File_Tag_As_Saved (ET_File *ETFile)
     g_list_foreach (FileTagList, (GFunc)Set_Saved_Value_Of_File_Tag,
                     GINT_TO_POINTER((gint)FALSE));
     FileTag->saved = TRUE; // The current FileTag set to TRUE
+
+    et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_STATE);
 }
 
 
@@ -1737,6 +2357,10 @@ void ET_Mark_File_Name_As_Saved (ET_File *ETFile)
     g_list_foreach (FileNameList, (GFunc)Set_Saved_Value_Of_File_Tag,
                     GINT_TO_POINTER((gint)FALSE));
     FileNameNew->saved = TRUE;
+
+    /* Called once the file was renamed on disk. */
+    et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_FILENAME
+                                       | ET_FILE_CHANGE_STATE);
 }
 
 /*
@@ -50,18 +50,43 @@ typedef struct
     GList *FileNameListBak;   /* Contains items of FileNameList removed by 'undo' procedure but have data currently saved (for example, when you save your last changes, make some 'undo', then make new changes) */
 
     GList *FileTag;           /* Points to the current item used of FileTagList */
-    GList *FileTagList;       /* Contains the history of changes about file tag data */
-    GList *FileTagListBak;    /* Contains items of FileTagList removed by 'undo' procedure but have data currently saved */
+    GList *FileTagList;       /* Contains the history of changes about file tag data, delta-encoded except for the current item (see et_file_tag_delta_encode()) */
 } ET_File;
 
+/*
+ * EtFileChange:
+ * @ET_FILE_CHANGE_TAG: mask of the #EtFileTagField flags of the tag fields
+ * @ET_FILE_CHANGE_FILENAME: the current filename (on disk)
+ * @ET_FILE_CHANGE_STATE: whether the file has unsaved changes
+ *
+ * Flags for what changed in a file, for the parts which are displayed.
+ */
+typedef enum
+{
+    ET_FILE_CHANGE_TAG = (ET_FILE_TAG_FIELD_PICTURE << 1) - 1,
+    ET_FILE_CHANGE_FILENAME = ET_FILE_TAG_FIELD_PICTURE << 1,
+    ET_FILE_CHANGE_STATE = ET_FILE_TAG_FIELD_PICTURE << 2
+} EtFileChange;
+
 /*
  * Description of each item of the ETHistoryFileList list
  */
 typedef struct
 {
     ET_File *ETFile;           /* Pointer to item of ETFileList changed */
+    GPtrArray *ETFiles;        /* All the files changed together by an #EtFileTagEdit, including ETFile, or NULL for a change of a single file */
+    gsize size;                /* Estimated memory used by the undo data of the change (in bytes) */
 } ET_History_File;
 
+/*
+ * EtFileTagEdit:
+ *
+ * A change of some fields of the tags, and of the filenames, of several files,
+ * which is added to the undo history as a single change. Only the fields
+ * which are set are compared with the current tags.
+ */
+typedef struct _EtFileTagEdit EtFileTagEdit;
+
 gboolean et_file_check_saved (const ET_File *ETFile);
 
 ET_File * ET_File_Item_New (void);
@@ -70,14 +95,24 @@ void ET_Free_File_List_Item (ET_File *ETFile);
 void ET_Save_File_Data_From_UI (ET_File *ETFile);
 gboolean ET_Save_File_Name_Internal (const ET_File *ETFile, File_Name *FileName);
 gboolean ET_Save_File_Tag_To_HD (ET_File *ETFile, GError **error);
+void et_file_save_batch_begin (void);
+guint et_file_save_batch_end (void);
 gboolean ET_Save_File_Tag_Internal (ET_File *ETFile, File_Tag *FileTag);
 
 gboolean ET_Undo_File_Data (ET_File *ETFile);
 gboolean ET_Redo_File_Data (ET_File *ETFile);
 gboolean ET_File_Data_Has_Undo_Data (const ET_File *ETFile);
 gboolean ET_File_Data_Has_Redo_Data (const ET_File *ETFile);
+gsize et_file_forget_oldest_undo_data (ET_File *ETFile);
 
 gboolean ET_Manage_Changes_Of_File_Data (ET_File *ETFile, File_Name *FileName, File_Tag *FileTag);
+
+EtFileTagEdit * et_file_tag_edit_new (void);
+void et_file_tag_edit_set_field (EtFileTagEdit *edit, ET_File *ETFile, EtFileTagField field, const gchar *value);
+const gchar * et_file_tag_edit_get_field (const EtFileTagEdit *edit, const ET_File *ETFile, EtFileTagField field);
+void et_file_tag_edit_set_picture (EtFileTagEdit *edit, ET_File *ETFile, const EtPicture *pic);
+void et_file_tag_edit_set_filename (EtFileTagEdit *edit, ET_File *ETFile, File_Name *FileName);
+guint et_file_tag_edit_commit (EtFileTagEdit *edit);
 void ET_Mark_File_Name_As_Saved (ET_File *ETFile);
 gchar *et_file_generate_name (const ET_File *ETFile, const gchar *new_file_name);
 gchar * ET_File_Format_File_Extension (const ET_File *ETFile);
@@ -37,6 +37,7 @@
 #include "monkeyaudio_header.h"
 #include "musepack_header.h"
 #include "picture.h"
+#include "profile.h"
 #include "ape_tag.h"
 #ifdef ENABLE_MP3
 #include "id3_tag.h"
@@ -79,21 +80,29 @@ et_file_list_free (GList *file_list)
 static void
 et_history_file_free (ET_History_File *file)
 {
+    if (file->ETFiles)
+    {
+        g_ptr_array_unref (file->ETFiles);
+    }
+
     g_slice_free (ET_History_File, file);
 }
 
 /*
- * History list contains only pointers, so no data to free except the history structure.
+ * et_history_list_clear:
+ *
+ * Free the main undo list. The list contains only pointers to the files, so
+ * the undo data of the files is not freed.
  */
 void
-et_history_file_list_free (GList *file_list)
+et_history_list_clear (void)
 {
-    g_return_if_fail (file_list != NULL);
-
-    /* et_history_list_add() sets the list to the final element, so explicitly
-     * go back to the start. */
-    g_list_free_full (g_list_first (file_list),
+    g_list_free_full (ETCore->ETHistoryFileListFirst,
                       (GDestroyNotify)et_history_file_free);
+    ETCore->ETHistoryFileList = NULL;
+    ETCore->ETHistoryFileListFirst = NULL;
+    ETCore->ETHistoryFileListLength = 0;
+    ETCore->ETHistoryFileListSize = 0;
 }
 
 /*
@@ -212,6 +221,8 @@ et_file_list_add (GList *file_list,
     gchar *display_path;
     GError *error = NULL;
     gboolean success;
+    gboolean header_read = FALSE;
+    gint64 span;
 
     g_return_val_if_fail (file != NULL, file_list);
 
@@ -235,6 +246,11 @@ et_file_list_add (GList *file_list,
     FileTag = et_file_tag_new ();
     FileTag->saved = TRUE;    /* The file hasn't been changed, so it's saved */
 
+    /* Filled while reading the tag for Ogg files, or later otherwise. */
+    ETFileInfo = et_file_info_new ();
+
+    span = et_profile_span_begin ();
+
     switch (description->TagType)
     {
 #ifdef ENABLE_MP3
@@ -250,6 +266,18 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OGG
         case OGG_TAG:
+            /* Read the tag and the header information in a single pass,
+             * falling back to separate readers for unusual streams. */
+            if (et_ogg_header_read_file (file, FileTag, ETFileInfo, &error))
+            {
+                header_read = TRUE;
+                break;
+            }
+
+            g_debug ("Falling back to separate readers for Ogg file ‘%s’: %s",
+                     display_path, error->message);
+            g_clear_error (&error);
+
             if (!ogg_tag_read_file_tag (file, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
@@ -303,6 +331,16 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OPUS
         case OPUS_TAG:
+            if (et_ogg_header_read_file (file, FileTag, ETFileInfo, &error))
+            {
+                header_read = TRUE;
+                break;
+            }
+
+            g_debug ("Falling back to opusfile for Opus file ‘%s’: %s",
+                     display_path, error->message);
+            g_clear_error (&error);
+
             if (!et_opus_tag_read_file_tag (file, FileTag, &error))
             {
                 Log_Print (LOG_ERROR,
@@ -339,6 +377,8 @@ et_file_list_add (GList *file_list,
             break;
     }
 
+    et_profile_span_end (ET_PROFILE_PHASE_READ_TAG, span);
+
     if (FileTag->year && g_utf8_strlen (FileTag->year, -1) > 4)
     {
         Log_Print (LOG_WARNING,
@@ -347,7 +387,7 @@ et_file_list_add (GList *file_list,
     }
 
     /* Fill the ET_File_Info structure */
-    ETFileInfo = et_file_info_new ();
+    span = et_profile_span_begin ();
 
     switch (description->FileType)
     {
@@ -359,13 +399,16 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OGG
         case OGG_FILE:
-            success = et_ogg_header_read_file_info (file, ETFileInfo, &error);
+            success = header_read
+                      || et_ogg_header_read_file_info (file, ETFileInfo,
+                                                       &error);
             break;
 #endif
 #ifdef ENABLE_SPEEX
         case SPEEX_FILE:
-            success = et_speex_header_read_file_info (file, ETFileInfo,
-                                                      &error);
+            success = header_read
+                      || et_speex_header_read_file_info (file, ETFileInfo,
+                                                         &error);
             break;
 #endif
 #ifdef ENABLE_FLAC
@@ -392,7 +435,8 @@ et_file_list_add (GList *file_list,
 #endif
 #ifdef ENABLE_OPUS
         case OPUS_FILE:
-            success = et_opus_read_file_info (file, ETFileInfo, &error);
+            success = header_read
+                      || et_opus_read_file_info (file, ETFileInfo, &error);
             break;
 #endif
         case OFR_FILE:
@@ -441,6 +485,7 @@ et_file_list_add (GList *file_list,
      * before saving */
     fileinfo = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
                                   G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    et_profile_span_end (ET_PROFILE_PHASE_READ_HEADER, span);
 
     /* Attach all data defined above to this ETFile item */
     ETFile = ET_File_Item_New();
@@ -475,6 +520,7 @@ et_file_list_add (GList *file_list,
      * Process the filename and tag to generate undo if needed...
      * The undo key must be the same for FileName and FileTag => changed in the same time
      */
+    span = et_profile_span_begin ();
     undo_key = et_undo_key_new ();
 
     FileName = et_file_name_new ();
@@ -490,6 +536,7 @@ et_file_list_add (GList *file_list,
      * If no changes detected, FileName and FileTag item are deleted.
      */
     ET_Manage_Changes_Of_File_Data(ETFile,FileName,FileTag);
+    et_profile_span_end (ET_PROFILE_PHASE_UNDO, span);
 
     /*
      * Display a message if the file was changed at start
@@ -510,6 +557,8 @@ et_file_list_add (GList *file_list,
     g_free (filename);
     g_free (display_path);
 
+    et_profile_count_file ();
+
     return result;
 }
 
@@ -843,6 +892,9 @@ ET_Remove_File_From_File_List (ET_File *ETFile)
     // Remove the file from the ETArtistAlbumList list
     ET_Remove_File_From_Artist_Album_List(ETFile);
 
+    /* Remove the changes of the file from the main undo list. */
+    et_history_list_remove_file (ETFile);
+
     /* Remove the file from the ETFileDisplayedList list (if not already). */
     ETCore->ETFileDisplayedList = g_list_remove (g_list_first (ETCore->ETFileDisplayedList),
                                                  ETFile);
@@ -929,6 +981,75 @@ set_sort_order_for_column_id (gint column_id, GtkTreeViewColumn *column,
     }
 }
 
+/*
+ * Comparison functions for each sort mode, in the order of #EtSortMode.
+ */
+static const GCompareFunc sort_funcs[] =
+{
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Filename,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Filename,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Title,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Title,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Year,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Year,
+    (GCompareFunc)et_comp_func_sort_file_by_ascending_disc_number,
+    (GCompareFunc)et_comp_func_sort_file_by_descending_disc_number,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Track_Number,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Track_Number,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Genre,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Genre,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Comment,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Comment,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Composer,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Composer,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Orig_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Orig_Artist,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Copyright,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Copyright,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Url,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Url,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Encoded_By,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Encoded_By,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Creation_Date,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Creation_Date,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Type,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Type,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Size,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Size,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Duration,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Duration,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Bitrate,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Bitrate,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Samplerate,
+    (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Samplerate
+};
+
+/*
+ * et_file_list_get_sort_func:
+ * @sort_mode: the sort mode for which to get the comparison function
+ *
+ * Look up the function comparing two #ET_File for @sort_mode, so that callers
+ * sorting many files can choose it once, rather than for each comparison.
+ *
+ * Returns: a #GCompareFunc taking two #ET_File
+ */
+GCompareFunc
+et_file_list_get_sort_func (EtSortMode sort_mode)
+{
+    G_STATIC_ASSERT (G_N_ELEMENTS (sort_funcs)
+                     == ET_SORT_MODE_DESCENDING_FILE_SAMPLERATE + 1);
+
+    g_return_val_if_fail ((gsize)sort_mode < G_N_ELEMENTS (sort_funcs), NULL);
+
+    return sort_funcs[sort_mode];
+}
+
 /*
  * Sort an 'ETFileList'
  */
@@ -951,144 +1072,9 @@ ET_Sort_File_List (GList *ETFileList,
     set_sort_order_for_column_id (column_id, column, Sorting_Type);
 
     /* Sort... */
-    switch (Sorting_Type)
-    {
-        case ET_SORT_MODE_ASCENDING_FILENAME:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Filename);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILENAME:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Filename);
-            break;
-        case ET_SORT_MODE_ASCENDING_TITLE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Title);
-            break;
-        case ET_SORT_MODE_DESCENDING_TITLE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Title);
-            break;
-        case ET_SORT_MODE_ASCENDING_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Artist);
-            break;
-        case ET_SORT_MODE_DESCENDING_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Artist);
-            break;
-        case ET_SORT_MODE_ASCENDING_ALBUM_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album_Artist);
-            break;
-        case ET_SORT_MODE_DESCENDING_ALBUM_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album_Artist);
-            break;
-		case ET_SORT_MODE_ASCENDING_ALBUM:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album);
-            break;
-        case ET_SORT_MODE_DESCENDING_ALBUM:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Album);
-            break;
-        case ET_SORT_MODE_ASCENDING_YEAR:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Year);
-            break;
-        case ET_SORT_MODE_DESCENDING_YEAR:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Year);
-            break;
-        case ET_SORT_MODE_ASCENDING_DISC_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)et_comp_func_sort_file_by_ascending_disc_number);
-            break;
-        case ET_SORT_MODE_DESCENDING_DISC_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)et_comp_func_sort_file_by_descending_disc_number);
-            break;
-        case ET_SORT_MODE_ASCENDING_TRACK_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Track_Number);
-            break;
-        case ET_SORT_MODE_DESCENDING_TRACK_NUMBER:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Track_Number);
-            break;
-        case ET_SORT_MODE_ASCENDING_GENRE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Genre);
-            break;
-        case ET_SORT_MODE_DESCENDING_GENRE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Genre);
-            break;
-        case ET_SORT_MODE_ASCENDING_COMMENT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Comment);
-            break;
-        case ET_SORT_MODE_DESCENDING_COMMENT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Comment);
-            break;
-        case ET_SORT_MODE_ASCENDING_COMPOSER:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Composer);
-            break;
-        case ET_SORT_MODE_DESCENDING_COMPOSER:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Composer);
-            break;
-        case ET_SORT_MODE_ASCENDING_ORIG_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Orig_Artist);
-            break;
-        case ET_SORT_MODE_DESCENDING_ORIG_ARTIST:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Orig_Artist);
-            break;
-        case ET_SORT_MODE_ASCENDING_COPYRIGHT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Copyright);
-            break;
-        case ET_SORT_MODE_DESCENDING_COPYRIGHT:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Copyright);
-            break;
-        case ET_SORT_MODE_ASCENDING_URL:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Url);
-            break;
-        case ET_SORT_MODE_DESCENDING_URL:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Url);
-            break;
-        case ET_SORT_MODE_ASCENDING_ENCODED_BY:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Encoded_By);
-            break;
-        case ET_SORT_MODE_DESCENDING_ENCODED_BY:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Encoded_By);
-            break;
-        case ET_SORT_MODE_ASCENDING_CREATION_DATE:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Creation_Date);
-            break;
-        case ET_SORT_MODE_DESCENDING_CREATION_DATE:
-            etfilelist = g_list_sort (etfilelist,
-                                      (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Creation_Date);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_TYPE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Type);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_TYPE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Type);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_SIZE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Size);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_SIZE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Size);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_DURATION:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Duration);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_DURATION:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Duration);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_BITRATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Bitrate);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_BITRATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Bitrate);
-            break;
-        case ET_SORT_MODE_ASCENDING_FILE_SAMPLERATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_File_Samplerate);
-            break;
-        case ET_SORT_MODE_DESCENDING_FILE_SAMPLERATE:
-            etfilelist = g_list_sort(etfilelist,(GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_File_Samplerate);
-            break;
-        default:
-            g_assert_not_reached ();
-            break;
-    }
+    etfilelist = g_list_sort (etfilelist,
+                              et_file_list_get_sort_func (Sorting_Type));
+
     /* Save sorting mode (note: needed when called from UI). */
     g_settings_set_enum (MainSettings, "sort-mode", Sorting_Type);
 
@@ -1253,6 +1239,12 @@ et_file_list_update_directory_name (GList *file_list,
                         ET_Set_Filename_File_Name_Item (FileName, NULL,
                                                         filename_tmp);
                         g_free (filename_tmp);
+
+                        if (filenamelist == file->FileNameCur)
+                        {
+                            et_file_list_mark_changed (file,
+                                                       ET_FILE_CHANGE_FILENAME);
+                        }
                     }
                 }
              }
@@ -1262,12 +1254,88 @@ et_file_list_update_directory_name (GList *file_list,
     g_free (old_path_tmp);
 }
 
+/*
+ * et_file_list_mark_changed:
+ * @ETFile: a file
+ * @changes: the #EtFileChange flags of what changed in @ETFile
+ *
+ * Record that the displayed data of @ETFile changed, so that only the changed
+ * files and columns are updated by the next refresh of the browser.
+ */
+void
+et_file_list_mark_changed (const ET_File *ETFile,
+                           guint changes)
+{
+    gpointer value;
+
+    g_return_if_fail (ETFile != NULL);
+
+    if (changes == 0)
+    {
+        return;
+    }
+
+    if (ETCore->ETFileChanges == NULL)
+    {
+        ETCore->ETFileChanges = g_hash_table_new (NULL, NULL);
+    }
+
+    value = g_hash_table_lookup (ETCore->ETFileChanges, ETFile);
+    g_hash_table_insert (ETCore->ETFileChanges, (gpointer)ETFile,
+                         GUINT_TO_POINTER (GPOINTER_TO_UINT (value)
+                                           | changes));
+}
+
+/*
+ * et_file_list_unmark_changed:
+ * @ETFile: a file
+ *
+ * Forget the changes recorded for @ETFile, for example because its row was
+ * updated in full, or because the file is freed.
+ */
+void
+et_file_list_unmark_changed (const ET_File *ETFile)
+{
+    if (ETCore != NULL && ETCore->ETFileChanges != NULL)
+    {
+        g_hash_table_remove (ETCore->ETFileChanges, ETFile);
+    }
+}
+
+/*
+ * et_file_list_take_changes:
+ *
+ * Take the files which were changed since the last call, and clear the
+ * recorded changes.
+ *
+ * Returns: (transfer full) (allow-none): a table of the changed #ET_File, with
+ * the #EtFileChange flags of each as the value, or %NULL if nothing changed.
+ * Free with g_hash_table_destroy()
+ */
+GHashTable *
+et_file_list_take_changes (void)
+{
+    GHashTable *changes;
+
+    changes = ETCore->ETFileChanges;
+    ETCore->ETFileChanges = NULL;
+
+    if (changes != NULL && g_hash_table_size (changes) == 0)
+    {
+        g_hash_table_destroy (changes);
+        return NULL;
+    }
+
+    return changes;
+}
+
 /*
  * Execute one 'undo' in the main undo list (it selects the last ETFile changed,
- * before to apply an undo action)
+ * before to apply an undo action). If the change was made to several files at
+ * once, it is undone for all of them, and @n_files is set to their number.
  */
 ET_File *
-ET_Undo_History_File_Data (void)
+ET_Undo_History_File_Data (guint *n_files)
 {
     ET_File *ETFile;
     const ET_History_File *ETHistoryFile;
@@ -1278,7 +1346,21 @@ ET_Undo_History_File_Data (void)
     ETHistoryFile = (ET_History_File *)ETCore->ETHistoryFileList->data;
     ETFile        = (ET_File *)ETHistoryFile->ETFile;
     ET_Displayed_File_List_By_Etfile(ETFile);
-    ET_Undo_File_Data(ETFile);
+
+    if (ETHistoryFile->ETFiles)
+    {
+        g_ptr_array_foreach (ETHistoryFile->ETFiles,
+                             (GFunc)ET_Undo_File_Data, NULL);
+    }
+    else
+    {
+        ET_Undo_File_Data (ETFile);
+    }
+
+    if (n_files)
+    {
+        *n_files = ETHistoryFile->ETFiles ? ETHistoryFile->ETFiles->len : 1;
+    }
 
     if (ETCore->ETHistoryFileList->prev)
         ETCore->ETHistoryFileList = ETCore->ETHistoryFileList->prev;
@@ -1299,10 +1381,10 @@ et_history_list_has_undo (GList *history_list)
 
 
 /*
- * Execute one 'redo' in the main undo list
+ * Execute one 'redo' in the main undo list, as ET_Undo_History_File_Data()
  */
 ET_File *
-ET_Redo_History_File_Data (void)
+ET_Redo_History_File_Data (guint *n_files)
 {
     ET_File *ETFile;
     ET_History_File *ETHistoryFile;
@@ -1316,7 +1398,21 @@ ET_Redo_History_File_Data (void)
     ETHistoryFile = (ET_History_File *)ETCore->ETHistoryFileList->next->data;
     ETFile        = (ET_File *)ETHistoryFile->ETFile;
     ET_Displayed_File_List_By_Etfile(ETFile);
-    ET_Redo_File_Data(ETFile);
+
+    if (ETHistoryFile->ETFiles)
+    {
+        g_ptr_array_foreach (ETHistoryFile->ETFiles,
+                             (GFunc)ET_Redo_File_Data, NULL);
+    }
+    else
+    {
+        ET_Redo_File_Data (ETFile);
+    }
+
+    if (n_files)
+    {
+        *n_files = ETHistoryFile->ETFiles ? ETHistoryFile->ETFiles->len : 1;
+    }
 
     if (ETCore->ETHistoryFileList->next)
         ETCore->ETHistoryFileList = ETCore->ETHistoryFileList->next;
@@ -1336,37 +1432,245 @@ et_history_list_has_redo (GList *history_list)
 }
 
 /*
- * Add a ETFile item to the main undo list of files
+ * et_history_list_free_changes:
+ * @changes: (allow-none): changes which were cut from the main undo list
+ *
+ * Free the changes, and remove them from the totals of the main undo list.
  */
-GList *
-et_history_list_add (GList *history_list,
-                     ET_File *ETFile)
+static void
+et_history_list_free_changes (GList *changes)
+{
+    GList *l;
+
+    for (l = changes; l != NULL; l = g_list_next (l))
+    {
+        ET_History_File *ETHistoryFile = (ET_History_File *)l->data;
+
+        ETCore->ETHistoryFileListLength--;
+        ETCore->ETHistoryFileListSize -= ETHistoryFile->size;
+        et_history_file_free (ETHistoryFile);
+    }
+
+    g_list_free (changes);
+}
+
+static void
+et_history_list_append (ET_File *ETFile,
+                        GPtrArray *ETFiles,
+                        gsize size)
 {
     ET_History_File *ETHistoryFile;
-    GList *result;
+    GList *redo_list;
 
-    g_return_val_if_fail (ETFile != NULL, FALSE);
+    /* The undo list must contains one item before the 'first undo' data */
+    if (!ETCore->ETHistoryFileListFirst)
+    {
+        ETCore->ETHistoryFileListFirst = g_list_append (NULL,
+                                                        g_slice_new0 (ET_History_File));
+        ETCore->ETHistoryFileList = ETCore->ETHistoryFileListFirst;
+    }
+
+    /* Cut the end of the list from the current element. */
+    redo_list = ETCore->ETHistoryFileList->next;
+
+    if (redo_list)
+    {
+        ETCore->ETHistoryFileList->next = NULL;
+        redo_list->prev = NULL;
+        et_history_list_free_changes (redo_list);
+    }
 
-    ETHistoryFile = g_slice_new0 (ET_History_File);
+    ETHistoryFile = g_slice_new (ET_History_File);
     ETHistoryFile->ETFile = ETFile;
+    ETHistoryFile->ETFiles = ETFiles;
+    ETHistoryFile->size = size;
+
+    /* The current element is the last one, so appending is cheap. */
+    ETCore->ETHistoryFileList = g_list_last (g_list_append (ETCore->ETHistoryFileList,
+                                                            ETHistoryFile));
+    ETCore->ETHistoryFileListLength++;
+    ETCore->ETHistoryFileListSize += size;
+}
 
-    /* The undo list must contains one item before the 'first undo' data */
-    if (!history_list)
+/*
+ * et_history_list_add:
+ * @ETFile: the file which was changed
+ * @size: the estimated memory used by the undo data of the change, in bytes
+ *
+ * Add a change of @ETFile after the current position of the main undo list.
+ * The changes which were undone can no longer be redone from the list, so
+ * they are removed.
+ */
+void
+et_history_list_add (ET_File *ETFile,
+                     gsize size)
+{
+    g_return_if_fail (ETFile != NULL);
+
+    et_history_list_append (ETFile, NULL, size);
+}
+
+/*
+ * et_history_list_add_files:
+ * @files: (transfer full) (element-type ET_File): the files which were
+ *         changed together
+ * @size: the estimated memory used by the undo data of the change, in bytes
+ *
+ * Add a change of several files, which is undone and redone for all of them
+ * at once, as et_history_list_add().
+ */
+void
+et_history_list_add_files (GPtrArray *files,
+                           gsize size)
+{
+    g_return_if_fail (files != NULL && files->len > 0);
+
+    if (files->len == 1)
     {
-        result = g_list_append (NULL,
-                                g_slice_new0 (ET_History_File));
+        et_history_list_add (g_ptr_array_index (files, 0), size);
+        g_ptr_array_unref (files);
     }
     else
     {
-        result = history_list;
+        et_history_list_append (g_ptr_array_index (files, 0), files, size);
     }
+}
+
+/*
+ * et_history_list_remove_file:
+ * @ETFile: the file to remove
+ *
+ * Remove all the changes to @ETFile from the main undo list, so that the list
+ * does not point to the file once it has been freed.
+ */
+void
+et_history_list_remove_file (const ET_File *ETFile)
+{
+    GList *l;
 
-    /* Add the item to the list (cut end of list from the current element) */
-    result = g_list_append (result, ETHistoryFile);
-    /* TODO: Investigate whether this is sensible. */
-    result = g_list_last (result);
+    g_return_if_fail (ETFile != NULL);
 
-    return result;
+    if (!ETCore->ETHistoryFileListFirst)
+    {
+        return;
+    }
+
+    /* The first item never refers to a file, so the head does not change. */
+    l = ETCore->ETHistoryFileListFirst->next;
+
+    while (l != NULL)
+    {
+        GList *next = g_list_next (l);
+        ET_History_File *ETHistoryFile = (ET_History_File *)l->data;
+
+        /* A change of several files is kept for the other files. */
+        if (ETHistoryFile->ETFiles
+            && g_ptr_array_remove (ETHistoryFile->ETFiles, (gpointer)ETFile)
+            && ETHistoryFile->ETFiles->len > 0)
+        {
+            ETHistoryFile->ETFile = g_ptr_array_index (ETHistoryFile->ETFiles,
+                                                       0);
+        }
+        else if (ETHistoryFile->ETFile == ETFile)
+        {
+            if (l == ETCore->ETHistoryFileList)
+            {
+                ETCore->ETHistoryFileList = l->prev;
+            }
+
+            ETCore->ETHistoryFileListLength--;
+            ETCore->ETHistoryFileListSize -= ETHistoryFile->size;
+            et_history_file_free (ETHistoryFile);
+            ETCore->ETHistoryFileListFirst = g_list_delete_link (ETCore->ETHistoryFileListFirst,
+                                                                 l);
+        }
+
+        l = next;
+    }
+}
+
+/*
+ * et_history_list_trim:
+ * @max_length: the maximum number of changes to keep, or 0 for no limit
+ * @max_size: the maximum estimated memory used by the undo data of the
+ *            changes, in bytes, or 0 for no limit
+ *
+ * Forget the oldest changes of the main undo list, and their undo data in the
+ * files, until the list is within the limits. Changes which were undone are
+ * kept, so that they can still be redone.
+ *
+ * Returns: the number of changes which were forgotten
+ */
+guint
+et_history_list_trim (guint max_length,
+                      gsize max_size)
+{
+    guint n_forgotten = 0;
+
+    while ((max_length > 0 && ETCore->ETHistoryFileListLength > max_length)
+           || (max_size > 0 && ETCore->ETHistoryFileListSize > max_size))
+    {
+        GList *oldest;
+        ET_History_File *ETHistoryFile;
+
+        /* Only the changes up to the current position can be undone. */
+        if (!ETCore->ETHistoryFileListFirst
+            || ETCore->ETHistoryFileList == ETCore->ETHistoryFileListFirst)
+        {
+            break;
+        }
+
+        oldest = ETCore->ETHistoryFileListFirst->next;
+        ETHistoryFile = (ET_History_File *)oldest->data;
+
+        if (ETHistoryFile->ETFiles)
+        {
+            g_ptr_array_foreach (ETHistoryFile->ETFiles,
+                                 (GFunc)et_file_forget_oldest_undo_data,
+                                 NULL);
+        }
+        else
+        {
+            et_file_forget_oldest_undo_data (ETHistoryFile->ETFile);
+        }
+
+        if (oldest == ETCore->ETHistoryFileList)
+        {
+            ETCore->ETHistoryFileList = ETCore->ETHistoryFileListFirst;
+        }
+
+        ETCore->ETHistoryFileListLength--;
+        ETCore->ETHistoryFileListSize -= ETHistoryFile->size;
+        et_history_file_free (ETHistoryFile);
+        ETCore->ETHistoryFileListFirst = g_list_delete_link (ETCore->ETHistoryFileListFirst,
+                                                             oldest);
+        n_forgotten++;
+    }
+
+    if (n_forgotten > 0)
+    {
+        gchar *size = g_format_size (ETCore->ETHistoryFileListSize);
+
+        g_debug ("Forgot %u changes, undo history has %u changes using %s",
+                 n_forgotten, ETCore->ETHistoryFileListLength, size);
+        g_free (size);
+    }
+
+    return n_forgotten;
+}
+
+/*
+ * et_history_list_get_size:
+ *
+ * Get the footprint of the main undo list, which is the total of the memory
+ * used by the undo data of its changes.
+ *
+ * Returns: the estimated memory used by the undo data, in bytes
+ */
+gsize
+et_history_list_get_size (void)
+{
+    return ETCore->ETHistoryFileListSize;
 }
 
 /*
@@ -1400,6 +1704,164 @@ et_file_list_check_all_saved (GList *etfilelist)
     }
 }
 
+/* Minimum number of files to check in a directory to enumerate it, rather
+ * than querying the files one by one. */
+#define ET_FILE_LIST_ENUMERATE_MIN 4
+
+/*
+ * Compare the modification time of @ETFile with the one in @info.
+ */
+static gboolean
+et_file_is_modified_externally (const ET_File *ETFile,
+                                GFileInfo *info)
+{
+    return ETFile->FileModificationTime
+           != g_file_info_get_attribute_uint64 (info,
+                                                G_FILE_ATTRIBUTE_TIME_MODIFIED);
+}
+
+/*
+ * et_file_list_count_modified_externally:
+ * @etfilelist: (element-type ET_File) (allow-none): a list of files
+ * @all_files: %TRUE to check all the files, %FALSE to only check the files
+ *             which were changed but not saved
+ *
+ * Count the files which were modified by another program since they were
+ * read or saved. The files are grouped by directory, and a directory with
+ * several files to check is enumerated once, instead of querying each file.
+ * Files which cannot be queried are not counted.
+ *
+ * Returns: the number of files modified by another program
+ */
+guint
+et_file_list_count_modified_externally (GList *etfilelist,
+                                        gboolean all_files)
+{
+    GHashTable *directories;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+    GList *l;
+    guint n_modified = 0;
+
+    /* Directory to a table of the basenames of its files to the files. */
+    directories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                         (GDestroyNotify)g_hash_table_unref);
+
+    for (l = etfilelist; l != NULL; l = g_list_next (l))
+    {
+        ET_File *ETFile = (ET_File *)l->data;
+        const gchar *filename;
+        gchar *dirname;
+        GHashTable *files;
+
+        if (!all_files && et_file_check_saved (ETFile))
+        {
+            continue;
+        }
+
+        filename = ((File_Name *)ETFile->FileNameCur->data)->value;
+        dirname = g_path_get_dirname (filename);
+        files = g_hash_table_lookup (directories, dirname);
+
+        if (files == NULL)
+        {
+            files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           NULL);
+            g_hash_table_insert (directories, dirname, files);
+        }
+        else
+        {
+            g_free (dirname);
+        }
+
+        g_hash_table_insert (files, g_path_get_basename (filename), ETFile);
+    }
+
+    g_hash_table_iter_init (&iter, directories);
+
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        GFile *dir;
+        GFileEnumerator *enumerator = NULL;
+        GHashTable *files = value;
+
+        dir = g_file_new_for_path (key);
+
+        if (g_hash_table_size (files) >= ET_FILE_LIST_ENUMERATE_MIN)
+        {
+            enumerator = g_file_enumerate_children (dir,
+                                                    G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                    G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                    G_FILE_QUERY_INFO_NONE,
+                                                    NULL, NULL);
+        }
+
+        if (enumerator)
+        {
+            GFileInfo *info;
+
+            while (g_hash_table_size (files) > 0
+                   && (info = g_file_enumerator_next_file (enumerator, NULL,
+                                                           NULL)) != NULL)
+            {
+                const gchar *name = g_file_info_get_name (info);
+                const ET_File *ETFile = g_hash_table_lookup (files, name);
+
+                if (ETFile)
+                {
+                    if (et_file_is_modified_externally (ETFile, info))
+                    {
+                        n_modified++;
+                    }
+
+                    g_hash_table_remove (files, name);
+                }
+
+                g_object_unref (info);
+            }
+
+            g_object_unref (enumerator);
+        }
+        else
+        {
+            GHashTableIter file_iter;
+            gpointer name;
+            gpointer ETFile;
+
+            g_hash_table_iter_init (&file_iter, files);
+
+            while (g_hash_table_iter_next (&file_iter, &name, &ETFile))
+            {
+                GFile *file;
+                GFileInfo *info;
+
+                file = g_file_get_child (dir, name);
+                info = g_file_query_info (file,
+                                          G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                          G_FILE_QUERY_INFO_NONE, NULL, NULL);
+                g_object_unref (file);
+
+                if (info)
+                {
+                    if (et_file_is_modified_externally (ETFile, info))
+                    {
+                        n_modified++;
+                    }
+
+                    g_object_unref (info);
+                }
+            }
+        }
+
+        g_object_unref (dir);
+    }
+
+    g_hash_table_destroy (directories);
+
+    return n_modified;
+}
+
 /*
  * Returns the number of file in the directory of the selected file.
  * Parameter "path" should be in UTF-8
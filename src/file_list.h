@@ -30,7 +30,11 @@ G_BEGIN_DECLS
 GList * et_file_list_add (GList *file_list, GFile *file);
 void ET_Remove_File_From_File_List (ET_File *ETFile);
 gboolean et_file_list_check_all_saved (GList *etfilelist);
+guint et_file_list_count_modified_externally (GList *etfilelist, gboolean all_files);
 void et_file_list_update_directory_name (GList *file_list, const gchar *old_path, const gchar *new_path);
+void et_file_list_mark_changed (const ET_File *ETFile, guint changes);
+void et_file_list_unmark_changed (const ET_File *ETFile);
+GHashTable * et_file_list_take_changes (void);
 guint et_file_list_get_n_files_in_path (GList *file_list, const gchar *path_utf8);
 void et_file_list_free (GList *file_list);
 
@@ -46,14 +50,18 @@ GList * ET_Displayed_File_List_By_Etfile (const ET_File *ETFile);
 void et_displayed_file_list_set (GList *ETFileList);
 void et_displayed_file_list_free (GList *file_list);
 
-GList * et_history_list_add (GList *history_list, ET_File *ETFile);
-gboolean ET_Add_File_To_History_List (ET_File *ETFile);
-ET_File * ET_Undo_History_File_Data (void);
-ET_File * ET_Redo_History_File_Data (void);
+void et_history_list_add (ET_File *ETFile, gsize size);
+void et_history_list_add_files (GPtrArray *files, gsize size);
+ET_File * ET_Undo_History_File_Data (guint *n_files);
+ET_File * ET_Redo_History_File_Data (guint *n_files);
 gboolean et_history_list_has_undo (GList *history_list);
 gboolean et_history_list_has_redo (GList *history_list);
-void et_history_file_list_free (GList *file_list);
+void et_history_list_remove_file (const ET_File *ETFile);
+guint et_history_list_trim (guint max_length, gsize max_size);
+gsize et_history_list_get_size (void);
+void et_history_list_clear (void);
 
+GCompareFunc et_file_list_get_sort_func (EtSortMode sort_mode);
 GList *ET_Sort_File_List (GList *ETFileList, EtSortMode Sorting_Type);
 
 G_END_DECLS
@@ -0,0 +1,753 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "file_monitor.h"
+
+#include <glib/gi18n.h>
+#include <string.h>
+
+#include "application_window.h"
+#include "easytag.h"
+#include "et_core.h"
+#include "file_description.h"
+#include "file_list.h"
+#include "log.h"
+#include "setting.h"
+
+/* Time to wait after the last event before applying the changes, in seconds.
+ * Files which are being written, for example by a CD ripper, emit many events,
+ * so only read them once they have settled. */
+#define FILE_MONITOR_DELAY 1
+
+/*
+ * EtFileMonitor:
+ * @monitors: a #GFileMonitor for each directory of the file list, keyed by
+ *            path in the filesystem encoding
+ * @pending: set of paths for which an event was received
+ * @moves: queue of #EtFileMonitorMove, in the order that they were received
+ * @recurse: whether subdirectories are part of the file list
+ * @flush_id: source ID of the timeout to apply the pending changes
+ */
+typedef struct
+{
+    GHashTable *monitors;
+    GHashTable *pending;
+    GQueue moves;
+    gboolean recurse;
+    guint flush_id;
+} EtFileMonitor;
+
+/*
+ * EtFileMonitorMove:
+ * @source: the old path
+ * @destination: the new path
+ */
+typedef struct
+{
+    gchar *source;
+    gchar *destination;
+} EtFileMonitorMove;
+
+/*
+ * EtFileMonitorChanges:
+ * @files: the loaded files, keyed by their current path on disk
+ * @n_added: number of files added to the file list
+ * @n_removed: number of files removed from the file list
+ * @n_renamed: number of files whose path was updated
+ * @displayed_path: path of the displayed file, if it was removed
+ */
+typedef struct
+{
+    GHashTable *files;
+    gchar *displayed_path;
+    guint n_added;
+    guint n_removed;
+    guint n_renamed;
+} EtFileMonitorChanges;
+
+static EtFileMonitor *monitor = NULL;
+
+static void on_directory_changed (GFileMonitor *dir_monitor, GFile *file,
+                                  GFile *other_file,
+                                  GFileMonitorEvent event_type,
+                                  gpointer user_data);
+
+static void
+et_file_monitor_move_free (EtFileMonitorMove *move)
+{
+    g_free (move->source);
+    g_free (move->destination);
+    g_slice_free (EtFileMonitorMove, move);
+}
+
+static void
+et_file_monitor_directory_free (gpointer data)
+{
+    GFileMonitor *dir_monitor = data;
+
+    g_signal_handlers_disconnect_by_func (dir_monitor, on_directory_changed,
+                                          NULL);
+    g_file_monitor_cancel (dir_monitor);
+    g_object_unref (dir_monitor);
+}
+
+static const gchar *
+et_file_get_path (const ET_File *ETFile)
+{
+    return ((File_Name *)ETFile->FileNameCur->data)->value;
+}
+
+/*
+ * Check if @path is the directory @dir, or is inside it.
+ */
+static gboolean
+path_is_in_directory (const gchar *path,
+                      const gchar *dir)
+{
+    gsize len = strlen (dir);
+
+    return strncmp (path, dir, len) == 0
+           && (path[len] == '\0' || path[len] == G_DIR_SEPARATOR);
+}
+
+/*
+ * Check the hidden file setting, in the same way as when reading the
+ * directory.
+ */
+static gboolean
+file_info_is_browsable (GFileInfo *info)
+{
+    return !g_file_info_get_is_hidden (info)
+           || g_settings_get_boolean (MainSettings, "browse-show-hidden");
+}
+
+static void
+et_file_monitor_add_directory (GFile *dir)
+{
+    gchar *path;
+    GFileMonitor *dir_monitor;
+    GError *error = NULL;
+
+    path = g_file_get_path (dir);
+
+    if (path == NULL || g_hash_table_contains (monitor->monitors, path))
+    {
+        g_free (path);
+        return;
+    }
+
+    dir_monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_SEND_MOVED,
+                                            NULL, &error);
+
+    if (!dir_monitor)
+    {
+        gchar *display_path = g_filename_display_name (path);
+
+        Log_Print (LOG_WARNING, _("Cannot monitor directory ‘%s’: %s"),
+                   display_path, error->message);
+
+        g_free (display_path);
+        g_error_free (error);
+        g_free (path);
+        return;
+    }
+
+    g_signal_connect (dir_monitor, "changed",
+                      G_CALLBACK (on_directory_changed), NULL);
+    g_hash_table_insert (monitor->monitors, path, dir_monitor);
+}
+
+/*
+ * Stop monitoring @path and its subdirectories.
+ */
+static void
+et_file_monitor_remove_directory (const gchar *path)
+{
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init (&iter, monitor->monitors);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        if (path_is_in_directory (key, path))
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+static GHashTable *
+et_file_monitor_index_files (void)
+{
+    GHashTable *files;
+    GList *l;
+
+    files = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (l = ETCore->ETFileList; l != NULL; l = g_list_next (l))
+    {
+        ET_File *ETFile = (ET_File *)l->data;
+
+        g_hash_table_insert (files, (gpointer)et_file_get_path (ETFile),
+                             ETFile);
+    }
+
+    return files;
+}
+
+static void
+et_file_monitor_add_file (EtFileMonitorChanges *changes,
+                          GFile *file)
+{
+    ET_File *ETFile;
+
+    ETCore->ETFileList = et_file_list_add (ETCore->ETFileList, file);
+
+    /* The new file is always appended. */
+    ETFile = (ET_File *)g_list_last (ETCore->ETFileList)->data;
+    g_hash_table_insert (changes->files, (gpointer)et_file_get_path (ETFile),
+                         ETFile);
+    changes->n_added++;
+}
+
+static void
+et_file_monitor_remove_file (EtFileMonitorChanges *changes,
+                             ET_File *ETFile)
+{
+    g_hash_table_remove (changes->files, et_file_get_path (ETFile));
+
+    if (ETFile == ETCore->ETFileDisplayed && !changes->displayed_path)
+    {
+        changes->displayed_path = g_strdup (et_file_get_path (ETFile));
+    }
+
+    et_application_window_browser_remove_file (ET_APPLICATION_WINDOW (MainWindow),
+                                               ETFile);
+    ET_Remove_File_From_File_List (ETFile);
+    changes->n_removed++;
+}
+
+/*
+ * Remove the file at @path, or all the files inside the directory at @path.
+ */
+static void
+et_file_monitor_remove_path (EtFileMonitorChanges *changes,
+                             const gchar *path)
+{
+    ET_File *ETFile;
+    GList *removed = NULL;
+    GList *l;
+
+    if ((ETFile = g_hash_table_lookup (changes->files, path)))
+    {
+        et_file_monitor_remove_file (changes, ETFile);
+        return;
+    }
+
+    if (!g_hash_table_contains (monitor->monitors, path))
+    {
+        return;
+    }
+
+    for (l = ETCore->ETFileList; l != NULL; l = g_list_next (l))
+    {
+        if (path_is_in_directory (et_file_get_path (l->data), path))
+        {
+            removed = g_list_prepend (removed, l->data);
+        }
+    }
+
+    for (l = removed; l != NULL; l = g_list_next (l))
+    {
+        et_file_monitor_remove_file (changes, l->data);
+    }
+
+    g_list_free (removed);
+    et_file_monitor_remove_directory (path);
+}
+
+/*
+ * Start monitoring @dir, and add the supported files inside it (and inside
+ * its subdirectories, if recursing) which are not yet in the file list.
+ */
+static void
+et_file_monitor_scan_directory (EtFileMonitorChanges *changes,
+                                GFile *dir)
+{
+    GFileEnumerator *enumerator;
+    GFileInfo *info;
+
+    et_file_monitor_add_directory (dir);
+
+    enumerator = g_file_enumerate_children (dir,
+                                            G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                            G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                            G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN,
+                                            G_FILE_QUERY_INFO_NONE, NULL,
+                                            NULL);
+
+    if (!enumerator)
+    {
+        return;
+    }
+
+    while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL))
+           != NULL)
+    {
+        if (file_info_is_browsable (info))
+        {
+            GFile *child = g_file_enumerator_get_child (enumerator, info);
+
+            switch (g_file_info_get_file_type (info))
+            {
+                case G_FILE_TYPE_DIRECTORY:
+                    if (monitor->recurse)
+                    {
+                        et_file_monitor_scan_directory (changes, child);
+                    }
+                    break;
+                case G_FILE_TYPE_REGULAR:
+                    if (et_file_is_supported (g_file_info_get_name (info)))
+                    {
+                        gchar *path = g_file_get_path (child);
+
+                        if (!g_hash_table_contains (changes->files, path))
+                        {
+                            et_file_monitor_add_file (changes, child);
+                        }
+
+                        g_free (path);
+                    }
+                    break;
+                default:
+                    break;
+            }
+
+            g_object_unref (child);
+        }
+
+        g_object_unref (info);
+    }
+
+    g_file_enumerator_close (enumerator, NULL, NULL);
+    g_object_unref (enumerator);
+}
+
+/*
+ * Apply a move inside the monitored directories, without reading the files
+ * again, so that unsaved changes are kept. Returns %FALSE if the move could
+ * not be applied in place.
+ */
+static gboolean
+et_file_monitor_apply_move (EtFileMonitorChanges *changes,
+                            const EtFileMonitorMove *move)
+{
+    ET_File *ETFile;
+    gchar *destination_dir;
+    gboolean monitored;
+
+    destination_dir = g_path_get_dirname (move->destination);
+    monitored = g_hash_table_contains (monitor->monitors, destination_dir);
+    g_free (destination_dir);
+
+    if (!monitored)
+    {
+        return FALSE;
+    }
+
+    if ((ETFile = g_hash_table_lookup (changes->files, move->source)))
+    {
+        File_Name *FileName = (File_Name *)ETFile->FileNameCur->data;
+        gchar *basename = g_path_get_basename (move->destination);
+        gboolean supported = et_file_is_supported (basename);
+
+        g_free (basename);
+
+        if (!supported)
+        {
+            return FALSE;
+        }
+
+        g_hash_table_remove (changes->files, move->source);
+
+        g_free (FileName->value);
+        g_free (FileName->value_utf8);
+        g_free (FileName->value_ck);
+        ET_Set_Filename_File_Name_Item (FileName, NULL, move->destination);
+
+        g_hash_table_insert (changes->files, FileName->value, ETFile);
+        et_application_window_browser_refresh_file_in_list (ET_APPLICATION_WINDOW (MainWindow),
+                                                            ETFile);
+        changes->n_renamed++;
+
+        return TRUE;
+    }
+
+    if (g_hash_table_contains (monitor->monitors, move->source))
+    {
+        GFile *dir;
+
+        if (!monitor->recurse)
+        {
+            return FALSE;
+        }
+
+        et_file_monitor_remove_directory (move->source);
+
+        /* If EasyTAG renamed the directory, the file list is already up to
+         * date. */
+        if (ETCore->ETFileList)
+        {
+            et_file_list_update_directory_name (ETCore->ETFileList,
+                                                move->source,
+                                                move->destination);
+            g_hash_table_unref (changes->files);
+            changes->files = et_file_monitor_index_files ();
+        }
+
+        dir = g_file_new_for_path (move->destination);
+        et_file_monitor_scan_directory (changes, dir);
+        g_object_unref (dir);
+
+        et_application_window_browser_refresh_list (ET_APPLICATION_WINDOW (MainWindow));
+        changes->n_renamed++;
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+et_file_monitor_apply_path (EtFileMonitorChanges *changes,
+                            const gchar *path)
+{
+    GFile *file;
+    GFileInfo *info;
+    ET_File *ETFile;
+
+    file = g_file_new_for_path (path);
+    info = g_file_query_info (file,
+                              G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                              G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                              G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN ","
+                              G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                              G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+    if (!info)
+    {
+        /* Deleted, or moved out of the monitored directories. */
+        et_file_monitor_remove_path (changes, path);
+        g_object_unref (file);
+        return;
+    }
+
+    ETFile = g_hash_table_lookup (changes->files, path);
+
+    switch (g_file_info_get_file_type (info))
+    {
+        case G_FILE_TYPE_DIRECTORY:
+            if (monitor->recurse
+                && file_info_is_browsable (info)
+                && !g_hash_table_contains (monitor->monitors, path))
+            {
+                et_file_monitor_scan_directory (changes, file);
+            }
+            break;
+        case G_FILE_TYPE_REGULAR:
+            if (!file_info_is_browsable (info)
+                || !et_file_is_supported (g_file_info_get_name (info)))
+            {
+                if (ETFile)
+                {
+                    et_file_monitor_remove_file (changes, ETFile);
+                }
+            }
+            else if (!ETFile)
+            {
+                et_file_monitor_add_file (changes, file);
+            }
+            else if (g_file_info_get_attribute_uint64 (info,
+                                                       G_FILE_ATTRIBUTE_TIME_MODIFIED)
+                     != ETFile->FileModificationTime)
+            {
+                if (et_file_check_saved (ETFile))
+                {
+                    /* Read the file again. */
+                    et_file_monitor_remove_file (changes, ETFile);
+                    et_file_monitor_add_file (changes, file);
+                }
+                else
+                {
+                    Log_Print (LOG_WARNING,
+                               _("File ‘%s’ was changed by an external program but has unsaved changes, so it was not read again"),
+                               ((File_Name *)ETFile->FileNameCur->data)->value_utf8);
+                }
+            }
+            /* Else the modification time was not changed, for example as the
+             * change was saved by EasyTAG. */
+            break;
+        default:
+            if (ETFile)
+            {
+                et_file_monitor_remove_file (changes, ETFile);
+            }
+            break;
+    }
+
+    g_object_unref (info);
+    g_object_unref (file);
+}
+
+static void
+et_file_monitor_apply_changes (void)
+{
+    EtApplicationWindow *window;
+    EtFileMonitorChanges changes = { NULL, NULL, 0, 0, 0 };
+    EtFileMonitorMove *move;
+    GHashTableIter iter;
+    gpointer key;
+    gchar *msg;
+
+    window = ET_APPLICATION_WINDOW (MainWindow);
+
+    /* Keep the edits of the displayed file, so that they are seen as unsaved
+     * changes. */
+    et_application_window_update_et_file_from_ui (window);
+
+    changes.files = et_file_monitor_index_files ();
+
+    while ((move = g_queue_pop_head (&monitor->moves)))
+    {
+        if (!et_file_monitor_apply_move (&changes, move))
+        {
+            g_hash_table_add (monitor->pending, move->source);
+            g_hash_table_add (monitor->pending, move->destination);
+            move->source = move->destination = NULL;
+        }
+
+        et_file_monitor_move_free (move);
+    }
+
+    g_hash_table_iter_init (&iter, monitor->pending);
+
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+    {
+        et_file_monitor_apply_path (&changes, key);
+    }
+
+    g_hash_table_remove_all (monitor->pending);
+
+    /* If the displayed file was read again, display the new copy. */
+    if (changes.displayed_path)
+    {
+        ET_File *ETFile = g_hash_table_lookup (changes.files,
+                                               changes.displayed_path);
+
+        if (ETFile)
+        {
+            ETCore->ETFileDisplayed = ETFile;
+        }
+
+        g_free (changes.displayed_path);
+    }
+
+    g_hash_table_unref (changes.files);
+
+    if (changes.n_added == 0 && changes.n_removed == 0
+        && changes.n_renamed == 0)
+    {
+        return;
+    }
+
+    /* Display the file before the browser list is rebuilt, as rebuilding it
+     * saves the displayed data to the displayed file. */
+    if (ETCore->ETFileDisplayed)
+    {
+        et_application_window_display_et_file (window,
+                                               ETCore->ETFileDisplayed);
+    }
+    else
+    {
+        et_application_window_file_area_clear (window);
+        et_application_window_tag_area_clear (window);
+    }
+
+    if (changes.n_added > 0)
+    {
+        /* Rebuild the browser list from memory, to sort the new files in. */
+        et_application_window_browser_toggle_display_mode (window);
+    }
+
+    et_application_window_update_actions (window);
+
+    msg = g_strdup_printf (_("Files changed on disk: %u added, %u removed, %u moved"),
+                           changes.n_added, changes.n_removed,
+                           changes.n_renamed);
+    et_application_window_status_bar_message (window, msg, TRUE);
+    g_free (msg);
+}
+
+static gboolean
+on_file_monitor_flush (gpointer user_data)
+{
+    /* Wait while the directory is read, or while a nested main loop is
+     * running, for example while saving or deleting files. */
+    if (ReadingDirectory || ETCore == NULL || g_main_depth () > 1)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    monitor->flush_id = 0;
+
+    if (!g_settings_get_boolean (MainSettings, "browse-monitor-changes"))
+    {
+        et_file_monitor_stop ();
+        return G_SOURCE_REMOVE;
+    }
+
+    et_file_monitor_apply_changes ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+on_directory_changed (GFileMonitor *dir_monitor,
+                      GFile *file,
+                      GFile *other_file,
+                      GFileMonitorEvent event_type,
+                      gpointer user_data)
+{
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_MOVED:
+            if (other_file)
+            {
+                EtFileMonitorMove *move = g_slice_new (EtFileMonitorMove);
+
+                move->source = g_file_get_path (file);
+                move->destination = g_file_get_path (other_file);
+
+                if (move->source && move->destination)
+                {
+                    g_queue_push_tail (&monitor->moves, move);
+                    break;
+                }
+
+                et_file_monitor_move_free (move);
+            }
+            /* Fall through. */
+        case G_FILE_MONITOR_EVENT_CHANGED:
+        case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+        case G_FILE_MONITOR_EVENT_CREATED:
+        case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_UNMOUNTED:
+            {
+                gchar *path = g_file_get_path (file);
+
+                if (path)
+                {
+                    g_hash_table_add (monitor->pending, path);
+                }
+            }
+            break;
+        case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+        case G_FILE_MONITOR_EVENT_PRE_UNMOUNT:
+        default:
+            /* Nothing which changes the file list. */
+            return;
+    }
+
+    if (monitor->flush_id != 0)
+    {
+        g_source_remove (monitor->flush_id);
+    }
+
+    monitor->flush_id = g_timeout_add_seconds (FILE_MONITOR_DELAY,
+                                               on_file_monitor_flush, NULL);
+    g_source_set_name_by_id (monitor->flush_id,
+                             "[EasyTAG] Apply file monitor changes");
+}
+
+/*
+ * et_file_monitor_start:
+ * @directories: (element-type GFile): the directories that were read
+ * @recurse: whether subdirectories were read
+ *
+ * Monitor the directories of the file list, and update the file list and the
+ * browser when files are created, deleted, moved or changed by other
+ * programs, instead of reading the whole directory again. Files with unsaved
+ * changes are never read again.
+ */
+void
+et_file_monitor_start (GList *directories,
+                       gboolean recurse)
+{
+    GList *l;
+
+    et_file_monitor_stop ();
+
+    if (!g_settings_get_boolean (MainSettings, "browse-monitor-changes"))
+    {
+        return;
+    }
+
+    monitor = g_slice_new0 (EtFileMonitor);
+    monitor->monitors = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free,
+                                               et_file_monitor_directory_free);
+    monitor->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                              NULL);
+    g_queue_init (&monitor->moves);
+    monitor->recurse = recurse;
+
+    for (l = directories; l != NULL; l = g_list_next (l))
+    {
+        et_file_monitor_add_directory (G_FILE (l->data));
+    }
+}
+
+/*
+ * et_file_monitor_stop:
+ *
+ * Stop monitoring the directories of the file list, and drop any changes
+ * which were not yet applied.
+ */
+void
+et_file_monitor_stop (void)
+{
+    if (monitor == NULL)
+    {
+        return;
+    }
+
+    if (monitor->flush_id != 0)
+    {
+        g_source_remove (monitor->flush_id);
+    }
+
+    g_hash_table_destroy (monitor->monitors);
+    g_hash_table_destroy (monitor->pending);
+    g_queue_foreach (&monitor->moves, (GFunc)et_file_monitor_move_free, NULL);
+    g_queue_clear (&monitor->moves);
+    g_slice_free (EtFileMonitor, monitor);
+    monitor = NULL;
+}
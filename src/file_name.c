@@ -159,3 +159,36 @@ et_file_name_detect_difference (const File_Name *a,
         return FALSE;
     }
 }
+
+/*
+ * et_file_name_get_size:
+ * @file_name: a filename
+ *
+ * Estimate the memory used by the filename, for the undo history.
+ *
+ * Returns: the estimated size of @file_name, in bytes
+ */
+gsize
+et_file_name_get_size (const File_Name *file_name)
+{
+    gsize size = sizeof (File_Name);
+
+    g_return_val_if_fail (file_name != NULL, 0);
+
+    if (file_name->value)
+    {
+        size += strlen (file_name->value) + 1;
+    }
+
+    if (file_name->value_utf8)
+    {
+        size += strlen (file_name->value_utf8) + 1;
+    }
+
+    if (file_name->value_ck)
+    {
+        size += strlen (file_name->value_ck) + 1;
+    }
+
+    return size;
+}
@@ -18,6 +18,8 @@
 
 #include "file_tag.h"
 
+#include <string.h>
+
 #include "misc.h"
 
 /*
@@ -46,31 +48,66 @@ et_file_tag_free_other_field (File_Tag *file_tag)
 
 
 /*
- * Frees a File_Tag item.
+ * Markers for the fields of a delta-encoded File_Tag, which have the same
+ * value as the neighbouring item in the undo history. Only the addresses are
+ * used.
+ */
+static gchar unchanged_string;
+static EtPicture unchanged_picture;
+static GList unchanged_other;
+
+/* Offsets of the string fields of File_Tag, for the delta encoding. */
+static const glong string_fields[] =
+{
+    G_STRUCT_OFFSET (File_Tag, title),
+    G_STRUCT_OFFSET (File_Tag, artist),
+    G_STRUCT_OFFSET (File_Tag, album_artist),
+    G_STRUCT_OFFSET (File_Tag, album),
+    G_STRUCT_OFFSET (File_Tag, disc_number),
+    G_STRUCT_OFFSET (File_Tag, disc_total),
+    G_STRUCT_OFFSET (File_Tag, year),
+    G_STRUCT_OFFSET (File_Tag, track),
+    G_STRUCT_OFFSET (File_Tag, track_total),
+    G_STRUCT_OFFSET (File_Tag, genre),
+    G_STRUCT_OFFSET (File_Tag, comment),
+    G_STRUCT_OFFSET (File_Tag, composer),
+    G_STRUCT_OFFSET (File_Tag, orig_artist),
+    G_STRUCT_OFFSET (File_Tag, copyright),
+    G_STRUCT_OFFSET (File_Tag, url),
+    G_STRUCT_OFFSET (File_Tag, encoded_by)
+};
+
+G_STATIC_ASSERT (ET_FILE_TAG_FIELD_PICTURE == 1 << G_N_ELEMENTS (string_fields));
+
+/*
+ * Frees a File_Tag item, which may be delta-encoded.
  */
 void
 et_file_tag_free (File_Tag *FileTag)
 {
+    gsize i;
+
     g_return_if_fail (FileTag != NULL);
 
-    g_free(FileTag->title);
-    g_free(FileTag->artist);
-    g_free(FileTag->album_artist);
-    g_free(FileTag->album);
-    g_free(FileTag->disc_number);
-    g_free (FileTag->disc_total);
-    g_free(FileTag->year);
-    g_free(FileTag->track);
-    g_free(FileTag->track_total);
-    g_free(FileTag->genre);
-    g_free(FileTag->comment);
-    g_free(FileTag->composer);
-    g_free(FileTag->orig_artist);
-    g_free(FileTag->copyright);
-    g_free(FileTag->url);
-    g_free(FileTag->encoded_by);
-    et_file_tag_set_picture (FileTag, NULL);
-    et_file_tag_free_other_field (FileTag);
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        gchar *field = G_STRUCT_MEMBER (gchar *, FileTag, string_fields[i]);
+
+        if (field != &unchanged_string)
+        {
+            g_free (field);
+        }
+    }
+
+    if (FileTag->picture != &unchanged_picture)
+    {
+        et_file_tag_set_picture (FileTag, NULL);
+    }
+
+    if (FileTag->other != &unchanged_other)
+    {
+        et_file_tag_free_other_field (FileTag);
+    }
 
     g_slice_free (File_Tag, FileTag);
 }
@@ -332,6 +369,122 @@ et_file_tag_set_picture (File_Tag *file_tag,
     }
 }
 
+/*
+ * Get the offset in File_Tag of the string field for the single flag @field.
+ */
+static glong
+et_file_tag_get_field_offset (EtFileTagField field)
+{
+    gint i = g_bit_nth_lsf (field, -1);
+
+    g_return_val_if_fail (i >= 0 && (gsize)i < G_N_ELEMENTS (string_fields)
+                          && field == (1U << i), -1);
+
+    return string_fields[i];
+}
+
+/*
+ * et_file_tag_get_field_value:
+ * @file_tag: the #File_Tag from which to get the value
+ * @field: a single string field
+ *
+ * Returns: (transfer none): the value of @field in @file_tag
+ */
+const gchar *
+et_file_tag_get_field_value (const File_Tag *file_tag,
+                             EtFileTagField field)
+{
+    glong offset;
+
+    g_return_val_if_fail (file_tag != NULL, NULL);
+
+    offset = et_file_tag_get_field_offset (field);
+    g_return_val_if_fail (offset >= 0, NULL);
+
+    return G_STRUCT_MEMBER (const gchar *, file_tag, offset);
+}
+
+/*
+ * et_file_tag_set_field_value:
+ * @file_tag: the #File_Tag on which to set the value
+ * @field: a single string field
+ * @value: (allow-none): the value to set, copied into @file_tag
+ *
+ * Set a string field of @file_tag, as the et_file_tag_set_*() functions do.
+ */
+void
+et_file_tag_set_field_value (File_Tag *file_tag,
+                             EtFileTagField field,
+                             const gchar *value)
+{
+    glong offset;
+
+    g_return_if_fail (file_tag != NULL);
+
+    offset = et_file_tag_get_field_offset (field);
+    g_return_if_fail (offset >= 0);
+
+    et_file_tag_set_field (&G_STRUCT_MEMBER (gchar *, file_tag, offset),
+                           value);
+}
+
+/*
+ * et_file_tag_matches:
+ * @file_tag: the tag to search in
+ * @needle: the string to search for, casefolded with g_utf8_casefold(), or
+ *          normalized with g_utf8_normalize() for a case-sensitive search
+ * @case_sensitive: whether @needle was normalized rather than casefolded
+ *
+ * Search for @needle in the string fields of @file_tag, as the search dialog
+ * does. The search stops at the first field which contains @needle.
+ *
+ * Returns: %TRUE if any string field of @file_tag contains @needle
+ */
+gboolean
+et_file_tag_matches (const File_Tag *file_tag,
+                     const gchar *needle,
+                     gboolean case_sensitive)
+{
+    guint field;
+
+    g_return_val_if_fail (file_tag != NULL, FALSE);
+    g_return_val_if_fail (needle != NULL, FALSE);
+
+    for (field = ET_FILE_TAG_FIELD_TITLE; field < ET_FILE_TAG_FIELD_PICTURE;
+         field <<= 1)
+    {
+        const gchar *value;
+        gchar *haystack;
+        gboolean found;
+
+        value = et_file_tag_get_field_value (file_tag, field);
+
+        if (value == NULL)
+        {
+            continue;
+        }
+
+        if (case_sensitive)
+        {
+            haystack = g_utf8_normalize (value, -1, G_NORMALIZE_DEFAULT);
+        }
+        else
+        {
+            haystack = g_utf8_casefold (value, -1);
+        }
+
+        found = haystack && strstr (haystack, needle);
+        g_free (haystack);
+
+        if (found)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 /*
  * Compares two File_Tag items and returns TRUE if there aren't the same.
  * Notes:
@@ -465,3 +618,276 @@ et_file_tag_detect_difference (const File_Tag *FileTag1,
 
     return FALSE; /* No changes */
 }
+
+static gboolean
+pictures_equal (const EtPicture *a,
+                const EtPicture *b)
+{
+    for (; a && b; a = a->next, b = b->next)
+    {
+        if (a->type != b->type || a->width != b->width
+            || a->height != b->height
+            || g_strcmp0 (a->description, b->description) != 0
+            || !g_bytes_equal (a->bytes, b->bytes))
+        {
+            return FALSE;
+        }
+    }
+
+    return a == b;
+}
+
+static gboolean
+others_equal (const GList *a,
+              const GList *b)
+{
+    for (; a && b; a = g_list_next (a), b = g_list_next (b))
+    {
+        if (g_strcmp0 (a->data, b->data) != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return a == b;
+}
+
+/*
+ * et_file_tag_delta_encode:
+ * @file_tag: a tag in the undo history, which is not the current tag
+ * @reference: the neighbouring tag in the history, towards the current tag,
+ *             which must not be delta-encoded
+ *
+ * Free the fields of @file_tag which are equal to those of @reference, and
+ * mark them as unchanged, so that the undo history only keeps the fields
+ * which differ between two changes. Unlike et_file_tag_detect_difference(),
+ * the values are compared exactly.
+ */
+void
+et_file_tag_delta_encode (File_Tag *file_tag,
+                          const File_Tag *reference)
+{
+    gsize i;
+
+    g_return_if_fail (file_tag != NULL && reference != NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        gchar **field = &G_STRUCT_MEMBER (gchar *, file_tag, string_fields[i]);
+        const gchar *value = G_STRUCT_MEMBER (gchar *, reference,
+                                              string_fields[i]);
+
+        g_return_if_fail (value != &unchanged_string);
+
+        if (*field != &unchanged_string && g_strcmp0 (*field, value) == 0)
+        {
+            g_free (*field);
+            *field = &unchanged_string;
+        }
+    }
+
+    if (file_tag->picture != &unchanged_picture
+        && pictures_equal (file_tag->picture, reference->picture))
+    {
+        et_file_tag_set_picture (file_tag, NULL);
+        file_tag->picture = &unchanged_picture;
+    }
+
+    if (file_tag->other != &unchanged_other
+        && others_equal (file_tag->other, reference->other))
+    {
+        et_file_tag_free_other_field (file_tag);
+        file_tag->other = &unchanged_other;
+    }
+}
+
+/*
+ * et_file_tag_delta_swap:
+ * @file_tag: a delta-encoded tag, which becomes the current tag
+ * @reference: the current tag, which is the neighbour of @file_tag in the
+ *             undo history
+ *
+ * Restore the unchanged fields of @file_tag by moving the values from
+ * @reference, which is left delta-encoded against @file_tag. Used to undo or
+ * redo a change without copying the fields.
+ */
+void
+et_file_tag_delta_swap (File_Tag *file_tag,
+                        File_Tag *reference)
+{
+    gsize i;
+
+    g_return_if_fail (file_tag != NULL && reference != NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        gchar **field = &G_STRUCT_MEMBER (gchar *, file_tag, string_fields[i]);
+        gchar **value = &G_STRUCT_MEMBER (gchar *, reference,
+                                          string_fields[i]);
+
+        if (*field == &unchanged_string)
+        {
+            *field = *value;
+            *value = &unchanged_string;
+        }
+    }
+
+    if (file_tag->picture == &unchanged_picture)
+    {
+        file_tag->picture = reference->picture;
+        reference->picture = &unchanged_picture;
+    }
+
+    if (file_tag->other == &unchanged_other)
+    {
+        file_tag->other = reference->other;
+        reference->other = &unchanged_other;
+    }
+}
+
+/*
+ * et_file_tag_take_unchanged:
+ * @file_tag: a new tag, which only has values for @fields
+ * @current: the current tag of the file, which must not be delta-encoded
+ * @fields: the #EtFileTagField flags of the fields set in @file_tag
+ *
+ * Move the other fields from @current to @file_tag, and mark them as
+ * unchanged in @current, which is then delta-encoded against @file_tag. Used
+ * to add a change of a few fields to the undo history without copying the
+ * fields which were not changed.
+ */
+void
+et_file_tag_take_unchanged (File_Tag *file_tag,
+                            File_Tag *current,
+                            guint fields)
+{
+    gsize i;
+
+    g_return_if_fail (file_tag != NULL && current != NULL);
+
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        gchar **field = &G_STRUCT_MEMBER (gchar *, file_tag, string_fields[i]);
+        gchar **value = &G_STRUCT_MEMBER (gchar *, current, string_fields[i]);
+
+        g_return_if_fail (*value != &unchanged_string);
+
+        if (!(fields & (1U << i)))
+        {
+            g_free (*field);
+            *field = *value;
+            *value = &unchanged_string;
+        }
+    }
+
+    if (!(fields & ET_FILE_TAG_FIELD_PICTURE))
+    {
+        et_file_tag_set_picture (file_tag, NULL);
+        file_tag->picture = current->picture;
+        current->picture = &unchanged_picture;
+    }
+
+    et_file_tag_free_other_field (file_tag);
+    file_tag->other = current->other;
+    current->other = &unchanged_other;
+}
+
+/*
+ * et_file_tag_get_changed_fields:
+ * @file_tag: a tag
+ * @other: the neighbouring tag of @file_tag in the undo history
+ *
+ * Compare the fields of the tags exactly. A field which is marked as
+ * unchanged in either tag by the delta encoding is equal in both.
+ *
+ * Returns: the #EtFileTagField flags of the fields which differ
+ */
+guint
+et_file_tag_get_changed_fields (const File_Tag *file_tag,
+                                const File_Tag *other)
+{
+    guint fields = 0;
+    gsize i;
+
+    g_return_val_if_fail (file_tag != NULL && other != NULL, 0);
+
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        const gchar *value1 = G_STRUCT_MEMBER (gchar *, file_tag,
+                                               string_fields[i]);
+        const gchar *value2 = G_STRUCT_MEMBER (gchar *, other,
+                                               string_fields[i]);
+
+        if (value1 != &unchanged_string && value2 != &unchanged_string
+            && g_strcmp0 (value1, value2) != 0)
+        {
+            fields |= 1U << i;
+        }
+    }
+
+    if (file_tag->picture != &unchanged_picture
+        && other->picture != &unchanged_picture
+        && !pictures_equal (file_tag->picture, other->picture))
+    {
+        fields |= ET_FILE_TAG_FIELD_PICTURE;
+    }
+
+    return fields;
+}
+
+/*
+ * et_file_tag_get_size:
+ * @file_tag: a tag, which may be delta-encoded
+ *
+ * Estimate the memory used by the tag, without the unchanged fields of a
+ * delta-encoded tag. Image data is counted even if it is shared with other
+ * tags.
+ *
+ * Returns: the estimated size of @file_tag, in bytes
+ */
+gsize
+et_file_tag_get_size (const File_Tag *file_tag)
+{
+    gsize size = sizeof (File_Tag);
+    gsize i;
+
+    g_return_val_if_fail (file_tag != NULL, 0);
+
+    for (i = 0; i < G_N_ELEMENTS (string_fields); i++)
+    {
+        const gchar *field = G_STRUCT_MEMBER (gchar *, file_tag,
+                                              string_fields[i]);
+
+        if (field && field != &unchanged_string)
+        {
+            size += strlen (field) + 1;
+        }
+    }
+
+    if (file_tag->picture != &unchanged_picture)
+    {
+        const EtPicture *pic;
+
+        for (pic = file_tag->picture; pic != NULL; pic = pic->next)
+        {
+            size += sizeof (EtPicture) + g_bytes_get_size (pic->bytes);
+
+            if (pic->description)
+            {
+                size += strlen (pic->description) + 1;
+            }
+        }
+    }
+
+    if (file_tag->other != &unchanged_other)
+    {
+        const GList *l;
+
+        for (l = file_tag->other; l != NULL; l = g_list_next (l))
+        {
+            size += sizeof (GList) + strlen (l->data) + 1;
+        }
+    }
+
+    return size;
+}
@@ -75,6 +75,49 @@ typedef struct
     GList *other;
 } File_Tag;
 
+/*
+ * EtFileTagField:
+ * @ET_FILE_TAG_FIELD_TITLE: the title
+ * @ET_FILE_TAG_FIELD_ARTIST: the artist
+ * @ET_FILE_TAG_FIELD_ALBUM_ARTIST: the album artist
+ * @ET_FILE_TAG_FIELD_ALBUM: the album
+ * @ET_FILE_TAG_FIELD_DISC_NUMBER: the disc number
+ * @ET_FILE_TAG_FIELD_DISC_TOTAL: the total number of discs
+ * @ET_FILE_TAG_FIELD_YEAR: the year
+ * @ET_FILE_TAG_FIELD_TRACK_NUMBER: the track number
+ * @ET_FILE_TAG_FIELD_TRACK_TOTAL: the total number of tracks
+ * @ET_FILE_TAG_FIELD_GENRE: the genre
+ * @ET_FILE_TAG_FIELD_COMMENT: the comment
+ * @ET_FILE_TAG_FIELD_COMPOSER: the composer
+ * @ET_FILE_TAG_FIELD_ORIG_ARTIST: the original artist
+ * @ET_FILE_TAG_FIELD_COPYRIGHT: the copyright
+ * @ET_FILE_TAG_FIELD_URL: the URL
+ * @ET_FILE_TAG_FIELD_ENCODED_BY: the encoded by field
+ * @ET_FILE_TAG_FIELD_PICTURE: the pictures
+ *
+ * Flags for the fields of a File_Tag, in the order of the structure.
+ */
+typedef enum
+{
+    ET_FILE_TAG_FIELD_TITLE = 1 << 0,
+    ET_FILE_TAG_FIELD_ARTIST = 1 << 1,
+    ET_FILE_TAG_FIELD_ALBUM_ARTIST = 1 << 2,
+    ET_FILE_TAG_FIELD_ALBUM = 1 << 3,
+    ET_FILE_TAG_FIELD_DISC_NUMBER = 1 << 4,
+    ET_FILE_TAG_FIELD_DISC_TOTAL = 1 << 5,
+    ET_FILE_TAG_FIELD_YEAR = 1 << 6,
+    ET_FILE_TAG_FIELD_TRACK_NUMBER = 1 << 7,
+    ET_FILE_TAG_FIELD_TRACK_TOTAL = 1 << 8,
+    ET_FILE_TAG_FIELD_GENRE = 1 << 9,
+    ET_FILE_TAG_FIELD_COMMENT = 1 << 10,
+    ET_FILE_TAG_FIELD_COMPOSER = 1 << 11,
+    ET_FILE_TAG_FIELD_ORIG_ARTIST = 1 << 12,
+    ET_FILE_TAG_FIELD_COPYRIGHT = 1 << 13,
+    ET_FILE_TAG_FIELD_URL = 1 << 14,
+    ET_FILE_TAG_FIELD_ENCODED_BY = 1 << 15,
+    ET_FILE_TAG_FIELD_PICTURE = 1 << 16
+} EtFileTagField;
+
 File_Tag * et_file_tag_new (void);
 void et_file_tag_free (File_Tag *file_tag);
 
@@ -96,11 +139,21 @@ void et_file_tag_set_url (File_Tag *file_tag, const gchar *url);
 void et_file_tag_set_encoded_by (File_Tag *file_tag, const gchar *encoded_by);
 void et_file_tag_set_picture (File_Tag *file_tag, const EtPicture *pic);
 
+const gchar * et_file_tag_get_field_value (const File_Tag *file_tag, EtFileTagField field);
+void et_file_tag_set_field_value (File_Tag *file_tag, EtFileTagField field, const gchar *value);
+gboolean et_file_tag_matches (const File_Tag *file_tag, const gchar *needle, gboolean case_sensitive);
+
 void et_file_tag_copy_into (File_Tag *destination, const File_Tag *source);
 void et_file_tag_copy_other_into (File_Tag *destination, const File_Tag *source);
 
 gboolean et_file_tag_detect_difference (const File_Tag *FileTag1, const File_Tag  *FileTag2);
 
+void et_file_tag_delta_encode (File_Tag *file_tag, const File_Tag *reference);
+void et_file_tag_delta_swap (File_Tag *file_tag, File_Tag *reference);
+void et_file_tag_take_unchanged (File_Tag *file_tag, File_Tag *current, guint fields);
+guint et_file_tag_get_changed_fields (const File_Tag *file_tag, const File_Tag *other);
+gsize et_file_tag_get_size (const File_Tag *file_tag);
+
 G_END_DECLS
 
 #endif /* !ET_FILE_TAG_H_ */
@@ -0,0 +1,225 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "genres.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of distinct strings remembered by et_genre_normalize(). */
+#define MAX_NORMALIZED_GENRES 4096
+
+/* The genre numbers, sorted by the case-insensitive name of the genre. */
+static guchar sorted_genres[G_N_ELEMENTS (id3_genres)];
+
+static GMutex normalized_mutex;
+static GHashTable *normalized_genres;
+
+static int
+compare_genre_numbers (const void *a,
+                       const void *b)
+{
+    return g_ascii_strcasecmp (id3_genres[*(const guchar *)a],
+                               id3_genres[*(const guchar *)b]);
+}
+
+static const guchar *
+get_sorted_genres (void)
+{
+    static gsize initialized = 0;
+
+    if (g_once_init_enter (&initialized))
+    {
+        gsize i;
+
+        for (i = 0; i < G_N_ELEMENTS (sorted_genres); i++)
+        {
+            sorted_genres[i] = i;
+        }
+
+        qsort (sorted_genres, G_N_ELEMENTS (sorted_genres),
+               sizeof (*sorted_genres), compare_genre_numbers);
+
+        g_once_init_leave (&initialized, 1);
+    }
+
+    return sorted_genres;
+}
+
+/*
+ * et_genre_lookup:
+ * @genre: the name of a genre
+ *
+ * Find the ID3v1 number of a genre, ignoring the case of the name.
+ *
+ * Returns: the genre number, or 0xFF if @genre is not one of the ID3v1 genres
+ */
+guchar
+et_genre_lookup (const gchar *genre)
+{
+    const guchar *sorted;
+    gsize low = 0;
+    gsize high = G_N_ELEMENTS (sorted_genres);
+
+    if (genre == NULL)
+    {
+        return 0xFF;
+    }
+
+    sorted = get_sorted_genres ();
+
+    while (low < high)
+    {
+        const gsize middle = low + (high - low) / 2;
+        const gint cmp = g_ascii_strcasecmp (genre,
+                                             id3_genres[sorted[middle]]);
+
+        if (cmp == 0)
+        {
+            return sorted[middle];
+        }
+        else if (cmp < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+
+    return 0xFF;
+}
+
+/* Results of normalize_genre() other than a genre number. */
+#define NORMALIZED_GENRE_UNKNOWN (-1)
+#define NORMALIZED_GENRE_TEXT(offset) (-2 - (gint)(offset))
+
+/*
+ * normalize_genre:
+ * @genre: a genre, as stored in a tag
+ *
+ * Convert the forms used for genres in ID3 tags into the name of the genre.
+ * Genres are written like this:
+ *    - "(<genre_id>)"              -> "(3)"
+ *    - "<genre_id>"                -> "3"
+ *    - "<genre_name>"              -> "Dance"
+ *    - "(<genre_id>)<refinement>"  -> "(3)EuroDance"
+ *
+ * Returns: the number of the genre, %NORMALIZED_GENRE_UNKNOWN if the genre
+ *          number is not known, or NORMALIZED_GENRE_TEXT() of the offset of
+ *          the name of the genre in @genre
+ */
+static gint
+normalize_genre (const gchar *genre)
+{
+    gchar *tmp;
+    gulong number;
+
+    if ((genre[0] == '(') && g_ascii_isdigit (genre[1])
+        && (tmp = strchr (genre + 1, ')')) && *(tmp + 1))
+    {
+        /* Convert a genre written as '(3)EuroDance' into 'EuroDance'. */
+        return NORMALIZED_GENRE_TEXT (tmp + 1 - genre);
+    }
+    else if ((genre[0] == '(') && g_ascii_isdigit (genre[1])
+             && strchr (genre, ')'))
+    {
+        /* Convert a genre written as '(3)' into 'Dance'. */
+        number = strtoul (genre + 1, &tmp, 10);
+
+        if (*tmp != ')')
+        {
+            return NORMALIZED_GENRE_TEXT (0);
+        }
+    }
+    else
+    {
+        number = strtoul (genre, &tmp, 10);
+
+        if (tmp == genre)
+        {
+            return NORMALIZED_GENRE_TEXT (0);
+        }
+    }
+
+    if (number < G_N_ELEMENTS (id3_genres))
+    {
+        return number;
+    }
+
+    return NORMALIZED_GENRE_UNKNOWN;
+}
+
+/*
+ * et_genre_normalize:
+ * @genre: a genre, as stored in a tag
+ *
+ * Convert a genre, which may be a number of an ID3v1 genre, possibly in
+ * parentheses and with a refinement, into the name of the genre. The
+ * conversion of each distinct string is remembered, as the same few genres
+ * are found in many files. Only the genre number, or the position of the name
+ * in the string, is remembered, so no other string is kept.
+ *
+ * Returns: the name of the genre, to be freed with g_free(), or %NULL if the
+ *          genre number is not known
+ */
+gchar *
+et_genre_normalize (const gchar *genre)
+{
+    gpointer value;
+    gint result;
+
+    g_return_val_if_fail (genre != NULL, NULL);
+
+    g_mutex_lock (&normalized_mutex);
+
+    if (normalized_genres == NULL)
+    {
+        normalized_genres = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                   g_free, NULL);
+    }
+
+    if (g_hash_table_lookup_extended (normalized_genres, genre, NULL, &value))
+    {
+        result = GPOINTER_TO_INT (value);
+    }
+    else
+    {
+        result = normalize_genre (genre);
+
+        if (g_hash_table_size (normalized_genres) < MAX_NORMALIZED_GENRES)
+        {
+            g_hash_table_insert (normalized_genres, g_strdup (genre),
+                                 GINT_TO_POINTER (result));
+        }
+    }
+
+    g_mutex_unlock (&normalized_mutex);
+
+    if (result >= 0)
+    {
+        return g_strdup (id3_genres[result]);
+    }
+    else if (result == NORMALIZED_GENRE_UNKNOWN)
+    {
+        return NULL;
+    }
+
+    return g_strdup (genre + (NORMALIZED_GENRE_TEXT (0) - result));
+}
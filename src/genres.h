@@ -20,6 +20,13 @@
 #ifndef ET_GENRES_H_
 #define ET_GENRES_H_
 
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+guchar et_genre_lookup (const gchar *genre);
+gchar * et_genre_normalize (const gchar *genre);
+
 /* GENRE_MAX is the last genre number that can be used */
 #define GENRE_MAX ( sizeof(id3_genres)/sizeof(id3_genres[0]) - 1 )
 
@@ -231,4 +238,6 @@ static const char *id3_genres[] =
     "Psybient"
 };
 
+G_END_DECLS
+
 #endif /* ET_GENRES_H_ */
@@ -24,6 +24,7 @@
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include "easytag.h"
@@ -31,6 +32,7 @@
 #include "browser.h"
 #include "setting.h"
 #include "preferences_dialog.h"
+#include "profile.h"
 
 #ifdef G_OS_WIN32
 #include <windows.h>
@@ -383,10 +385,12 @@ et_rename_file (const char *old_filepath,
     GFile *file_old;
     GFile *file_new;
     GFile *file_new_parent;
+    gint64 span;
 
     g_return_val_if_fail (old_filepath != NULL && new_filepath != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+    span = et_profile_span_begin ();
     file_old = g_file_new_for_path (old_filepath);
     file_new = g_file_new_for_path (new_filepath);
     file_new_parent = g_file_get_parent (file_new);
@@ -480,12 +484,14 @@ et_rename_file (const char *old_filepath,
 out:
     g_object_unref (file_old);
     g_object_unref (file_new);
+    et_profile_span_end (ET_PROFILE_PHASE_RENAME, span);
     g_assert (error == NULL || *error == NULL);
     return TRUE;
 
 err:
     g_object_unref (file_old);
     g_object_unref (file_new);
+    et_profile_span_end (ET_PROFILE_PHASE_RENAME, span);
     g_assert (error == NULL || *error != NULL);
     return FALSE;
 }
@@ -573,6 +579,212 @@ et_undo_key_new (void)
     return ++ETUndoKey;
 }
 
+/*
+ * EtCompareScratch:
+ * @decomposed: canonically decomposed code points of each string
+ *
+ * Buffers reused by the normalized string comparisons of a thread, so that
+ * comparing does not allocate once the buffers are large enough.
+ */
+typedef struct
+{
+    GArray *decomposed[2];
+} EtCompareScratch;
+
+static void
+compare_scratch_free (gpointer data)
+{
+    EtCompareScratch *scratch = data;
+    gsize i;
+
+    for (i = 0; i < 2; i++)
+    {
+        g_array_free (scratch->decomposed[i], TRUE);
+    }
+
+    g_slice_free (EtCompareScratch, scratch);
+}
+
+static GPrivate compare_scratch_key = G_PRIVATE_INIT (compare_scratch_free);
+
+static EtCompareScratch *
+get_compare_scratch (void)
+{
+    EtCompareScratch *scratch;
+
+    scratch = g_private_get (&compare_scratch_key);
+
+    if (scratch == NULL)
+    {
+        gsize i;
+
+        scratch = g_slice_new (EtCompareScratch);
+
+        for (i = 0; i < 2; i++)
+        {
+            scratch->decomposed[i] = g_array_sized_new (FALSE, FALSE,
+                                                        sizeof (gunichar),
+                                                        64);
+        }
+
+        g_private_set (&compare_scratch_key, scratch);
+    }
+
+    return scratch;
+}
+
+/*
+ * common_prefix_length:
+ * @str1: a string
+ * @length1: the length of @str1, in bytes
+ * @str2: a string
+ * @length2: the length of @str2, in bytes
+ *
+ * Find the number of leading bytes which are identical in both strings. The
+ * bulk of the comparison is done a word at a time, while both strings have a
+ * whole word left, and the rest a byte at a time, so that no byte is read
+ * beyond the end of either string.
+ *
+ * Returns: the offset of the first byte which differs, or the length of the
+ *          shorter string
+ */
+static gsize
+common_prefix_length (const gchar *str1,
+                      gsize length1,
+                      const gchar *str2,
+                      gsize length2)
+{
+    const gsize length = MIN (length1, length2);
+    gsize i = 0;
+
+    while (length - i >= sizeof (gsize))
+    {
+        gsize word1;
+        gsize word2;
+
+        memcpy (&word1, str1 + i, sizeof (word1));
+        memcpy (&word2, str2 + i, sizeof (word2));
+
+        if (word1 != word2)
+        {
+            break;
+        }
+
+        i += sizeof (gsize);
+    }
+
+    while (i < length && str1[i] == str2[i])
+    {
+        i++;
+    }
+
+    return i;
+}
+
+/*
+ * utf8_is_decomposed:
+ * @str: a valid UTF-8 string
+ *
+ * Check whether @str is unchanged by canonical decomposition, in which case
+ * it can be compared without being normalized first.
+ *
+ * Returns: %TRUE if @str is already in NFD, %FALSE otherwise
+ */
+static gboolean
+utf8_is_decomposed (const gchar *str)
+{
+    gint last_class = 0;
+
+    for (; *str != '\0'; str = g_utf8_next_char (str))
+    {
+        gunichar c;
+        gunichar decomposition[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+        gint combining_class;
+
+        /* ASCII characters are starters, which never decompose. */
+        if ((guchar)*str < 0x80)
+        {
+            last_class = 0;
+            continue;
+        }
+
+        c = g_utf8_get_char (str);
+
+        if (g_unichar_fully_decompose (c, FALSE, decomposition,
+                                       G_N_ELEMENTS (decomposition)) != 1
+            || decomposition[0] != c)
+        {
+            return FALSE;
+        }
+
+        combining_class = g_unichar_combining_class (c);
+
+        if (combining_class != 0 && combining_class < last_class)
+        {
+            return FALSE;
+        }
+
+        last_class = combining_class;
+    }
+
+    return TRUE;
+}
+
+/*
+ * utf8_decompose:
+ * @str: a valid UTF-8 string
+ * @decomposed: an array of #gunichar to fill
+ *
+ * Store the canonical decomposition of @str, in canonical order, in
+ * @decomposed. This gives the same code points as g_utf8_normalize() with
+ * %G_NORMALIZE_DEFAULT, without allocating a new string.
+ */
+static void
+utf8_decompose (const gchar *str,
+                GArray *decomposed)
+{
+    gunichar *chars;
+    guint i;
+
+    g_array_set_size (decomposed, 0);
+
+    for (; *str != '\0'; str = g_utf8_next_char (str))
+    {
+        gunichar decomposition[G_UNICHAR_MAX_DECOMPOSITION_LENGTH];
+        gsize length;
+
+        length = g_unichar_fully_decompose (g_utf8_get_char (str), FALSE,
+                                            decomposition,
+                                            G_N_ELEMENTS (decomposition));
+        g_array_append_vals (decomposed, decomposition, length);
+    }
+
+    /* Canonical ordering: a stable sort of each run of combining marks by
+     * combining class. Starters have class 0, and so are never moved. */
+    chars = (gunichar *)decomposed->data;
+
+    for (i = 1; i < decomposed->len; i++)
+    {
+        const gunichar c = chars[i];
+        const gint combining_class = g_unichar_combining_class (c);
+        guint j;
+
+        if (combining_class == 0)
+        {
+            continue;
+        }
+
+        for (j = i; j > 0
+             && g_unichar_combining_class (chars[j - 1]) > combining_class;
+             j--)
+        {
+            chars[j] = chars[j - 1];
+        }
+
+        chars[j] = c;
+    }
+}
+
 /*
  * et_normalized_strcmp0:
  * @str1: UTF-8 string, or %NULL
@@ -581,6 +793,10 @@ et_undo_key_new (void)
  * Compare two UTF-8 strings, normalizing them before doing so, and return the
  * difference.
  *
+ * Normalization only has to start after the last ASCII character which both
+ * strings share, and is skipped entirely if the strings differ at an ASCII
+ * character or are already normalized, which covers most tags and filenames.
+ *
  * Returns: an integer less than, equal to, or greater than zero, if str1 is <,
  * == or > than str2
  */
@@ -589,8 +805,15 @@ et_normalized_strcmp0 (const gchar *str1,
                        const gchar *str2)
 {
     gint result;
-    gchar *normalized1;
-    gchar *normalized2;
+    gsize prefix;
+    gsize start;
+    guchar c1;
+    guchar c2;
+    EtCompareScratch *scratch;
+    const gunichar *chars1;
+    const gunichar *chars2;
+    guint length;
+    guint i;
 
     /* Check for NULL, as it cannot be passed to g_utf8_normalize(). */
     if (!str1)
@@ -603,15 +826,101 @@ et_normalized_strcmp0 (const gchar *str1,
         return str1 != str2;
     }
 
-    normalized1 = g_utf8_normalize (str1, -1, G_NORMALIZE_DEFAULT);
-    normalized2 = g_utf8_normalize (str2, -1, G_NORMALIZE_DEFAULT);
+    prefix = common_prefix_length (str1, strlen (str1), str2, strlen (str2));
+    c1 = str1[prefix];
+    c2 = str2[prefix];
 
-    result = g_strcmp0 (normalized1, normalized2);
+    /* Identical strings are identical after normalization. */
+    if (c1 == '\0' && c2 == '\0')
+    {
+        return 0;
+    }
+
+    /* An ASCII character is a starter, which does not combine with anything
+     * before it, so the normalized strings differ at the same character. */
+    if (c1 < 0x80 && c2 < 0x80)
+    {
+        return c1 - c2;
+    }
 
-    g_free (normalized1);
-    g_free (normalized2);
+    /* Otherwise, the strings only have to be compared from after the last
+     * ASCII character which they share. */
+    start = prefix;
 
-    return result;
+    while (start > 0 && (guchar)str1[start - 1] >= 0x80)
+    {
+        start--;
+    }
+
+    if (!g_utf8_validate (str1 + start, -1, NULL)
+        || !g_utf8_validate (str2 + start, -1, NULL))
+    {
+        gchar *normalized1;
+        gchar *normalized2;
+
+        normalized1 = g_utf8_normalize (str1, -1, G_NORMALIZE_DEFAULT);
+        normalized2 = g_utf8_normalize (str2, -1, G_NORMALIZE_DEFAULT);
+
+        result = g_strcmp0 (normalized1, normalized2);
+
+        g_free (normalized1);
+        g_free (normalized2);
+
+        return result;
+    }
+
+    if (utf8_is_decomposed (str1 + start) && utf8_is_decomposed (str2 + start))
+    {
+        return c1 - c2;
+    }
+
+    /* UTF-8 sorts in code point order, so compare the code points. */
+    scratch = get_compare_scratch ();
+    utf8_decompose (str1 + start, scratch->decomposed[0]);
+    utf8_decompose (str2 + start, scratch->decomposed[1]);
+
+    chars1 = (const gunichar *)scratch->decomposed[0]->data;
+    chars2 = (const gunichar *)scratch->decomposed[1]->data;
+    length = MIN (scratch->decomposed[0]->len, scratch->decomposed[1]->len);
+
+    for (i = 0; i < length; i++)
+    {
+        if (chars1[i] != chars2[i])
+        {
+            return chars1[i] < chars2[i] ? -1 : 1;
+        }
+    }
+
+    return (scratch->decomposed[0]->len > length)
+           - (scratch->decomposed[1]->len > length);
+}
+
+/*
+ * ascii_strcaseequal:
+ * @str1: a nul-terminated string
+ * @str2: a nul-terminated string
+ *
+ * Compare the strings in place, ignoring the case of ASCII letters.
+ *
+ * Returns: %TRUE if both strings only contain ASCII characters and are equal
+ * ignoring case, %FALSE otherwise
+ */
+static gboolean
+ascii_strcaseequal (const gchar *str1,
+                    const gchar *str2)
+{
+    /* Only ASCII letters are changed by g_ascii_tolower(), so if @str1 is
+     * ASCII and the characters are equal, so is @str2. */
+    for (; *str1 != '\0' || *str2 != '\0'; str1++, str2++)
+    {
+        if ((guchar)*str1 >= 0x80
+            || g_ascii_tolower (*str1) != g_ascii_tolower (*str2))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
 }
 
 /*
@@ -644,6 +953,13 @@ et_normalized_strcasecmp0 (const gchar *str1,
         return str1 != str2;
     }
 
+    /* ASCII strings are already normalized, so if they are equal ignoring
+     * case, they are equal without being copied and casefolded. */
+    if (ascii_strcaseequal (str1, str2))
+    {
+        return 0;
+    }
+
     /* The strings are automatically normalized during casefolding. */
     casefolded1 = g_utf8_casefold (str1, -1);
     casefolded2 = g_utf8_casefold (str2, -1);
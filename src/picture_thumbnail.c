@@ -0,0 +1,665 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "picture_thumbnail.h"
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+/* Number of decoded thumbnails kept in memory. */
+#define THUMBNAIL_MEMORY_CACHE_SIZE 128
+
+/* Limits of the thumbnails kept on disk. Thumbnails which were not used for
+ * longer than the maximum age are removed, and then the least recently used
+ * ones until the total size is below the maximum size. */
+#define THUMBNAIL_DISK_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+#define THUMBNAIL_DISK_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* Number of thumbnails saved between two prunings of the disk cache. The disk
+ * cache is also pruned before the first thumbnail is saved. */
+#define THUMBNAIL_DISK_CACHE_PRUNE_INTERVAL 256
+
+/* Keys used by the freedesktop.org thumbnail specification to store the size
+ * of the original image in the thumbnail PNG. */
+#define THUMBNAIL_KEY_WIDTH "tEXt::Thumb::Image::Width"
+#define THUMBNAIL_KEY_HEIGHT "tEXt::Thumb::Image::Height"
+
+/*
+ * EtThumbnail:
+ * @key: cache key, built from the image checksum, size and scale factor
+ * @pixbuf: the scaled image
+ * @width: width of the original image
+ * @height: height of the original image
+ * @link: link in the least-recently-used queue
+ */
+typedef struct
+{
+    gchar *key;
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+    GList *link;
+} EtThumbnail;
+
+/*
+ * EtThumbnailRequest:
+ * @bytes: image data to decode
+ * @size: size of the longest side of the thumbnail, in logical pixels
+ * @scale_factor: scale factor of the widget displaying the thumbnail
+ */
+typedef struct
+{
+    GBytes *bytes;
+    gint size;
+    gint scale_factor;
+} EtThumbnailRequest;
+
+/* The memory cache is shared between the worker threads and the main loop. */
+G_LOCK_DEFINE_STATIC (memory_cache);
+static GHashTable *memory_cache = NULL;
+static GQueue memory_cache_lru = G_QUEUE_INIT;
+
+/* Only one worker thread prunes the disk cache at a time. */
+G_LOCK_DEFINE_STATIC (disk_cache_prune);
+static gint disk_cache_n_saved = 0;
+
+/*
+ * EtThumbnailFile:
+ * @path: the path of the thumbnail in the disk cache
+ * @size: size of the file
+ * @mtime: the time at which the thumbnail was last saved or used
+ */
+typedef struct
+{
+    gchar *path;
+    goffset size;
+    gint64 mtime;
+} EtThumbnailFile;
+
+static void
+et_thumbnail_free (EtThumbnail *thumbnail)
+{
+    g_free (thumbnail->key);
+    g_clear_object (&thumbnail->pixbuf);
+    g_slice_free (EtThumbnail, thumbnail);
+}
+
+static EtThumbnail *
+et_thumbnail_copy (const EtThumbnail *thumbnail)
+{
+    EtThumbnail *copy;
+
+    copy = g_slice_new0 (EtThumbnail);
+    copy->key = g_strdup (thumbnail->key);
+    copy->pixbuf = g_object_ref (thumbnail->pixbuf);
+    copy->width = thumbnail->width;
+    copy->height = thumbnail->height;
+
+    return copy;
+}
+
+static void
+et_thumbnail_request_free (EtThumbnailRequest *request)
+{
+    g_bytes_unref (request->bytes);
+    g_slice_free (EtThumbnailRequest, request);
+}
+
+/*
+ * memory_cache_lookup:
+ * @key: the cache key
+ *
+ * Look up @key in the memory cache, and mark the entry as the most recently
+ * used one.
+ *
+ * Returns: a copy of the cached thumbnail, or %NULL if it was not cached
+ */
+static EtThumbnail *
+memory_cache_lookup (const gchar *key)
+{
+    EtThumbnail *thumbnail;
+    EtThumbnail *result = NULL;
+
+    G_LOCK (memory_cache);
+
+    if (memory_cache
+        && (thumbnail = g_hash_table_lookup (memory_cache, key)) != NULL)
+    {
+        g_queue_unlink (&memory_cache_lru, thumbnail->link);
+        g_queue_push_head_link (&memory_cache_lru, thumbnail->link);
+        result = et_thumbnail_copy (thumbnail);
+    }
+
+    G_UNLOCK (memory_cache);
+
+    return result;
+}
+
+/*
+ * memory_cache_insert:
+ * @thumbnail: the thumbnail to cache
+ *
+ * Insert a copy of @thumbnail into the memory cache, evicting the least
+ * recently used entry if the cache is full.
+ */
+static void
+memory_cache_insert (const EtThumbnail *thumbnail)
+{
+    EtThumbnail *copy;
+
+    G_LOCK (memory_cache);
+
+    if (!memory_cache)
+    {
+        memory_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                              (GDestroyNotify)et_thumbnail_free);
+    }
+
+    /* Another worker may have decoded the same image in the meantime. */
+    if (!g_hash_table_contains (memory_cache, thumbnail->key))
+    {
+        copy = et_thumbnail_copy (thumbnail);
+        g_queue_push_head (&memory_cache_lru, copy);
+        copy->link = memory_cache_lru.head;
+        g_hash_table_insert (memory_cache, copy->key, copy);
+
+        while (g_queue_get_length (&memory_cache_lru)
+               > THUMBNAIL_MEMORY_CACHE_SIZE)
+        {
+            EtThumbnail *oldest = g_queue_pop_tail (&memory_cache_lru);
+
+            g_hash_table_remove (memory_cache, oldest->key);
+        }
+    }
+
+    G_UNLOCK (memory_cache);
+}
+
+static gchar *
+disk_cache_get_dirname (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), PACKAGE_TARNAME,
+                             "thumbnails", NULL);
+}
+
+static gchar *
+disk_cache_get_path (const gchar *key)
+{
+    gchar *dirname;
+    gchar *filename;
+    gchar *path;
+
+    dirname = disk_cache_get_dirname ();
+    filename = g_strconcat (key, ".png", NULL);
+    path = g_build_filename (dirname, filename, NULL);
+    g_free (filename);
+    g_free (dirname);
+
+    return path;
+}
+
+static void
+et_thumbnail_file_free (EtThumbnailFile *file)
+{
+    g_free (file->path);
+    g_slice_free (EtThumbnailFile, file);
+}
+
+static gint
+et_thumbnail_file_compare_mtime (gconstpointer a,
+                                 gconstpointer b)
+{
+    const EtThumbnailFile *file1 = a;
+    const EtThumbnailFile *file2 = b;
+
+    return (file1->mtime > file2->mtime) - (file1->mtime < file2->mtime);
+}
+
+/*
+ * disk_cache_prune:
+ *
+ * Remove the thumbnails which were not used for longer than
+ * %THUMBNAIL_DISK_CACHE_MAX_AGE, and then the least recently used thumbnails
+ * until the total size of the disk cache is below
+ * %THUMBNAIL_DISK_CACHE_MAX_SIZE. Only files written by disk_cache_insert()
+ * are considered.
+ */
+static void
+disk_cache_prune (void)
+{
+    gchar *dirname;
+    GDir *dir;
+    const gchar *name;
+    const gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+    GList *files = NULL;
+    GList *l;
+    goffset total_size = 0;
+
+    dirname = disk_cache_get_dirname ();
+
+    if ((dir = g_dir_open (dirname, 0, NULL)) == NULL)
+    {
+        g_free (dirname);
+        return;
+    }
+
+    while ((name = g_dir_read_name (dir)) != NULL)
+    {
+        gchar *path;
+        GStatBuf statbuf;
+        EtThumbnailFile *file;
+
+        if (!g_str_has_suffix (name, ".png"))
+        {
+            continue;
+        }
+
+        path = g_build_filename (dirname, name, NULL);
+
+        if (g_stat (path, &statbuf) != 0 || !S_ISREG (statbuf.st_mode))
+        {
+            g_free (path);
+            continue;
+        }
+
+        if (now - (gint64)statbuf.st_mtime >= THUMBNAIL_DISK_CACHE_MAX_AGE)
+        {
+            g_unlink (path);
+            g_free (path);
+            continue;
+        }
+
+        file = g_slice_new (EtThumbnailFile);
+        file->path = path;
+        file->size = statbuf.st_size;
+        file->mtime = statbuf.st_mtime;
+        files = g_list_prepend (files, file);
+        total_size += file->size;
+    }
+
+    g_dir_close (dir);
+    g_free (dirname);
+
+    files = g_list_sort (files, et_thumbnail_file_compare_mtime);
+
+    for (l = files; l != NULL && total_size > THUMBNAIL_DISK_CACHE_MAX_SIZE;
+         l = g_list_next (l))
+    {
+        const EtThumbnailFile *file = l->data;
+
+        if (g_unlink (file->path) == 0)
+        {
+            total_size -= file->size;
+        }
+    }
+
+    g_list_free_full (files, (GDestroyNotify)et_thumbnail_file_free);
+}
+
+/*
+ * disk_cache_lookup:
+ * @key: the cache key
+ *
+ * Load a thumbnail which was previously saved by disk_cache_insert().
+ *
+ * Returns: the thumbnail, or %NULL if it was not cached or could not be read
+ */
+static EtThumbnail *
+disk_cache_lookup (const gchar *key)
+{
+    gchar *path;
+    GdkPixbuf *pixbuf;
+    const gchar *width;
+    const gchar *height;
+    EtThumbnail *thumbnail;
+
+    path = disk_cache_get_path (key);
+    pixbuf = gdk_pixbuf_new_from_file (path, NULL);
+
+    if (!pixbuf)
+    {
+        g_free (path);
+        return NULL;
+    }
+
+    /* Mark the thumbnail as recently used, so that it is pruned last. */
+    g_utime (path, NULL);
+    g_free (path);
+
+    width = gdk_pixbuf_get_option (pixbuf, THUMBNAIL_KEY_WIDTH);
+    height = gdk_pixbuf_get_option (pixbuf, THUMBNAIL_KEY_HEIGHT);
+
+    if (!width || !height)
+    {
+        /* Not written by EasyTAG, so ignore it. */
+        g_object_unref (pixbuf);
+        return NULL;
+    }
+
+    thumbnail = g_slice_new0 (EtThumbnail);
+    thumbnail->key = g_strdup (key);
+    thumbnail->pixbuf = pixbuf;
+    thumbnail->width = atoi (width);
+    thumbnail->height = atoi (height);
+
+    return thumbnail;
+}
+
+/*
+ * disk_cache_insert:
+ * @thumbnail: the thumbnail to save
+ *
+ * Save @thumbnail to the user cache directory. Failures are not fatal, as the
+ * thumbnail can always be generated again from the image data. The disk cache
+ * is pruned before the first thumbnail is saved, and then every
+ * %THUMBNAIL_DISK_CACHE_PRUNE_INTERVAL thumbnails.
+ */
+static void
+disk_cache_insert (const EtThumbnail *thumbnail)
+{
+    gchar *path;
+    gchar *dirname;
+    gchar *width;
+    gchar *height;
+    gchar *buffer;
+    gsize buffer_size;
+    GError *error = NULL;
+
+    if (g_atomic_int_add (&disk_cache_n_saved, 1)
+        % THUMBNAIL_DISK_CACHE_PRUNE_INTERVAL == 0
+        && G_TRYLOCK (disk_cache_prune))
+    {
+        disk_cache_prune ();
+        G_UNLOCK (disk_cache_prune);
+    }
+
+    path = disk_cache_get_path (thumbnail->key);
+    dirname = g_path_get_dirname (path);
+
+    if (g_mkdir_with_parents (dirname, S_IRWXU) == -1)
+    {
+        g_debug ("Unable to create thumbnail cache directory ‘%s’", dirname);
+        goto out;
+    }
+
+    width = g_strdup_printf ("%d", thumbnail->width);
+    height = g_strdup_printf ("%d", thumbnail->height);
+
+    if (!gdk_pixbuf_save_to_buffer (thumbnail->pixbuf, &buffer, &buffer_size,
+                                    "png", &error, THUMBNAIL_KEY_WIDTH, width,
+                                    THUMBNAIL_KEY_HEIGHT, height, NULL))
+    {
+        g_debug ("Error encoding thumbnail: %s", error->message);
+        g_error_free (error);
+        g_free (width);
+        g_free (height);
+        goto out;
+    }
+
+    g_free (width);
+    g_free (height);
+
+    /* Written atomically, so that concurrent readers never see a partial
+     * image. */
+    if (!g_file_set_contents (path, buffer, buffer_size, &error))
+    {
+        g_debug ("Error saving thumbnail: %s", error->message);
+        g_error_free (error);
+    }
+
+    g_free (buffer);
+
+out:
+    g_free (dirname);
+    g_free (path);
+}
+
+/*
+ * thumbnail_decode:
+ * @request: the image data and the requested thumbnail size
+ * @key: the cache key for the thumbnail
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Decode the image data and scale it, keeping the aspect ratio, so that the
+ * longest side is @request->size scaled by @request->scale_factor.
+ *
+ * Returns: the new thumbnail, or %NULL on error
+ */
+static EtThumbnail *
+thumbnail_decode (const EtThumbnailRequest *request,
+                  const gchar *key,
+                  GCancellable *cancellable,
+                  GError **error)
+{
+    GdkPixbufLoader *loader;
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+    gint scaled_width;
+    gint scaled_height;
+    EtThumbnail *thumbnail;
+
+    loader = gdk_pixbuf_loader_new ();
+
+    if (!gdk_pixbuf_loader_write_bytes (loader, request->bytes, error))
+    {
+        gdk_pixbuf_loader_close (loader, NULL);
+        g_object_unref (loader);
+        return NULL;
+    }
+
+    if (!gdk_pixbuf_loader_close (loader, error))
+    {
+        g_object_unref (loader);
+        return NULL;
+    }
+
+    pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+
+    if (!pixbuf)
+    {
+        g_object_unref (loader);
+        g_set_error_literal (error, GDK_PIXBUF_ERROR,
+                             GDK_PIXBUF_ERROR_CORRUPT_IMAGE,
+                             _("Not enough data has been read to determine how to create the image buffer."));
+        return NULL;
+    }
+
+    g_object_ref (pixbuf);
+    g_object_unref (loader);
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+        g_object_unref (pixbuf);
+        return NULL;
+    }
+
+    /* Keep aspect ratio of the picture. */
+    width = gdk_pixbuf_get_width (pixbuf);
+    height = gdk_pixbuf_get_height (pixbuf);
+
+    if (width > height)
+    {
+        scaled_width = request->size * request->scale_factor;
+        scaled_height = MAX (1, request->size * request->scale_factor * height
+                                / width);
+    }
+    else
+    {
+        scaled_width = MAX (1, request->size * request->scale_factor * width
+                               / height);
+        scaled_height = request->size * request->scale_factor;
+    }
+
+    thumbnail = g_slice_new0 (EtThumbnail);
+    thumbnail->key = g_strdup (key);
+    thumbnail->pixbuf = gdk_pixbuf_scale_simple (pixbuf, scaled_width,
+                                                 scaled_height,
+                                                 GDK_INTERP_BILINEAR);
+    thumbnail->width = width;
+    thumbnail->height = height;
+    g_object_unref (pixbuf);
+
+    return thumbnail;
+}
+
+static void
+thumbnail_load_thread (GTask *task,
+                       gpointer source_object,
+                       gpointer task_data,
+                       GCancellable *cancellable)
+{
+    const EtThumbnailRequest *request = task_data;
+    gchar *checksum;
+    gchar *key;
+    EtThumbnail *thumbnail;
+    GError *error = NULL;
+
+    /* The content hash means that the same cover, embedded in every file of
+     * an album, is only decoded once. */
+    checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, request->bytes);
+    key = g_strdup_printf ("%s-%d@%d", checksum, request->size,
+                           request->scale_factor);
+    g_free (checksum);
+
+    if ((thumbnail = memory_cache_lookup (key)) != NULL)
+    {
+        goto out;
+    }
+
+    if ((thumbnail = disk_cache_lookup (key)) != NULL)
+    {
+        memory_cache_insert (thumbnail);
+        goto out;
+    }
+
+    if (g_task_return_error_if_cancelled (task))
+    {
+        g_free (key);
+        return;
+    }
+
+    thumbnail = thumbnail_decode (request, key, cancellable, &error);
+
+    if (!thumbnail)
+    {
+        g_free (key);
+        g_task_return_error (task, error);
+        return;
+    }
+
+    memory_cache_insert (thumbnail);
+    disk_cache_insert (thumbnail);
+
+out:
+    g_free (key);
+    g_task_return_pointer (task, thumbnail, (GDestroyNotify)et_thumbnail_free);
+}
+
+/*
+ * et_picture_thumbnail_load_async:
+ * @pic: the picture to generate a thumbnail for
+ * @size: size of the longest side of the thumbnail, in logical pixels
+ * @scale_factor: scale factor of the widget which will display the thumbnail
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: callback to call when the thumbnail is ready
+ * @user_data: user data to pass to @callback
+ *
+ * Decode and scale the image data of @pic in a worker thread. Thumbnails are
+ * cached in memory and on disk, keyed by the checksum of the image data,
+ * @size and @scale_factor.
+ */
+void
+et_picture_thumbnail_load_async (const EtPicture *pic,
+                                 gint size,
+                                 gint scale_factor,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+    GTask *task;
+    EtThumbnailRequest *request;
+
+    g_return_if_fail (pic != NULL && pic->bytes != NULL);
+    g_return_if_fail (size > 0 && scale_factor > 0);
+
+    request = g_slice_new (EtThumbnailRequest);
+    request->bytes = g_bytes_ref (pic->bytes);
+    request->size = size;
+    request->scale_factor = scale_factor;
+
+    task = g_task_new (NULL, cancellable, callback, user_data);
+    g_task_set_source_tag (task, et_picture_thumbnail_load_async);
+    g_task_set_task_data (task, request,
+                          (GDestroyNotify)et_thumbnail_request_free);
+    /* Do not wait for a decode in progress when the user moves on. */
+    g_task_set_return_on_cancel (task, TRUE);
+    g_task_run_in_thread (task, thumbnail_load_thread);
+    g_object_unref (task);
+}
+
+/*
+ * et_picture_thumbnail_load_finish:
+ * @result: the #GAsyncResult passed to the callback
+ * @width: location to store the width of the original image, or %NULL
+ * @height: location to store the height of the original image, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Finish an operation started with et_picture_thumbnail_load_async().
+ *
+ * Returns: (transfer full): the scaled image, or %NULL on error
+ */
+GdkPixbuf *
+et_picture_thumbnail_load_finish (GAsyncResult *result,
+                                  gint *width,
+                                  gint *height,
+                                  GError **error)
+{
+    EtThumbnail *thumbnail;
+    GdkPixbuf *pixbuf;
+
+    g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+    g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+    thumbnail = g_task_propagate_pointer (G_TASK (result), error);
+
+    if (!thumbnail)
+    {
+        return NULL;
+    }
+
+    if (width)
+    {
+        *width = thumbnail->width;
+    }
+
+    if (height)
+    {
+        *height = thumbnail->height;
+    }
+
+    pixbuf = g_object_ref (thumbnail->pixbuf);
+    et_thumbnail_free (thumbnail);
+
+    return pixbuf;
+}
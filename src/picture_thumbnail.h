@@ -0,0 +1,33 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PICTURE_THUMBNAIL_H_
+#define ET_PICTURE_THUMBNAIL_H_
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+G_BEGIN_DECLS
+
+#include "picture.h"
+
+void et_picture_thumbnail_load_async (const EtPicture *pic, gint size, gint scale_factor, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GdkPixbuf * et_picture_thumbnail_load_finish (GAsyncResult *result, gint *width, gint *height, GError **error);
+
+G_END_DECLS
+
+#endif /* !ET_PICTURE_THUMBNAIL_H_ */
@@ -0,0 +1,528 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "playlist.h"
+
+#include <string.h>
+
+#include "charset.h"
+
+/* Size of the buffer of the stream to which a playlist is written. */
+#define PLAYLIST_BUFFER_SIZE (1 << 16)
+
+/*
+ * EtPlaylistEntry:
+ * @filename: the filename of the file, in the GLib filename encoding
+ * @filename_utf8: the filename of the file in UTF-8, only kept when the
+ *                 information is generated from a mask
+ * @file_tag: a copy of the fields of the tag which the mask references, only
+ *            kept when the information is generated from a mask
+ * @duration: the duration of the file, in seconds
+ */
+typedef struct
+{
+    gchar *filename;
+    gchar *filename_utf8;
+    File_Tag *file_tag;
+    gint duration;
+} EtPlaylistEntry;
+
+/*
+ * EtPlaylist:
+ * @filename: the filename of the playlist, in the GLib filename encoding
+ * @entries: an array of #EtPlaylistEntry, in playlist order
+ */
+typedef struct
+{
+    gchar *filename;
+    GArray *entries;
+} EtPlaylist;
+
+struct _EtPlaylistBatch
+{
+    EtPlaylistContent content;
+    EtScanMask *mask;
+    gboolean relative;
+    gboolean dos_separator;
+    GPtrArray *playlists;
+};
+
+static void
+et_playlist_entry_clear (EtPlaylistEntry *entry)
+{
+    g_free (entry->filename);
+    g_free (entry->filename_utf8);
+
+    if (entry->file_tag)
+    {
+        et_file_tag_free (entry->file_tag);
+    }
+}
+
+static void
+et_playlist_free (EtPlaylist *playlist)
+{
+    g_free (playlist->filename);
+    g_array_free (playlist->entries, TRUE);
+    g_slice_free (EtPlaylist, playlist);
+}
+
+/*
+ * et_playlist_batch_new:
+ * @content: the content to write for each file
+ * @mask: (transfer full) (allow-none): a rename file mask to generate the
+ *        extended information from, if @content is
+ *        %ET_PLAYLIST_CONTENT_EXTENDED_MASK
+ * @relative: whether to write the paths of the files relative to the
+ *            playlist, skipping files outside of the directory of the playlist
+ * @dos_separator: whether to write paths with backslashes as separators
+ *
+ * Create an empty batch of playlists, with the options for all of them.
+ *
+ * Returns: a new batch, to be freed with et_playlist_batch_free()
+ */
+EtPlaylistBatch *
+et_playlist_batch_new (EtPlaylistContent content,
+                       EtScanMask *mask,
+                       gboolean relative,
+                       gboolean dos_separator)
+{
+    EtPlaylistBatch *batch;
+
+    g_return_val_if_fail (content != ET_PLAYLIST_CONTENT_EXTENDED_MASK
+                          || mask != NULL, NULL);
+
+    batch = g_slice_new (EtPlaylistBatch);
+    batch->content = content;
+    batch->mask = mask;
+    batch->relative = relative;
+    batch->dos_separator = dos_separator;
+    batch->playlists = g_ptr_array_new_with_free_func ((GDestroyNotify)et_playlist_free);
+
+    return batch;
+}
+
+/*
+ * et_playlist_batch_free:
+ * @batch: (allow-none): a batch, or %NULL
+ *
+ * Free the batch, and the copies of the data of its files.
+ */
+void
+et_playlist_batch_free (EtPlaylistBatch *batch)
+{
+    if (batch == NULL)
+    {
+        return;
+    }
+
+    if (batch->mask)
+    {
+        et_scan_mask_free (batch->mask);
+    }
+
+    g_ptr_array_unref (batch->playlists);
+    g_slice_free (EtPlaylistBatch, batch);
+}
+
+/*
+ * et_playlist_batch_add_playlist:
+ * @batch: a batch
+ * @filename: the filename of the playlist, in the GLib filename encoding
+ *
+ * Add an empty playlist to the batch.
+ *
+ * Returns: the index of the playlist, to add files to it
+ */
+guint
+et_playlist_batch_add_playlist (EtPlaylistBatch *batch,
+                                const gchar *filename)
+{
+    EtPlaylist *playlist;
+
+    g_return_val_if_fail (batch != NULL, 0);
+    g_return_val_if_fail (filename != NULL, 0);
+
+    playlist = g_slice_new (EtPlaylist);
+    playlist->filename = g_strdup (filename);
+    playlist->entries = g_array_new (FALSE, FALSE, sizeof (EtPlaylistEntry));
+    g_array_set_clear_func (playlist->entries,
+                            (GDestroyNotify)et_playlist_entry_clear);
+    g_ptr_array_add (batch->playlists, playlist);
+
+    return batch->playlists->len - 1;
+}
+
+/*
+ * et_playlist_batch_add_file:
+ * @batch: a batch
+ * @playlist: the index of the playlist to add the file to
+ * @filename: the filename of the file, in the GLib filename encoding
+ * @filename_utf8: the filename of the file, in UTF-8
+ * @file_tag: the tag of the file
+ * @duration: the duration of the file, in seconds
+ *
+ * Add a file to the end of a playlist. The UTF-8 filename, and the fields of
+ * the tag which the mask references, are only copied if they are needed to
+ * generate the extended information.
+ */
+void
+et_playlist_batch_add_file (EtPlaylistBatch *batch,
+                            guint playlist,
+                            const gchar *filename,
+                            const gchar *filename_utf8,
+                            const File_Tag *file_tag,
+                            gint duration)
+{
+    EtPlaylist *list;
+    EtPlaylistEntry entry;
+
+    g_return_if_fail (batch != NULL);
+    g_return_if_fail (playlist < batch->playlists->len);
+    g_return_if_fail (filename != NULL);
+
+    list = g_ptr_array_index (batch->playlists, playlist);
+
+    entry.filename = g_strdup (filename);
+    entry.duration = duration;
+
+    if (batch->content == ET_PLAYLIST_CONTENT_EXTENDED_MASK)
+    {
+        g_return_if_fail (filename_utf8 != NULL && file_tag != NULL);
+
+        entry.filename_utf8 = g_strdup (filename_utf8);
+        entry.file_tag = et_file_tag_new ();
+        et_scan_mask_copy_fields (batch->mask, entry.file_tag, file_tag);
+    }
+    else
+    {
+        entry.filename_utf8 = NULL;
+        entry.file_tag = NULL;
+    }
+
+    g_array_append_val (list->entries, entry);
+}
+
+/*
+ * et_playlist_batch_get_n_playlists:
+ * @batch: a batch
+ *
+ * Returns: the number of playlists in the batch
+ */
+guint
+et_playlist_batch_get_n_playlists (const EtPlaylistBatch *batch)
+{
+    g_return_val_if_fail (batch != NULL, 0);
+
+    return batch->playlists->len;
+}
+
+/*
+ * et_playlist_batch_get_filename:
+ * @batch: a batch
+ * @playlist: the index of a playlist
+ *
+ * Returns: the filename of the playlist, in the GLib filename encoding
+ */
+const gchar *
+et_playlist_batch_get_filename (const EtPlaylistBatch *batch,
+                                guint playlist)
+{
+    g_return_val_if_fail (batch != NULL, NULL);
+    g_return_val_if_fail (playlist < batch->playlists->len, NULL);
+
+    return ((EtPlaylist *)g_ptr_array_index (batch->playlists,
+                                             playlist))->filename;
+}
+
+/*
+ * get_relative_path:
+ * @filename: the filename of a file
+ * @basedir: the directory of the playlist
+ * @basedir_length: the length of @basedir, without a trailing separator
+ *
+ * Returns: the path of @filename relative to @basedir, pointing into
+ *          @filename, or %NULL if the file is not inside @basedir
+ */
+static const gchar *
+get_relative_path (const gchar *filename,
+                   const gchar *basedir,
+                   gsize basedir_length)
+{
+    if (strncmp (filename, basedir, basedir_length) != 0
+        || filename[basedir_length] != G_DIR_SEPARATOR)
+    {
+        return NULL;
+    }
+
+    return filename + basedir_length + 1;
+}
+
+/*
+ * append_entry:
+ * @batch: a batch
+ * @entry: the entry to write
+ * @path: the path of the file to write
+ * @line: the string to append the lines to
+ *
+ * Append the lines for a file, in the GLib filename encoding and with DOS
+ * line endings.
+ */
+static void
+append_entry (const EtPlaylistBatch *batch,
+              const EtPlaylistEntry *entry,
+              const gchar *path,
+              GString *line)
+{
+    gsize path_start;
+
+    switch (batch->content)
+    {
+        case ET_PLAYLIST_CONTENT_FILENAMES:
+            /* No header written. */
+            break;
+        case ET_PLAYLIST_CONTENT_EXTENDED:
+        {
+            /* Header has extended information. */
+            const gchar *basename = strrchr (entry->filename, G_DIR_SEPARATOR);
+
+            g_string_append_printf (line, "#EXTINF:%d,%s\r\n",
+                                    entry->duration,
+                                    basename ? basename + 1 : entry->filename);
+            break;
+        }
+        case ET_PLAYLIST_CONTENT_EXTENDED_MASK:
+        {
+            /* Header uses information generated from a mask. */
+            gchar *generated_utf8;
+            gchar *generated;
+
+            generated_utf8 = et_scan_mask_rename_file (batch->mask,
+                                                       entry->file_tag,
+                                                       entry->filename_utf8);
+            generated = filename_from_display (generated_utf8);
+            g_string_append_printf (line, "#EXTINF:%d,%s\r\n",
+                                    entry->duration,
+                                    generated ? generated : generated_utf8);
+            g_free (generated);
+            g_free (generated_utf8);
+            break;
+        }
+        default:
+            g_assert_not_reached ();
+            break;
+    }
+
+    path_start = line->len;
+    g_string_append (line, path);
+
+    if (batch->dos_separator)
+    {
+        gsize i;
+
+        for (i = path_start; i < line->len; i++)
+        {
+            if (line->str[i] == '/')
+            {
+                line->str[i] = '\\';
+            }
+        }
+    }
+
+    g_string_append (line, "\r\n");
+}
+
+/*
+ * write_playlist:
+ * @batch: a batch
+ * @playlist: the playlist to write
+ * @line: a string to format the lines into
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Write a playlist through a buffered stream. On failure, the previous
+ * contents of the playlist file are kept.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set on failure
+ */
+static gboolean
+write_playlist (const EtPlaylistBatch *batch,
+                const EtPlaylist *playlist,
+                GString *line,
+                GCancellable *cancellable,
+                GError **error)
+{
+    GFile *file;
+    GFileOutputStream *file_ostream;
+    GOutputStream *ostream;
+    gchar *basedir;
+    gsize basedir_length;
+    gboolean success = TRUE;
+    guint i;
+
+    file = g_file_new_for_path (playlist->filename);
+    file_ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE,
+                                   cancellable, error);
+    g_object_unref (file);
+
+    if (!file_ostream)
+    {
+        return FALSE;
+    }
+
+    ostream = g_buffered_output_stream_new_sized (G_OUTPUT_STREAM (file_ostream),
+                                                  PLAYLIST_BUFFER_SIZE);
+
+    /* 'base directory' where is located the playlist. Used also to write file
+     * with a relative path for file located in this directory and
+     * sub-directories. */
+    basedir = g_path_get_dirname (playlist->filename);
+    basedir_length = strlen (basedir);
+
+    if (basedir_length > 0 && basedir[basedir_length - 1] == G_DIR_SEPARATOR)
+    {
+        basedir_length--;
+    }
+
+    g_string_truncate (line, 0);
+
+    /* First line of the file (if playlist content is not set to "write only
+     * list of files"). */
+    if (batch->content != ET_PLAYLIST_CONTENT_FILENAMES)
+    {
+        g_string_append (line, "#EXTM3U\r\n");
+    }
+
+    for (i = 0; success && i < playlist->entries->len; i++)
+    {
+        const EtPlaylistEntry *entry;
+        const gchar *path;
+
+        entry = &g_array_index (playlist->entries, EtPlaylistEntry, i);
+
+        if (batch->relative)
+        {
+            /* Keep only files in this directory and sub-directories. */
+            path = get_relative_path (entry->filename, basedir,
+                                      basedir_length);
+
+            if (path == NULL)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            path = entry->filename;
+        }
+
+        append_entry (batch, entry, path, line);
+
+        /* The buffered stream batches the writes, so only flush the formatted
+         * lines once they fill a good part of it. */
+        if (line->len >= PLAYLIST_BUFFER_SIZE / 4)
+        {
+            success = g_output_stream_write_all (ostream, line->str,
+                                                 line->len, NULL, cancellable,
+                                                 error);
+            g_string_truncate (line, 0);
+        }
+    }
+
+    if (success)
+    {
+        success = g_output_stream_write_all (ostream, line->str, line->len,
+                                             NULL, cancellable, error)
+                  && g_output_stream_close (ostream, cancellable, error);
+    }
+
+    if (!success)
+    {
+        GCancellable *close_cancellable;
+
+        /* Closing a cancelled replacement leaves the original file. */
+        close_cancellable = g_cancellable_new ();
+        g_cancellable_cancel (close_cancellable);
+        g_output_stream_close (G_OUTPUT_STREAM (file_ostream),
+                               close_cancellable, NULL);
+        g_object_unref (close_cancellable);
+    }
+
+    g_free (basedir);
+    g_object_unref (ostream);
+    g_object_unref (file_ostream);
+
+    return success;
+}
+
+/*
+ * et_playlist_batch_write:
+ * @batch: a batch
+ * @cancellable: (allow-none): a #GCancellable, or %NULL
+ * @progress: (allow-none): a function to call after each playlist is
+ *            written, or %NULL
+ * @user_data: user data to pass to @progress
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Write all the playlists of the batch, in the order in which they were
+ * added, and stop at the first playlist which cannot be written. The batch
+ * only reads the copies of the file data, so this can be called from a
+ * worker thread.
+ *
+ * Returns: %TRUE on success, %FALSE and with @error set on failure
+ */
+gboolean
+et_playlist_batch_write (EtPlaylistBatch *batch,
+                         GCancellable *cancellable,
+                         EtPlaylistProgressFunc progress,
+                         gpointer user_data,
+                         GError **error)
+{
+    GString *line;
+    gboolean success = TRUE;
+    guint i;
+
+    g_return_val_if_fail (batch != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    line = g_string_sized_new (PLAYLIST_BUFFER_SIZE / 4 + 1024);
+
+    for (i = 0; success && i < batch->playlists->len; i++)
+    {
+        const EtPlaylist *playlist = g_ptr_array_index (batch->playlists, i);
+
+        if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+            success = FALSE;
+            break;
+        }
+
+        success = write_playlist (batch, playlist, line, cancellable, error);
+
+        if (success && progress)
+        {
+            progress (i + 1, batch->playlists->len, user_data);
+        }
+    }
+
+    g_string_free (line, TRUE);
+
+    return success;
+}
@@ -0,0 +1,61 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PLAYLIST_H_
+#define ET_PLAYLIST_H_
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#include "file_tag.h"
+#include "scan_mask.h"
+#include "setting.h"
+
+/*
+ * EtPlaylistBatch:
+ *
+ * A batch of playlists, which are filled in on the main thread with copies of
+ * the data needed from each file, and can then be written in a worker thread.
+ */
+typedef struct _EtPlaylistBatch EtPlaylistBatch;
+
+/*
+ * EtPlaylistProgressFunc:
+ * @n_written: the number of playlists written so far
+ * @n_playlists: the number of playlists in the batch
+ * @user_data: user data passed to et_playlist_batch_write()
+ *
+ * Called after each playlist is written, from the thread which writes the
+ * batch.
+ */
+typedef void (*EtPlaylistProgressFunc) (guint n_written, guint n_playlists, gpointer user_data);
+
+EtPlaylistBatch * et_playlist_batch_new (EtPlaylistContent content, EtScanMask *mask, gboolean relative, gboolean dos_separator);
+void et_playlist_batch_free (EtPlaylistBatch *batch);
+
+guint et_playlist_batch_add_playlist (EtPlaylistBatch *batch, const gchar *filename);
+void et_playlist_batch_add_file (EtPlaylistBatch *batch, guint playlist, const gchar *filename, const gchar *filename_utf8, const File_Tag *file_tag, gint duration);
+guint et_playlist_batch_get_n_playlists (const EtPlaylistBatch *batch);
+const gchar * et_playlist_batch_get_filename (const EtPlaylistBatch *batch, guint playlist);
+
+gboolean et_playlist_batch_write (EtPlaylistBatch *batch, GCancellable *cancellable, EtPlaylistProgressFunc progress, gpointer user_data, GError **error);
+
+G_END_DECLS
+
+#endif /* !ET_PLAYLIST_H_ */
@@ -28,6 +28,7 @@
 #include "easytag.h"
 #include "misc.h"
 #include "picture.h"
+#include "playlist.h"
 #include "scan.h"
 #include "scan_dialog.h"
 #include "setting.h"
@@ -44,376 +45,373 @@ typedef struct
     GtkWidget *content_extended_radio;
     GtkWidget *content_extended_mask_radio;
     GtkWidget *content_mask_entry;
+    GtkWidget *playlist_each_check;
+
+    gboolean writing;
+    guint n_playlists;
+    gint n_written;
+    gint progress_pending;
 } EtPlaylistDialogPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (EtPlaylistDialog, et_playlist_dialog, GTK_TYPE_DIALOG)
 
 /*
- * Function to replace UNIX ForwardSlash with a DOS BackSlash
+ * get_playlist_basename_utf8:
+ * @name_mask: (allow-none): the compiled playlist name mask, or %NULL to name
+ *             the playlist after its directory
+ * @convert_mode: the conversion of spaces to apply to a generated name
+ * @etfile: the file to generate the name from, if @name_mask is not %NULL
+ * @path_utf8: the directory of the files in the playlist
+ *
+ * Returns: the name of the playlist, without the extension, in UTF-8
  */
-static void
-convert_forwardslash_to_backslash (const gchar *string)
+static gchar *
+get_playlist_basename_utf8 (const EtScanMask *name_mask,
+                            EtConvertSpaces convert_mode,
+                            const ET_File *etfile,
+                            const gchar *path_utf8)
 {
-    gchar *tmp;
+    gchar *basename_utf8;
 
-    while ((tmp = strchr (string,'/')) != NULL)
+    if (name_mask)
     {
-        *tmp = '\\';
+        /* Generate filename from tag of the file. */
+        basename_utf8 = et_scan_mask_rename_file (name_mask,
+                                                  etfile->FileTag->data,
+                                                  ((File_Name *)etfile->FileNameCur->data)->value_utf8);
+
+        /* Replace Characters (with scanner). */
+        switch (convert_mode)
+        {
+            case ET_CONVERT_SPACES_SPACES:
+                Scan_Convert_Underscore_Into_Space (basename_utf8);
+                Scan_Convert_P20_Into_Space (basename_utf8);
+                break;
+            case ET_CONVERT_SPACES_UNDERSCORES:
+                Scan_Convert_Space_Into_Underscore (basename_utf8);
+                break;
+            case ET_CONVERT_SPACES_REMOVE:
+                Scan_Remove_Spaces (basename_utf8);
+                break;
+            /* FIXME: Check that this is intended. */
+            case ET_CONVERT_SPACES_NO_CHANGE:
+            default:
+                g_assert_not_reached ();
+                break;
+        }
+    }
+    else /* PLAYLIST_USE_DIR_NAME */
+    {
+        if (strcmp (path_utf8, G_DIR_SEPARATOR_S) == 0)
+        {
+            basename_utf8 = g_strdup ("playlist");
+        }
+        else
+        {
+            gchar *tmp_string = g_strdup (path_utf8);
+            gsize length = strlen (tmp_string);
+
+            /* Remove last '/'. */
+            if (tmp_string[length - 1] == G_DIR_SEPARATOR)
+            {
+                tmp_string[length - 1] = '\0';
+            }
+
+            /* Get directory name. */
+            basename_utf8 = g_path_get_basename (tmp_string);
+            g_free (tmp_string);
+        }
     }
+
+    return basename_utf8;
 }
 
 /*
- * Write a playlist
- *  - 'playlist_name' in file system encoding (not UTF-8)
+ * get_playlist_name_utf8:
+ * @path_utf8: the directory of the files in the playlist
+ * @basename_utf8: the name of the playlist, without the extension
+ *
+ * Returns: the path and filename of the playlist, in UTF-8
  */
+static gchar *
+get_playlist_name_utf8 (const gchar *path_utf8,
+                        const gchar *basename_utf8)
+{
+    gchar *playlist_path_utf8;
+    gchar *playlist_name_utf8;
+
+    /* Path of the playlist file (may be truncated if the playlist is created
+     * in the parent directory). */
+    playlist_path_utf8 = g_strdup (path_utf8);
+
+    /* Must be done after building the playlist filename, as the path can be
+     * truncated! */
+    if (g_settings_get_boolean (MainSettings, "playlist-parent-directory"))
+    {
+        if (strcmp (playlist_path_utf8, G_DIR_SEPARATOR_S) != 0)
+        {
+            gchar *tmp;
+
+            /* Remove last '/'. */
+            if (playlist_path_utf8[strlen (playlist_path_utf8) - 1] == G_DIR_SEPARATOR)
+            {
+                playlist_path_utf8[strlen (playlist_path_utf8) - 1] = '\0';
+            }
+
+            /* Get parent directory. */
+            if ((tmp = strrchr (playlist_path_utf8, G_DIR_SEPARATOR)) != NULL)
+            {
+                *(tmp + 1) = '\0';
+            }
+        }
+    }
+
+    /* Generate path + filename of playlist. */
+    if (playlist_path_utf8[strlen (playlist_path_utf8) - 1] == G_DIR_SEPARATOR)
+    {
+        playlist_name_utf8 = g_strconcat (playlist_path_utf8, basename_utf8,
+                                          ".m3u", NULL);
+    }
+    else
+    {
+        playlist_name_utf8 = g_strconcat (playlist_path_utf8,
+                                          G_DIR_SEPARATOR_S, basename_utf8,
+                                          ".m3u", NULL);
+    }
+
+    g_free (playlist_path_utf8);
+
+    return playlist_name_utf8;
+}
+
+/*
+ * add_playlist:
+ * @batch: the batch to add the playlist to
+ * @playlists: a table of the indices of the playlists in @batch, plus one,
+ *             keyed by the UTF-8 names of the playlists
+ * @playlist_name_utf8: (transfer full): the path and filename of the playlist
+ *
+ * Returns: the index of the playlist in @batch, which is only added if it is
+ *          not yet in @playlists
+ */
+static guint
+add_playlist (EtPlaylistBatch *batch,
+              GHashTable *playlists,
+              gchar *playlist_name_utf8)
+{
+    guint index;
+    gchar *playlist_name;
+
+    index = GPOINTER_TO_UINT (g_hash_table_lookup (playlists,
+                                                   playlist_name_utf8));
+
+    if (index > 0)
+    {
+        g_free (playlist_name_utf8);
+        return index - 1;
+    }
+
+    playlist_name = filename_from_display (playlist_name_utf8);
+    index = et_playlist_batch_add_playlist (batch, playlist_name);
+    g_free (playlist_name);
+    g_hash_table_insert (playlists, playlist_name_utf8,
+                         GUINT_TO_POINTER (index + 1));
+
+    return index;
+}
+
 static gboolean
-write_playlist (EtPlaylistDialog *self, GFile *file, GError **error)
+on_write_progress_idle (gpointer user_data)
 {
+    EtPlaylistDialog *self;
     EtPlaylistDialogPrivate *priv;
-    GFile *parent;
-    GFileOutputStream *ostream;
-    GString *to_write;
-    GList *l;
-    GList *etfilelist = NULL;
-    gchar *basedir;
-    gchar *temp;
-    EtPlaylistContent playlist_content;
-
-    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+    gint n_written;
+    gchar progress_bar_text[30];
 
+    self = ET_PLAYLIST_DIALOG (user_data);
     priv = et_playlist_dialog_get_instance_private (self);
 
-    ostream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+    g_atomic_int_set (&priv->progress_pending, FALSE);
 
-    if (!ostream)
+    /* The playlists may have been written before the update was run. */
+    if (!priv->writing)
     {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
+        return G_SOURCE_REMOVE;
     }
 
-    /* 'base directory' where is located the playlist. Used also to write file with a
-     * relative path for file located in this directory and sub-directories
-     */
-    parent = g_file_get_parent (file);
-    basedir = g_file_get_path (parent);
-    g_object_unref (parent);
+    n_written = g_atomic_int_get (&priv->n_written);
 
-    playlist_content = g_settings_get_enum (MainSettings, "playlist-content");
+    et_application_window_progress_set_fraction (ET_APPLICATION_WINDOW (MainWindow),
+                                                 n_written / (gdouble)priv->n_playlists);
+    g_snprintf (progress_bar_text, sizeof (progress_bar_text), "%d/%u",
+                n_written, priv->n_playlists);
+    et_application_window_progress_set_text (ET_APPLICATION_WINDOW (MainWindow),
+                                             progress_bar_text);
 
-    /* 1) First line of the file (if playlist content is not set to "write only
-     * list of files") */
-    if (playlist_content != ET_PLAYLIST_CONTENT_FILENAMES)
-    {
-        gsize bytes_written;
+    return G_SOURCE_REMOVE;
+}
 
-        to_write = g_string_new ("#EXTM3U\r\n");
+/*
+ * on_playlist_written:
+ * @n_written: the number of playlists written so far
+ * @n_playlists: the number of playlists to write
+ * @user_data: the playlist dialog
+ *
+ * Called from the worker thread after each playlist is written. The progress
+ * bar is updated from the main loop, with at most one update pending.
+ */
+static void
+on_playlist_written (guint n_written,
+                     guint n_playlists,
+                     gpointer user_data)
+{
+    EtPlaylistDialog *self;
+    EtPlaylistDialogPrivate *priv;
 
-        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                        to_write->str, to_write->len,
-                                        &bytes_written, NULL, error))
-        {
-            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
-                     "bytes of data were written", bytes_written,
-                     to_write->len);
-            g_assert (error == NULL || *error != NULL);
-            g_string_free (to_write, TRUE);
-            g_object_unref (ostream);
-            return FALSE;
-        }
-        g_string_free (to_write, TRUE);
+    self = ET_PLAYLIST_DIALOG (user_data);
+    priv = et_playlist_dialog_get_instance_private (self);
+
+    g_atomic_int_set (&priv->n_written, n_written);
+
+    if (g_atomic_int_compare_and_exchange (&priv->progress_pending, FALSE,
+                                           TRUE))
+    {
+        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, on_write_progress_idle,
+                         g_object_ref (self), g_object_unref);
     }
+}
 
-    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+static void
+write_playlists_thread_func (GTask *task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable *cancellable)
+{
+    GError *error = NULL;
+
+    if (et_playlist_batch_write (task_data, cancellable, on_playlist_written,
+                                 source_object, &error))
     {
-        etfilelist = et_application_window_browser_get_selected_files (ET_APPLICATION_WINDOW (MainWindow));
+        g_task_return_boolean (task, TRUE);
     }
     else
     {
-        etfilelist = ETCore->ETFileList;
+        g_task_return_error (task, error);
     }
+}
 
-    for (l = etfilelist; l != NULL; l = g_list_next (l))
-    {
-        const ET_File *etfile;
-        const gchar *filename;
-        gint duration;
+static void
+on_playlists_written (GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+    EtPlaylistDialog *self;
+    EtPlaylistDialogPrivate *priv;
+    const EtPlaylistBatch *batch;
+    guint n_playlists;
+    GError *error = NULL;
 
-        etfile = (ET_File *)l->data;
-        filename = ((File_Name *)etfile->FileNameCur->data)->value;
-        duration = ((ET_File_Info *)etfile->ETFileInfo)->duration;
+    self = ET_PLAYLIST_DIALOG (source_object);
+    priv = et_playlist_dialog_get_instance_private (self);
+    batch = g_task_get_task_data (G_TASK (result));
+    n_playlists = et_playlist_batch_get_n_playlists (batch);
+
+    priv->writing = FALSE;
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (self), GTK_RESPONSE_OK,
+                                       TRUE);
+    et_application_window_progress_set_text (ET_APPLICATION_WINDOW (MainWindow),
+                                             "");
+    et_application_window_progress_set_fraction (ET_APPLICATION_WINDOW (MainWindow),
+                                                 0.0);
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
+    {
+        GtkWidget *msgdialog;
+        gchar *playlist_name_utf8;
+        guint failed;
+
+        /* The playlists are written in order, so the first one which was not
+         * written is the one which failed. */
+        failed = MIN ((guint)g_atomic_int_get (&priv->n_written),
+                      n_playlists - 1);
+        playlist_name_utf8 = g_filename_display_name (et_playlist_batch_get_filename (batch,
+                                                                                      failed));
+
+        /* Writing fails... */
+        msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
+                                            GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                                            GTK_MESSAGE_ERROR,
+                                            GTK_BUTTONS_CLOSE,
+                                            _("Cannot write playlist file ‘%s’"),
+                                            playlist_name_utf8);
+        gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
+                                                  "%s", error->message);
+        gtk_window_set_title (GTK_WINDOW (msgdialog), _("Playlist File Error"));
+
+        gtk_dialog_run (GTK_DIALOG (msgdialog));
+        gtk_widget_destroy (msgdialog);
+        g_free (playlist_name_utf8);
+        g_error_free (error);
+    }
+    else
+    {
+        gchar *msg;
 
-        if (g_settings_get_boolean (MainSettings, "playlist-relative"))
+        if (n_playlists == 1)
         {
-            // Keep only files in this directory and sub-dirs
-            if ( strncmp(filename,basedir,strlen(basedir))==0 )
-            {
-                gsize bytes_written;
-
-                /* 2) Write the header. */
-                switch (playlist_content)
-                {
-                    case ET_PLAYLIST_CONTENT_FILENAMES:
-                        /* No header written. */
-                        break;
-                    case ET_PLAYLIST_CONTENT_EXTENDED:
-                        /* Header has extended information. */
-                        temp = g_path_get_basename (filename);
-                        to_write = g_string_new ("#EXTINF:");
-                        /* Must be written in system encoding (not UTF-8). */
-                        g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                                temp);
-
-                        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                        to_write->str,
-                                                        to_write->len,
-                                                        &bytes_written, NULL,
-                                                        error))
-                        {
-                            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                     G_GSIZE_FORMAT "bytes of data were written",
-                                     bytes_written, to_write->len);
-                            g_assert (error == NULL || *error != NULL);
-                            g_string_free (to_write, TRUE);
-                            g_object_unref (ostream);
-                            return FALSE;
-                        }
-                        g_string_free (to_write, TRUE);
-                        g_free (temp);
-                        break;
-                    case ET_PLAYLIST_CONTENT_EXTENDED_MASK:
-                    {
-                        /* Header uses information generated from a mask. */
-                        gchar *mask = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
-                        /* Special case: do not replace illegal characters and
-                         * do not check if there is a directory separator in
-                         * the mask. */
-                        gchar *filename_generated_utf8 = et_scan_generate_new_filename_from_mask (etfile, mask, TRUE);
-                        gchar *filename_generated = filename_from_display (filename_generated_utf8);
-
-                        to_write = g_string_new ("#EXTINF:");
-                        /* Must be written in system encoding (not UTF-8). */
-                        g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                                filename_generated);
-
-                        if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                        to_write->str,
-                                                        to_write->len,
-                                                        &bytes_written, NULL,
-                                                        error))
-                        {
-                            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                     G_GSIZE_FORMAT "bytes of data were written",
-                                     bytes_written, to_write->len);
-                            g_assert (error == NULL || *error != NULL);
-                            g_string_free (to_write, TRUE);
-                            g_object_unref (ostream);
-                            return FALSE;
-                        }
-                        g_string_free (to_write, TRUE);
-                        g_free (mask);
-                        g_free (filename_generated_utf8);
-
-                        break;
-                    }
-                    default:
-                        g_assert_not_reached ();
-                        break;
-                }
-
-                /* 3) Write the file path. */
-                if (g_settings_get_boolean (MainSettings,
-                                            "playlist-dos-separator"))
-                {
-                    gchar *filename_conv = g_strdup(filename+strlen(basedir)+1);
-                    convert_forwardslash_to_backslash (filename_conv);
-
-                    to_write = g_string_new (filename_conv);
-                    /* Must be written in system encoding (not UTF-8)*/
-                    to_write = g_string_append (to_write, "\r\n");
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str,
-                                                    to_write->len,
-                                                    &bytes_written, NULL,
-                                                    error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT "bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    g_free(filename_conv);
-                }else
-                {
-                    to_write = g_string_new (filename+strlen(basedir)+1);
-                    /* Must be written in system encoding (not UTF-8)*/
-                    to_write = g_string_append (to_write, "\r\n");
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str,
-                                                    to_write->len,
-                                                    &bytes_written, NULL,
-                                                    error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT "bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                }
-            }
+            gchar *playlist_name_utf8;
+
+            playlist_name_utf8 = g_filename_display_name (et_playlist_batch_get_filename (batch,
+                                                                                          0));
+            msg = g_strdup_printf (_("Wrote playlist file ‘%s’"),
+                                   playlist_name_utf8);
+            g_free (playlist_name_utf8);
         }
-        else /* !ETSettings:playlist-relative */
+        else
         {
-            gsize bytes_written;
-
-            /* 2) Write the header. */
-            switch (playlist_content)
-            {
-                case ET_PLAYLIST_CONTENT_FILENAMES:
-                    /* No header written. */
-                    break;
-                case ET_PLAYLIST_CONTENT_EXTENDED:
-                    /* Header has extended information. */
-                    temp = g_path_get_basename (filename);
-                    to_write = g_string_new ("#EXTINF:");
-                    /* Must be written in system encoding (not UTF-8). */
-                    g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                            temp);
-                    g_free (temp);
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str, to_write->len,
-                                                    &bytes_written, NULL, error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT" bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    break;
-                case ET_PLAYLIST_CONTENT_EXTENDED_MASK:
-                {
-                    /* Header uses information generated from a mask. */
-                    gchar *mask = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
-                    /* Special case: do not replace illegal characters and
-                     * do not check if there is a directory separator in
-                     * the mask. */
-                    gchar *filename_generated_utf8 = et_scan_generate_new_filename_from_mask (etfile, mask, TRUE);
-                    gchar *filename_generated = filename_from_display (filename_generated_utf8);
-
-                    to_write = g_string_new ("#EXTINF:");
-                    /* Must be written in system encoding (not UTF-8). */
-                    g_string_append_printf (to_write, "%d,%s\r\n", duration,
-                                            filename_generated);
-                    g_free (filename_generated);
-
-                    if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                    to_write->str, to_write->len,
-                                                    &bytes_written, NULL, error))
-                    {
-                        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                                 G_GSIZE_FORMAT" bytes of data were written",
-                                 bytes_written, to_write->len);
-                        g_assert (error == NULL || *error != NULL);
-                        g_string_free (to_write, TRUE);
-                        g_object_unref (ostream);
-                        return FALSE;
-                    }
-                    g_string_free (to_write, TRUE);
-                    g_free (mask);
-                    g_free (filename_generated_utf8);
-                }
-                break;
-                default:
-                    g_assert_not_reached ();
-                    break;
-            }
-
-            /* 3) Write the file path. */
-            if (g_settings_get_boolean (MainSettings,
-                                        "playlist-dos-separator"))
-            {
-                gchar *filename_conv = g_strdup(filename);
-                convert_forwardslash_to_backslash(filename_conv);
-
-                to_write = g_string_new (filename_conv);
-                /* Must be written in system encoding (not UTF-8)*/
-                to_write = g_string_append (to_write, "\r\n");
-
-                if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                to_write->str, to_write->len,
-                                                &bytes_written, NULL, error))
-                {
-                    g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                             G_GSIZE_FORMAT" bytes of data were written",
-                             bytes_written, to_write->len);
-                    g_assert (error == NULL || *error != NULL);
-                    g_string_free (to_write, TRUE);
-                    g_object_unref (ostream);
-                    return FALSE;
-                }
-                g_string_free (to_write, TRUE);
-                g_free(filename_conv);
-            }else
-            {
-                to_write = g_string_new (filename);
-                /* Must be written in system encoding (not UTF-8)*/
-                to_write = g_string_append (to_write, "\r\n");
-
-                if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
-                                                to_write->str, to_write->len,
-                                                &bytes_written, NULL, error))
-                {
-                    g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %"
-                             G_GSIZE_FORMAT" bytes of data were written",
-                             bytes_written, to_write->len);
-                    g_assert (error == NULL || *error != NULL);
-                    g_string_free (to_write, TRUE);
-                    g_object_unref (ostream);
-                    return FALSE;
-                }
-                g_string_free (to_write, TRUE);
-            }
+            msg = g_strdup_printf (ngettext ("Wrote %u playlist file",
+                                             "Wrote %u playlist files",
+                                             n_playlists),
+                                   n_playlists);
         }
-    }
 
-    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
-    {
-        g_list_free (etfilelist);
+        et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
+                                                  msg, TRUE);
+        g_free (msg);
     }
-
-    g_assert (error == NULL || *error == NULL);
-    g_object_unref (ostream);
-    g_free(basedir);
-    return TRUE;
 }
 
+/*
+ * write_button_clicked:
+ * @self: the playlist dialog
+ *
+ * Collect the files of the playlist, or of one playlist per directory, and
+ * write the playlists in a worker thread.
+ */
 static void
 write_button_clicked (EtPlaylistDialog *self)
 {
     EtPlaylistDialogPrivate *priv;
-    gchar *playlist_name = NULL;
-    gchar *playlist_path_utf8;      // Path
-    gchar *playlist_basename_utf8;  // Filename
-    gchar *playlist_name_utf8;      // Path + filename
-    gchar *temp;
-    GtkWidget *msgdialog;
+    EtPlaylistContent playlist_content;
+    EtConvertSpaces convert_mode;
+    gboolean replace_illegal;
+    EtScanMask *name_mask = NULL;
+    EtScanMask *content_mask = NULL;
+    EtPlaylistBatch *batch;
+    GHashTable *playlists;
+    GList *etfilelist;
+    GList *l;
+    gboolean each_directory;
+    guint index = 0;
+    GTask *task;
 
     priv = et_playlist_dialog_get_instance_private (self);
 
+    if (priv->writing)
+    {
+        return;
+    }
+
     /* Check if playlist name was filled. */
     if (g_settings_get_boolean (MainSettings, "playlist-use-mask")
         && *(gtk_entry_get_text (GTK_ENTRY (priv->name_mask_entry))) == '\0')
@@ -422,133 +420,141 @@ write_button_clicked (EtPlaylistDialog *self)
         g_settings_set_boolean (MainSettings, "playlist-use-mask", FALSE);
     }
 
-    // Path of the playlist file (may be truncated later if PLAYLIST_CREATE_IN_PARENT_DIR is TRUE)
-    temp = g_file_get_path (et_application_window_get_current_path (ET_APPLICATION_WINDOW (MainWindow)));
-    playlist_path_utf8 = g_filename_display_name (temp);
-    g_free (temp);
+    convert_mode = g_settings_get_enum (MainSettings, "rename-convert-spaces");
+    replace_illegal = g_settings_get_boolean (MainSettings,
+                                              "rename-replace-illegal-chars");
 
     /* Build the playlist filename. */
     if (g_settings_get_boolean (MainSettings, "playlist-use-mask"))
     {
-        EtConvertSpaces convert_mode;
+        gchar *playlist_mask;
+        gchar *temp;
 
         if (!ETCore->ETFileList)
             return;
 
-        playlist_name = g_settings_get_string (MainSettings,
+        playlist_mask = g_settings_get_string (MainSettings,
                                                "playlist-filename-mask");
-
-        /* Generate filename from tag of the current selected file (FIXME). */
-        temp = filename_from_display (playlist_name);
-        g_free (playlist_name);
-        playlist_basename_utf8 = et_scan_generate_new_filename_from_mask (ETCore->ETFileDisplayed,
-                                                                          temp,
-                                                                          FALSE);
+        temp = filename_from_display (playlist_mask);
+        g_free (playlist_mask);
+        name_mask = et_scan_mask_new_rename_file (temp, FALSE, convert_mode,
+                                                  replace_illegal);
         g_free (temp);
+    }
 
-        /* Replace Characters (with scanner). */
-        convert_mode = g_settings_get_enum (MainSettings,
-                                            "rename-convert-spaces");
+    playlist_content = g_settings_get_enum (MainSettings, "playlist-content");
 
-        switch (convert_mode)
-        {
-            case ET_CONVERT_SPACES_SPACES:
-                Scan_Convert_Underscore_Into_Space (playlist_basename_utf8);
-                Scan_Convert_P20_Into_Space (playlist_basename_utf8);
-                break;
-            case ET_CONVERT_SPACES_UNDERSCORES:
-                Scan_Convert_Space_Into_Underscore (playlist_basename_utf8);
-                break;
-            case ET_CONVERT_SPACES_REMOVE:
-                Scan_Remove_Spaces (playlist_basename_utf8);
-                break;
-            /* FIXME: Check that this is intended. */
-            case ET_CONVERT_SPACES_NO_CHANGE:
-            default:
-                g_assert_not_reached ();
-                break;
-        }
-    }else // PLAYLIST_USE_DIR_NAME
+    if (playlist_content == ET_PLAYLIST_CONTENT_EXTENDED_MASK)
     {
+        gchar *mask;
+
+        /* Special case: do not replace illegal characters and do not check if
+         * there is a directory separator in the mask. */
+        mask = filename_from_display (gtk_entry_get_text (GTK_ENTRY (priv->content_mask_entry)));
+        content_mask = et_scan_mask_new_rename_file (mask, TRUE, convert_mode,
+                                                     replace_illegal);
+        g_free (mask);
+    }
 
-        if ( strcmp(playlist_path_utf8,G_DIR_SEPARATOR_S)==0 )
-        {
-            playlist_basename_utf8 = g_strdup("playlist");
-        }else
-        {
-            gchar *tmp_string = g_strdup(playlist_path_utf8);
-            // Remove last '/'
-            if (tmp_string[strlen(tmp_string)-1]==G_DIR_SEPARATOR)
-                tmp_string[strlen(tmp_string)-1] = '\0';
-            // Get directory name
-            temp = g_path_get_basename(tmp_string);
-            playlist_basename_utf8 = g_strdup(temp);
-            g_free(tmp_string);
-            g_free(temp);
-        }
+    batch = et_playlist_batch_new (playlist_content, content_mask,
+                                   g_settings_get_boolean (MainSettings,
+                                                           "playlist-relative"),
+                                   g_settings_get_boolean (MainSettings,
+                                                           "playlist-dos-separator"));
+    playlists = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    each_directory = g_settings_get_boolean (MainSettings,
+                                             "playlist-each-directory");
 
+    if (!each_directory)
+    {
+        gchar *temp;
+        gchar *path_utf8;
+        gchar *basename_utf8;
+
+        temp = g_file_get_path (et_application_window_get_current_path (ET_APPLICATION_WINDOW (MainWindow)));
+        path_utf8 = g_filename_display_name (temp);
+        g_free (temp);
+
+        /* Generate filename from tag of the current selected file (FIXME). */
+        basename_utf8 = get_playlist_basename_utf8 (name_mask, convert_mode,
+                                                    ETCore->ETFileDisplayed,
+                                                    path_utf8);
+        index = add_playlist (batch, playlists,
+                              get_playlist_name_utf8 (path_utf8,
+                                                      basename_utf8));
+        g_free (basename_utf8);
+        g_free (path_utf8);
     }
 
-    /* Must be placed after "Build the playlist filename", as we can truncate
-     * the path! */
-    if (g_settings_get_boolean (MainSettings, "playlist-parent-directory"))
+    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    {
+        etfilelist = et_application_window_browser_get_selected_files (ET_APPLICATION_WINDOW (MainWindow));
+    }
+    else
+    {
+        etfilelist = ETCore->ETFileList;
+    }
+
+    for (l = etfilelist; l != NULL; l = g_list_next (l))
     {
-        if ( (strcmp(playlist_path_utf8,G_DIR_SEPARATOR_S) != 0) )
+        const ET_File *etfile = l->data;
+        const File_Name *file_name = etfile->FileNameCur->data;
+
+        if (each_directory)
         {
-            gchar *tmp;
-            // Remove last '/'
-            if (playlist_path_utf8[strlen(playlist_path_utf8)-1]==G_DIR_SEPARATOR)
-                playlist_path_utf8[strlen(playlist_path_utf8)-1] = '\0';
-            // Get parent directory
-            if ( (tmp=strrchr(playlist_path_utf8,G_DIR_SEPARATOR)) != NULL )
-                *(tmp + 1) = '\0';
+            gchar *path_utf8;
+            gchar *basename_utf8;
+
+            /* One playlist per directory, or per distinct name generated from
+             * the mask, for example per album. */
+            path_utf8 = g_path_get_dirname (file_name->value_utf8);
+            basename_utf8 = get_playlist_basename_utf8 (name_mask,
+                                                        convert_mode, etfile,
+                                                        path_utf8);
+            index = add_playlist (batch, playlists,
+                                  get_playlist_name_utf8 (path_utf8,
+                                                          basename_utf8));
+            g_free (basename_utf8);
+            g_free (path_utf8);
         }
-    }
 
-    // Generate path + filename of playlist
-    if (playlist_path_utf8[strlen(playlist_path_utf8)-1]==G_DIR_SEPARATOR)
-        playlist_name_utf8 = g_strconcat(playlist_path_utf8,playlist_basename_utf8,".m3u",NULL);
-    else
-        playlist_name_utf8 = g_strconcat(playlist_path_utf8,G_DIR_SEPARATOR_S,playlist_basename_utf8,".m3u",NULL);
+        et_playlist_batch_add_file (batch, index, file_name->value,
+                                    file_name->value_utf8,
+                                    etfile->FileTag->data,
+                                    ((ET_File_Info *)etfile->ETFileInfo)->duration);
+    }
 
-    g_free(playlist_path_utf8);
-    g_free(playlist_basename_utf8);
+    if (g_settings_get_boolean (MainSettings, "playlist-selected-only"))
+    {
+        g_list_free (etfilelist);
+    }
 
-    playlist_name = filename_from_display(playlist_name_utf8);
+    g_hash_table_unref (playlists);
 
+    if (name_mask)
     {
-        GFile *file = g_file_new_for_path (playlist_name);
-        GError *error = NULL;
+        et_scan_mask_free (name_mask);
+    }
 
-        if (!write_playlist (self, file, &error))
-        {
-            // Writing fails...
-            msgdialog = gtk_message_dialog_new (GTK_WINDOW (self),
-                                               GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                               GTK_MESSAGE_ERROR,
-                                               GTK_BUTTONS_CLOSE,
-                                               _("Cannot write playlist file ‘%s’"),
-                                               playlist_name_utf8);
-            gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
-                                                      "%s", error->message);
-            gtk_window_set_title(GTK_WINDOW(msgdialog),_("Playlist File Error"));
-
-            gtk_dialog_run(GTK_DIALOG(msgdialog));
-            gtk_widget_destroy(msgdialog);
-            g_error_free (error);
-        }else
-        {
-            gchar *msg;
-            msg = g_strdup_printf (_("Wrote playlist file ‘%s’"),
-                                   playlist_name_utf8);
-            et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
-                                                      msg, TRUE);
-            g_free (msg);
-        }
-        g_object_unref (file);
+    if (et_playlist_batch_get_n_playlists (batch) == 0)
+    {
+        et_playlist_batch_free (batch);
+        return;
     }
-    g_free(playlist_name_utf8);
-    g_free(playlist_name);
+
+    priv->writing = TRUE;
+    priv->n_written = 0;
+    priv->n_playlists = et_playlist_batch_get_n_playlists (batch);
+
+    gtk_dialog_set_response_sensitive (GTK_DIALOG (self), GTK_RESPONSE_OK,
+                                       FALSE);
+    et_application_window_progress_set_fraction (ET_APPLICATION_WINDOW (MainWindow),
+                                                 0.0);
+
+    task = g_task_new (self, NULL, on_playlists_written, NULL);
+    g_task_set_task_data (task, batch, (GDestroyNotify)et_playlist_batch_free);
+    g_task_run_in_thread (task, write_playlists_thread_func);
+    g_object_unref (task);
 }
 
 /*
@@ -660,6 +666,11 @@ create_playlist_dialog (EtPlaylistDialog *self)
                      priv->playlist_parent_check, "active",
                      G_SETTINGS_BIND_DEFAULT);
 
+    /* One playlist for each directory. */
+    g_settings_bind (MainSettings, "playlist-each-directory",
+                     priv->playlist_each_check, "active",
+                     G_SETTINGS_BIND_DEFAULT);
+
     /* DOS Separator. */
     g_settings_bind (MainSettings, "playlist-dos-separator",
                      priv->playlist_dos_check, "active",
@@ -728,6 +739,9 @@ et_playlist_dialog_class_init (EtPlaylistDialogClass *klass)
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   playlist_parent_check);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPlaylistDialog,
+                                                  playlist_each_check);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPlaylistDialog,
                                                   playlist_dos_check);
@@ -44,6 +44,8 @@ typedef struct
     GtkWidget *browser_subdirs_check;
     GtkWidget *browser_expand_subdirs_check;
     GtkWidget *browser_hidden_check;
+    GtkWidget *browser_monitor_check;
+    GtkWidget *browser_prefetch_check;
     GtkWidget *browser_case_check;
     GtkWidget *log_show_check;
     GtkWidget *header_show_check;
@@ -118,6 +120,8 @@ typedef struct
     GtkWidget *cddb_manual_host_combo;
     GtkWidget *cddb_manual_port_button;
     GtkWidget *cddb_manual_path_entry;
+    GtkWidget *cddb_local_path_entry;
+    GtkWidget *cddb_cache_days_button;
     GtkWidget *cddb_follow_check;
     GtkWidget *cddb_dlm_check;
     GtkWidget *confirm_write_check;
@@ -297,6 +301,16 @@ create_preferences_dialog (EtPreferencesDialog *self)
                      priv->browser_hidden_check, "active",
                      G_SETTINGS_BIND_DEFAULT);
 
+    /* Monitor the file list for changes. */
+    g_settings_bind (MainSettings, "browse-monitor-changes",
+                     priv->browser_monitor_check, "active",
+                     G_SETTINGS_BIND_DEFAULT);
+
+    /* Read the neighbouring directories in the background. */
+    g_settings_bind (MainSettings, "browse-prefetch-siblings",
+                     priv->browser_prefetch_check, "active",
+                     G_SETTINGS_BIND_DEFAULT);
+
     g_settings_bind (MainSettings, "sort-case-sensitive",
                      priv->browser_case_check, "active",
                      G_SETTINGS_BIND_DEFAULT);
@@ -313,9 +327,6 @@ create_preferences_dialog (EtPreferencesDialog *self)
     /* Set "new" Gtk+-2.0ish black/bold style for changed items. */
     g_settings_bind (MainSettings, "file-changed-bold", priv->list_bold_radio,
                      "active", G_SETTINGS_BIND_DEFAULT);
-    g_signal_connect_swapped (priv->list_bold_radio, "notify::active",
-                              G_CALLBACK (et_application_window_browser_refresh_list),
-                              MainWindow);
 
     /*
      * File Settings
@@ -692,6 +703,16 @@ create_preferences_dialog (EtPreferencesDialog *self)
                      priv->cddb_manual_path_entry, "text",
                      G_SETTINGS_BIND_DEFAULT);
 
+    /* Local CDDB database. */
+    g_settings_bind (MainSettings, "cddb-local-path",
+                     priv->cddb_local_path_entry, "text",
+                     G_SETTINGS_BIND_DEFAULT);
+
+    /* Cache of CDDB server responses. */
+    g_settings_bind (MainSettings, "cddb-cache-days",
+                     priv->cddb_cache_days_button, "value",
+                     G_SETTINGS_BIND_DEFAULT);
+
     /* Track Name list (CDDB results). */
     g_settings_bind (MainSettings, "cddb-follow-file", priv->cddb_follow_check,
                      "active", G_SETTINGS_BIND_DEFAULT);
@@ -965,6 +986,12 @@ et_preferences_dialog_class_init (EtPreferencesDialogClass *klass)
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPreferencesDialog,
                                                   browser_hidden_check);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPreferencesDialog,
+                                                  browser_monitor_check);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPreferencesDialog,
+                                                  browser_prefetch_check);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPreferencesDialog,
                                                   browser_case_check);
@@ -1187,6 +1214,12 @@ et_preferences_dialog_class_init (EtPreferencesDialogClass *klass)
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPreferencesDialog,
                                                   cddb_manual_path_entry);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPreferencesDialog,
+                                                  cddb_local_path_entry);
+    gtk_widget_class_bind_template_child_private (widget_class,
+                                                  EtPreferencesDialog,
+                                                  cddb_cache_days_button);
     gtk_widget_class_bind_template_child_private (widget_class,
                                                   EtPreferencesDialog,
                                                   cddb_follow_check);
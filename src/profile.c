@@ -0,0 +1,549 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "profile.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif /* HAVE_MALLINFO2 */
+
+/* Size at which the buffered spans are appended to the trace file, so that
+ * the memory used by a long session stays bounded. */
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+/*
+ * EtProfileIO:
+ * @bytes_read: the number of bytes read by the process
+ * @bytes_written: the number of bytes written by the process
+ * @syscalls: the number of read and write system calls of the process
+ */
+typedef struct
+{
+    guint64 bytes_read;
+    guint64 bytes_written;
+    guint64 syscalls;
+} EtProfileIO;
+
+/*
+ * EtProfileOperation:
+ * @depth: the nesting level of operations, only the outermost is measured
+ * @name: the (interned) name of the operation
+ * @start: the monotonic time at the start of the operation
+ * @n_files: the number of files which were processed
+ * @phase_time: the total time spent in each phase, in microseconds
+ * @phase_calls: the number of spans of each phase
+ * @io: the I/O counters at the start of the operation
+ * @io_valid: whether the I/O counters are available
+ * @heap: the heap size at the start of the operation
+ */
+typedef struct
+{
+    guint depth;
+    const gchar *name;
+    gint64 start;
+    guint n_files;
+    gint64 phase_time[ET_PROFILE_N_PHASES];
+    guint phase_calls[ET_PROFILE_N_PHASES];
+    EtProfileIO io;
+    gboolean io_valid;
+    gsize heap;
+} EtProfileOperation;
+
+/* These names are used untranslated in the trace. */
+static const gchar * const phase_names[ET_PROFILE_N_PHASES] =
+{
+    N_("Directory enumeration"),
+    N_("Tag reading"),
+    N_("Header reading"),
+    N_("Undo generation"),
+    N_("Browser list insertion"),
+    N_("Tag writing"),
+    N_("Modification times"),
+    N_("Renaming")
+};
+
+static gboolean profile_enabled = FALSE;
+static gchar *trace_filename = NULL;
+static GMutex profile_mutex;
+static FILE *trace_file = NULL;
+static GString *trace_buffer = NULL;
+static guint trace_n_events = 0;
+static gchar *trace_error = NULL;
+static gboolean trace_error_reported = FALSE;
+static gint64 trace_epoch = 0;
+static gint n_threads = 0;
+static GPrivate thread_key;
+static EtProfileOperation operation;
+
+/*
+ * et_profile_init:
+ * @enabled: whether to time the phases of loading and saving files
+ * @trace: the filename to write a trace of the timed spans to, or %NULL
+ *
+ * Enable the timing of operations. A summary of each operation is returned by
+ * et_profile_operation_end(), and if @trace is set, every span is also written
+ * to it in the Chrome trace event format, for loading into chrome://tracing
+ * or a similar viewer. The spans are buffered, and appended to the file when
+ * the buffer is full and by et_profile_shutdown(). Passing a trace filename
+ * enables timing.
+ */
+void
+et_profile_init (gboolean enabled,
+                 const gchar *trace)
+{
+    profile_enabled = enabled || trace != NULL;
+
+    if (!profile_enabled)
+    {
+        return;
+    }
+
+    trace_epoch = g_get_monotonic_time ();
+
+    if (trace != NULL)
+    {
+        trace_file = g_fopen (trace, "wb");
+
+        if (trace_file == NULL)
+        {
+            g_warning ("Unable to write trace ‘%s’: %s", trace,
+                       g_strerror (errno));
+            return;
+        }
+
+        trace_filename = g_strdup (trace);
+        trace_buffer = g_string_sized_new (TRACE_BUFFER_SIZE + 256);
+        g_string_append (trace_buffer, "{\"traceEvents\":[\n");
+        trace_n_events = 0;
+    }
+}
+
+static guint
+get_thread_number (void)
+{
+    guint number;
+
+    number = GPOINTER_TO_UINT (g_private_get (&thread_key));
+
+    if (number == 0)
+    {
+        number = g_atomic_int_add (&n_threads, 1) + 1;
+        g_private_set (&thread_key, GUINT_TO_POINTER (number));
+    }
+
+    return number;
+}
+
+static void
+append_json_string (GString *json,
+                    const gchar *str)
+{
+    g_string_append_c (json, '"');
+
+    for (; *str != '\0'; str++)
+    {
+        const guchar c = *str;
+
+        if (c == '"' || c == '\\')
+        {
+            g_string_append_c (json, '\\');
+            g_string_append_c (json, c);
+        }
+        else if (c < 0x20)
+        {
+            g_string_append_printf (json, "\\u%04x", c);
+        }
+        else
+        {
+            g_string_append_c (json, c);
+        }
+    }
+
+    g_string_append_c (json, '"');
+}
+
+/* Must be called with the mutex held. After an error, the buffered spans are
+ * discarded, and the first error is kept to be reported. */
+static void
+flush_trace (void)
+{
+    if (trace_buffer->len > 0 && trace_error == NULL
+        && fwrite (trace_buffer->str, 1, trace_buffer->len, trace_file)
+           != trace_buffer->len)
+    {
+        trace_error = g_strdup (g_strerror (errno));
+    }
+
+    g_string_truncate (trace_buffer, 0);
+}
+
+/* Must be called with the mutex held. */
+static void
+add_trace_event (const gchar *name,
+                 gint64 start,
+                 gint64 duration)
+{
+    if (trace_buffer == NULL)
+    {
+        return;
+    }
+
+    if (trace_n_events++ > 0)
+    {
+        g_string_append (trace_buffer, ",\n");
+    }
+
+    g_string_append (trace_buffer, "{\"name\":");
+    append_json_string (trace_buffer, name);
+    g_string_append_printf (trace_buffer,
+                            ",\"cat\":\"" PACKAGE_TARNAME "\",\"ph\":\"X\","
+                            "\"ts\":%" G_GINT64_FORMAT ","
+                            "\"dur\":%" G_GINT64_FORMAT ","
+                            "\"pid\":1,\"tid\":%u}",
+                            start - trace_epoch, duration,
+                            get_thread_number ());
+
+    if (trace_buffer->len >= TRACE_BUFFER_SIZE)
+    {
+        flush_trace ();
+    }
+}
+
+/*
+ * et_profile_shutdown:
+ *
+ * Append the rest of the trace, if one was requested, and release the memory
+ * used for timing.
+ */
+void
+et_profile_shutdown (void)
+{
+    g_mutex_lock (&profile_mutex);
+
+    if (trace_buffer != NULL)
+    {
+        g_string_append (trace_buffer, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        flush_trace ();
+
+        if (fclose (trace_file) != 0 && trace_error == NULL)
+        {
+            trace_error = g_strdup (g_strerror (errno));
+        }
+
+        if (trace_error != NULL)
+        {
+            g_warning ("Unable to write trace ‘%s’: %s", trace_filename,
+                       trace_error);
+        }
+
+        trace_file = NULL;
+        g_string_free (trace_buffer, TRUE);
+        trace_buffer = NULL;
+        g_clear_pointer (&trace_error, g_free);
+        trace_error_reported = FALSE;
+    }
+
+    g_clear_pointer (&trace_filename, g_free);
+    profile_enabled = FALSE;
+
+    g_mutex_unlock (&profile_mutex);
+}
+
+/*
+ * read_io_counters:
+ * @io: the counters to fill
+ *
+ * Read the I/O counters of the process, which are only available on Linux.
+ *
+ * Returns: %TRUE if the counters could be read, %FALSE otherwise
+ */
+static gboolean
+read_io_counters (EtProfileIO *io)
+{
+    gchar *contents;
+    gchar **lines;
+    gsize i;
+    guint found = 0;
+
+    if (!g_file_get_contents ("/proc/self/io", &contents, NULL, NULL))
+    {
+        return FALSE;
+    }
+
+    memset (io, 0, sizeof (*io));
+    lines = g_strsplit (contents, "\n", -1);
+
+    for (i = 0; lines[i] != NULL; i++)
+    {
+        const gchar *value = strchr (lines[i], ':');
+        guint64 number;
+
+        if (value == NULL)
+        {
+            continue;
+        }
+
+        number = g_ascii_strtoull (value + 1, NULL, 10);
+
+        if (g_str_has_prefix (lines[i], "rchar:"))
+        {
+            io->bytes_read = number;
+            found++;
+        }
+        else if (g_str_has_prefix (lines[i], "wchar:"))
+        {
+            io->bytes_written = number;
+            found++;
+        }
+        else if (g_str_has_prefix (lines[i], "syscr:")
+                 || g_str_has_prefix (lines[i], "syscw:"))
+        {
+            io->syscalls += number;
+            found++;
+        }
+    }
+
+    g_strfreev (lines);
+    g_free (contents);
+
+    return found == 4;
+}
+
+static gsize
+get_heap_size (void)
+{
+#ifdef HAVE_MALLINFO2
+    return mallinfo2 ().uordblks;
+#else /* !HAVE_MALLINFO2 */
+    return 0;
+#endif /* !HAVE_MALLINFO2 */
+}
+
+/*
+ * et_profile_operation_begin:
+ * @name: the name of the operation, to show in the summary
+ *
+ * Start timing an operation, such as reading a directory. Operations which
+ * are started while another is in progress are part of the outer operation.
+ */
+void
+et_profile_operation_begin (const gchar *name)
+{
+    g_return_if_fail (name != NULL);
+
+    if (!profile_enabled)
+    {
+        return;
+    }
+
+    g_mutex_lock (&profile_mutex);
+
+    if (operation.depth++ == 0)
+    {
+        memset (operation.phase_time, 0, sizeof (operation.phase_time));
+        memset (operation.phase_calls, 0, sizeof (operation.phase_calls));
+        operation.name = g_intern_string (name);
+        operation.n_files = 0;
+        operation.io_valid = read_io_counters (&operation.io);
+        operation.heap = get_heap_size ();
+        operation.start = g_get_monotonic_time ();
+    }
+
+    g_mutex_unlock (&profile_mutex);
+}
+
+/*
+ * et_profile_operation_end:
+ *
+ * Finish timing the operation started with et_profile_operation_begin().
+ *
+ * Returns: the lines of a summary of the operation, to be freed with
+ * g_strfreev(), or %NULL if timing is disabled or an outer operation is still
+ * in progress
+ */
+gchar **
+et_profile_operation_end (void)
+{
+    gint64 duration;
+    GPtrArray *lines;
+    EtProfileIO io;
+    gsize i;
+
+    if (!profile_enabled)
+    {
+        return NULL;
+    }
+
+    duration = g_get_monotonic_time ();
+
+    g_mutex_lock (&profile_mutex);
+
+    g_warn_if_fail (operation.depth > 0);
+
+    if (operation.depth == 0 || --operation.depth > 0)
+    {
+        g_mutex_unlock (&profile_mutex);
+        return NULL;
+    }
+
+    duration -= operation.start;
+    add_trace_event (operation.name, operation.start, duration);
+
+    lines = g_ptr_array_new ();
+    g_ptr_array_add (lines,
+                     g_strdup_printf (ngettext ("Timing of ‘%s’: %u file in %.3f seconds",
+                                                "Timing of ‘%s’: %u files in %.3f seconds",
+                                                operation.n_files),
+                                      operation.name, operation.n_files,
+                                      duration / (gdouble)G_USEC_PER_SEC));
+
+    for (i = 0; i < ET_PROFILE_N_PHASES; i++)
+    {
+        if (operation.phase_calls[i] == 0)
+        {
+            continue;
+        }
+
+        g_ptr_array_add (lines,
+                         g_strdup_printf (ngettext ("%s: %.3f seconds in %u call (%.0f%%)",
+                                                    "%s: %.3f seconds in %u calls (%.0f%%)",
+                                                    operation.phase_calls[i]),
+                                          _(phase_names[i]),
+                                          operation.phase_time[i]
+                                          / (gdouble)G_USEC_PER_SEC,
+                                          operation.phase_calls[i],
+                                          100.0 * operation.phase_time[i]
+                                          / MAX (duration, 1)));
+    }
+
+    if (operation.io_valid && read_io_counters (&io))
+    {
+        gchar *read_size;
+        gchar *written_size;
+
+        read_size = g_format_size (io.bytes_read - operation.io.bytes_read);
+        written_size = g_format_size (io.bytes_written
+                                      - operation.io.bytes_written);
+        g_ptr_array_add (lines,
+                         g_strdup_printf (_("Read %s and wrote %s in %" G_GUINT64_FORMAT " system calls"),
+                                          read_size, written_size,
+                                          io.syscalls - operation.io.syscalls));
+        g_free (written_size);
+        g_free (read_size);
+    }
+
+#ifdef HAVE_MALLINFO2
+    {
+        const gsize heap = get_heap_size ();
+        gchar *heap_size;
+
+        /* Only growth is interesting, as the heap may shrink when the previous
+         * file list is freed. */
+        heap_size = g_format_size (heap > operation.heap ? heap - operation.heap
+                                                         : 0);
+        g_ptr_array_add (lines, g_strdup_printf (_("Heap grew by %s"),
+                                                 heap_size));
+        g_free (heap_size);
+    }
+#endif /* HAVE_MALLINFO2 */
+
+    /* Only report the first error, rather than after every operation. */
+    if (trace_error != NULL && !trace_error_reported)
+    {
+        g_ptr_array_add (lines,
+                         g_strdup_printf (_("Unable to write trace ‘%s’: %s"),
+                                          trace_filename, trace_error));
+        trace_error_reported = TRUE;
+    }
+
+    g_mutex_unlock (&profile_mutex);
+
+    g_ptr_array_add (lines, NULL);
+
+    return (gchar **)g_ptr_array_free (lines, FALSE);
+}
+
+/*
+ * et_profile_span_begin:
+ *
+ * Start timing a span of a phase, to be finished with et_profile_span_end().
+ *
+ * Returns: the time at the start of the span, or 0 if timing is disabled
+ */
+gint64
+et_profile_span_begin (void)
+{
+    return profile_enabled ? g_get_monotonic_time () : 0;
+}
+
+/*
+ * et_profile_span_end:
+ * @phase: the phase which the span belongs to
+ * @start: the value returned from et_profile_span_begin()
+ *
+ * Finish timing a span, and add its time to the current operation.
+ */
+void
+et_profile_span_end (EtProfilePhase phase,
+                     gint64 start)
+{
+    gint64 duration;
+
+    g_return_if_fail (phase < ET_PROFILE_N_PHASES);
+
+    if (!profile_enabled || start == 0)
+    {
+        return;
+    }
+
+    duration = g_get_monotonic_time () - start;
+
+    g_mutex_lock (&profile_mutex);
+
+    operation.phase_time[phase] += duration;
+    operation.phase_calls[phase]++;
+    add_trace_event (phase_names[phase], start, duration);
+
+    g_mutex_unlock (&profile_mutex);
+}
+
+/*
+ * et_profile_count_file:
+ *
+ * Count a file as processed by the current operation.
+ */
+void
+et_profile_count_file (void)
+{
+    if (!profile_enabled)
+    {
+        return;
+    }
+
+    g_mutex_lock (&profile_mutex);
+    operation.n_files++;
+    g_mutex_unlock (&profile_mutex);
+}
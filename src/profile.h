@@ -0,0 +1,64 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_PROFILE_H_
+#define ET_PROFILE_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * EtProfilePhase:
+ * @ET_PROFILE_PHASE_ENUMERATE: enumerating the files of a directory
+ * @ET_PROFILE_PHASE_READ_TAG: reading the tag of a file
+ * @ET_PROFILE_PHASE_READ_HEADER: reading the audio properties of a file
+ * @ET_PROFILE_PHASE_UNDO: generating the initial undo data of a file
+ * @ET_PROFILE_PHASE_BROWSER_FILL: inserting files into the browser list
+ * @ET_PROFILE_PHASE_WRITE_TAG: writing the tag of a file
+ * @ET_PROFILE_PHASE_TIMESTAMPS: preserving and updating modification times
+ * @ET_PROFILE_PHASE_RENAME: renaming a file
+ *
+ * The phases of loading and saving files which are timed separately.
+ */
+typedef enum
+{
+    ET_PROFILE_PHASE_ENUMERATE,
+    ET_PROFILE_PHASE_READ_TAG,
+    ET_PROFILE_PHASE_READ_HEADER,
+    ET_PROFILE_PHASE_UNDO,
+    ET_PROFILE_PHASE_BROWSER_FILL,
+    ET_PROFILE_PHASE_WRITE_TAG,
+    ET_PROFILE_PHASE_TIMESTAMPS,
+    ET_PROFILE_PHASE_RENAME,
+    ET_PROFILE_N_PHASES
+} EtProfilePhase;
+
+void et_profile_init (gboolean enabled, const gchar *trace);
+void et_profile_shutdown (void);
+
+void et_profile_operation_begin (const gchar *name);
+gchar ** et_profile_operation_end (void);
+
+gint64 et_profile_span_begin (void);
+void et_profile_span_end (EtProfilePhase phase, gint64 start);
+void et_profile_count_file (void);
+
+G_END_DECLS
+
+#endif /* !ET_PROFILE_H_ */
@@ -0,0 +1,725 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "rename_plan.h"
+
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+/*
+ * EtRename:
+ * @old_filepath: the current path of the file
+ * @new_filepath: the path to rename the file to
+ * @next: index of the rename which moves the file at @new_filepath away, or
+ *        -1 if there is none
+ * @has_previous: whether another rename moves a file to @old_filepath
+ * @visited: whether the rename was already assigned to a chain
+ */
+typedef struct
+{
+    gchar *old_filepath;
+    gchar *new_filepath;
+    gint next;
+    gboolean has_previous;
+    gboolean visited;
+} EtRename;
+
+struct _EtRenamePlan
+{
+    GArray *renames;
+};
+
+/*
+ * EtRenameStep:
+ * @from: path to move from, or %NULL to move the temporary file of the chain
+ * @to: path to move to, or a template if @to_temporary is set
+ * @to_temporary: whether @to is a temporary file which must be created first
+ */
+typedef struct
+{
+    gchar *from;
+    gchar *to;
+    gboolean to_temporary;
+} EtRenameStep;
+
+/*
+ * EtRenameChain:
+ * @steps: the #EtRenameStep to execute in order, which depend on each other
+ * @n_done: the number of steps that were executed successfully
+ *
+ * A sequence of renames, where each rename moves a file to the old path of
+ * the file moved by the previous step. Chains are independent of each other.
+ */
+typedef struct
+{
+    GArray *steps;
+    guint n_done;
+} EtRenameChain;
+
+/*
+ * EtRenameExecution:
+ * @failed: set to non-zero when a chain failed, so that the others stop
+ * @lock: protects @error
+ * @error: the first error
+ */
+typedef struct
+{
+    volatile gint failed;
+    GMutex lock;
+    GError *error;
+} EtRenameExecution;
+
+/*
+ * et_rename_plan_new:
+ *
+ * Create a new, empty, rename plan.
+ *
+ * Returns: a new #EtRenamePlan, free with et_rename_plan_free()
+ */
+EtRenamePlan *
+et_rename_plan_new (void)
+{
+    EtRenamePlan *plan;
+
+    plan = g_slice_new (EtRenamePlan);
+    plan->renames = g_array_new (FALSE, FALSE, sizeof (EtRename));
+
+    return plan;
+}
+
+/*
+ * et_rename_plan_add:
+ * @plan: the plan to add the rename to
+ * @old_filepath: the current path of the file, in the GLib filename encoding
+ * @new_filepath: the path to rename the file to, in the GLib filename
+ *                encoding
+ *
+ * Add a rename to @plan. @new_filepath may be the current path of another
+ * file which is renamed by the same plan.
+ */
+void
+et_rename_plan_add (EtRenamePlan *plan,
+                    const gchar *old_filepath,
+                    const gchar *new_filepath)
+{
+    EtRename entry;
+
+    g_return_if_fail (plan != NULL);
+    g_return_if_fail (old_filepath != NULL && new_filepath != NULL);
+
+    /* Nothing to do. */
+    if (strcmp (old_filepath, new_filepath) == 0)
+    {
+        return;
+    }
+
+    entry.old_filepath = g_strdup (old_filepath);
+    entry.new_filepath = g_strdup (new_filepath);
+    entry.next = -1;
+    entry.has_previous = FALSE;
+    entry.visited = FALSE;
+
+    g_array_append_val (plan->renames, entry);
+}
+
+/*
+ * et_rename_plan_get_length:
+ * @plan: a rename plan
+ *
+ * Returns: the number of renames in @plan
+ */
+guint
+et_rename_plan_get_length (const EtRenamePlan *plan)
+{
+    g_return_val_if_fail (plan != NULL, 0);
+
+    return plan->renames->len;
+}
+
+/*
+ * et_rename_plan_free:
+ * @plan: (allow-none): a rename plan
+ *
+ * Free @plan.
+ */
+void
+et_rename_plan_free (EtRenamePlan *plan)
+{
+    guint i;
+
+    if (plan == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < plan->renames->len; i++)
+    {
+        EtRename *entry = &g_array_index (plan->renames, EtRename, i);
+
+        g_free (entry->old_filepath);
+        g_free (entry->new_filepath);
+    }
+
+    g_array_free (plan->renames, TRUE);
+    g_slice_free (EtRenamePlan, plan);
+}
+
+static void
+et_rename_chain_free (EtRenameChain *chain)
+{
+    guint i;
+
+    for (i = 0; i < chain->steps->len; i++)
+    {
+        EtRenameStep *step = &g_array_index (chain->steps, EtRenameStep, i);
+
+        g_free (step->from);
+        g_free (step->to);
+    }
+
+    g_array_free (chain->steps, TRUE);
+    g_slice_free (EtRenameChain, chain);
+}
+
+static void
+et_rename_chain_add_step (EtRenameChain *chain,
+                          const gchar *from,
+                          const gchar *to,
+                          gboolean to_temporary)
+{
+    EtRenameStep step;
+
+    step.from = g_strdup (from);
+    step.to = to_temporary ? g_strconcat (from, ".XXXXXX", NULL)
+                           : g_strdup (to);
+    step.to_temporary = to_temporary;
+
+    g_array_append_val (chain->steps, step);
+}
+
+/*
+ * Check if @old_filepath and @new_filepath only differ by case, in which case
+ * a case-insensitive filesystem reports that the new file already exists.
+ */
+static gboolean
+filepaths_differ_by_case (const gchar *old_filepath,
+                          const gchar *new_filepath)
+{
+    gchar *old_casefold;
+    gchar *new_casefold;
+    gboolean result;
+
+    if (!g_utf8_validate (old_filepath, -1, NULL)
+        || !g_utf8_validate (new_filepath, -1, NULL))
+    {
+        return g_ascii_strcasecmp (old_filepath, new_filepath) == 0;
+    }
+
+    old_casefold = g_utf8_casefold (old_filepath, -1);
+    new_casefold = g_utf8_casefold (new_filepath, -1);
+    result = strcmp (old_casefold, new_casefold) == 0;
+    g_free (old_casefold);
+    g_free (new_casefold);
+
+    return result;
+}
+
+/*
+ * Link each rename to the rename which frees its new path, and split the
+ * renames into independent chains. As each file is only renamed once, and
+ * only one file can be renamed to each path, the renames form simple paths
+ * and cycles. A path is executed from its end, where the new path is free.
+ * A cycle needs one temporary file, to free the path of its first file.
+ */
+static GPtrArray *
+et_rename_plan_build_chains (EtRenamePlan *plan,
+                             GError **error)
+{
+    GHashTable *old_filepaths;
+    GHashTable *new_filepaths;
+    GPtrArray *chains;
+    guint i;
+
+    old_filepaths = g_hash_table_new (g_str_hash, g_str_equal);
+    new_filepaths = g_hash_table_new (g_str_hash, g_str_equal);
+    chains = g_ptr_array_new_with_free_func ((GDestroyNotify)et_rename_chain_free);
+
+    for (i = 0; i < plan->renames->len; i++)
+    {
+        EtRename *entry = &g_array_index (plan->renames, EtRename, i);
+
+        gchar *display_path;
+
+        if (!g_hash_table_insert (old_filepaths, entry->old_filepath,
+                                  GUINT_TO_POINTER (i + 1)))
+        {
+            display_path = g_filename_display_name (entry->old_filepath);
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         _("The file ‘%s’ is renamed more than once"),
+                         display_path);
+        }
+        else if (!g_hash_table_insert (new_filepaths, entry->new_filepath,
+                                       GUINT_TO_POINTER (i + 1)))
+        {
+            display_path = g_filename_display_name (entry->new_filepath);
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         _("Several files are renamed to ‘%s’"),
+                         display_path);
+        }
+        else
+        {
+            continue;
+        }
+
+        g_free (display_path);
+        g_ptr_array_unref (chains);
+        chains = NULL;
+        goto out;
+    }
+
+    for (i = 0; i < plan->renames->len; i++)
+    {
+        EtRename *entry = &g_array_index (plan->renames, EtRename, i);
+        guint next = GPOINTER_TO_UINT (g_hash_table_lookup (old_filepaths,
+                                                            entry->new_filepath));
+
+        entry->next = (gint)next - 1;
+
+        if (entry->next >= 0)
+        {
+            g_array_index (plan->renames, EtRename, next - 1).has_previous = TRUE;
+        }
+    }
+
+    /* Paths, starting from the renames whose old path is not needed by any
+     * other rename. */
+    for (i = 0; i < plan->renames->len; i++)
+    {
+        EtRename *entry = &g_array_index (plan->renames, EtRename, i);
+        EtRenameChain *chain;
+        GPtrArray *path;
+        gint j;
+
+        if (entry->has_previous)
+        {
+            continue;
+        }
+
+        path = g_ptr_array_new ();
+
+        for (j = i; j >= 0; j = g_array_index (plan->renames, EtRename, j).next)
+        {
+            EtRename *member = &g_array_index (plan->renames, EtRename, j);
+
+            member->visited = TRUE;
+            g_ptr_array_add (path, member);
+        }
+
+        chain = g_slice_new0 (EtRenameChain);
+        chain->steps = g_array_sized_new (FALSE, FALSE, sizeof (EtRenameStep),
+                                          path->len + 1);
+
+        for (j = path->len - 1; j >= 0; j--)
+        {
+            EtRename *member = g_ptr_array_index (path, j);
+
+            /* The last rename of the path has a free new path, except for a
+             * change of case on a case-insensitive filesystem. */
+            if ((guint)j == path->len - 1
+                && filepaths_differ_by_case (member->old_filepath,
+                                             member->new_filepath))
+            {
+                et_rename_chain_add_step (chain, member->old_filepath, NULL,
+                                          TRUE);
+                et_rename_chain_add_step (chain, NULL, member->new_filepath,
+                                          FALSE);
+            }
+            else
+            {
+                et_rename_chain_add_step (chain, member->old_filepath,
+                                          member->new_filepath, FALSE);
+            }
+        }
+
+        g_ptr_array_unref (path);
+        g_ptr_array_add (chains, chain);
+    }
+
+    /* The remaining renames are cycles. */
+    for (i = 0; i < plan->renames->len; i++)
+    {
+        EtRename *first = &g_array_index (plan->renames, EtRename, i);
+        EtRenameChain *chain;
+        GPtrArray *cycle;
+        gint j;
+
+        if (first->visited)
+        {
+            continue;
+        }
+
+        cycle = g_ptr_array_new ();
+
+        for (j = i; !g_array_index (plan->renames, EtRename, j).visited;
+             j = g_array_index (plan->renames, EtRename, j).next)
+        {
+            EtRename *member = &g_array_index (plan->renames, EtRename, j);
+
+            member->visited = TRUE;
+            g_ptr_array_add (cycle, member);
+        }
+
+        chain = g_slice_new0 (EtRenameChain);
+        chain->steps = g_array_sized_new (FALSE, FALSE, sizeof (EtRenameStep),
+                                          cycle->len + 1);
+
+        /* Free the old path of the first file, rename the others from the end
+         * of the cycle, then move the first file to its new path. */
+        et_rename_chain_add_step (chain, first->old_filepath, NULL, TRUE);
+
+        for (j = cycle->len - 1; j > 0; j--)
+        {
+            EtRename *member = g_ptr_array_index (cycle, j);
+
+            et_rename_chain_add_step (chain, member->old_filepath,
+                                      member->new_filepath, FALSE);
+        }
+
+        et_rename_chain_add_step (chain, NULL, first->new_filepath, FALSE);
+
+        g_ptr_array_unref (cycle);
+        g_ptr_array_add (chains, chain);
+    }
+
+out:
+    g_hash_table_unref (new_filepaths);
+    g_hash_table_unref (old_filepaths);
+
+    return chains;
+}
+
+/*
+ * Create the parent directories of the new paths, once per directory. The
+ * directories which were created are prepended to @created, so that they can
+ * be removed if the renames are rolled back.
+ */
+static gboolean
+et_rename_plan_make_directories (EtRenamePlan *plan,
+                                 GList **created,
+                                 GError **error)
+{
+    GHashTable *checked;
+    guint i;
+    gboolean success = TRUE;
+
+    checked = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    for (i = 0; i < plan->renames->len && success; i++)
+    {
+        const EtRename *entry = &g_array_index (plan->renames, EtRename, i);
+        GList *missing = NULL;
+        GList *l;
+        gchar *dirname;
+
+        dirname = g_path_get_dirname (entry->new_filepath);
+
+        /* Find the missing directories, up to the first one which exists or
+         * which was already checked. */
+        while (!g_hash_table_contains (checked, dirname)
+               && !g_file_test (dirname, G_FILE_TEST_IS_DIR))
+        {
+            gchar *parent = g_path_get_dirname (dirname);
+
+            missing = g_list_prepend (missing, dirname);
+
+            if (strcmp (parent, dirname) == 0)
+            {
+                g_free (parent);
+                dirname = NULL;
+                break;
+            }
+
+            dirname = parent;
+        }
+
+        if (dirname)
+        {
+            g_hash_table_add (checked, dirname);
+        }
+
+        /* Create the missing directories, from the outermost one. */
+        for (l = missing; l != NULL; l = g_list_next (l))
+        {
+            GFile *dir;
+
+            g_hash_table_add (checked, l->data);
+
+            if (!success)
+            {
+                continue;
+            }
+
+            dir = g_file_new_for_path (l->data);
+
+            if (g_file_make_directory (dir, NULL, error))
+            {
+                *created = g_list_prepend (*created, dir);
+            }
+            else
+            {
+                g_object_unref (dir);
+                success = FALSE;
+            }
+        }
+
+        g_list_free (missing);
+    }
+
+    g_hash_table_unref (checked);
+
+    return success;
+}
+
+static gboolean
+et_rename_step_execute (EtRenameStep *step,
+                        GError **error)
+{
+    GFile *from;
+    GFile *to;
+    gboolean success;
+    GFileCopyFlags flags = G_FILE_COPY_NONE;
+
+    if (step->to_temporary)
+    {
+        gint fd;
+
+        /* Reserve a unique name, which the file then replaces. The file is
+         * created with mode 0600. */
+        fd = g_mkstemp (step->to);
+
+        if (fd < 0)
+        {
+            gint saved_errno = errno;
+            gchar *display_path = g_filename_display_name (step->to);
+
+            g_set_error (error, G_IO_ERROR,
+                         g_io_error_from_errno (saved_errno),
+                         _("Error creating temporary file ‘%s’: %s"),
+                         display_path, g_strerror (saved_errno));
+            g_free (display_path);
+            return FALSE;
+        }
+
+        g_close (fd, NULL);
+        flags = G_FILE_COPY_OVERWRITE;
+    }
+
+    from = g_file_new_for_path (step->from);
+    to = g_file_new_for_path (step->to);
+
+    success = g_file_move (from, to, flags, NULL, NULL, NULL, error);
+
+    if (!success && step->to_temporary)
+    {
+        g_file_delete (to, NULL, NULL);
+    }
+
+    g_object_unref (from);
+    g_object_unref (to);
+
+    return success;
+}
+
+static void
+et_rename_chain_execute (EtRenameChain *chain,
+                         EtRenameExecution *execution)
+{
+    const gchar *temporary = NULL;
+    guint i;
+
+    for (i = 0; i < chain->steps->len; i++)
+    {
+        EtRenameStep *step = &g_array_index (chain->steps, EtRenameStep, i);
+        GError *error = NULL;
+
+        /* Stop as soon as possible if another chain failed. */
+        if (g_atomic_int_get (&execution->failed))
+        {
+            return;
+        }
+
+        /* The name of the temporary file is only known once it is created. */
+        if (step->from == NULL)
+        {
+            step->from = g_strdup (temporary);
+        }
+
+        if (!et_rename_step_execute (step, &error))
+        {
+            g_atomic_int_set (&execution->failed, 1);
+
+            g_mutex_lock (&execution->lock);
+
+            if (execution->error == NULL)
+            {
+                execution->error = error;
+            }
+            else
+            {
+                g_error_free (error);
+            }
+
+            g_mutex_unlock (&execution->lock);
+            return;
+        }
+
+        if (step->to_temporary)
+        {
+            temporary = step->to;
+        }
+
+        chain->n_done++;
+    }
+}
+
+static void
+et_rename_chain_thread_func (gpointer data,
+                             gpointer user_data)
+{
+    et_rename_chain_execute (data, user_data);
+}
+
+/*
+ * Undo the steps of @chain which were executed, in reverse order.
+ */
+static void
+et_rename_chain_rollback (EtRenameChain *chain)
+{
+    while (chain->n_done > 0)
+    {
+        EtRenameStep *step;
+        GFile *from;
+        GFile *to;
+        GError *error = NULL;
+
+        step = &g_array_index (chain->steps, EtRenameStep, --chain->n_done);
+        from = g_file_new_for_path (step->from);
+        to = g_file_new_for_path (step->to);
+
+        if (!g_file_move (to, from, G_FILE_COPY_NONE, NULL, NULL, NULL,
+                          &error))
+        {
+            g_warning ("Error restoring file ‘%s’: %s", step->from,
+                       error->message);
+            g_error_free (error);
+        }
+
+        g_object_unref (from);
+        g_object_unref (to);
+    }
+}
+
+/*
+ * et_rename_plan_execute:
+ * @plan: the renames to execute
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Execute all the renames of @plan. The renames are ordered so that no file
+ * is overwritten, and a cycle of renames, such as swapping the names of two
+ * files, uses one temporary file. Each parent directory which is missing is
+ * created once. Independent sequences of renames are executed in parallel.
+ *
+ * If a rename fails, the renames which were already executed are undone, and
+ * the directories which were created are removed.
+ *
+ * Returns: %TRUE if all the files were renamed, %FALSE otherwise
+ */
+gboolean
+et_rename_plan_execute (EtRenamePlan *plan,
+                        GError **error)
+{
+    GPtrArray *chains;
+    GList *created = NULL;
+    GList *l;
+    EtRenameExecution execution = { 0, };
+    guint i;
+
+    g_return_val_if_fail (plan != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    chains = et_rename_plan_build_chains (plan, error);
+
+    if (!chains)
+    {
+        return FALSE;
+    }
+
+    g_mutex_init (&execution.lock);
+
+    if (!et_rename_plan_make_directories (plan, &created, &execution.error))
+    {
+        execution.failed = 1;
+    }
+    else if (chains->len > 1)
+    {
+        GThreadPool *pool;
+
+        pool = g_thread_pool_new (et_rename_chain_thread_func, &execution,
+                                  MIN (chains->len, g_get_num_processors ()),
+                                  FALSE, NULL);
+
+        for (i = 0; i < chains->len; i++)
+        {
+            g_thread_pool_push (pool, g_ptr_array_index (chains, i), NULL);
+        }
+
+        /* Wait for all the chains to finish. */
+        g_thread_pool_free (pool, FALSE, TRUE);
+    }
+    else if (chains->len == 1)
+    {
+        et_rename_chain_execute (g_ptr_array_index (chains, 0), &execution);
+    }
+
+    if (execution.failed)
+    {
+        for (i = chains->len; i > 0; i--)
+        {
+            et_rename_chain_rollback (g_ptr_array_index (chains, i - 1));
+        }
+
+        /* Only empty directories can be deleted, so anything left behind by
+         * a failed restore is kept. */
+        for (l = created; l != NULL; l = g_list_next (l))
+        {
+            g_file_delete (G_FILE (l->data), NULL, NULL);
+        }
+
+        g_propagate_error (error, execution.error);
+    }
+
+    g_mutex_clear (&execution.lock);
+    g_list_free_full (created, g_object_unref);
+    g_ptr_array_unref (chains);
+
+    return !execution.failed;
+}
@@ -40,6 +40,7 @@
 #include "et_core.h"
 #include "crc32.h"
 #include "charset.h"
+#include "scan_mask.h"
 
 typedef struct
 {
@@ -96,6 +97,12 @@ typedef struct
 
     GtkWidget *fill_preview_label;
     GtkWidget *rename_preview_label;
+
+    GtkListStore *preview_model;
+    guint preview_timeout_id;
+    GCancellable *preview_cancellable;
+    GPtrArray *preview_jobs;
+    EtScanMode preview_mode;
 } EtScanDialogPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (EtScanDialog, et_scan_dialog, GTK_TYPE_DIALOG)
@@ -168,42 +175,25 @@ static const gchar *Rename_File_Masks [] =
 /* Keep up to date with the format specifiers shown in the UI. */
 static const gchar allowed_specifiers[] = "abcdegilnoprtuxyz";
 
-typedef enum
-{
-    UNKNOWN = 0,           /* Default value when initialized */
-    LEADING_SEPARATOR,     /* characters before the first code */
-    TRAILING_SEPARATOR,    /* characters after the last code */
-    SEPARATOR,             /* item is a separator between two codes */
-    DIRECTORY_SEPARATOR,   /* item is a separator between two codes with character '/' (G_DIR_SEPARATOR) */
-    FIELD,                 /* item contains text (not empty) of entry */
-    EMPTY_FIELD            /* item when entry contains no text */
-} Mask_Item_Type;
-
-
 enum {
     MASK_EDITOR_TEXT,
     MASK_EDITOR_COUNT
 };
 
-/*
- * Used into Rename File Scanner
- */
-typedef struct _File_Mask_Item File_Mask_Item;
-struct _File_Mask_Item
-{
-    Mask_Item_Type  type;
-    gchar          *string;
+enum {
+    PREVIEW_FILENAME,
+    PREVIEW_TEXT,
+    PREVIEW_ICON_NAME,
+    PREVIEW_ERRORS,
+    PREVIEW_COUNT
 };
 
-/*
- * Used into Scan Tag Scanner
- */
-typedef struct _Scan_Mask_Item Scan_Mask_Item;
-struct _Scan_Mask_Item
-{
-    gchar  code;   // The code of the mask without % (ex: %a => a)
-    gchar *string; // The string found by the scanner for the code defined the line above
-};
+/* Number of selected files in the preview of the scanner. */
+static const guint PREVIEW_MAX_FILES = 200;
+/* Delay after the last change of the mask, before updating the previews. */
+static const guint PREVIEW_DELAY = 250;
+/* Number of rows sent at once from the preview thread. */
+static const guint PREVIEW_CHUNK_SIZE = 20;
 
 
 
@@ -213,203 +203,230 @@ struct _Scan_Mask_Item
 static void Scan_Option_Button (void);
 static void entry_check_scan_tag_mask (GtkEntry *entry, gpointer user_data);
 
-static GList *Scan_Generate_New_Tag_From_Mask (ET_File *ETFile, gchar *mask);
-static void Scan_Free_File_Rename_List (GList *list);
-static void Scan_Free_File_Fill_Tag_List (GList *list);
-
 static void et_scan_on_response (GtkDialog *dialog, gint response_id,
                                  gpointer user_data);
+static void et_scan_dialog_on_mask_changed (EtScanDialog *self);
 
 
 /*************
  * Functions *
  *************/
 
-/*
- * Return the field of a 'File_Tag' structure corresponding to the mask code
- */
-static gchar **
-Scan_Return_File_Tag_Field_From_Mask_Code (File_Tag *FileTag, gchar code)
-{
-    switch (code)
-    {
-        case 't':    /* Title */
-            return &FileTag->title;
-        case 'a':    /* Artist */
-            return &FileTag->artist;
-        case 'b':    /* Album */
-            return &FileTag->album;
-        case 'd':    /* Disc Number */
-            return &FileTag->disc_number;
-        case 'x': /* Total number of discs. */
-            return &FileTag->disc_total;
-        case 'y':    /* Year */
-            return &FileTag->year;
-        case 'n':    /* Track */
-            return &FileTag->track;
-        case 'l':    /* Track Total */
-            return &FileTag->track_total;
-        case 'g':    /* Genre */
-            return &FileTag->genre;
-        case 'c':    /* Comment */
-            return &FileTag->comment;
-        case 'p':    /* Composer */
-            return &FileTag->composer;
-        case 'o':    /* Orig. Artist */
-            return &FileTag->orig_artist;
-        case 'r':    /* Copyright */
-            return &FileTag->copyright;
-        case 'u':    /* URL */
-            return &FileTag->url;
-        case 'e':    /* Encoded by */
-            return &FileTag->encoded_by;
-        case 'z':    /* Album Artist */
-            return &FileTag->album_artist;
-        case 'i':    /* Ignored */
-            return NULL;
-        default:
-            Log_Print(LOG_ERROR,"Scanner: Invalid code '%%%c' found!",code);
-            return NULL;
-    }
-}
-
 static void
-et_scan_dialog_set_file_tag_for_mask_item (File_Tag *file_tag,
-                                           const Scan_Mask_Item *item,
+et_scan_dialog_set_file_tag_for_mask_item (EtFileTagEdit *edit,
+                                           ET_File *ETFile,
+                                           const EtScanMaskField *item,
                                            gboolean overwrite)
 {
+    EtFileTagField field;
+
     switch (item->code)
     {
         case 't':
-            if (!overwrite && !et_str_empty (file_tag->title)) return;
-            et_file_tag_set_title (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_TITLE;
             break;
         case 'a':
-            if (!overwrite && !et_str_empty (file_tag->artist)) return;
-            et_file_tag_set_artist (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_ARTIST;
             break;
         case 'b':
-            if (!overwrite && !et_str_empty (file_tag->album)) return;
-            et_file_tag_set_album (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_ALBUM;
             break;
         case 'd':
-            if (!overwrite && !et_str_empty (file_tag->disc_number)) return;
-            et_file_tag_set_disc_number (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_DISC_NUMBER;
             break;
         case 'x':
-            if (!overwrite && !et_str_empty (file_tag->disc_total)) return;
-            et_file_tag_set_disc_total (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_DISC_TOTAL;
             break;
         case 'y':
-            if (!overwrite && !et_str_empty (file_tag->year)) return;
-            et_file_tag_set_year (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_YEAR;
             break;
         case 'n':
-            if (!overwrite && !et_str_empty (file_tag->track)) return;
-            et_file_tag_set_track_number (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_TRACK_NUMBER;
             break;
         case 'l':
-            if (!overwrite && !et_str_empty (file_tag->track_total)) return;
-            et_file_tag_set_track_total (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_TRACK_TOTAL;
             break;
         case 'g':
-            if (!overwrite && !et_str_empty (file_tag->genre)) return;
-            et_file_tag_set_genre (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_GENRE;
             break;
         case 'c':
-            if (!overwrite && !et_str_empty (file_tag->comment)) return;
-            et_file_tag_set_comment (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_COMMENT;
             break;
         case 'p':
-            if (!overwrite && !et_str_empty (file_tag->composer)) return;
-            et_file_tag_set_composer (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_COMPOSER;
             break;
         case 'o':
-            if (!overwrite && !et_str_empty (file_tag->orig_artist)) return;
-            et_file_tag_set_orig_artist (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_ORIG_ARTIST;
             break;
         case 'r':
-            if (!overwrite && !et_str_empty (file_tag->copyright)) return;
-            et_file_tag_set_copyright (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_COPYRIGHT;
             break;
         case 'u':
-            if (!overwrite && !et_str_empty (file_tag->url)) return;
-            et_file_tag_set_url (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_URL;
             break;
         case 'e':
-            if (!overwrite && !et_str_empty (file_tag->encoded_by)) return;
-            et_file_tag_set_encoded_by (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_ENCODED_BY;
             break;
         case 'z':
-            if (!overwrite && !et_str_empty (file_tag->album_artist)) return;
-            et_file_tag_set_album_artist (file_tag, item->string);
+            field = ET_FILE_TAG_FIELD_ALBUM_ARTIST;
             break;
         case 'i':
             /* Ignored. */
-            break;
+            return;
         default:
             Log_Print (LOG_ERROR, "Scanner: Invalid code '%%%c' found!",
                        item->code);
-            break;
+            return;
+    }
+
+    if (!overwrite
+        && !et_str_empty (et_file_tag_edit_get_field (edit, ETFile, field)))
+    {
+        return;
     }
+
+    et_file_tag_edit_set_field (edit, ETFile, field, item->string);
 }
 
 /*
- * Uses the filename and path to fill tag information
- * Note: mask and source are read from the right to the left
+ * et_scan_new_rename_file_mask:
+ * @mask: the mask to compile
+ * @no_dir_check_or_conversion: see et_scan_generate_new_filename_from_mask()
+ *
+ * Compile a rename file mask with the current settings.
+ *
+ * Returns: a new compiled mask, to be freed with et_scan_mask_free()
  */
-static void
-Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
+static EtScanMask *
+et_scan_new_rename_file_mask (const gchar *mask,
+                              gboolean no_dir_check_or_conversion)
 {
-    EtScanDialogPrivate *priv;
-    GList *fill_tag_list = NULL;
-    GList *l;
-    gchar *mask; // The 'mask' in the entry
-    gchar *filename_utf8;
-    File_Tag *FileTag;
+    return et_scan_mask_new_rename_file (mask, no_dir_check_or_conversion,
+                                         g_settings_get_enum (MainSettings,
+                                                              "rename-convert-spaces"),
+                                         g_settings_get_boolean (MainSettings,
+                                                                 "rename-replace-illegal-chars"));
+}
 
-    g_return_if_fail (ETFile != NULL);
+static EtScanMask *
+et_scan_dialog_new_rename_file_mask (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
 
     priv = et_scan_dialog_get_instance_private (self);
 
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
-    if (!mask) return;
+    return et_scan_new_rename_file_mask (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))),
+                                         FALSE);
+}
+
+static EtScanMask *
+et_scan_dialog_new_fill_tag_mask (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+
+    priv = et_scan_dialog_get_instance_private (self);
 
-    // Create a new File_Tag item
-    FileTag = et_file_tag_new ();
-    et_file_tag_copy_into (FileTag, ETFile->FileTag->data);
+    return et_scan_mask_new_fill_tag (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))),
+                                      g_settings_get_enum (MainSettings,
+                                                           "fill-convert-spaces"));
+}
 
-    // Process this mask with file
-    fill_tag_list = Scan_Generate_New_Tag_From_Mask(ETFile,mask);
+static void
+et_scan_log_errors (const GPtrArray *errors)
+{
+    guint i;
 
-    for (l = fill_tag_list; l != NULL; l = g_list_next (l))
+    for (i = 0; i < errors->len; i++)
     {
-        const Scan_Mask_Item *mask_item = l->data;
+        Log_Print (LOG_ERROR, "%s",
+                   (const gchar *)g_ptr_array_index (errors, i));
+    }
+}
 
-        /* We display the text affected to the code. */
-        et_scan_dialog_set_file_tag_for_mask_item (FileTag, mask_item,
-                                                   g_settings_get_boolean (MainSettings,
-                                                                           "fill-overwrite-tag-fields"));
+/*
+ * Return the new filename of the file in UTF-8, without the extension, to be
+ * matched against the fill tag mask. An error is added to @errors if the
+ * extension is not a known one.
+ */
+static gchar *
+et_scan_get_filename_without_extension (const ET_File *ETFile,
+                                        GPtrArray *errors)
+{
+    gchar *filename_utf8;
+    gchar *tmp;
+    gsize i;
+
+    filename_utf8 = g_strdup(((File_Name *)((GList *)ETFile->FileNameNew)->data)->value_utf8);
+    if (!filename_utf8) return NULL;
+
+    // Remove extension of file (if found)
+    tmp = strrchr(filename_utf8,'.');
+    for (i = 0; i <= ET_FILE_DESCRIPTION_SIZE; i++)
+    {
+        if ( strcasecmp(tmp,ETFileDescription[i].Extension)==0 )
+        {
+            *tmp = 0; //strrchr(source,'.') = 0;
+            break;
+        }
+    }
 
+    if (i==ET_FILE_DESCRIPTION_SIZE)
+    {
+        gchar *tmp1 = g_path_get_basename(filename_utf8);
+        g_ptr_array_add (errors,
+                         g_strdup_printf (_("The extension ‘%s’ was not found in filename ‘%s’"),
+                                          tmp, tmp1));
+        g_free(tmp1);
     }
 
-    Scan_Free_File_Fill_Tag_List(fill_tag_list);
+    return filename_utf8;
+}
+
+/*
+ * Fill the tag of the file with the fields found by the scanner, and with the
+ * default comment if requested. The fields are added to @edit, so that the
+ * tags of all the scanned files are committed together.
+ */
+static void
+et_scan_fill_tag_with_fields (EtFileTagEdit *edit,
+                              ET_File *ETFile,
+                              const GArray *fields)
+{
+    gchar *filename_utf8;
+    gboolean overwrite;
+    guint i;
+
+    overwrite = g_settings_get_boolean (MainSettings,
+                                        "fill-overwrite-tag-fields");
+
+    for (i = 0; fields != NULL && i < fields->len; i++)
+    {
+        /* We display the text affected to the code. */
+        et_scan_dialog_set_file_tag_for_mask_item (edit, ETFile,
+                                                   &g_array_index (fields,
+                                                                   EtScanMaskField,
+                                                                   i),
+                                                   overwrite);
+    }
 
     /* Set the default text to comment. */
     if (g_settings_get_boolean (MainSettings, "fill-set-default-comment")
-        && (g_settings_get_boolean (MainSettings, "fill-overwrite-tag-fields")
-            || et_str_empty (FileTag->comment)))
+        && (overwrite
+            || et_str_empty (et_file_tag_edit_get_field (edit, ETFile,
+                                                         ET_FILE_TAG_FIELD_COMMENT))))
     {
         gchar *default_comment = g_settings_get_string (MainSettings,
                                                         "fill-default-comment");
-        et_file_tag_set_comment  (FileTag, default_comment);
+        et_file_tag_edit_set_field (edit, ETFile, ET_FILE_TAG_FIELD_COMMENT,
+                                    default_comment);
         g_free (default_comment);
     }
 
     /* Set CRC-32 value as default comment (for files with ID3 tag only). */
     if (g_settings_get_boolean (MainSettings, "fill-crc32-comment")
-        && (g_settings_get_boolean (MainSettings, "fill-overwrite-tag-fields")
-            || et_str_empty (FileTag->comment)))
+        && (overwrite
+            || et_str_empty (et_file_tag_edit_get_field (edit, ETFile,
+                                                         ET_FILE_TAG_FIELD_COMMENT))))
     {
         GFile *file;
         GError *error = NULL;
@@ -424,7 +441,8 @@ Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
             {
                 buffer = g_strdup_printf ("%.8" G_GUINT32_FORMAT,
                                           crc32_value);
-                et_file_tag_set_comment (FileTag, buffer);
+                et_file_tag_edit_set_field (edit, ETFile,
+                                            ET_FILE_TAG_FIELD_COMMENT, buffer);
                 g_free(buffer);
             }
             else
@@ -439,11 +457,6 @@ Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
         }
     }
 
-
-    // Save changes of the 'File_Tag' item
-    ET_Manage_Changes_Of_File_Data(ETFile,NULL,FileTag);
-
-    g_free(mask);
     et_application_window_status_bar_message (ET_APPLICATION_WINDOW (MainWindow),
                                               _("Tag successfully scanned"),
                                               TRUE);
@@ -452,217 +465,88 @@ Scan_Tag_With_Mask (EtScanDialog *self, ET_File *ETFile)
     g_free(filename_utf8);
 }
 
-static GList *
-Scan_Generate_New_Tag_From_Mask (ET_File *ETFile, gchar *mask)
+/*
+ * Uses the filename and path to fill tag information
+ * Note: mask and source are read from the right to the left
+ */
+static void
+Scan_Tag_With_Mask (ET_File *ETFile, const EtScanMask *mask)
 {
-    GList *fill_tag_list = NULL;
+    GArray *fields = NULL;
+    GPtrArray *errors;
     gchar *filename_utf8;
-    gchar *tmp;
-    gchar *buf;
-    gchar *separator;
-    gchar *string;
-    gsize len, i, loop=0;
-    gchar **mask_splitted;
-    gchar **file_splitted;
-    guint mask_splitted_number;
-    guint file_splitted_number;
-    guint mask_splitted_index;
-    guint file_splitted_index;
-    Scan_Mask_Item *mask_item;
-    EtConvertSpaces convert_mode;
+    EtFileTagEdit *edit;
 
-    g_return_val_if_fail (ETFile != NULL && mask != NULL, NULL);
+    g_return_if_fail (ETFile != NULL);
+    g_return_if_fail (mask != NULL);
 
-    filename_utf8 = g_strdup(((File_Name *)((GList *)ETFile->FileNameNew)->data)->value_utf8);
-    if (!filename_utf8) return NULL;
+    errors = g_ptr_array_new_with_free_func (g_free);
+    filename_utf8 = et_scan_get_filename_without_extension (ETFile, errors);
 
-    // Remove extension of file (if found)
-    tmp = strrchr(filename_utf8,'.');
-    for (i = 0; i <= ET_FILE_DESCRIPTION_SIZE; i++)
+    // Process this mask with file
+    if (filename_utf8)
     {
-        if ( strcasecmp(tmp,ETFileDescription[i].Extension)==0 )
-        {
-            *tmp = 0; //strrchr(source,'.') = 0;
-            break;
-        }
+        fields = et_scan_mask_fill_tag (mask, filename_utf8, errors);
     }
 
-    if (i==ET_FILE_DESCRIPTION_SIZE)
-    {
-        gchar *tmp1 = g_path_get_basename(filename_utf8);
-        Log_Print (LOG_ERROR,
-                   _("The extension ‘%s’ was not found in filename ‘%s’"), tmp,
-                   tmp1);
-        g_free(tmp1);
-    }
+    et_scan_log_errors (errors);
 
-    /* Replace characters into mask and filename before parsing. */
-    convert_mode = g_settings_get_enum (MainSettings, "fill-convert-spaces");
+    edit = et_file_tag_edit_new ();
+    et_scan_fill_tag_with_fields (edit, ETFile, fields);
+    et_file_tag_edit_commit (edit);
 
-    switch (convert_mode)
+    if (fields)
     {
-        case ET_CONVERT_SPACES_SPACES:
-            Scan_Convert_Underscore_Into_Space (mask);
-            Scan_Convert_Underscore_Into_Space (filename_utf8);
-            Scan_Convert_P20_Into_Space (mask);
-            Scan_Convert_P20_Into_Space (filename_utf8);
-            break;
-        case ET_CONVERT_SPACES_UNDERSCORES:
-            Scan_Convert_Space_Into_Underscore (mask);
-            Scan_Convert_Space_Into_Underscore (filename_utf8);
-            break;
-        case ET_CONVERT_SPACES_NO_CHANGE:
-            break;
-        /* FIXME: Check if this is intentional. */
-        case ET_CONVERT_SPACES_REMOVE:
-        default:
-            g_assert_not_reached ();
+        g_array_unref (fields);
     }
 
-    // Split the Scanner mask
-    mask_splitted = g_strsplit(mask,G_DIR_SEPARATOR_S,0);
-    // Get number of arguments into 'mask_splitted'
-    for (mask_splitted_number=0;mask_splitted[mask_splitted_number];mask_splitted_number++);
+    g_ptr_array_unref (errors);
+    g_free (filename_utf8);
+}
 
-    // Split the File Path
-    file_splitted = g_strsplit(filename_utf8,G_DIR_SEPARATOR_S,0);
-    // Get number of arguments into 'file_splitted'
-    for (file_splitted_number=0;file_splitted[file_splitted_number];file_splitted_number++);
+/*
+ * Return the fields found by the fill tag scanner, as Pango markup.
+ */
+static gchar *
+et_scan_fill_tag_preview_markup (const GArray *fields)
+{
+    gchar *preview_text;
+    guint i;
 
-    // Set the starting position for each tab
-    if (mask_splitted_number <= file_splitted_number)
-    {
-        mask_splitted_index = 0;
-        file_splitted_index = file_splitted_number - mask_splitted_number;
-    }else
-    {
-        mask_splitted_index = mask_splitted_number - file_splitted_number;
-        file_splitted_index = 0;
-    }
+    preview_text = g_strdup("");
 
-    loop = 0;
-    while ( mask_splitted[mask_splitted_index]!= NULL && file_splitted[file_splitted_index]!=NULL )
+    for (i = 0; fields != NULL && i < fields->len; i++)
     {
-        gchar *mask_seq = mask_splitted[mask_splitted_index];
-        gchar *file_seq = file_splitted[file_splitted_index];
-        gchar *file_seq_utf8 = g_filename_display_name (file_seq);
-
-        //g_print(">%d> seq '%s' '%s'\n",loop,mask_seq,file_seq);
-        while (!et_str_empty (mask_seq))
-        {
-
-            /*
-             * Determine (first) code and destination
-             */
-            if ( (tmp=strchr(mask_seq,'%')) == NULL || strlen(tmp) < 2 )
-            {
-                break;
-            }
-
-            /*
-             * Allocate a new iten for the fill_tag_list
-             */
-            mask_item = g_slice_new0 (Scan_Mask_Item);
-
-            // Get the code (used to determine the corresponding target entry)
-            mask_item->code = tmp[1];
-
-            /*
-             * Delete text before the code
-             */
-            if ( (len = strlen(mask_seq) - strlen(tmp)) > 0 )
-            {
-                // Get this text in 'mask_seq'
-                buf = g_strndup(mask_seq,len);
-                // We remove it in 'mask_seq'
-                mask_seq = mask_seq + len;
-                // Find the same text at the begining of 'file_seq' ?
-                if ( (strstr(file_seq,buf)) == file_seq )
-                {
-                    file_seq = file_seq + len; // We remove it
-                }else
-                {
-                    Log_Print (LOG_ERROR,
-                               _("Cannot find separator ‘%s’ within ‘%s’"),
-                               buf, file_seq_utf8);
-                }
-                g_free(buf);
-            }
-
-            // Remove the current code into 'mask_seq'
-            mask_seq = mask_seq + 2;
-
-            /*
-             * Determine separator between two code or trailing text (after code)
-             */
-            if (!et_str_empty (mask_seq))
-            {
-                if ( (tmp=strchr(mask_seq,'%')) == NULL || strlen(tmp) < 2 )
-                {
-                    // No more code found
-                    len = strlen(mask_seq);
-                }else
-                {
-                    len = strlen(mask_seq) - strlen(tmp);
-                }
-                separator = g_strndup(mask_seq,len);
-
-                // Remove the current separator in 'mask_seq'
-                mask_seq = mask_seq + len;
-
-                // Try to find the separator in 'file_seq'
-                if ( (tmp=strstr(file_seq,separator)) == NULL )
-                {
-                    Log_Print (LOG_ERROR,
-                               _("Cannot find separator ‘%s’ within ‘%s’"),
-                               separator, file_seq_utf8);
-                    separator[0] = 0; // Needed to avoid error when calculting 'len' below
-                }
-
-                // Get the string affected to the code (or the corresponding entry field)
-                len = strlen(file_seq) - (tmp!=NULL?strlen(tmp):0);
-                string = g_strndup(file_seq,len);
-
-                // Remove the current separator in 'file_seq'
-                file_seq = file_seq + strlen(string) + strlen(separator);
-                g_free(separator);
-
-                // We get the text affected to the code
-                mask_item->string = string;
-            }else
-            {
-                // We display the remaining text, affected to the code (no more data in 'mask_seq')
-                mask_item->string = g_strdup(file_seq);
-            }
-
-            // Add the filled mask_iten to the list
-            fill_tag_list = g_list_append(fill_tag_list,mask_item);
-        }
+        const EtScanMaskField *mask_item = &g_array_index (fields,
+                                                           EtScanMaskField,
+                                                           i);
+        gchar *tmp_code   = g_strdup_printf("%c",mask_item->code);
+        gchar *tmp_string = g_markup_printf_escaped("%s",mask_item->string); // To avoid problem with strings containing characters like '&'
+        gchar *tmp_preview_text = preview_text;
 
-        g_free(file_seq_utf8);
+        preview_text = g_strconcat(tmp_preview_text,"<b>","%",tmp_code," = ",
+                                   "</b>","<i>",tmp_string,"</i>",NULL);
+        g_free(tmp_code);
+        g_free(tmp_string);
+        g_free(tmp_preview_text);
 
-        // Next sequences
-        mask_splitted_index++;
-        file_splitted_index++;
-        loop++;
+        tmp_preview_text = preview_text;
+        preview_text = g_strconcat(tmp_preview_text,"  ||  ",NULL);
+        g_free(tmp_preview_text);
     }
 
-    g_free(filename_utf8);
-    g_strfreev(mask_splitted);
-    g_strfreev(file_splitted);
-
-    // The 'fill_tag_list' must be freed after use
-    return fill_tag_list;
+    return preview_text;
 }
 
 static void
 Scan_Fill_Tag_Generate_Preview (EtScanDialog *self)
 {
     EtScanDialogPrivate *priv;
-    gchar *mask = NULL;
+    EtScanMask *mask;
+    gchar *filename_utf8;
     gchar *preview_text = NULL;
-    GList *fill_tag_list = NULL;
-    GList *l;
+    GArray *fields = NULL;
+    GPtrArray *errors;
 
     priv = et_scan_dialog_get_instance_private (self);
 
@@ -670,31 +554,27 @@ Scan_Fill_Tag_Generate_Preview (EtScanDialog *self)
         || gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)) != ET_SCAN_MODE_FILL_TAG)
         return;
 
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->fill_combo)))));
-    if (!mask)
-        return;
+    mask = et_scan_dialog_new_fill_tag_mask (self);
+    errors = g_ptr_array_new_with_free_func (g_free);
+    filename_utf8 = et_scan_get_filename_without_extension (ETCore->ETFileDisplayed,
+                                                            errors);
 
-    preview_text = g_strdup("");
-    fill_tag_list = Scan_Generate_New_Tag_From_Mask(ETCore->ETFileDisplayed,mask);
-    for (l = fill_tag_list; l != NULL; l = g_list_next (l))
+    if (filename_utf8)
     {
-        Scan_Mask_Item *mask_item = l->data;
-        gchar *tmp_code   = g_strdup_printf("%c",mask_item->code);
-        gchar *tmp_string = g_markup_printf_escaped("%s",mask_item->string); // To avoid problem with strings containing characters like '&'
-        gchar *tmp_preview_text = preview_text;
+        fields = et_scan_mask_fill_tag (mask, filename_utf8, errors);
+    }
 
-        preview_text = g_strconcat(tmp_preview_text,"<b>","%",tmp_code," = ",
-                                   "</b>","<i>",tmp_string,"</i>",NULL);
-        g_free(tmp_code);
-        g_free(tmp_string);
-        g_free(tmp_preview_text);
+    et_scan_log_errors (errors);
+    preview_text = et_scan_fill_tag_preview_markup (fields);
 
-        tmp_preview_text = preview_text;
-        preview_text = g_strconcat(tmp_preview_text,"  ||  ",NULL);
-        g_free(tmp_preview_text);
+    if (fields)
+    {
+        g_array_unref (fields);
     }
 
-    Scan_Free_File_Fill_Tag_List(fill_tag_list);
+    g_ptr_array_unref (errors);
+    g_free (filename_utf8);
+    et_scan_mask_free (mask);
 
     if (GTK_IS_LABEL (priv->fill_preview_label))
     {
@@ -712,7 +592,6 @@ Scan_Fill_Tag_Generate_Preview (EtScanDialog *self)
         gtk_widget_queue_resize (GTK_WIDGET (self));
     }
 
-    g_free(mask);
     g_free(preview_text);
 }
 
@@ -765,71 +644,24 @@ Scan_Rename_File_Generate_Preview (EtScanDialog *self)
 }
 
 
-void
-et_scan_dialog_update_previews (EtScanDialog *self)
-{
-    g_return_if_fail (ET_SCAN_DIALOG (self));
-
-    Scan_Fill_Tag_Generate_Preview (self);
-    Scan_Rename_File_Generate_Preview (self);
-}
-
-static void
-Scan_Free_File_Fill_Tag_List (GList *list)
-{
-    GList *l;
-
-    list = g_list_first (list);
-
-    for (l = list; l != NULL; l = g_list_next (l))
-    {
-        if (l->data)
-        {
-            g_free (((Scan_Mask_Item *)l->data)->string);
-            g_slice_free (Scan_Mask_Item, l->data);
-        }
-    }
-
-    g_list_free (list);
-}
-
-
 
 /**************************
  * Scanner To Rename File *
  **************************/
 /*
- * Uses tag information (displayed into tag entries) to rename file
- * Note: mask and source are read from the right to the left.
- * Note1: a mask code may be used severals times...
+ * Rename the file with the filename generated by the scanner.
  */
 static void
-Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
+et_scan_dialog_rename_file_with_generated (EtScanDialog *self,
+                                           ET_File *ETFile,
+                                           const gchar *filename_generated_utf8)
 {
-    EtScanDialogPrivate *priv;
-    gchar *filename_generated_utf8 = NULL;
     gchar *filename_generated = NULL;
     gchar *filename_new_utf8 = NULL;
-    gchar *mask = NULL;
     File_Name *FileName;
 
-    g_return_if_fail (ETFile != NULL);
-
-    priv = et_scan_dialog_get_instance_private (self);
-
-    mask = g_strdup (gtk_entry_get_text (GTK_ENTRY (gtk_bin_get_child (GTK_BIN (priv->rename_combo)))));
-    if (!mask) return;
-
-    // Note : if the first character is '/', we have a path with the filename,
-    // else we have only the filename. The both are in UTF-8.
-    filename_generated_utf8 = et_scan_generate_new_filename_from_mask (ETFile,
-                                                                       mask,
-                                                                       FALSE);
-    g_free(mask);
-
     if (et_str_empty (filename_generated_utf8))
     {
-        g_free (filename_generated_utf8);
         return;
     }
 
@@ -848,7 +680,6 @@ Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
 
         gtk_dialog_run(GTK_DIALOG(msgdialog));
         gtk_widget_destroy(msgdialog);
-        g_free(filename_generated_utf8);
         return;
     }
 
@@ -856,7 +687,6 @@ Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
     filename_new_utf8 = et_file_generate_name (ETFile,
                                                filename_generated_utf8);
     g_free(filename_generated);
-    g_free(filename_generated_utf8);
 
     /* Set the new filename */
     /* Create a new 'File_Name' item. */
@@ -875,8 +705,31 @@ Scan_Rename_File_With_Mask (EtScanDialog *self, ET_File *ETFile)
     Log_Print (LOG_OK, _("New filename successfully scanned ‘%s’"),
                filename_new_utf8);
     g_free(filename_new_utf8);
+}
 
-    return;
+/*
+ * Uses tag information (displayed into tag entries) to rename file
+ * Note: mask and source are read from the right to the left.
+ * Note1: a mask code may be used severals times...
+ */
+static void
+Scan_Rename_File_With_Mask (EtScanDialog *self,
+                            ET_File *ETFile,
+                            const EtScanMask *mask)
+{
+    gchar *filename_generated_utf8;
+
+    g_return_if_fail (ETFile != NULL);
+    g_return_if_fail (mask != NULL);
+
+    // Note : if the first character is '/', we have a path with the filename,
+    // else we have only the filename. The both are in UTF-8.
+    filename_generated_utf8 = et_scan_mask_rename_file (mask,
+                                                        ETFile->FileTag->data,
+                                                        ((File_Name *)ETFile->FileNameCur->data)->value_utf8);
+    et_scan_dialog_rename_file_with_generated (self, ETFile,
+                                               filename_generated_utf8);
+    g_free (filename_generated_utf8);
 }
 
 /*
@@ -894,248 +747,20 @@ et_scan_generate_new_filename_from_mask (const ET_File *ETFile,
                                          const gchar *mask,
                                          gboolean no_dir_check_or_conversion)
 {
-    gchar *tmp;
-    gchar **source = NULL;
-    gchar *path_utf8_cur = NULL;
-    gchar *filename_new_utf8 = NULL;
-    gchar *filename_tmp = NULL;
-    GList *rename_file_list = NULL;
-    GList *l;
-    File_Mask_Item *mask_item;
-    File_Mask_Item *mask_item_prev;
-    File_Mask_Item *mask_item_next;
-    gint counter = 0;
+    EtScanMask *compiled;
+    gchar *filename_new_utf8;
 
     g_return_val_if_fail (ETFile != NULL && mask != NULL, NULL);
 
-    /*
-     * Check for a directory in the mask
-     */
-    if (!no_dir_check_or_conversion)
-    {
-        if (g_path_is_absolute(mask))
-        {
-            // Absolute directory
-        }else if (strrchr(mask,G_DIR_SEPARATOR)!=NULL) // This is '/' on UNIX machines and '\' under Windows
-        {
-            // Relative path => set beginning of the path
-            path_utf8_cur = g_path_get_dirname( ((File_Name *)ETFile->FileNameCur->data)->value_utf8 );
-        }
-    }
-
-
-    /*
-     * Parse the codes to generate a list (1rst item = 1rst code)
-     */
-    while ( mask!=NULL && (tmp=strrchr(mask,'%'))!=NULL && strlen(tmp)>1 )
-    {
-        // Mask contains some characters after the code ('%b__')
-        if (strlen(tmp)>2)
-        {
-            mask_item = g_slice_new0 (File_Mask_Item);
-            if (counter)
-            {
-                if (strchr(tmp+2,G_DIR_SEPARATOR))
-                    mask_item->type = DIRECTORY_SEPARATOR;
-                else
-                    mask_item->type = SEPARATOR;
-            } else
-            {
-                mask_item->type = TRAILING_SEPARATOR;
-            }
-            mask_item->string = g_strdup(tmp+2);
-            rename_file_list = g_list_prepend(rename_file_list,mask_item);
-        }
-
-        // Now, parses the code to get the corresponding string (from tag)
-        source = Scan_Return_File_Tag_Field_From_Mask_Code((File_Tag *)ETFile->FileTag->data,tmp[1]);
-        mask_item = g_slice_new0 (File_Mask_Item);
-
-        if (source && !et_str_empty (*source))
-        {
-            mask_item->type = FIELD;
-            mask_item->string = g_strdup(*source);
-
-            // Replace invalid characters for this field
-            /* Do not replace characters in a playlist information field. */
-            if (!no_dir_check_or_conversion)
-            {
-                EtConvertSpaces convert_mode;
-
-                convert_mode = g_settings_get_enum (MainSettings,
-                                                    "rename-convert-spaces");
-
-                switch (convert_mode)
-                {
-                    case ET_CONVERT_SPACES_SPACES:
-                        Scan_Convert_Underscore_Into_Space (mask_item->string);
-                        Scan_Convert_P20_Into_Space (mask_item->string);
-                        break;
-                    case ET_CONVERT_SPACES_UNDERSCORES:
-                        Scan_Convert_Space_Into_Underscore (mask_item->string);
-                        break;
-                    case ET_CONVERT_SPACES_REMOVE:
-                        Scan_Remove_Spaces (mask_item->string);
-                        break;
-                    /* FIXME: Check that this is intended. */
-                    case ET_CONVERT_SPACES_NO_CHANGE:
-                    default:
-                        g_assert_not_reached ();
-                }
-
-                /* This must occur after the space processing, to ensure that a
-                 * trailing space cannot be present (if illegal characters are to be
-                 * replaced). */
-                et_filename_prepare (mask_item->string,
-                                     g_settings_get_boolean (MainSettings,
-                                                             "rename-replace-illegal-chars"));
-            }
-        }else
-        {
-            mask_item->type = EMPTY_FIELD;
-            mask_item->string = NULL;
-        }
-        rename_file_list = g_list_prepend(rename_file_list,mask_item);
-        *tmp = '\0'; // Cut parsed data of mask
-        counter++; // To indicate that we made at least one loop to identifiate 'separator' or 'trailing_separator'
-    }
-
-    // It may have some characters before the last remaining code ('__%a')
-    if (!et_str_empty (mask))
-    {
-        mask_item = g_slice_new0 (File_Mask_Item);
-        mask_item->type = LEADING_SEPARATOR;
-        mask_item->string = g_strdup(mask);
-        rename_file_list = g_list_prepend(rename_file_list,mask_item);
-    }
-
-    if (!rename_file_list) return NULL;
-
-    /*
-     * For Debugging : display the "rename_file_list" list
-     */
-    /***{
-        GList *list = g_list_first(rename_file_list);
-        gint i = 0;
-        g_print("## rename_file_list - start\n");
-        while (list)
-        {
-            File_Mask_Item *mask_item = (File_Mask_Item *)list->data;
-            Mask_Item_Type  type      = mask_item->type;
-            gchar          *string    = mask_item->string;
-
-            //g_print("item %d : \n",i++);
-            //g_print("  - type   : '%s'\n",type==UNKNOWN?"UNKNOWN":type==LEADING_SEPARATOR?"LEADING_SEPARATOR":type==TRAILING_SEPARATOR?"TRAILING_SEPARATOR":type==SEPARATOR?"SEPARATOR":type==DIRECTORY_SEPARATOR?"DIRECTORY_SEPARATOR":type==FIELD?"FIELD":type==EMPTY_FIELD?"EMPTY_FIELD":"???");
-            //g_print("  - string : '%s'\n",string);
-            g_print("%d -> %s (%s) | ",i++,type==UNKNOWN?"UNKNOWN":type==LEADING_SEPARATOR?"LEADING_SEPARATOR":type==TRAILING_SEPARATOR?"TRAILING_SEPARATOR":type==SEPARATOR?"SEPARATOR":type==DIRECTORY_SEPARATOR?"DIRECTORY_SEPARATOR":type==FIELD?"FIELD":type==EMPTY_FIELD?"EMPTY_FIELD":"???",string);
-
-            list = list->next;
-        }
-        g_print("\n## rename_file_list - end\n\n");
-    }***/
-
-    /*
-     * Build the new filename with items placed into the list
-     * (read the list from the end to the beginning)
-     */
-    filename_new_utf8 = g_strdup("");
-
-    for (l = g_list_last (rename_file_list); l != NULL;
-         l = g_list_previous (l))
-    {
-        File_Mask_Item *mask_item2 = l->data;
-
-        /* Trailing mask characters. */
-        if (mask_item2->type == TRAILING_SEPARATOR)
-        {
-            // Doesn't write it if previous field is empty
-            if (l->prev
-                && ((File_Mask_Item *)l->prev->data)->type != EMPTY_FIELD)
-            {
-                filename_tmp = filename_new_utf8;
-                filename_new_utf8 = g_strconcat (mask_item2->string,
-                                                 filename_new_utf8, NULL);
-                g_free(filename_tmp);
-            }
-        }
-        else if (mask_item2->type == EMPTY_FIELD)
-        // We don't concatenate the field value (empty) and the previous
-        // separator (except leading separator) to the filename.
-        // If the empty field is the 'first', we don't concatenate it, and the
-        // next separator too.
-        {
-            if (l->prev)
-            {
-                // The empty field isn't the first.
-                // If previous string is a separator, we don't use it, except if the next
-                // string is a FIELD (not empty)
-                mask_item_prev = l->prev->data;
-                if ( mask_item_prev->type==SEPARATOR )
-                {
-                    if (!(l->next
-                        && (mask_item_next = rename_file_list->next->data)
-                        && mask_item_next->type == FIELD))
-                    {
-                        l = l->prev;
-                    }
-                }
-            }else
-            if (l->next && (mask_item_next = l->next->data)
-                && mask_item_next->type == SEPARATOR)
-            // We are at the 'beginning' of the mask (so empty field is the first)
-            // and next field is a separator. As the separator may have been already added, we remove it
-            {
-                if ( filename_new_utf8 && mask_item_next->string && (strncmp(filename_new_utf8,mask_item_next->string,strlen(mask_item_next->string))==0) ) // To avoid crash if filename_new_utf8 is 'empty'
-                {
-                    filename_tmp = filename_new_utf8;
-                    filename_new_utf8 = g_strdup(filename_new_utf8+strlen(mask_item_next->string));
-                    g_free(filename_tmp);
-                 }
-            }
-
-        }else // SEPARATOR, FIELD, LEADING_SEPARATOR, DIRECTORY_SEPARATOR
-        {
-            filename_tmp = filename_new_utf8;
-            filename_new_utf8 = g_strconcat (mask_item2->string,
-                                             filename_new_utf8, NULL);
-            g_free(filename_tmp);
-        }
-    }
-
-    // Free the list
-    Scan_Free_File_Rename_List(rename_file_list);
-
-
-    // Add current path if relative path entered
-    if (path_utf8_cur)
-    {
-        filename_tmp = filename_new_utf8; // in UTF-8!
-        filename_new_utf8 = g_build_filename (path_utf8_cur, filename_new_utf8,
-                                              NULL);
-        g_free(filename_tmp);
-        g_free(path_utf8_cur);
-    }
+    compiled = et_scan_new_rename_file_mask (mask, no_dir_check_or_conversion);
+    filename_new_utf8 = et_scan_mask_rename_file (compiled,
+                                                  ETFile->FileTag->data,
+                                                  ((File_Name *)ETFile->FileNameCur->data)->value_utf8);
+    et_scan_mask_free (compiled);
 
     return filename_new_utf8; // in UTF-8!
 }
 
-static void
-Scan_Free_File_Rename_List (GList *list)
-{
-    GList *l;
-
-    for (l = list; l != NULL; l = g_list_next (l))
-    {
-        if (l->data)
-        {
-            g_free (((File_Mask_Item *)l->data)->string);
-            g_slice_free (File_Mask_Item, l->data);
-        }
-    }
-
-    g_list_free (list);
-}
-
 /*
  * Adds the current path of the file to the mask on the "Rename File Scanner" entry
  */
@@ -1632,7 +1257,7 @@ on_scan_mode_changed (EtScanDialog *self,
             gtk_widget_show(priv->legend_toggle);
             gtk_tree_view_set_model (GTK_TREE_VIEW (priv->mask_view),
                                      GTK_TREE_MODEL (priv->fill_masks_model));
-            Scan_Fill_Tag_Generate_Preview (self);
+            et_scan_dialog_update_previews (self);
             g_signal_emit_by_name(G_OBJECT(priv->legend_toggle),"toggled");        /* To hide or show legend frame */
             g_signal_emit_by_name(G_OBJECT(priv->mask_editor_toggle),"toggled");    /* To hide or show mask editor frame */
             break;
@@ -1642,7 +1267,7 @@ on_scan_mode_changed (EtScanDialog *self,
             gtk_widget_show(priv->legend_toggle);
             gtk_tree_view_set_model (GTK_TREE_VIEW (priv->mask_view),
                                      GTK_TREE_MODEL (priv->rename_masks_model));
-            Scan_Rename_File_Generate_Preview (self);
+            et_scan_dialog_update_previews (self);
             g_signal_emit_by_name(G_OBJECT(priv->legend_toggle),"toggled");        /* To hide or show legend frame */
             g_signal_emit_by_name(G_OBJECT(priv->mask_editor_toggle),"toggled");    /* To hide or show mask editor frame */
             break;
@@ -2310,11 +1935,41 @@ Process_Fields_Convert_Check_Button_Toggled (EtScanDialog *self, GtkWidget *obje
                               gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (priv->convert_string_radio)));
 }
 
+/*
+ * Stop any pending or running update of the previews.
+ */
+static void
+et_scan_dialog_stop_previews (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (priv->preview_timeout_id != 0)
+    {
+        g_source_remove (priv->preview_timeout_id);
+        priv->preview_timeout_id = 0;
+    }
+
+    if (priv->preview_cancellable)
+    {
+        g_cancellable_cancel (priv->preview_cancellable);
+        g_clear_object (&priv->preview_cancellable);
+    }
+
+    if (priv->preview_jobs)
+    {
+        g_ptr_array_unref (priv->preview_jobs);
+        priv->preview_jobs = NULL;
+    }
+}
+
 /* Make sure that the Show Scanner toggle action is updated. */
 static void
 et_scan_on_hide (GtkWidget *widget,
                  gpointer user_data)
 {
+    et_scan_dialog_stop_previews (ET_SCAN_DIALOG (widget));
     g_action_group_activate_action (G_ACTION_GROUP (MainWindow), "scanner",
                                     NULL);
 }
@@ -2358,7 +2013,7 @@ create_scan_dialog (EtScanDialog *self)
     /* Signal to generate preview (preview of the new tag values). */
     g_signal_connect_swapped (gtk_bin_get_child (GTK_BIN (priv->fill_combo)),
                               "changed",
-                              G_CALLBACK (Scan_Fill_Tag_Generate_Preview),
+                              G_CALLBACK (et_scan_dialog_on_mask_changed),
                               self);
 
     /* Load masks into the combobox from a file. */
@@ -2380,7 +2035,7 @@ create_scan_dialog (EtScanDialog *self)
     /* Signal to generate preview (preview of the new filename). */
     g_signal_connect_swapped (gtk_bin_get_child (GTK_BIN (priv->rename_combo)),
                               "changed",
-                              G_CALLBACK (Scan_Rename_File_Generate_Preview),
+                              G_CALLBACK (et_scan_dialog_on_mask_changed),
                               self);
 
     /* Load masks into the combobox from a file. */
@@ -2520,6 +2175,7 @@ Scan_Select_Mode_And_Run_Scanner (EtScanDialog *self, ET_File *ETFile)
 {
     EtScanDialogPrivate *priv;
     EtScanMode mode;
+    EtScanMask *mask;
 
     g_return_if_fail (ET_SCAN_DIALOG (self));
     g_return_if_fail (ETFile != NULL);
@@ -2530,10 +2186,14 @@ Scan_Select_Mode_And_Run_Scanner (EtScanDialog *self, ET_File *ETFile)
     switch (mode)
     {
         case ET_SCAN_MODE_FILL_TAG:
-            Scan_Tag_With_Mask (self, ETFile);
+            mask = et_scan_dialog_new_fill_tag_mask (self);
+            Scan_Tag_With_Mask (ETFile, mask);
+            et_scan_mask_free (mask);
             break;
         case ET_SCAN_MODE_RENAME_FILE:
-            Scan_Rename_File_With_Mask (self, ETFile);
+            mask = et_scan_dialog_new_rename_file_mask (self);
+            Scan_Rename_File_With_Mask (self, ETFile, mask);
+            et_scan_mask_free (mask);
             break;
         case ET_SCAN_MODE_PROCESS_FIELDS:
             Scan_Process_Fields (self, ETFile);
@@ -2709,19 +2369,711 @@ entry_check_rename_file_mask (GtkEntry *entry, gpointer user_data)
                                            NULL);
 }
 
+/*
+ * EtScanJob:
+ * @index: the position of the file in the selection
+ * @ETFile: the file to scan, only accessed from the main thread
+ * @filename_utf8: for the fill tag scanner, the filename without extension
+ * @file_tag: for the rename file scanner, a copy of the fields of the tag
+ *            which a mask can reference
+ * @current_filename_utf8: for the rename file scanner, the current filename
+ * @fields: the fields found by the fill tag scanner
+ * @filename_generated_utf8: the filename generated by the rename file scanner
+ * @errors: the errors found while applying the mask
+ * @done: whether the job was returned by the worker thread
+ *
+ * The inputs are copied from @ETFile on the main thread, so that the mask can
+ * be applied in a worker thread.
+ */
+typedef struct
+{
+    guint index;
+    ET_File *ETFile;
+    gchar *filename_utf8;
+    File_Tag *file_tag;
+    gchar *current_filename_utf8;
+    GArray *fields;
+    gchar *filename_generated_utf8;
+    GPtrArray *errors;
+    gboolean done;
+} EtScanJob;
+
+/*
+ * EtScanBatch:
+ * @mode: the scanner mode
+ * @mask: the compiled mask, shared by all worker threads
+ * @done: queue of the jobs returned by the worker threads
+ */
+typedef struct
+{
+    EtScanMode mode;
+    EtScanMask *mask;
+    GAsyncQueue *done;
+} EtScanBatch;
+
+static void
+et_scan_job_free (EtScanJob *job)
+{
+    g_free (job->filename_utf8);
+
+    if (job->file_tag)
+    {
+        et_file_tag_free (job->file_tag);
+    }
+
+    g_free (job->current_filename_utf8);
+
+    if (job->fields)
+    {
+        g_array_unref (job->fields);
+    }
+
+    g_free (job->filename_generated_utf8);
+    g_ptr_array_unref (job->errors);
+    g_slice_free (EtScanJob, job);
+}
+
+/*
+ * Copy the inputs of the scanner from the file. Must be called from the main
+ * thread.
+ */
+static EtScanJob *
+et_scan_job_new (ET_File *ETFile, guint index, EtScanMode mode)
+{
+    EtScanJob *job;
+
+    job = g_slice_new0 (EtScanJob);
+    job->index = index;
+    job->ETFile = ETFile;
+    job->errors = g_ptr_array_new_with_free_func (g_free);
+
+    if (mode == ET_SCAN_MODE_FILL_TAG)
+    {
+        job->filename_utf8 = et_scan_get_filename_without_extension (ETFile,
+                                                                     job->errors);
+    }
+    else
+    {
+        /* The jobs of the preview are kept when the mask changes, so copy
+         * every field that a mask can reference. */
+        job->file_tag = et_file_tag_new ();
+        et_scan_mask_copy_fields (NULL, job->file_tag,
+                                  ETFile->FileTag->data);
+        job->current_filename_utf8 = g_strdup (((File_Name *)ETFile->FileNameCur->data)->value_utf8);
+    }
+
+    return job;
+}
+
+/*
+ * Apply the mask to the copied inputs. May be called from any thread.
+ */
+static void
+et_scan_job_run (EtScanJob *job, EtScanMode mode, const EtScanMask *mask)
+{
+    switch (mode)
+    {
+        case ET_SCAN_MODE_FILL_TAG:
+            if (job->filename_utf8)
+            {
+                job->fields = et_scan_mask_fill_tag (mask, job->filename_utf8,
+                                                     job->errors);
+            }
+            break;
+        case ET_SCAN_MODE_RENAME_FILE:
+            job->filename_generated_utf8 = et_scan_mask_rename_file (mask,
+                                                                     job->file_tag,
+                                                                     job->current_filename_utf8);
+            break;
+        case ET_SCAN_MODE_PROCESS_FIELDS:
+        default:
+            g_assert_not_reached ();
+    }
+}
+
+static void
+et_scan_batch_run_job (gpointer data, gpointer user_data)
+{
+    EtScanJob *job = data;
+    EtScanBatch *batch = user_data;
+
+    et_scan_job_run (job, batch->mode, batch->mask);
+    g_async_queue_push (batch->done, job);
+}
+
+static void
+et_scan_update_progress (EtApplicationWindow *window,
+                         guint progress_bar_index,
+                         guint selectcount)
+{
+    gchar progress_bar_text[30];
+    double fraction;
+
+    fraction = progress_bar_index / (double) selectcount;
+    et_application_window_progress_set_fraction (window, fraction);
+    g_snprintf (progress_bar_text, 30, "%u/%u", progress_bar_index,
+                selectcount);
+    et_application_window_progress_set_text (window, progress_bar_text);
+
+    /* Needed to refresh status bar */
+    while (gtk_events_pending())
+        gtk_main_iteration();
+}
+
+/*
+ * et_scan_dialog_scan_files_with_mask:
+ * @self: the scanner window
+ * @mode: %ET_SCAN_MODE_FILL_TAG or %ET_SCAN_MODE_RENAME_FILE
+ * @files: (element-type ET_File): the files to scan
+ *
+ * Compile the mask once, apply it to all the files in a pool of worker
+ * threads, and merge the results into the files on the main thread, in the
+ * order of @files.
+ */
+static void
+et_scan_dialog_scan_files_with_mask (EtScanDialog *self,
+                                     EtScanMode mode,
+                                     GList *files)
+{
+    EtApplicationWindow *window;
+    EtScanBatch batch;
+    EtScanJob **jobs;
+    EtFileTagEdit *edit;
+    GThreadPool *pool;
+    GList *l;
+    guint n_jobs;
+    guint next = 0;
+
+    window = ET_APPLICATION_WINDOW (MainWindow);
+    /* The tags filled from all the files are undone at once. */
+    edit = et_file_tag_edit_new ();
+
+    batch.mode = mode;
+    batch.mask = mode == ET_SCAN_MODE_FILL_TAG
+                 ? et_scan_dialog_new_fill_tag_mask (self)
+                 : et_scan_dialog_new_rename_file_mask (self);
+    batch.done = g_async_queue_new ();
+
+    pool = g_thread_pool_new (et_scan_batch_run_job, &batch,
+                              g_get_num_processors (), FALSE, NULL);
+
+    n_jobs = g_list_length (files);
+    jobs = g_new0 (EtScanJob *, n_jobs);
+
+    for (l = files; l != NULL; l = g_list_next (l), next++)
+    {
+        jobs[next] = et_scan_job_new ((ET_File *)l->data, next, mode);
+        g_thread_pool_push (pool, jobs[next], NULL);
+    }
+
+    next = 0;
+
+    while (next < n_jobs)
+    {
+        EtScanJob *job;
+
+        /* Keep the interface responsive while the workers are busy. */
+        job = g_async_queue_timeout_pop (batch.done, G_USEC_PER_SEC / 20);
+
+        if (job == NULL)
+        {
+            while (gtk_events_pending ())
+                gtk_main_iteration ();
+
+            continue;
+        }
+
+        job->done = TRUE;
+
+        /* Merge the results in the order of the selection. */
+        while (next < n_jobs && jobs[next]->done)
+        {
+            EtScanJob *current = jobs[next];
+
+            et_scan_log_errors (current->errors);
+
+            if (mode == ET_SCAN_MODE_FILL_TAG)
+            {
+                et_scan_fill_tag_with_fields (edit, current->ETFile,
+                                              current->fields);
+            }
+            else
+            {
+                et_scan_dialog_rename_file_with_generated (self,
+                                                           current->ETFile,
+                                                           current->filename_generated_utf8);
+            }
+
+            et_scan_job_free (current);
+            jobs[next++] = NULL;
+
+            et_scan_update_progress (window, next, n_jobs);
+        }
+    }
+
+    g_thread_pool_free (pool, FALSE, TRUE);
+    g_async_queue_unref (batch.done);
+    et_scan_mask_free (batch.mask);
+    g_free (jobs);
+
+    et_file_tag_edit_commit (edit);
+}
+
+/*
+ * EtScanPreview:
+ * @mode: the scanner mode
+ * @mask: the compiled mask
+ * @jobs: (element-type EtScanJob): the files to preview, which are shared
+ *        with the later previews of the same selection, and so only read
+ *
+ * The data of a preview of the scanner over the selected files, generated in
+ * a worker thread.
+ */
+typedef struct
+{
+    EtScanMode mode;
+    EtScanMask *mask;
+    GPtrArray *jobs;
+} EtScanPreview;
+
+/*
+ * EtScanPreviewChunk:
+ * @self: the scanner window
+ * @cancellable: the cancellable of the preview
+ * @start: the row of the first result
+ * @texts: the preview of each file, as Pango markup
+ * @errors: the errors for each file, or %NULL
+ *
+ * Results of the preview, passed from the worker thread to the main thread.
+ */
+typedef struct
+{
+    EtScanDialog *self;
+    GCancellable *cancellable;
+    guint start;
+    GPtrArray *texts;
+    GPtrArray *errors;
+} EtScanPreviewChunk;
+
+static void
+et_scan_preview_free (EtScanPreview *preview)
+{
+    et_scan_mask_free (preview->mask);
+    g_ptr_array_unref (preview->jobs);
+    g_slice_free (EtScanPreview, preview);
+}
+
+static EtScanPreviewChunk *
+et_scan_preview_chunk_new (EtScanDialog *self,
+                           GCancellable *cancellable,
+                           guint start)
+{
+    EtScanPreviewChunk *chunk;
+
+    chunk = g_slice_new (EtScanPreviewChunk);
+    chunk->self = g_object_ref (self);
+    chunk->cancellable = g_object_ref (cancellable);
+    chunk->start = start;
+    chunk->texts = g_ptr_array_new_with_free_func (g_free);
+    chunk->errors = g_ptr_array_new_with_free_func (g_free);
+
+    return chunk;
+}
+
+static void
+et_scan_preview_chunk_free (EtScanPreviewChunk *chunk)
+{
+    g_object_unref (chunk->self);
+    g_object_unref (chunk->cancellable);
+    g_ptr_array_unref (chunk->texts);
+    g_ptr_array_unref (chunk->errors);
+    g_slice_free (EtScanPreviewChunk, chunk);
+}
+
+/*
+ * Update the rows of the preview, on the main thread.
+ */
+static gboolean
+on_scan_preview_chunk (gpointer user_data)
+{
+    EtScanPreviewChunk *chunk = user_data;
+    EtScanDialogPrivate *priv;
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    guint i;
+
+    /* The preview was restarted or the dialog destroyed. */
+    if (g_cancellable_is_cancelled (chunk->cancellable))
+    {
+        return G_SOURCE_REMOVE;
+    }
+
+    priv = et_scan_dialog_get_instance_private (chunk->self);
+    model = GTK_TREE_MODEL (priv->preview_model);
+
+    if (!gtk_tree_model_iter_nth_child (model, &iter, NULL, chunk->start))
+    {
+        return G_SOURCE_REMOVE;
+    }
+
+    for (i = 0; i < chunk->texts->len; i++)
+    {
+        const gchar *errors = g_ptr_array_index (chunk->errors, i);
+
+        gtk_list_store_set (priv->preview_model, &iter,
+                            PREVIEW_TEXT, g_ptr_array_index (chunk->texts, i),
+                            PREVIEW_ICON_NAME,
+                            errors ? "dialog-warning" : NULL,
+                            PREVIEW_ERRORS, errors, -1);
+
+        if (!gtk_tree_model_iter_next (model, &iter))
+        {
+            break;
+        }
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+et_scan_preview_send_chunk (EtScanPreviewChunk *chunk)
+{
+    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, on_scan_preview_chunk, chunk,
+                     (GDestroyNotify)et_scan_preview_chunk_free);
+}
+
+/*
+ * Apply the mask to the inputs of a job, with the outputs kept apart from the
+ * job, which may be in use by an earlier preview which is being cancelled.
+ * The preview of the file and its errors are returned as Pango markup, and
+ * the errors are %NULL if there are none.
+ */
+static void
+et_scan_preview_run_job (const EtScanJob *job,
+                         EtScanMode mode,
+                         const EtScanMask *mask,
+                         gchar **text,
+                         gchar **errors)
+{
+    EtScanJob run = *job;
+    guint i;
+
+    run.fields = NULL;
+    run.filename_generated_utf8 = NULL;
+    run.errors = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < job->errors->len; i++)
+    {
+        g_ptr_array_add (run.errors,
+                         g_strdup (g_ptr_array_index (job->errors, i)));
+    }
+
+    et_scan_job_run (&run, mode, mask);
+
+    if (mode == ET_SCAN_MODE_FILL_TAG)
+    {
+        *text = et_scan_fill_tag_preview_markup (run.fields);
+    }
+    else
+    {
+        *text = run.filename_generated_utf8
+                ? g_markup_escape_text (run.filename_generated_utf8, -1)
+                : g_strdup ("");
+    }
+
+    *errors = NULL;
+
+    if (run.errors->len > 0)
+    {
+        gchar *joined;
+
+        /* Terminate the array, to join the messages. */
+        g_ptr_array_add (run.errors, NULL);
+        joined = g_strjoinv ("\n", (gchar **)run.errors->pdata);
+        /* The errors are the tooltip of the row, which is markup. */
+        *errors = g_markup_escape_text (joined, -1);
+        g_free (joined);
+    }
+
+    if (run.fields)
+    {
+        g_array_unref (run.fields);
+    }
+
+    g_free (run.filename_generated_utf8);
+    g_ptr_array_unref (run.errors);
+}
+
+/*
+ * Apply the mask to the files of the preview, in a worker thread, and send
+ * the results to the main thread in chunks, so that the preview is updated
+ * while the remaining files are scanned.
+ */
+static void
+et_scan_preview_thread_func (GTask *task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable *cancellable)
+{
+    EtScanPreview *preview = task_data;
+    EtScanPreviewChunk *chunk = NULL;
+    guint i;
+
+    for (i = 0; i < preview->jobs->len; i++)
+    {
+        gchar *text;
+        gchar *errors;
+
+        if (g_task_return_error_if_cancelled (task))
+        {
+            if (chunk)
+            {
+                et_scan_preview_chunk_free (chunk);
+            }
+
+            return;
+        }
+
+        et_scan_preview_run_job (g_ptr_array_index (preview->jobs, i),
+                                 preview->mode, preview->mask, &text,
+                                 &errors);
+
+        if (chunk == NULL)
+        {
+            chunk = et_scan_preview_chunk_new (ET_SCAN_DIALOG (source_object),
+                                               cancellable, i);
+        }
+
+        g_ptr_array_add (chunk->texts, text);
+        g_ptr_array_add (chunk->errors, errors);
+
+        if (chunk->texts->len == PREVIEW_CHUNK_SIZE)
+        {
+            et_scan_preview_send_chunk (chunk);
+            chunk = NULL;
+        }
+    }
+
+    if (chunk)
+    {
+        et_scan_preview_send_chunk (chunk);
+    }
+
+    g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * et_scan_dialog_start_preview:
+ * @self: the scanner window
+ *
+ * Cancel the running preview, if any, and apply the current mask to the jobs
+ * of the preview in a worker thread. The rows of the preview are kept, and
+ * their results are replaced as they are computed.
+ */
+static void
+et_scan_dialog_start_preview (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+    EtScanPreview *preview;
+    GTask *task;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (priv->preview_cancellable)
+    {
+        g_cancellable_cancel (priv->preview_cancellable);
+        g_clear_object (&priv->preview_cancellable);
+    }
+
+    preview = g_slice_new (EtScanPreview);
+    preview->mode = priv->preview_mode;
+    preview->mask = preview->mode == ET_SCAN_MODE_FILL_TAG
+                    ? et_scan_dialog_new_fill_tag_mask (self)
+                    : et_scan_dialog_new_rename_file_mask (self);
+    preview->jobs = g_ptr_array_ref (priv->preview_jobs);
+
+    priv->preview_cancellable = g_cancellable_new ();
+
+    task = g_task_new (self, priv->preview_cancellable, NULL, NULL);
+    g_task_set_task_data (task, preview,
+                          (GDestroyNotify)et_scan_preview_free);
+    g_task_run_in_thread (task, et_scan_preview_thread_func);
+    g_object_unref (task);
+}
+
+/*
+ * et_scan_dialog_generate_selection_preview:
+ * @self: the scanner window
+ *
+ * Cancel the running preview, if any, and start a preview of the current mask
+ * over the first selected files. The inputs of the files are copied, and the
+ * filenames are listed immediately, and the results are filled in as they are
+ * computed.
+ */
+static void
+et_scan_dialog_generate_selection_preview (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+    EtScanMode mode;
+    GList *selfilelist;
+    GList *l;
+    guint i;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    et_scan_dialog_stop_previews (self);
+    gtk_list_store_clear (priv->preview_model);
+
+    if (!ETCore->ETFileDisplayedList
+        || !gtk_widget_get_visible (GTK_WIDGET (self)))
+    {
+        return;
+    }
+
+    mode = gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook));
+
+    switch (mode)
+    {
+        case ET_SCAN_MODE_FILL_TAG:
+        case ET_SCAN_MODE_RENAME_FILE:
+            break;
+        case ET_SCAN_MODE_PROCESS_FIELDS:
+            return;
+        default:
+            g_assert_not_reached ();
+    }
+
+    priv->preview_mode = mode;
+    priv->preview_jobs = g_ptr_array_new_with_free_func ((GDestroyNotify)et_scan_job_free);
+
+    selfilelist = et_application_window_browser_get_selected_files (ET_APPLICATION_WINDOW (MainWindow));
+
+    for (l = selfilelist, i = 0; l != NULL && i < PREVIEW_MAX_FILES;
+         l = g_list_next (l), i++)
+    {
+        ET_File *ETFile = l->data;
+        gchar *basename_utf8;
+
+        g_ptr_array_add (priv->preview_jobs,
+                         et_scan_job_new (ETFile, i, mode));
+
+        basename_utf8 = g_path_get_basename (((File_Name *)ETFile->FileNameNew->data)->value_utf8);
+        gtk_list_store_insert_with_values (priv->preview_model, NULL, -1,
+                                           PREVIEW_FILENAME, basename_utf8,
+                                           -1);
+        g_free (basename_utf8);
+    }
+
+    g_list_free (selfilelist);
+
+    if (priv->preview_jobs->len == 0)
+    {
+        g_ptr_array_unref (priv->preview_jobs);
+        priv->preview_jobs = NULL;
+        return;
+    }
+
+    et_scan_dialog_start_preview (self);
+}
+
+static gboolean
+on_scan_preview_timeout (gpointer user_data)
+{
+    EtScanDialog *self;
+    EtScanDialogPrivate *priv;
+
+    self = ET_SCAN_DIALOG (user_data);
+    priv = et_scan_dialog_get_instance_private (self);
+
+    priv->preview_timeout_id = 0;
+
+    Scan_Fill_Tag_Generate_Preview (self);
+    Scan_Rename_File_Generate_Preview (self);
+
+    /* Only the mask changed, so the copied inputs of the selection are still
+     * valid. */
+    if (priv->preview_jobs
+        && priv->preview_mode
+           == gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook)))
+    {
+        et_scan_dialog_start_preview (self);
+    }
+    else
+    {
+        et_scan_dialog_generate_selection_preview (self);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/*
+ * et_scan_dialog_on_mask_changed:
+ * @self: the scanner window
+ *
+ * Schedule an update of the previews for the new mask, after a short delay,
+ * so that typing in the mask entries is not slowed down by the generation of
+ * the previews.
+ */
+static void
+et_scan_dialog_on_mask_changed (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (priv->preview_timeout_id != 0)
+    {
+        g_source_remove (priv->preview_timeout_id);
+    }
+
+    priv->preview_timeout_id = g_timeout_add (PREVIEW_DELAY,
+                                              on_scan_preview_timeout, self);
+    g_source_set_name_by_id (priv->preview_timeout_id,
+                             "Scanner preview timeout");
+}
+
+/*
+ * et_scan_dialog_update_previews:
+ * @self: the scanner window
+ *
+ * Update the previews immediately, for example when the displayed file or
+ * the selection changes, copying the inputs of the selected files again.
+ */
+void
+et_scan_dialog_update_previews (EtScanDialog *self)
+{
+    EtScanDialogPrivate *priv;
+
+    g_return_if_fail (ET_SCAN_DIALOG (self));
+
+    priv = et_scan_dialog_get_instance_private (self);
+
+    if (priv->preview_timeout_id != 0)
+    {
+        g_source_remove (priv->preview_timeout_id);
+        priv->preview_timeout_id = 0;
+    }
+
+    Scan_Fill_Tag_Generate_Preview (self);
+    Scan_Rename_File_Generate_Preview (self);
+    et_scan_dialog_generate_selection_preview (self);
+}
+
 void
 et_scan_dialog_scan_selected_files (EtScanDialog *self)
 {
+    EtScanDialogPrivate *priv;
     EtApplicationWindow *window;
+    EtScanMode mode;
     guint progress_bar_index = 0;
     guint selectcount;
     gchar progress_bar_text[30];
-    double fraction;
     GList *selfilelist = NULL;
     GList *l;
 
     g_return_if_fail (ETCore->ETFileDisplayedList != NULL);
 
+    priv = et_scan_dialog_get_instance_private (self);
     window = ET_APPLICATION_WINDOW (MainWindow);
     et_application_window_update_et_file_from_ui (window);
 
@@ -2736,21 +3088,25 @@ et_scan_dialog_scan_selected_files (EtScanDialog *self)
     /* Set to unsensitive all command buttons (except Quit button) */
     et_application_window_disable_command_actions (window);
 
-    for (l = selfilelist; l != NULL; l = g_list_next (l))
-    {
-        ET_File *etfile = l->data;
-
-        /* Run the current scanner. */
-        Scan_Select_Mode_And_Run_Scanner (self, etfile);
-
-        fraction = (++progress_bar_index) / (double) selectcount;
-        et_application_window_progress_set_fraction (window, fraction);
-        g_snprintf(progress_bar_text, 30, "%d/%d", progress_bar_index, selectcount);
-        et_application_window_progress_set_text (window, progress_bar_text);
+    mode = gtk_notebook_get_current_page (GTK_NOTEBOOK (priv->notebook));
 
-        /* Needed to refresh status bar */
-        while (gtk_events_pending())
-            gtk_main_iteration();
+    switch (mode)
+    {
+        case ET_SCAN_MODE_FILL_TAG:
+        case ET_SCAN_MODE_RENAME_FILE:
+            et_scan_dialog_scan_files_with_mask (self, mode, selfilelist);
+            break;
+        case ET_SCAN_MODE_PROCESS_FIELDS:
+            for (l = selfilelist; l != NULL; l = g_list_next (l))
+            {
+                /* Run the current scanner. */
+                Scan_Process_Fields (self, (ET_File *)l->data);
+                et_scan_update_progress (window, ++progress_bar_index,
+                                         selectcount);
+            }
+            break;
+        default:
+            g_assert_not_reached ();
     }
 
     g_list_free (selfilelist);
@@ -2798,6 +3154,14 @@ et_scan_on_response (GtkDialog *dialog, gint response_id, gpointer user_data)
     }
 }
 
+static void
+et_scan_dialog_dispose (GObject *object)
+{
+    et_scan_dialog_stop_previews (ET_SCAN_DIALOG (object));
+
+    G_OBJECT_CLASS (et_scan_dialog_parent_class)->dispose (object);
+}
+
 static void
 et_scan_dialog_init (EtScanDialog *self)
 {
@@ -2810,6 +3174,8 @@ et_scan_dialog_class_init (EtScanDialogClass *klass)
 {
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+    G_OBJECT_CLASS (klass)->dispose = et_scan_dialog_dispose;
+
     gtk_widget_class_set_template_from_resource (widget_class,
                                                  "/org/gnome/EasyTAG/scan_dialog.ui");
     gtk_widget_class_bind_template_child_private (widget_class, EtScanDialog,
@@ -2900,9 +3266,13 @@ et_scan_dialog_class_init (EtScanDialogClass *klass)
                                                   fill_preview_label);
     gtk_widget_class_bind_template_child_private (widget_class, EtScanDialog,
                                                   rename_preview_label);
+    gtk_widget_class_bind_template_child_private (widget_class, EtScanDialog,
+                                                  preview_model);
     gtk_widget_class_bind_template_callback (widget_class,
                                              entry_check_scan_tag_mask);
     gtk_widget_class_bind_template_callback (widget_class, et_scan_on_hide);
+    gtk_widget_class_bind_template_callback (widget_class,
+                                             et_scan_dialog_update_previews);
     gtk_widget_class_bind_template_callback (widget_class,
                                              et_scan_on_response);
     gtk_widget_class_bind_template_callback (widget_class,
@@ -0,0 +1,862 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ * Copyright (C) 2000-2003  Jerome Couderc <easytag@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "scan_mask.h"
+
+#include <glib/gi18n.h>
+#include <string.h>
+
+#include "misc.h"
+#include "scan.h"
+
+typedef enum
+{
+    UNKNOWN = 0,           /* Default value when initialized */
+    LEADING_SEPARATOR,     /* characters before the first code */
+    TRAILING_SEPARATOR,    /* characters after the last code */
+    SEPARATOR,             /* item is a separator between two codes */
+    DIRECTORY_SEPARATOR,   /* item is a separator between two codes with character '/' (G_DIR_SEPARATOR) */
+    FIELD,                 /* item contains text (not empty) of entry */
+    EMPTY_FIELD            /* item when entry contains no text */
+} Mask_Item_Type;
+
+typedef enum
+{
+    ET_SCAN_MASK_FILL_TAG,
+    ET_SCAN_MASK_RENAME_FILE
+} EtScanMaskKind;
+
+/*
+ * EtScanMaskToken:
+ * @type: the type of the item, for rename masks
+ * @code: the mask code, without the leading '%', or 0 for a separator
+ * @field_offset: offset of the corresponding field in #File_Tag, or -1
+ * @leading: text expected before the code, or %NULL, for fill masks
+ * @leading_len: length of @leading
+ * @string: the separator following the code, or %NULL if the code takes the
+ *          rest of the path component (fill masks), or the separator text
+ *          (rename masks)
+ * @string_len: length of @string
+ */
+typedef struct
+{
+    Mask_Item_Type type;
+    gchar code;
+    goffset field_offset;
+    gchar *leading;
+    gsize leading_len;
+    gchar *string;
+    gsize string_len;
+} EtScanMaskToken;
+
+/*
+ * EtScanMaskSegment:
+ * @tokens: array of #EtScanMaskToken for a path component of a fill mask
+ */
+typedef struct
+{
+    GArray *tokens;
+} EtScanMaskSegment;
+
+struct _EtScanMask
+{
+    EtScanMaskKind kind;
+    EtConvertSpaces convert_mode;
+
+    /* Fill tag masks: one segment for each path component of the mask. */
+    EtScanMaskSegment *segments;
+    guint n_segments;
+
+    /* Rename file masks: tokens in the order of the mask. */
+    GArray *tokens;
+    gboolean no_dir_check_or_conversion;
+    gboolean replace_illegal;
+    gboolean prefix_current_path;
+};
+
+/*
+ * Return the offset of the field of a 'File_Tag' structure corresponding to
+ * the mask code, or -1 if the code does not correspond to a field.
+ */
+static goffset
+field_offset_from_mask_code (gchar code)
+{
+    switch (code)
+    {
+        case 't':    /* Title */
+            return G_STRUCT_OFFSET (File_Tag, title);
+        case 'a':    /* Artist */
+            return G_STRUCT_OFFSET (File_Tag, artist);
+        case 'b':    /* Album */
+            return G_STRUCT_OFFSET (File_Tag, album);
+        case 'd':    /* Disc Number */
+            return G_STRUCT_OFFSET (File_Tag, disc_number);
+        case 'x': /* Total number of discs. */
+            return G_STRUCT_OFFSET (File_Tag, disc_total);
+        case 'y':    /* Year */
+            return G_STRUCT_OFFSET (File_Tag, year);
+        case 'n':    /* Track */
+            return G_STRUCT_OFFSET (File_Tag, track);
+        case 'l':    /* Track Total */
+            return G_STRUCT_OFFSET (File_Tag, track_total);
+        case 'g':    /* Genre */
+            return G_STRUCT_OFFSET (File_Tag, genre);
+        case 'c':    /* Comment */
+            return G_STRUCT_OFFSET (File_Tag, comment);
+        case 'p':    /* Composer */
+            return G_STRUCT_OFFSET (File_Tag, composer);
+        case 'o':    /* Orig. Artist */
+            return G_STRUCT_OFFSET (File_Tag, orig_artist);
+        case 'r':    /* Copyright */
+            return G_STRUCT_OFFSET (File_Tag, copyright);
+        case 'u':    /* URL */
+            return G_STRUCT_OFFSET (File_Tag, url);
+        case 'e':    /* Encoded by */
+            return G_STRUCT_OFFSET (File_Tag, encoded_by);
+        case 'z':    /* Album Artist */
+            return G_STRUCT_OFFSET (File_Tag, album_artist);
+        case 'i':    /* Ignored */
+        default:
+            return -1;
+    }
+}
+
+static void
+et_scan_mask_token_clear (EtScanMaskToken *token)
+{
+    g_free (token->leading);
+    g_free (token->string);
+}
+
+static GArray *
+et_scan_mask_token_array_new (void)
+{
+    GArray *tokens;
+
+    tokens = g_array_new (FALSE, TRUE, sizeof (EtScanMaskToken));
+    g_array_set_clear_func (tokens, (GDestroyNotify)et_scan_mask_token_clear);
+
+    return tokens;
+}
+
+/*
+ * Find the next code in @mask_seq, in other words a '%' followed by at least
+ * one character.
+ */
+static const gchar *
+find_next_code (const gchar *mask_seq)
+{
+    const gchar *tmp = strchr (mask_seq, '%');
+
+    if (tmp == NULL || tmp[1] == '\0')
+    {
+        return NULL;
+    }
+
+    return tmp;
+}
+
+/*
+ * compile_fill_segment:
+ * @mask_seq: a path component of the mask
+ *
+ * Split a path component of a fill tag mask into codes, each with the text
+ * expected before it and the separator expected after it.
+ */
+static GArray *
+compile_fill_segment (const gchar *mask_seq)
+{
+    GArray *tokens;
+
+    tokens = et_scan_mask_token_array_new ();
+
+    while (!et_str_empty (mask_seq))
+    {
+        EtScanMaskToken token = { 0, };
+        const gchar *tmp;
+        gsize len;
+
+        /* Determine (first) code and destination. */
+        if ((tmp = find_next_code (mask_seq)) == NULL)
+        {
+            break;
+        }
+
+        token.code = tmp[1];
+        token.field_offset = field_offset_from_mask_code (token.code);
+
+        /* Text before the code. */
+        if ((len = tmp - mask_seq) > 0)
+        {
+            token.leading = g_strndup (mask_seq, len);
+            token.leading_len = len;
+        }
+
+        /* Remove the current code from 'mask_seq'. */
+        mask_seq = tmp + 2;
+
+        /* Determine separator between two codes or trailing text (after
+         * code). */
+        if (!et_str_empty (mask_seq))
+        {
+            if ((tmp = find_next_code (mask_seq)) == NULL)
+            {
+                /* No more code found. */
+                len = strlen (mask_seq);
+            }
+            else
+            {
+                len = tmp - mask_seq;
+            }
+
+            token.string = g_strndup (mask_seq, len);
+            token.string_len = len;
+            mask_seq += len;
+        }
+
+        g_array_append_val (tokens, token);
+    }
+
+    return tokens;
+}
+
+/*
+ * et_scan_mask_new_fill_tag:
+ * @mask: the mask to compile, for example "%a - %b/%n - %t"
+ * @convert_mode: how to convert spaces in the mask and the filenames
+ *
+ * Compile a mask for the fill tag scanner, which extracts tag fields from
+ * filenames.
+ *
+ * Returns: a new compiled mask, to be freed with et_scan_mask_free()
+ */
+EtScanMask *
+et_scan_mask_new_fill_tag (const gchar *mask,
+                           EtConvertSpaces convert_mode)
+{
+    EtScanMask *self;
+    gchar *mask_converted;
+    gchar **mask_splitted;
+    guint i;
+
+    g_return_val_if_fail (mask != NULL, NULL);
+
+    self = g_slice_new0 (EtScanMask);
+    self->kind = ET_SCAN_MASK_FILL_TAG;
+    self->convert_mode = convert_mode;
+
+    /* Replace characters into mask before parsing. */
+    mask_converted = g_strdup (mask);
+
+    switch (convert_mode)
+    {
+        case ET_CONVERT_SPACES_SPACES:
+            Scan_Convert_Underscore_Into_Space (mask_converted);
+            Scan_Convert_P20_Into_Space (mask_converted);
+            break;
+        case ET_CONVERT_SPACES_UNDERSCORES:
+            Scan_Convert_Space_Into_Underscore (mask_converted);
+            break;
+        case ET_CONVERT_SPACES_NO_CHANGE:
+            break;
+        /* FIXME: Check if this is intentional. */
+        case ET_CONVERT_SPACES_REMOVE:
+        default:
+            g_assert_not_reached ();
+    }
+
+    mask_splitted = g_strsplit (mask_converted, G_DIR_SEPARATOR_S, 0);
+    self->n_segments = g_strv_length (mask_splitted);
+    self->segments = g_new0 (EtScanMaskSegment, self->n_segments);
+
+    for (i = 0; i < self->n_segments; i++)
+    {
+        self->segments[i].tokens = compile_fill_segment (mask_splitted[i]);
+    }
+
+    g_strfreev (mask_splitted);
+    g_free (mask_converted);
+
+    return self;
+}
+
+/*
+ * et_scan_mask_new_rename_file:
+ * @mask: the mask to compile, for example "%n - %a - %t"
+ * @no_dir_check_or_conversion: if %TRUE, do not check for a directory in the
+ *                              mask, and do not convert "illegal" characters
+ *                              in fields (used for playlist content)
+ * @convert_mode: how to convert spaces in fields
+ * @replace_illegal: whether to replace characters which are illegal on
+ *                   FAT filesystems
+ *
+ * Compile a mask for the rename file scanner, which generates filenames from
+ * tag fields.
+ *
+ * Returns: a new compiled mask, to be freed with et_scan_mask_free()
+ */
+EtScanMask *
+et_scan_mask_new_rename_file (const gchar *mask,
+                              gboolean no_dir_check_or_conversion,
+                              EtConvertSpaces convert_mode,
+                              gboolean replace_illegal)
+{
+    EtScanMask *self;
+    gchar *mask_copy;
+    gchar *tmp;
+    GArray *reversed;
+    gint counter = 0;
+    guint i;
+
+    g_return_val_if_fail (mask != NULL, NULL);
+
+    self = g_slice_new0 (EtScanMask);
+    self->kind = ET_SCAN_MASK_RENAME_FILE;
+    self->convert_mode = convert_mode;
+    self->no_dir_check_or_conversion = no_dir_check_or_conversion;
+    self->replace_illegal = replace_illegal;
+
+    /* Check for a directory in the mask. A relative path is relative to the
+     * directory of the file. */
+    if (!no_dir_check_or_conversion && !g_path_is_absolute (mask)
+        && strrchr (mask, G_DIR_SEPARATOR) != NULL)
+    {
+        self->prefix_current_path = TRUE;
+    }
+
+    /* Parse the codes from the end of the mask, as the generated name is
+     * built from the end. */
+    mask_copy = g_strdup (mask);
+    reversed = g_array_new (FALSE, TRUE, sizeof (EtScanMaskToken));
+
+    while ((tmp = strrchr (mask_copy, '%')) != NULL && strlen (tmp) > 1)
+    {
+        EtScanMaskToken token = { 0, };
+
+        /* Mask contains some characters after the code ('%b__'). */
+        if (strlen (tmp) > 2)
+        {
+            if (counter)
+            {
+                token.type = strchr (tmp + 2, G_DIR_SEPARATOR)
+                             ? DIRECTORY_SEPARATOR : SEPARATOR;
+            }
+            else
+            {
+                token.type = TRAILING_SEPARATOR;
+            }
+
+            token.string = g_strdup (tmp + 2);
+            token.string_len = strlen (token.string);
+            token.field_offset = -1;
+            g_array_append_val (reversed, token);
+        }
+
+        /* The code, replaced by the tag field when the mask is applied. */
+        token.type = FIELD;
+        token.code = tmp[1];
+        token.field_offset = field_offset_from_mask_code (token.code);
+        token.string = NULL;
+        token.string_len = 0;
+        g_array_append_val (reversed, token);
+
+        *tmp = '\0';
+        counter++;
+    }
+
+    /* It may have some characters before the last remaining code ('__%a'). */
+    if (!et_str_empty (mask_copy))
+    {
+        EtScanMaskToken token = { 0, };
+
+        token.type = LEADING_SEPARATOR;
+        token.string = g_strdup (mask_copy);
+        token.string_len = strlen (token.string);
+        token.field_offset = -1;
+        g_array_append_val (reversed, token);
+    }
+
+    g_free (mask_copy);
+
+    self->tokens = et_scan_mask_token_array_new ();
+
+    for (i = reversed->len; i > 0; i--)
+    {
+        g_array_append_val (self->tokens,
+                            g_array_index (reversed, EtScanMaskToken, i - 1));
+    }
+
+    /* The strings are now owned by self->tokens. */
+    g_array_free (reversed, TRUE);
+
+    return self;
+}
+
+/*
+ * et_scan_mask_free:
+ * @mask: a compiled mask
+ *
+ * Free a mask compiled by et_scan_mask_new_fill_tag() or
+ * et_scan_mask_new_rename_file().
+ */
+void
+et_scan_mask_free (EtScanMask *mask)
+{
+    guint i;
+
+    if (mask == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < mask->n_segments; i++)
+    {
+        g_array_free (mask->segments[i].tokens, TRUE);
+    }
+
+    g_free (mask->segments);
+
+    if (mask->tokens)
+    {
+        g_array_free (mask->tokens, TRUE);
+    }
+
+    g_slice_free (EtScanMask, mask);
+}
+
+static void
+et_scan_mask_field_clear (EtScanMaskField *field)
+{
+    g_free (field->string);
+}
+
+static void
+add_separator_error (GPtrArray *errors,
+                     const gchar *separator,
+                     const gchar *file_seq)
+{
+    gchar *file_seq_utf8;
+
+    if (!errors)
+    {
+        return;
+    }
+
+    file_seq_utf8 = g_filename_display_name (file_seq);
+    g_ptr_array_add (errors,
+                     g_strdup_printf (_("Cannot find separator ‘%s’ within ‘%s’"),
+                                      separator, file_seq_utf8));
+    g_free (file_seq_utf8);
+}
+
+/*
+ * et_scan_mask_fill_tag:
+ * @mask: a mask compiled with et_scan_mask_new_fill_tag()
+ * @filename_utf8: the path of the file, without the extension
+ * @errors: (element-type utf8): array to append error messages to, or %NULL
+ *
+ * Apply the mask to a filename. The mask and the path are matched from the
+ * last path component backwards.
+ *
+ * Returns: (element-type EtScanMaskField): the fields found in the filename,
+ *          to be freed with g_array_unref()
+ */
+GArray *
+et_scan_mask_fill_tag (const EtScanMask *mask,
+                       const gchar *filename_utf8,
+                       GPtrArray *errors)
+{
+    GArray *fields;
+    gchar *filename;
+    gchar **file_splitted;
+    guint file_splitted_number;
+    guint mask_index;
+    guint file_index;
+
+    g_return_val_if_fail (mask != NULL, NULL);
+    g_return_val_if_fail (mask->kind == ET_SCAN_MASK_FILL_TAG, NULL);
+    g_return_val_if_fail (filename_utf8 != NULL, NULL);
+
+    fields = g_array_new (FALSE, FALSE, sizeof (EtScanMaskField));
+    g_array_set_clear_func (fields, (GDestroyNotify)et_scan_mask_field_clear);
+
+    /* Replace characters into filename before parsing. */
+    filename = g_strdup (filename_utf8);
+
+    switch (mask->convert_mode)
+    {
+        case ET_CONVERT_SPACES_SPACES:
+            Scan_Convert_Underscore_Into_Space (filename);
+            Scan_Convert_P20_Into_Space (filename);
+            break;
+        case ET_CONVERT_SPACES_UNDERSCORES:
+            Scan_Convert_Space_Into_Underscore (filename);
+            break;
+        case ET_CONVERT_SPACES_NO_CHANGE:
+        case ET_CONVERT_SPACES_REMOVE:
+        default:
+            break;
+    }
+
+    file_splitted = g_strsplit (filename, G_DIR_SEPARATOR_S, 0);
+    file_splitted_number = g_strv_length (file_splitted);
+
+    /* Set the starting position for each array. */
+    if (mask->n_segments <= file_splitted_number)
+    {
+        mask_index = 0;
+        file_index = file_splitted_number - mask->n_segments;
+    }
+    else
+    {
+        mask_index = mask->n_segments - file_splitted_number;
+        file_index = 0;
+    }
+
+    for (; mask_index < mask->n_segments && file_index < file_splitted_number;
+         mask_index++, file_index++)
+    {
+        const GArray *tokens = mask->segments[mask_index].tokens;
+        const gchar *file_seq = file_splitted[file_index];
+        guint i;
+
+        for (i = 0; i < tokens->len; i++)
+        {
+            const EtScanMaskToken *token = &g_array_index (tokens,
+                                                           EtScanMaskToken,
+                                                           i);
+            EtScanMaskField field;
+
+            field.code = token->code;
+
+            /* Skip the text before the code. */
+            if (token->leading)
+            {
+                if (strncmp (file_seq, token->leading, token->leading_len)
+                    == 0)
+                {
+                    file_seq += token->leading_len;
+                }
+                else
+                {
+                    add_separator_error (errors, token->leading,
+                                         file_splitted[file_index]);
+                }
+            }
+
+            if (token->string)
+            {
+                const gchar *tmp;
+
+                /* Try to find the separator in 'file_seq'. */
+                if ((tmp = strstr (file_seq, token->string)) == NULL)
+                {
+                    add_separator_error (errors, token->string,
+                                         file_splitted[file_index]);
+                    field.string = g_strdup (file_seq);
+                    file_seq += strlen (file_seq);
+                }
+                else
+                {
+                    field.string = g_strndup (file_seq, tmp - file_seq);
+                    file_seq = tmp + token->string_len;
+                }
+            }
+            else
+            {
+                /* The remaining text is affected to the code (no more data
+                 * in the mask). */
+                field.string = g_strdup (file_seq);
+            }
+
+            g_array_append_val (fields, field);
+        }
+    }
+
+    g_strfreev (file_splitted);
+    g_free (filename);
+
+    return fields;
+}
+
+/*
+ * EtScanMaskItem:
+ * @type: the type of the item, with codes resolved to %FIELD or %EMPTY_FIELD
+ * @string: the text of the item, or %NULL for an empty field
+ */
+typedef struct
+{
+    Mask_Item_Type type;
+    const gchar *string;
+} EtScanMaskItem;
+
+/*
+ * convert_field:
+ * @mask: a mask compiled with et_scan_mask_new_rename_file()
+ * @value: the value of the tag field
+ *
+ * Returns: a copy of @value, with spaces and illegal characters converted
+ */
+static gchar *
+convert_field (const EtScanMask *mask,
+               const gchar *value)
+{
+    gchar *string = g_strdup (value);
+
+    /* Do not replace characters in a playlist information field. */
+    if (!mask->no_dir_check_or_conversion)
+    {
+        switch (mask->convert_mode)
+        {
+            case ET_CONVERT_SPACES_SPACES:
+                Scan_Convert_Underscore_Into_Space (string);
+                Scan_Convert_P20_Into_Space (string);
+                break;
+            case ET_CONVERT_SPACES_UNDERSCORES:
+                Scan_Convert_Space_Into_Underscore (string);
+                break;
+            case ET_CONVERT_SPACES_REMOVE:
+                Scan_Remove_Spaces (string);
+                break;
+            /* FIXME: Check that this is intended. */
+            case ET_CONVERT_SPACES_NO_CHANGE:
+            default:
+                g_assert_not_reached ();
+        }
+
+        /* This must occur after the space processing, to ensure that a
+         * trailing space cannot be present (if illegal characters are to be
+         * replaced). */
+        et_filename_prepare (string, mask->replace_illegal);
+    }
+
+    return string;
+}
+
+static void
+copy_field (File_Tag *destination,
+            const File_Tag *source,
+            goffset field_offset)
+{
+    gchar **field = &G_STRUCT_MEMBER (gchar *, destination, field_offset);
+
+    g_free (*field);
+    *field = g_strdup (G_STRUCT_MEMBER (const gchar *, source, field_offset));
+}
+
+/*
+ * et_scan_mask_copy_fields:
+ * @mask: (allow-none): a mask compiled with et_scan_mask_new_rename_file(), or
+ *        %NULL for any rename file mask
+ * @destination: the tag to copy the fields into
+ * @source: the tag to copy the fields from
+ *
+ * Copy only the fields of @source which @mask references, so that the mask
+ * can later be applied to @destination instead. The pictures and the other
+ * fields are never copied, as a mask cannot reference them.
+ */
+void
+et_scan_mask_copy_fields (const EtScanMask *mask,
+                          File_Tag *destination,
+                          const File_Tag *source)
+{
+    g_return_if_fail (mask == NULL || mask->kind == ET_SCAN_MASK_RENAME_FILE);
+    g_return_if_fail (destination != NULL);
+    g_return_if_fail (source != NULL);
+
+    if (mask == NULL)
+    {
+        static const gchar codes[] = "tabdxynlgcporuez";
+        const gchar *code;
+
+        for (code = codes; *code != '\0'; code++)
+        {
+            copy_field (destination, source,
+                        field_offset_from_mask_code (*code));
+        }
+    }
+    else
+    {
+        guint i;
+
+        for (i = 0; i < mask->tokens->len; i++)
+        {
+            const EtScanMaskToken *token = &g_array_index (mask->tokens,
+                                                           EtScanMaskToken, i);
+
+            if (token->type == FIELD && token->field_offset >= 0)
+            {
+                copy_field (destination, source, token->field_offset);
+            }
+        }
+    }
+}
+
+/*
+ * et_scan_mask_rename_file:
+ * @mask: a mask compiled with et_scan_mask_new_rename_file()
+ * @file_tag: the tag to take field values from
+ * @current_filename_utf8: the current path of the file, used when the mask
+ *                         contains a relative directory
+ *
+ * Generate a filename by replacing the codes in the mask with tag fields.
+ * Separators next to empty fields are dropped.
+ *
+ * Returns: the new filename in UTF-8, or %NULL if the mask was empty
+ */
+gchar *
+et_scan_mask_rename_file (const EtScanMask *mask,
+                          const File_Tag *file_tag,
+                          const gchar *current_filename_utf8)
+{
+    EtScanMaskItem *items;
+    gchar **converted;
+    GString *filename;
+    guint n_items;
+    gint i;
+
+    g_return_val_if_fail (mask != NULL, NULL);
+    g_return_val_if_fail (mask->kind == ET_SCAN_MASK_RENAME_FILE, NULL);
+    g_return_val_if_fail (file_tag != NULL, NULL);
+
+    n_items = mask->tokens->len;
+
+    if (n_items == 0)
+    {
+        return NULL;
+    }
+
+    items = g_new (EtScanMaskItem, n_items);
+    converted = g_new0 (gchar *, n_items);
+
+    /* Resolve the codes to the field values of this file. */
+    for (i = 0; i < (gint)n_items; i++)
+    {
+        const EtScanMaskToken *token = &g_array_index (mask->tokens,
+                                                       EtScanMaskToken, i);
+
+        if (token->type == FIELD)
+        {
+            const gchar *value = NULL;
+
+            if (token->field_offset >= 0)
+            {
+                value = G_STRUCT_MEMBER (const gchar *, file_tag,
+                                         token->field_offset);
+            }
+
+            if (!et_str_empty (value))
+            {
+                converted[i] = convert_field (mask, value);
+                items[i].type = FIELD;
+                items[i].string = converted[i];
+            }
+            else
+            {
+                items[i].type = EMPTY_FIELD;
+                items[i].string = NULL;
+            }
+        }
+        else
+        {
+            items[i].type = token->type;
+            items[i].string = token->string;
+        }
+    }
+
+    /* Build the new filename with the items (read from the end to the
+     * beginning). */
+    filename = g_string_new ("");
+
+    for (i = n_items - 1; i >= 0; i--)
+    {
+        if (items[i].type == TRAILING_SEPARATOR)
+        {
+            /* Doesn't write it if previous field is empty. */
+            if (i > 0 && items[i - 1].type != EMPTY_FIELD)
+            {
+                g_string_prepend (filename, items[i].string);
+            }
+        }
+        else if (items[i].type == EMPTY_FIELD)
+        {
+            /* We don't concatenate the field value (empty) and the previous
+             * separator (except leading separator) to the filename. If the
+             * empty field is the 'first', we don't concatenate it, and the
+             * next separator too. */
+            if (i > 0)
+            {
+                /* The empty field isn't the first. If the previous item is a
+                 * separator, we don't use it, except if the second item of
+                 * the mask is a non-empty field. */
+                if (items[i - 1].type == SEPARATOR)
+                {
+                    if (!(i + 1 < (gint)n_items && items[1].type == FIELD))
+                    {
+                        i--;
+                    }
+                }
+            }
+            else if (i + 1 < (gint)n_items && items[i + 1].type == SEPARATOR)
+            {
+                /* We are at the 'beginning' of the mask (so empty field is
+                 * the first) and next field is a separator. As the separator
+                 * may have been already added, we remove it. */
+                const gchar *separator = items[i + 1].string;
+
+                if (separator && g_str_has_prefix (filename->str, separator))
+                {
+                    g_string_erase (filename, 0, strlen (separator));
+                }
+            }
+        }
+        else
+        {
+            /* SEPARATOR, FIELD, LEADING_SEPARATOR, DIRECTORY_SEPARATOR. */
+            g_string_prepend (filename, items[i].string);
+        }
+    }
+
+    for (i = 0; i < (gint)n_items; i++)
+    {
+        g_free (converted[i]);
+    }
+
+    g_free (converted);
+    g_free (items);
+
+    /* Add current path if relative path entered. */
+    if (mask->prefix_current_path && current_filename_utf8)
+    {
+        gchar *path_utf8_cur;
+        gchar *filename_new_utf8;
+
+        path_utf8_cur = g_path_get_dirname (current_filename_utf8);
+        filename_new_utf8 = g_build_filename (path_utf8_cur, filename->str,
+                                              NULL);
+        g_free (path_utf8_cur);
+        g_string_free (filename, TRUE);
+
+        return filename_new_utf8;
+    }
+
+    return g_string_free (filename, FALSE);
+}
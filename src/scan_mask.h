@@ -0,0 +1,59 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_SCAN_MASK_H_
+#define ET_SCAN_MASK_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#include "file_tag.h"
+#include "setting.h"
+
+/*
+ * EtScanMask:
+ *
+ * A scanner mask, compiled once so that it can be applied to many files
+ * without parsing the mask again. A compiled mask is immutable, so it can be
+ * shared between threads.
+ */
+typedef struct _EtScanMask EtScanMask;
+
+/*
+ * EtScanMaskField:
+ * @code: the mask code, without the leading '%'
+ * @string: the text found for the code
+ */
+typedef struct
+{
+    gchar code;
+    gchar *string;
+} EtScanMaskField;
+
+EtScanMask * et_scan_mask_new_fill_tag (const gchar *mask, EtConvertSpaces convert_mode);
+EtScanMask * et_scan_mask_new_rename_file (const gchar *mask, gboolean no_dir_check_or_conversion, EtConvertSpaces convert_mode, gboolean replace_illegal);
+void et_scan_mask_free (EtScanMask *mask);
+
+GArray * et_scan_mask_fill_tag (const EtScanMask *mask, const gchar *filename_utf8, GPtrArray *errors);
+gchar * et_scan_mask_rename_file (const EtScanMask *mask, const File_Tag *file_tag, const gchar *current_filename_utf8);
+void et_scan_mask_copy_fields (const EtScanMask *mask, File_Tag *destination, const File_Tag *source);
+
+G_END_DECLS
+
+#endif /* !ET_SCAN_MASK_H_ */
@@ -468,162 +468,30 @@ Search_File (GtkWidget *search_button,
         /* Search in the tag. */
         if (g_settings_get_boolean (MainSettings, "search-tag"))
         {
-            gchar *title2, *artist2, *album_artist2, *album2, *disc_number2,
-                  *disc_total2, *year2, *track2, *track_total2, *genre2,
-                  *comment2, *composer2, *orig_artist2, *copyright2, *url2,
-                  *encoded_by2;
+            gboolean case_sensitive;
             gchar *needle;
-            const File_Tag *FileTag = (File_Tag *)ETFile->FileTag->data;
 
-            if (!g_settings_get_boolean (MainSettings, "search-case-sensitive"))
+            case_sensitive = g_settings_get_boolean (MainSettings,
+                                                     "search-case-sensitive");
+
+            if (!case_sensitive)
             {
                 /* To search without case sensitivity. */
-                title2 = FileTag->title ? g_utf8_casefold (FileTag->title, -1)
-                                        : NULL;
-                artist2 = FileTag->artist ? g_utf8_casefold (FileTag->artist,
-                                                             -1)
-                                          : NULL;
-                album_artist2 = FileTag->album_artist ? g_utf8_casefold (FileTag->album_artist,
-                                                                         -1)
-                                          : NULL;
-                album2 = FileTag->album ? g_utf8_casefold (FileTag->album, -1)
-                                          : NULL;
-                disc_number2 = FileTag->disc_number ? g_utf8_casefold (FileTag->disc_number,
-                                                                       -1)
-                                                    : NULL;
-                disc_total2 = FileTag->disc_total ? g_utf8_casefold (FileTag->disc_total,
-                                                                     -1)
-                                                  : NULL;
-                year2 = FileTag->year ? g_utf8_casefold (FileTag->year, -1)
-                                      : NULL;
-                track2 = FileTag->track ? g_utf8_casefold (FileTag->track, -1)
-                                        : NULL;
-                track_total2 = FileTag->track_total ? g_utf8_casefold (FileTag->track_total,
-                                                                       -1)
-                                                    : NULL;
-                genre2 = FileTag->genre ? g_utf8_casefold (FileTag->genre, -1)
-                                        : NULL;
-                comment2 = FileTag->comment ? g_utf8_casefold (FileTag->comment,
-                                                               -1)
-                                            : NULL;
-                composer2 = FileTag->composer ? g_utf8_casefold (FileTag->composer,
-                                                                 -1)
-                                              : NULL;
-                orig_artist2 = FileTag->orig_artist ? g_utf8_casefold (FileTag->orig_artist,
-                                                                       -1)
-                                                    : NULL;
-                copyright2 = FileTag->copyright ? g_utf8_casefold (FileTag->copyright,
-                                                                   -1)
-                                                : NULL;
-                url2 = FileTag->url ? g_utf8_casefold (FileTag->url, -1)
-                                    : NULL;
-                encoded_by2 = FileTag->encoded_by ? g_utf8_casefold (FileTag->encoded_by,
-                                                                     -1)
-                                                  : NULL;
                 needle = g_utf8_casefold (string_to_search, -1);
             }
             else
             {
                 /* To search with case-sensitivity. */
-                title2 = FileTag->disc_number ? g_utf8_normalize (FileTag->title,
-                                                                  -1,
-                                                                  G_NORMALIZE_DEFAULT)
-                                              : NULL;
-                artist2 = FileTag->artist ? g_utf8_normalize (FileTag->artist,
-                                                              -1,
-                                                              G_NORMALIZE_DEFAULT)
-                                          : NULL;
-                album_artist2 = FileTag->album_artist ? g_utf8_normalize (FileTag->album_artist,
-                                                                          -1,
-                                                                          G_NORMALIZE_DEFAULT)
-                                                      : NULL;
-                album2 = FileTag->album ? g_utf8_normalize (FileTag->album, -1,
-                                                            G_NORMALIZE_DEFAULT)
-                                        : NULL;
-                disc_number2 = FileTag->disc_number ? g_utf8_normalize (FileTag->disc_number,
-                                                                        -1,
-                                                                        G_NORMALIZE_DEFAULT)
-                                                     : NULL;
-                disc_total2 = FileTag->disc_total ? g_utf8_normalize (FileTag->disc_total,
-                                                                      -1,
-                                                                      G_NORMALIZE_DEFAULT)
-                                                  : NULL;
-                year2 = FileTag->year ? g_utf8_normalize (FileTag->year, -1,
-                                                          G_NORMALIZE_DEFAULT)
-                                      : NULL;
-                track2 = FileTag->track ? g_utf8_normalize (FileTag->track, -1,
-                                                            G_NORMALIZE_DEFAULT)
-                                        : NULL;
-                track_total2 = FileTag->track_total ? g_utf8_normalize (FileTag->track_total,
-                                                                        -1,
-                                                                        G_NORMALIZE_DEFAULT)
-                                                    : NULL;
-                genre2 = FileTag->genre ? g_utf8_normalize (FileTag->genre, -1,
-                                                            G_NORMALIZE_DEFAULT)
-                                        : NULL;
-                comment2 = FileTag->comment ? g_utf8_normalize (FileTag->comment,
-                                                                -1,
-                                                                G_NORMALIZE_DEFAULT)
-                                            : NULL;
-                composer2 = FileTag->composer ? g_utf8_normalize (FileTag->composer,
-                                                                  -1,
-                                                                  G_NORMALIZE_DEFAULT)
-                                              : NULL;
-                orig_artist2 = FileTag->orig_artist ? g_utf8_normalize (FileTag->orig_artist,
-                                                                        -1,
-                                                                        G_NORMALIZE_DEFAULT)
-                                                    : NULL;
-                copyright2 = FileTag->copyright ? g_utf8_normalize (FileTag->copyright,
-                                                                    -1,
-                                                                    G_NORMALIZE_DEFAULT)
-                                                : NULL;
-                url2 = FileTag->url ? g_utf8_normalize (FileTag->url, -1,
-                                                        G_NORMALIZE_DEFAULT)
-                                    : NULL;
-                encoded_by2 = FileTag->encoded_by ? g_utf8_normalize (FileTag->encoded_by,
-                                                                      -1,
-                                                                      G_NORMALIZE_DEFAULT)
-                                                  : NULL;
                 needle = g_utf8_normalize (string_to_search, -1,
                                            G_NORMALIZE_DEFAULT);
             }
 
-            if ((title2 && strstr (title2, needle))
-                || (artist2 && strstr (artist2, needle))
-                || (album_artist2 && strstr (album_artist2, needle))
-                || (album2 && strstr (album2, needle))
-                || (disc_number2 && strstr (disc_number2, needle))
-                || (disc_total2 && strstr (disc_total2, needle))
-                || (year2 && strstr (year2, needle))
-                || (track2 && strstr (track2, needle))
-                || (track_total2 && strstr (track_total2, needle))
-                || (genre2 && strstr (genre2, needle))
-                || (comment2 && strstr (comment2, needle))
-                || (composer2 && strstr (composer2, needle))
-                || (orig_artist2 && strstr (orig_artist2, needle))
-                || (copyright2 && strstr (copyright2, needle))
-                || (url2 && strstr (url2, needle))
-                || (encoded_by2 && strstr (encoded_by2, needle)))
+            if (et_file_tag_matches ((File_Tag *)ETFile->FileTag->data,
+                                     needle, case_sensitive))
             {
                 Add_Row_To_Search_Result_List (self, ETFile, string_to_search);
             }
 
-            g_free (title2);
-            g_free (artist2);
-            g_free (album_artist2);
-            g_free (album2);
-            g_free (disc_number2);
-            g_free (disc_total2);
-            g_free (year2);
-            g_free (track2);
-            g_free (track_total2);
-            g_free (genre2);
-            g_free (comment2);
-            g_free (composer2);
-            g_free (orig_artist2);
-            g_free (copyright2);
-            g_free (url2);
-            g_free (encoded_by2);
             g_free (needle);
         }
     }
@@ -30,6 +30,7 @@
 #include "log.h"
 #include "misc.h"
 #include "picture.h"
+#include "picture_thumbnail.h"
 #include "scan.h"
 #include "scan_dialog.h"
 
@@ -86,6 +87,8 @@ typedef struct
 
     /* Image treeview model. */
     GtkListStore *images_model;
+    /* Cancels the thumbnails being decoded for the displayed file. */
+    GCancellable *images_cancellable;
 
     /* Mini buttons. */
     GtkWidget *track_sequence_button;
@@ -139,7 +142,7 @@ on_apply_to_selection (GObject *object,
     const gchar *string_to_set1;
     gchar *msg = NULL;
     ET_File *etfile;
-    File_Tag *FileTag;
+    EtFileTagEdit *edit;
 
     g_return_if_fail (ETCore->ETFileDisplayedList != NULL);
 
@@ -151,17 +154,18 @@ on_apply_to_selection (GObject *object,
 
     etfilelist = et_application_window_browser_get_selected_files (window);
 
+    /* The changes to all the files are undone at once. */
+    edit = et_file_tag_edit_new ();
+
     if (object == G_OBJECT (priv->title_entry))
     {
         string_to_set = gtk_entry_get_text (GTK_ENTRY (priv->title_entry));
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_title (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_TITLE,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -180,11 +184,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_artist (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_ARTIST,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -203,11 +205,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_album_artist (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_ALBUM_ARTIST,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -226,11 +226,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_album (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_ALBUM,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -266,12 +264,13 @@ on_apply_to_selection (GObject *object,
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
             etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_disc_number (FileTag, disc_number ? disc_number
-                                                              : string_to_set);
-            et_file_tag_set_disc_total (FileTag, string_to_set1);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, etfile,
+                                        ET_FILE_TAG_FIELD_DISC_NUMBER,
+                                        disc_number ? disc_number
+                                                    : string_to_set);
+            et_file_tag_edit_set_field (edit, etfile,
+                                        ET_FILE_TAG_FIELD_DISC_TOTAL,
+                                        string_to_set1);
         }
 
         if (!et_str_empty (string_to_set))
@@ -301,11 +300,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_year (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_YEAR,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -327,18 +324,19 @@ on_apply_to_selection (GObject *object,
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
             etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
 
             // We apply the TrackEntry field to all others files only if it is to delete
             // the field (string=""). Else we don't overwrite the track number
             if (et_str_empty (string_to_set))
             {
-                et_file_tag_set_track_number (FileTag, string_to_set);
+                et_file_tag_edit_set_field (edit, etfile,
+                                            ET_FILE_TAG_FIELD_TRACK_NUMBER,
+                                            string_to_set);
             }
 
-            et_file_tag_set_track_total (FileTag, string_to_set1);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, etfile,
+                                        ET_FILE_TAG_FIELD_TRACK_TOTAL,
+                                        string_to_set1);
         }
 
         if (!et_str_empty (string_to_set))
@@ -395,10 +393,9 @@ on_apply_to_selection (GObject *object,
             // The file is in the selection?
             if ( (ET_File *)etfilelistfull->data == etfile )
             {
-                FileTag = et_file_tag_new ();
-                et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-                et_file_tag_set_track_number (FileTag, track_string);
-                ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+                et_file_tag_edit_set_field (edit, etfile,
+                                            ET_FILE_TAG_FIELD_TRACK_NUMBER,
+                                            track_string);
 
                 if (!etfilelist->next) break;
                 etfilelist = g_list_next(etfilelist);
@@ -440,10 +437,9 @@ on_apply_to_selection (GObject *object,
                 track_total = g_strdup (track_string);
             }
 
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_track_total (FileTag, track_string);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, etfile,
+                                        ET_FILE_TAG_FIELD_TRACK_TOTAL,
+                                        track_string);
 
             g_free (track_string);
         }
@@ -466,11 +462,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_genre (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_GENRE,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -496,11 +490,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_comment (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_COMMENT,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -519,11 +511,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_composer (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_COMPOSER,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -542,11 +532,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_orig_artist (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_ORIG_ARTIST,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -565,11 +553,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_copyright (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_COPYRIGHT,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -588,11 +574,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_url (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_URL,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -611,11 +595,9 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_encoded_by (FileTag, string_to_set);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_field (edit, (ET_File *)l->data,
+                                        ET_FILE_TAG_FIELD_ENCODED_BY,
+                                        string_to_set);
         }
 
         if (!et_str_empty (string_to_set))
@@ -653,11 +635,7 @@ on_apply_to_selection (GObject *object,
 
         for (l = etfilelist; l != NULL; l = g_list_next (l))
         {
-            etfile = (ET_File *)l->data;
-            FileTag = et_file_tag_new ();
-            et_file_tag_copy_into (FileTag, etfile->FileTag->data);
-            et_file_tag_set_picture (FileTag, res);
-            ET_Manage_Changes_Of_File_Data(etfile,NULL,FileTag);
+            et_file_tag_edit_set_picture (edit, (ET_File *)l->data, res);
         }
         if (res)
         {
@@ -673,6 +651,8 @@ on_apply_to_selection (GObject *object,
 
     g_list_free(etfilelist);
 
+    et_file_tag_edit_commit (edit);
+
     /* Refresh the whole list (faster than file by file) to show changes. */
     et_application_window_browser_refresh_list (window);
 
@@ -1238,145 +1218,214 @@ PictureEntry_Clear (EtTagArea *self)
 
     priv = et_tag_area_get_instance_private (self);
 
+    /* Abandon thumbnails still being decoded for the previous file. */
+    g_cancellable_cancel (priv->images_cancellable);
+    g_clear_object (&priv->images_cancellable);
+    priv->images_cancellable = g_cancellable_new ();
+
     gtk_list_store_clear (priv->images_model);
 }
 
+/*
+ * EtPictureThumbnailData:
+ * @self: the #EtTagArea
+ * @row: the row of the images model to update once the thumbnail is ready
+ * @set_size: whether to store the decoded size in the picture, rather than
+ *            only displaying it
+ */
+typedef struct
+{
+    EtTagArea *self;
+    GtkTreeRowReference *row;
+    gboolean set_size;
+} EtPictureThumbnailData;
+
 static void
-PictureEntry_Update (EtTagArea *self,
-                     EtPicture *pic,
-                     gboolean select_it)
+et_picture_thumbnail_data_free (EtPictureThumbnailData *data)
 {
+    gtk_tree_row_reference_free (data->row);
+    g_object_unref (data->self);
+    g_slice_free (EtPictureThumbnailData, data);
+}
+
+static void
+on_picture_thumbnail_loaded (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+    EtPictureThumbnailData *data = user_data;
     EtTagAreaPrivate *priv;
-    GdkPixbufLoader *loader = 0;
+    GdkPixbuf *pixbuf;
+    gint width;
+    gint height;
+    gint scale_factor;
+    GdkWindow *view_window;
+    GtkTreePath *path;
+    GtkTreeIter iter;
     GError *error = NULL;
-    
-    g_return_if_fail (pic != NULL);
 
-    priv = et_tag_area_get_instance_private (self);
+    pixbuf = et_picture_thumbnail_load_finish (result, &width, &height,
+                                               &error);
 
-    if (g_bytes_get_size (pic->bytes) == 0)
+    if (!pixbuf && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
     {
-        goto next;
+        g_error_free (error);
+        et_picture_thumbnail_data_free (data);
+        return;
+    }
+
+    priv = et_tag_area_get_instance_private (data->self);
+    path = gtk_tree_row_reference_get_path (data->row);
+
+    /* The row was removed in the meantime. */
+    if (!path || !gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->images_model),
+                                           &iter, path))
+    {
+        gtk_tree_path_free (path);
+        g_clear_object (&pixbuf);
+        g_clear_error (&error);
+        et_picture_thumbnail_data_free (data);
+        return;
     }
 
-    loader = gdk_pixbuf_loader_new ();
+    gtk_tree_path_free (path);
 
-    if (loader)
+    /* TODO: Connect to notify:scale-factor and update when the scale
+     * changes. */
+    scale_factor = gtk_widget_get_scale_factor (priv->images_view);
+
+    /* This ties the model to the view, so if the model is to be shared in the
+     * future, the surface should be per-view. */
+    view_window = gtk_widget_get_window (priv->images_view);
+
+    if (pixbuf)
     {
-        if (gdk_pixbuf_loader_write_bytes (loader, pic->bytes, &error))
+        EtPicture *pic;
+        cairo_surface_t *surface;
+        gchar *pic_info;
+
+        /* The model holds a copy of the picture. */
+        gtk_tree_model_get (GTK_TREE_MODEL (priv->images_model), &iter,
+                            PICTURE_COLUMN_DATA, &pic, -1);
+
+        pic->width = width;
+        pic->height = height;
+
+        surface = gdk_cairo_surface_create_from_pixbuf (pixbuf, scale_factor,
+                                                        view_window);
+        pic_info = et_picture_format_info (pic,
+                                           ETCore->ETFileDisplayed->ETFileDescription->TagType);
+        gtk_list_store_set (priv->images_model, &iter,
+                            PICTURE_COLUMN_SURFACE, surface,
+                            PICTURE_COLUMN_TEXT, pic_info, -1);
+
+        /* Pictures which are displayed from the tag are kept as they are, so
+         * that displaying a file never changes its tag. */
+        if (data->set_size)
         {
-            GtkTreeSelection *selection;
-            GdkPixbuf *pixbuf;
+            gtk_list_store_set (priv->images_model, &iter,
+                                PICTURE_COLUMN_DATA, pic, -1);
+        }
 
-            if (!gdk_pixbuf_loader_close(loader, &error))
-            {
-                Log_Print (LOG_ERROR, _("Error parsing image data ‘%s’"),
-                           error->message);
-                g_error_free (error);
-            }
+        g_free (pic_info);
+        cairo_surface_destroy (surface);
+        et_picture_free (pic);
+        g_object_unref (pixbuf);
+    }
+    else
+    {
+        cairo_surface_t *surface;
 
-            selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->images_view));
+        /* Keep the picture in the tag, even if it cannot be displayed. */
+        Log_Print (LOG_ERROR, _("Error parsing image data ‘%s’"),
+                   error->message);
+        g_clear_error (&error);
 
-            pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
-            if (pixbuf)
-            {
-                GtkTreeIter iter1;
-                gint scale_factor;
-                GdkPixbuf *scaled_pixbuf;
-                cairo_surface_t *surface;
-                GdkWindow *view_window;
-                gint scaled_pixbuf_width;
-                gint scaled_pixbuf_height;
-                gchar *pic_info;
-
-                g_object_ref(pixbuf);
-                g_object_unref(loader);
-                
-                // Keep aspect ratio of the picture
-                pic->width  = gdk_pixbuf_get_width(pixbuf);
-                pic->height = gdk_pixbuf_get_height(pixbuf);
-                /* TODO: Connect to notify:scale-factor and update when the
-                 * scale changes. */
-                scale_factor = gtk_widget_get_scale_factor (priv->images_view);
-
-                if (pic->width > pic->height)
-                {
-                    scaled_pixbuf_width = 96 * scale_factor;
-                    scaled_pixbuf_height = 96 * scale_factor * pic->height
-                                           / pic->width;
-                }else
-                {
-                    scaled_pixbuf_width = 96 * scale_factor * pic->width
-                                          / pic->height;
-                    scaled_pixbuf_height = 96 * scale_factor;
-                }
+        surface = gtk_icon_theme_load_surface (gtk_icon_theme_get_default (),
+                                               "image-missing", 96,
+                                               scale_factor, view_window, 0,
+                                               &error);
 
-                scaled_pixbuf = gdk_pixbuf_scale_simple (pixbuf,
-                                                         scaled_pixbuf_width,
-                                                         scaled_pixbuf_height,
-                                                         GDK_INTERP_BILINEAR);
-                g_object_unref (pixbuf);
-
-                /* This ties the model to the view, so if the model is to be
-                 * shared in the future, the surface should be per-view. */
-                view_window = gtk_widget_get_window (priv->images_view);
-                surface = gdk_cairo_surface_create_from_pixbuf (scaled_pixbuf,
-                                                                scale_factor,
-                                                                view_window);
-                pic_info = et_picture_format_info (pic,
-                                                   ETCore->ETFileDisplayed->ETFileDescription->TagType);
-                gtk_list_store_insert_with_values (priv->images_model, &iter1,
-                                                   G_MAXINT,
-                                                   PICTURE_COLUMN_SURFACE,
-                                                   surface,
-                                                   PICTURE_COLUMN_TEXT,
-                                                   pic_info,
-                                                   PICTURE_COLUMN_DATA,
-                                                   pic, -1);
-                g_free(pic_info);
-
-                if (select_it)
-                    gtk_tree_selection_select_iter(selection, &iter1);
-                g_object_unref(scaled_pixbuf);
-            }else
-            {
-                GtkWidget *msgdialog;
-                
-                g_object_unref(loader);
-                
-                Log_Print (LOG_ERROR, "%s",
-                           _("Cannot display the image because not enough data has been read to determine how to create the image buffer"));
-
-                msgdialog = gtk_message_dialog_new(GTK_WINDOW(MainWindow),
-                                                   GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
-                                                   GTK_MESSAGE_ERROR,
-                                                   GTK_BUTTONS_CLOSE,
-                                                   "%s",
-                                                   _("Cannot display the image"));
-                gtk_message_dialog_format_secondary_text (GTK_MESSAGE_DIALOG (msgdialog),
-                                                          _("Not enough data has been read to determine how to create the image buffer."));
-                gtk_window_set_title (GTK_WINDOW (msgdialog),
-                                      _("Load Image File"));
-                gtk_dialog_run(GTK_DIALOG(msgdialog));
-                gtk_widget_destroy(msgdialog);
-            }
+        if (surface)
+        {
+            gtk_list_store_set (priv->images_model, &iter,
+                                PICTURE_COLUMN_SURFACE, surface, -1);
+            cairo_surface_destroy (surface);
         }
         else
         {
-            Log_Print (LOG_ERROR, _("Error parsing image data ‘%s’"),
-                       error->message);
+            g_debug ("Error loading placeholder image: %s", error->message);
             g_error_free (error);
         }
     }
 
-next:
-    /* Do also for next picture. */
-    if (pic->next)
+    et_picture_thumbnail_data_free (data);
+}
+
+/*
+ * PictureEntry_Update:
+ * @self: the #EtTagArea
+ * @pic: the first picture of the list to add to the images view
+ * @select_it: whether the pictures were added by the user, in which case they
+ *             are selected and their decoded size is stored
+ *
+ * Add the pictures to the images view. The rows are added immediately, and
+ * the thumbnails are filled in when they have been decoded in the background,
+ * so that stepping through files with large images does not block the UI.
+ */
+static void
+PictureEntry_Update (EtTagArea *self,
+                     EtPicture *pic,
+                     gboolean select_it)
+{
+    EtTagAreaPrivate *priv;
+    GtkTreeSelection *selection;
+    gint scale_factor;
+    
+    g_return_if_fail (pic != NULL);
+
+    priv = et_tag_area_get_instance_private (self);
+    selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (priv->images_view));
+    scale_factor = gtk_widget_get_scale_factor (priv->images_view);
+
+    for (; pic != NULL; pic = pic->next)
     {
-        PictureEntry_Update (self, pic->next, select_it);
-    }
+        GtkTreeIter iter1;
+        GtkTreePath *path;
+        gchar *pic_info;
+        EtPictureThumbnailData *data;
+
+        if (g_bytes_get_size (pic->bytes) == 0)
+        {
+            continue;
+        }
+
+        pic_info = et_picture_format_info (pic,
+                                           ETCore->ETFileDisplayed->ETFileDescription->TagType);
+        gtk_list_store_insert_with_values (priv->images_model, &iter1,
+                                           G_MAXINT,
+                                           PICTURE_COLUMN_TEXT, pic_info,
+                                           PICTURE_COLUMN_DATA, pic, -1);
+        g_free (pic_info);
 
-    return;
+        if (select_it)
+        {
+            gtk_tree_selection_select_iter (selection, &iter1);
+        }
+
+        path = gtk_tree_model_get_path (GTK_TREE_MODEL (priv->images_model),
+                                        &iter1);
+        data = g_slice_new (EtPictureThumbnailData);
+        data->self = g_object_ref (self);
+        data->set_size = select_it;
+        data->row = gtk_tree_row_reference_new (GTK_TREE_MODEL (priv->images_model),
+                                                path);
+        gtk_tree_path_free (path);
+
+        et_picture_thumbnail_load_async (pic, 96, scale_factor,
+                                         priv->images_cancellable,
+                                         on_picture_thumbnail_loaded, data);
+    }
 }
 
 
@@ -2212,13 +2261,35 @@ create_tag_area (EtTagArea *self)
                        GDK_ACTION_COPY);
 }
 
+static void
+et_tag_area_dispose (GObject *object)
+{
+    EtTagAreaPrivate *priv;
+
+    priv = et_tag_area_get_instance_private (ET_TAG_AREA (object));
+
+    if (priv->images_cancellable)
+    {
+        g_cancellable_cancel (priv->images_cancellable);
+        g_clear_object (&priv->images_cancellable);
+    }
+
+    G_OBJECT_CLASS (et_tag_area_parent_class)->dispose (object);
+}
+
 static void
 et_tag_area_init (EtTagArea *self)
 {
+    EtTagAreaPrivate *priv;
+
+    priv = et_tag_area_get_instance_private (self);
+
     /* Ensure that the boxed type is registered before using it in
      * GtkBuilder. */
     et_picture_get_type ();
 
+    priv->images_cancellable = g_cancellable_new ();
+
     gtk_widget_init_template (GTK_WIDGET (self));
     create_tag_area (self);
 }
@@ -2228,6 +2299,8 @@ et_tag_area_class_init (EtTagAreaClass *klass)
 {
     GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+    G_OBJECT_CLASS (klass)->dispose = et_tag_area_dispose;
+
     gtk_widget_class_set_template_from_resource (widget_class,
                                                  "/org/gnome/EasyTAG/tag_area.ui");
     gtk_widget_class_bind_template_child_private (widget_class, EtTagArea,
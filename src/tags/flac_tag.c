@@ -34,153 +34,10 @@
 #include "setting.h"
 #include "picture.h"
 #include "charset.h"
+#include "vorbis_comment.h"
 
 #define MULTIFIELD_SEPARATOR " - "
 
-/*
- * validate_field_utf8:
- * @field_value: the string to validate
- * @field_len: the length of the string
- *
- * Validate a Vorbis comment field to ensure that it is UTF-8. Either return a
- * duplicate of the original (valid) string, or a converted equivalent (of an
- * invalid UTF-8 string).
- *
- * Returns: a valid UTF-8 represenation of @field_value
- */
-static gchar *
-validate_field_utf8 (const gchar *field_value,
-                     guint32 field_len)
-{
-    gchar *result;
-
-    if (g_utf8_validate (field_value, field_len, NULL))
-    {
-        result = g_strndup (field_value, field_len);
-    }
-    else
-    {
-        gchar *field_value_tmp = g_strndup (field_value,
-                                            field_len);
-        /* Unnecessarily validates the field again, but this should not be the
-         * common case. */
-        result = Try_To_Validate_Utf8_String (field_value_tmp);
-        g_free (field_value_tmp);
-    }
-
-    return result;
-}
-
-/*
- * set_or_append_field:
- * @field: (inout): pointer to a location in which to store the field value
- * @field_value: (transfer full): the string to store in @field
- *
- * Set @field to @field_value if @field is empty, otherwise append to it.
- * Ownership of @field_value is transferred to this function.
- */
-static void
-set_or_append_field (gchar **field,
-                     gchar *field_value)
-{
-    if (*field == NULL)
-    {
-        *field = field_value;
-    }
-    else
-    {
-        gchar *field_tmp = g_strconcat (*field, MULTIFIELD_SEPARATOR,
-                                        field_value, NULL);
-        g_free (*field);
-        *field = field_tmp;
-        g_free (field_value);
-    }
-}
-
-/*
- * populate_tag_hash_table:
- * @vc: a Vorbis comment block from which to read fields
- *
- * Add comments from the supplied @vc block to a newly-allocated hash table.
- * Normalise the field names to upper-case ASCII, taking care to ignore the
- * current locale. Validate the field values are UTF-8 before inserting them in
- * the hash table. Add the values as strings in a GSList.
- *
- * Returns: (transfer full): a newly-allocated hash table of tags
- */
-static GHashTable *
-populate_tag_hash_table (const FLAC__StreamMetadata_VorbisComment *vc)
-{
-    GHashTable *ret;
-    guint32 i;
-
-    /* Free the string lists manually, to avoid having to duplicate them each
-     * time that an existing key is inserted. */
-    ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
-
-    for (i = 0; i < vc->num_comments; i++)
-    {
-        const FLAC__StreamMetadata_VorbisComment_Entry comment = vc->comments[i];
-        const gchar *separator;
-        gchar *field;
-        gchar *field_up;
-        gchar *value;
-        /* TODO: Use a GPtrArray instead? */
-        GSList *l;
-
-        separator = memchr (comment.entry, '=', comment.length);
-
-        if (!separator)
-        {
-            g_warning ("Field separator not found when reading FLAC tag: %s",
-                       vc->comments[i].entry);
-            continue;
-        }
-
-        field = g_strndup ((const gchar *)comment.entry,
-                           separator - (const gchar *)comment.entry);
-        field_up = g_ascii_strup (field, -1);
-        g_free (field);
-
-        l = g_hash_table_lookup (ret, field_up);
-
-        /* If the lookup failed, a new list is created. The list takes
-         * ownership of the field value. */
-        value = validate_field_utf8 (separator + 1,
-                                     comment.length - ((separator + 1)
-                                                       - (const gchar *)comment.entry));
-
-        /* Appending is slower, but much easier here (and the lists should be
-         * short). */
-        l = g_slist_append (l, value);
-
-        g_hash_table_insert (ret, field_up, l);
-    }
-
-    return ret;
-}
-
-/*
- * values_list_foreach:
- * @data: (transfer full): the tag value
- * @user_data: (inout): a tag location to fill
- *
- * Called on each element in a GSList of tag values, to set or append the
- * string to the tag.
- */
-static void
-values_list_foreach (gpointer data,
-                     gpointer user_data)
-{
-    gchar *value = (gchar *)data;
-    gchar **tag = (gchar **)user_data;
-
-    if (!et_str_empty (value))
-    {
-        set_or_append_field (tag, value);
-    }
-}
-
 /*
  * Read tag data from a FLAC file using the level 2 flac interface,
  * Note:
@@ -249,274 +106,27 @@ flac_tag_read_file_tag (GFile *file,
         if (block->type == FLAC__METADATA_TYPE_VORBIS_COMMENT)
         {
             const FLAC__StreamMetadata_VorbisComment *vc;
-            GHashTable *tags;
-            GSList *strings;
-            GHashTableIter tags_iter;
-            gchar *key;
+            EtVorbisCommentReader reader;
+            guint32 i;
 
-            /* Get comments from block. */
+            /* Get comments from block. The fields are read directly from the
+             * block, and the picture fields of Ogg files are kept as
+             * unsupported fields, as FLAC has picture blocks. */
             vc = &block->data.vorbis_comment;
-            tags = populate_tag_hash_table (vc);
-
-            /* Title */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TITLE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->title);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TITLE);
-            }
-
-            /* Artist */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ARTIST)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ARTIST);
-            }
-
-            /* Album artist. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->album_artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST);
-            }
-
-            /* Album. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ALBUM)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->album);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM);
-            }
-
-            /* Disc number and total discs. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DISC_TOTAL)))
-            {
-                /* Only take values from the first total discs field. */
-                if (!et_str_empty (strings->data))
-                {
-                    FileTag->disc_total = et_disc_number_to_string (atoi (strings->data));
-                }
-
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DISC_TOTAL);
-            }
-
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DISC_NUMBER)))
-            {
-                /* Only take values from the first disc number field. */
-                if (!et_str_empty (strings->data))
-                {
-                    gchar *separator;
-
-                    separator = strchr (strings->data, '/');
-
-                    if (separator && !FileTag->disc_total)
-                    {
-                        FileTag->disc_total = et_disc_number_to_string (atoi (separator + 1));
-                        *separator = '\0';
-                    }
-
-                    FileTag->disc_number = et_disc_number_to_string (atoi (strings->data));
-                }
-
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DISC_NUMBER);
-            }
-
-            /* Track number and total tracks. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL)))
-            {
-                /* Only take values from the first total tracks field. */
-                if (!et_str_empty (strings->data))
-                {
-                    FileTag->track_total = et_track_number_to_string (atoi (strings->data));
-                }
-
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL);
-            }
-
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER)))
-            {
-                /* Only take values from the first track number field. */
-                if (!et_str_empty (strings->data))
-                {
-                    gchar *separator;
-
-                    separator = strchr (strings->data, '/');
-
-                    if (separator && !FileTag->track_total)
-                    {
-                        FileTag->track_total = et_track_number_to_string (atoi (separator + 1));
-                        *separator = '\0';
-                    }
-
-                    FileTag->track = et_track_number_to_string (atoi (strings->data));
-                }
-
-                g_slist_free_full (strings, g_free);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER);
-            }
-
-            /* Year. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_DATE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->year);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DATE);
-            }
-
-            /* Genre. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_GENRE)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->genre);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_GENRE);
-            }
+            et_vorbis_comment_reader_init (&reader, FileTag, FALSE);
 
-            /* Comment. */
+            for (i = 0; i < vc->num_comments; i++)
             {
-                GSList *descs;
-                GSList *comments;
+                const gchar *value;
+                gsize value_length;
 
-                descs = g_hash_table_lookup (tags,
-                                             ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-                comments = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COMMENT);
-
-                /* Prefer DESCRIPTION, as it is part of the spec. */
-                if (descs && !comments)
-                {
-                    g_slist_foreach (descs, values_list_foreach,
-                                     &FileTag->comment);
-                }
-                else if (descs && comments)
-                {
-                    /* Mark the file as modified, so that comments are written
-                     * to the DESCRIPTION field on saving. */
-                    FileTag->saved = FALSE;
-
-                    g_slist_foreach (descs, values_list_foreach,
-                                     &FileTag->comment);
-                    g_slist_foreach (comments, values_list_foreach,
-                                     &FileTag->comment);
-                }
-                else if (comments)
-                {
-                    FileTag->saved = FALSE;
-
-                    g_slist_foreach (comments, values_list_foreach,
-                                     &FileTag->comment);
-                }
-
-                g_slist_free (descs);
-                g_slist_free (comments);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-                g_hash_table_remove (tags,
-                                     ET_VORBIS_COMMENT_FIELD_COMMENT);
-            }
-
-            /* Composer. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COMPOSER)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->composer);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COMPOSER);
-            }
-
-            /* Original artist. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_PERFORMER)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->orig_artist);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_PERFORMER);
-            }
-
-            /* Copyright. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_COPYRIGHT)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->copyright);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COPYRIGHT);
-            }
-
-            /* URL. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_CONTACT)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->url);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_CONTACT);
-            }
-
-            /* Encoded by. */
-            if ((strings = g_hash_table_lookup (tags,
-                                                ET_VORBIS_COMMENT_FIELD_ENCODED_BY)))
-            {
-                g_slist_foreach (strings, values_list_foreach,
-                                 &FileTag->encoded_by);
-                g_slist_free (strings);
-                g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ENCODED_BY);
-            }
-
-            /* Save unsupported fields. */
-            g_hash_table_iter_init (&tags_iter, tags);
-
-            while (g_hash_table_iter_next (&tags_iter, (gpointer *)&key,
-                                           (gpointer *)&strings))
-            {
-                GSList *l;
-
-                for (l = strings; l != NULL; l = g_slist_next (l))
-                {
-                    FileTag->other = g_list_prepend (FileTag->other,
-                                                     g_strconcat (key,
-                                                                  "=",
-                                                                  l->data,
-                                                                  NULL));
-                }
-
-                g_slist_free_full (strings, g_free);
-                g_hash_table_iter_remove (&tags_iter);
-            }
-
-            if (FileTag->other)
-            {
-                FileTag->other = g_list_reverse (FileTag->other);
+                et_vorbis_comment_reader_add (&reader,
+                                              (const gchar *)vc->comments[i].entry,
+                                              vc->comments[i].length, &value,
+                                              &value_length);
             }
 
-            /* The hash table should now only contain keys. */
-            g_hash_table_unref (tags);
+            et_vorbis_comment_reader_finish (&reader);
         }
         else if (block->type == FLAC__METADATA_TYPE_PICTURE)
         {
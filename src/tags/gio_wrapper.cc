@@ -23,6 +23,380 @@
 
 #include "gio_wrapper.h"
 
+#if defined (G_OS_UNIX) && defined (HAVE_COPY_FILE_RANGE)
+#include <gio/gfiledescriptorbased.h>
+#include <unistd.h>
+#endif
+
+/* Size of the buffer used when moving or copying file data. */
+static const gsize IOSTREAM_BUFFER_SIZE = 1024 * 1024;
+
+/* When a block grows or shrinks by at most this amount, the data after it is
+ * shifted in place, which needs no extra disk space and does not copy the
+ * data before the block. Shifting is not atomic, so an interrupted save can
+ * leave a partly shifted file behind. Larger changes rewrite the file into a
+ * temporary file in the same directory, which then atomically replaces the
+ * original. */
+static const goffset IOSTREAM_IN_PLACE_DELTA_LIMIT = 1024 * 1024;
+
+/* The file is rewritten regardless of the change in size if more than this
+ * amount of data would have to be shifted, as the rewrite can then share the
+ * extents of the file through copy_file_range(), and is atomic. */
+static const goffset IOSTREAM_IN_PLACE_MOVE_LIMIT = 256 * 1024 * 1024;
+
+/*
+ * read_at:
+ * @stream: the stream to read from
+ * @offset: the offset in the stream to read from
+ * @buffer: buffer to read into
+ * @count: number of bytes to read
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read exactly @count bytes from @stream, starting at @offset.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+read_at (GFileIOStream *stream,
+         goffset offset,
+         guchar *buffer,
+         gsize count,
+         GError **error)
+{
+    gsize bytes_read;
+    GInputStream *istream = g_io_stream_get_input_stream (G_IO_STREAM (stream));
+
+    if (!g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL,
+                          error)
+        || !g_input_stream_read_all (istream, buffer, count, &bytes_read, NULL,
+                                     error))
+    {
+        return FALSE;
+    }
+
+    if (bytes_read != count)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
+                     " bytes of data were read", bytes_read, count);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * write_at:
+ * @stream: the stream to write to
+ * @offset: the offset in the stream to write to
+ * @buffer: the data to write
+ * @count: number of bytes to write
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Write @count bytes to @stream, starting at @offset.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+write_at (GFileIOStream *stream,
+          goffset offset,
+          const guchar *buffer,
+          gsize count,
+          GError **error)
+{
+    gsize bytes_written;
+    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (stream));
+
+    if (!g_seekable_seek (G_SEEKABLE (stream), offset, G_SEEK_SET, NULL,
+                          error))
+    {
+        return FALSE;
+    }
+
+    if (!g_output_stream_write_all (ostream, buffer, count, &bytes_written,
+                                    NULL, error))
+    {
+        g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
+                 " bytes of data were written", bytes_written, count);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * move_range:
+ * @stream: the stream to move data within
+ * @from: offset of the data to move
+ * @to: offset to move the data to
+ * @len: number of bytes to move
+ * @buffer: scratch buffer of %IOSTREAM_BUFFER_SIZE bytes
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Move a range of bytes within @stream, in the same way as memmove(). When
+ * moving towards the end of the file, the data is processed from the end of
+ * the range backwards, so that no data is overwritten before it is read.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+move_range (GFileIOStream *stream,
+            goffset from,
+            goffset to,
+            goffset len,
+            guchar *buffer,
+            GError **error)
+{
+    if (from == to || len <= 0)
+    {
+        return TRUE;
+    }
+
+    if (to < from)
+    {
+        goffset done;
+
+        for (done = 0; done < len;)
+        {
+            gsize chunk = MIN ((goffset)IOSTREAM_BUFFER_SIZE, len - done);
+
+            if (!read_at (stream, from + done, buffer, chunk, error)
+                || !write_at (stream, to + done, buffer, chunk, error))
+            {
+                return FALSE;
+            }
+
+            done += chunk;
+        }
+    }
+    else
+    {
+        goffset remaining;
+
+        for (remaining = len; remaining > 0;)
+        {
+            gsize chunk = MIN ((goffset)IOSTREAM_BUFFER_SIZE, remaining);
+
+            remaining -= chunk;
+
+            if (!read_at (stream, from + remaining, buffer, chunk, error)
+                || !write_at (stream, to + remaining, buffer, chunk, error))
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+#if defined (G_OS_UNIX) && defined (HAVE_COPY_FILE_RANGE)
+/*
+ * get_stream_fd:
+ * @stream: a stream
+ *
+ * Returns: the file descriptor of @stream, or -1 if it is not a local file
+ */
+static int
+get_stream_fd (GFileIOStream *stream)
+{
+    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (stream));
+
+    if (!G_IS_FILE_DESCRIPTOR_BASED (ostream))
+    {
+        return -1;
+    }
+
+    return g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (ostream));
+}
+
+/*
+ * copy_range_in_kernel:
+ * @source: the stream to copy from
+ * @offset: offset in @source to start copying from, updated on return
+ * @dest: the stream to copy to
+ * @len: number of bytes to copy, updated on return
+ *
+ * Try to copy data with copy_file_range(), which avoids copying through
+ * userspace and can share extents on filesystems which support reflinks.
+ * The file descriptors of the open streams are used, with explicit offsets,
+ * so that no file is opened again. On return, @offset and @len describe the
+ * data which is still to be copied, and @dest is positioned after the copied
+ * data.
+ */
+static void
+copy_range_in_kernel (GFileIOStream *source,
+                      goffset *offset,
+                      GFileIOStream *dest,
+                      goffset *len)
+{
+    int fd_in = get_stream_fd (source);
+    int fd_out = get_stream_fd (dest);
+    loff_t off_in;
+    loff_t off_out;
+
+    if (fd_in < 0 || fd_out < 0)
+    {
+        return;
+    }
+
+    off_in = *offset;
+    off_out = g_seekable_tell (G_SEEKABLE (dest));
+
+    while (*len > 0)
+    {
+        ssize_t copied = copy_file_range (fd_in, &off_in, fd_out, &off_out,
+                                          *len, 0);
+
+        if (copied <= 0)
+        {
+            /* For example, EXDEV or ENOSYS: fall back to copying through a
+             * buffer. */
+            break;
+        }
+
+        *len -= copied;
+    }
+
+    *offset = off_in;
+    g_seekable_seek (G_SEEKABLE (dest), off_out, G_SEEK_SET, NULL, NULL);
+}
+#endif /* G_OS_UNIX && HAVE_COPY_FILE_RANGE */
+
+/*
+ * copy_range:
+ * @source: the stream to copy from
+ * @offset: offset in @source to start copying from
+ * @dest: the stream to copy to, at its current position
+ * @len: number of bytes to copy
+ * @buffer: scratch buffer of %IOSTREAM_BUFFER_SIZE bytes
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Copy a range of bytes from @source to the current position of @dest.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+static gboolean
+copy_range (GFileIOStream *source,
+            goffset offset,
+            GFileIOStream *dest,
+            goffset len,
+            guchar *buffer,
+            GError **error)
+{
+    GInputStream *istream = g_io_stream_get_input_stream (G_IO_STREAM (source));
+    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (dest));
+
+#if defined (G_OS_UNIX) && defined (HAVE_COPY_FILE_RANGE)
+    copy_range_in_kernel (source, &offset, dest, &len);
+#endif /* G_OS_UNIX && HAVE_COPY_FILE_RANGE */
+
+    if (len <= 0)
+    {
+        return TRUE;
+    }
+
+    if (!g_seekable_seek (G_SEEKABLE (source), offset, G_SEEK_SET, NULL,
+                          error))
+    {
+        return FALSE;
+    }
+
+    while (len > 0)
+    {
+        gsize chunk = MIN ((goffset)IOSTREAM_BUFFER_SIZE, len);
+        gsize bytes_read;
+        gsize bytes_written;
+
+        if (!g_input_stream_read_all (istream, buffer, chunk, &bytes_read,
+                                      NULL, error))
+        {
+            return FALSE;
+        }
+
+        if (bytes_read == 0)
+        {
+            g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "Unexpected end of file");
+            return FALSE;
+        }
+
+        if (!g_output_stream_write_all (ostream, buffer, bytes_read,
+                                        &bytes_written, NULL, error))
+        {
+            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
+                     " bytes of data were written", bytes_written,
+                     bytes_read);
+            return FALSE;
+        }
+
+        len -= bytes_read;
+    }
+
+    return TRUE;
+}
+
+/*
+ * create_temporary_file:
+ * @file: the file which will be replaced by the temporary file
+ * @iostream: return location for a stream to write to the temporary file
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Create a new, hidden, file in the same directory as @file, so that it is
+ * on the same filesystem and can be atomically renamed over @file.
+ *
+ * Returns: the temporary file, or %NULL on error
+ */
+static GFile *
+create_temporary_file (GFile *file,
+                       GFileIOStream **iostream,
+                       GError **error)
+{
+    GFile *parent = g_file_get_parent (file);
+    gchar *basename = g_file_get_basename (file);
+    GFile *tmp = NULL;
+    gint i;
+
+    for (i = 0; i < 100; i++)
+    {
+        GError *tmp_error = NULL;
+        gchar *tmp_name = g_strdup_printf (".%s.easytag-%06x", basename,
+                                           g_random_int_range (0, 0xffffff));
+
+        tmp = g_file_get_child (parent, tmp_name);
+        g_free (tmp_name);
+
+        *iostream = g_file_create_readwrite (tmp, G_FILE_CREATE_PRIVATE, NULL,
+                                             &tmp_error);
+
+        if (*iostream)
+        {
+            break;
+        }
+
+        g_clear_object (&tmp);
+
+        if (!g_error_matches (tmp_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        {
+            g_propagate_error (error, tmp_error);
+            break;
+        }
+
+        g_error_free (tmp_error);
+    }
+
+    if (!tmp && error && !*error)
+    {
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                             "Unable to create a unique temporary file");
+    }
+
+    g_free (basename);
+    g_object_unref (parent);
+
+    return tmp;
+}
+
 GIO_InputStream::GIO_InputStream (GFile * file_) :
     file ((GFile *)g_object_ref (gpointer (file_))),
     filename (g_file_get_uri (file)),
@@ -253,96 +627,88 @@ GIO_IOStream::insert (TagLib::ByteVector const &data,
         writeBlock (data);
         return;
     }
-    else if (data.size () < replace)
-    {
-        removeBlock (start, replace - data.size ());
-        seek (start);
-        writeBlock (data);
-        return;
-    }
 
-    GFileIOStream *tstr;
-    GFile *tmp = g_file_new_tmp ("easytag-XXXXXX", &tstr, &error);
+    goffset file_length = length ();
 
-    if (tmp == NULL)
+    if (error)
     {
         return;
     }
 
-    char buffer[4096];
-    gsize r;
+    goffset tail_start = MIN (start + (goffset)replace, file_length);
+    goffset tail_length = file_length - tail_start;
+    goffset new_tail_start = start + data.size ();
+    goffset delta = ABS ((goffset)data.size () - (tail_start - start));
 
-    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (tstr));
-    GInputStream *istream = g_io_stream_get_input_stream (G_IO_STREAM (stream));
-
-    seek (0);
-
-    while (g_input_stream_read_all (istream, buffer,
-                                    MIN (G_N_ELEMENTS (buffer), start),
-                                    &r, NULL, &error) && r > 0)
+    /* A small change in size, such as a tag growing in front of the media
+     * data, shifts the rest of the file in place. */
+    if (delta <= IOSTREAM_IN_PLACE_DELTA_LIMIT
+        && tail_length <= IOSTREAM_IN_PLACE_MOVE_LIMIT)
     {
-        gsize w;
-        g_output_stream_write_all (ostream, buffer, r, &w, NULL, &error);
+        guchar *buffer = (guchar *)g_malloc (IOSTREAM_BUFFER_SIZE);
 
-        if (w != r)
+        if (move_range (stream, tail_start, new_tail_start, tail_length,
+                        buffer, &error))
         {
-            g_warning ("%s", "Unable to write all bytes");
-        }
+            if (data.size () < replace)
+            {
+                truncate (new_tail_start + tail_length);
+            }
 
-	if (error)
-	{
-            g_object_unref (tstr);
-            g_object_unref (tmp);
-            return;
-	}
+            seek (start);
+            writeBlock (data);
+        }
 
-        start -= r;
+        g_free (buffer);
+        return;
     }
 
-    if (error)
+    /* Otherwise, rewrite the file into a temporary file in the same
+     * directory, so that it can be atomically renamed over the original. */
+    GFileIOStream *tstr;
+    GFile *tmp = create_temporary_file (file, &tstr, &error);
+
+    if (tmp == NULL)
     {
-        g_object_unref (tstr);
-        g_object_unref (tmp);
         return;
     }
 
-    g_output_stream_write_all (ostream, data.data (), data.size (), NULL,
-                               NULL, &error);
-    seek (replace, TagLib::IOStream::Current);
+    guchar *buffer = (guchar *)g_malloc (IOSTREAM_BUFFER_SIZE);
+    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (tstr));
+    gsize bytes_written;
 
-    if (error)
+    if (!copy_range (stream, 0, tstr, start, buffer, &error)
+        || !g_output_stream_write_all (ostream, data.data (), data.size (),
+                                       &bytes_written, NULL, &error)
+        || !copy_range (stream, tail_start, tstr, tail_length, buffer,
+                        &error)
+        || !g_io_stream_close (G_IO_STREAM (tstr), NULL, &error))
     {
+        g_free (buffer);
         g_object_unref (tstr);
+        g_file_delete (tmp, NULL, NULL);
         g_object_unref (tmp);
         return;
     }
 
-    while (g_input_stream_read_all (istream, buffer, sizeof (buffer), &r,
-                                    NULL, &error) && r > 0)
-    {
-        gsize bytes_written;
+    g_free (buffer);
+    g_object_unref (tstr);
 
-        if (!g_output_stream_write_all (ostream, buffer, r, &bytes_written,
-                                        NULL, &error))
-        {
-            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
-                     " bytes of data were written", bytes_written, r);
-            g_object_unref (tstr);
-            g_object_unref (tmp);
-            return;
-        }
+    /* Keep the permissions of the original file. */
+    if (!g_file_copy_attributes (file, tmp, G_FILE_COPY_NONE, NULL, NULL))
+    {
+        g_debug ("%s", "Unable to copy file attributes to the temporary file");
     }
 
-    g_object_unref (tstr);
     g_object_unref (stream);
     stream = NULL;
 
-    g_file_move (tmp, file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL, &error);
-
-    if (error)
+    if (!g_file_move (tmp, file, G_FILE_COPY_OVERWRITE, NULL, NULL, NULL,
+                      &error))
     {
-            g_object_unref (tmp);
-	    return;
+        g_file_delete (tmp, NULL, NULL);
+        g_object_unref (tmp);
+        return;
     }
 
     stream = g_file_open_readwrite (file, NULL, &error);
@@ -353,38 +719,42 @@ GIO_IOStream::insert (TagLib::ByteVector const &data,
 void
 GIO_IOStream::removeBlock (TagLib::offset_t start, size_t len)
 {
-    if (start + len >= (ulong)length ())
+    if (error)
     {
-        truncate (start);
         return;
     }
 
-    char *buffer[4096];
-    gsize r;
-    GInputStream *istream = g_io_stream_get_input_stream (G_IO_STREAM (stream));
-    GOutputStream *ostream = g_io_stream_get_output_stream (G_IO_STREAM (stream));
-    seek (start + len);
+    goffset file_length = length ();
 
-    while (g_input_stream_read_all (istream, buffer, sizeof (buffer), &r, NULL,
-                                    NULL) && r > 0)
+    if (error)
     {
-        gsize bytes_written;
+        return;
+    }
 
-        seek (start);
+    if (start + (goffset)len >= file_length)
+    {
+        truncate (start);
+        return;
+    }
 
-        if (!g_output_stream_write_all (ostream, buffer, r, &bytes_written,
-                                        NULL, &error))
-        {
-            g_debug ("Only %" G_GSIZE_FORMAT " bytes out of %" G_GSIZE_FORMAT
-                     " bytes of data were written", bytes_written, r);
-            return;
-        }
+    /* As for insert (), only shift the rest of the file in place for a small
+     * change in size. */
+    if ((goffset)len > IOSTREAM_IN_PLACE_DELTA_LIMIT
+        || file_length - start - (goffset)len > IOSTREAM_IN_PLACE_MOVE_LIMIT)
+    {
+        insert (TagLib::ByteVector (), start, len);
+        return;
+    }
+
+    guchar *buffer = (guchar *)g_malloc (IOSTREAM_BUFFER_SIZE);
 
-        start += r;
-        seek (start + len);
+    if (move_range (stream, start + len, start, file_length - start - len,
+                    buffer, &error))
+    {
+        truncate (file_length - len);
     }
 
-    truncate (start);
+    g_free (buffer);
 }
 
 bool
@@ -21,7 +21,6 @@
 
 #include <glib/gi18n.h>
 #include <string.h>
-#include <strings.h>
 #include <errno.h>
 
 #include "id3_tag.h"
@@ -1190,8 +1189,9 @@ Id3tag_Set_Field (const ID3Frame *id3_frame,
         if (g_settings_get_boolean (MainSettings, "id3v2-enable-unicode"))
         {
             // Check if we can write the tag using ISO-8859-1 instead of UTF-16...
-            if ( (string_converted = g_convert(string, strlen(string), "ISO-8859-1",
-                                               "UTF-8", NULL, NULL ,NULL)) )
+            if ( (string_converted = et_charset_convert (string, -1, "ISO-8859-1",
+                                                         "UTF-8", NULL, NULL,
+                                                         NULL)) )
             {
                 enc = ID3TE_ISO8859_1;
                 g_free(string_converted);
@@ -1663,15 +1663,7 @@ id3tag_write_file_tag (const ET_File *ETFile,
 guchar
 Id3tag_String_To_Genre (const gchar *genre)
 {
-    guint i;
-
-    if (genre != NULL)
-    {
-        for (i=0; i<=GENRE_MAX; i++)
-            if (strcasecmp(genre,id3_genres[i])==0)
-                return (guchar)i;
-    }
-    return (guchar)0xFF;
+    return et_genre_lookup (genre);
 }
 
 
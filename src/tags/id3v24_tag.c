@@ -339,56 +339,9 @@ id3tag_read_file_tag (GFile *gfile,
         update |= libid3tag_Get_Frame_Str(frame, ~0, &string1);
         if ( string1 )
         {
-            /*
-             * We manipulate only the name of the genre
-             * Genre is written like this :
-             *    - "(<genre_id>)"              -> "(3)"
-             *    - "<genre_name>"              -> "Dance"
-             *    - "(<genre_id>)<refinement>"  -> "(3)EuroDance"
-             */
-            gchar *tmp;
-            unsigned genre = 0;
-            FileTag->genre = NULL;
-
-            if ((string1[0] == '(') && g_ascii_isdigit (string1[1])
-                && (tmp = strchr (string1 + 1, ')')) && *(tmp+1))
-                /* Convert a genre written as '(3)EuroDance' into 'EuroDance' */
-            {
-                FileTag->genre = g_strdup (tmp + 1);
-            }
-            else if ((string1[0] == '(') && g_ascii_isdigit (string1[1])
-                     && strchr (string1, ')'))
-            {
-                /* Convert a genre written as '(3)' into 'Dance' */
-                genre = strtol (string1 +1 , &tmp, 10);
-                if (*tmp != ')')
-                {
-                    FileTag->genre = g_strdup (string1);
-                }
-            }
-            else
-            {
-                genre = strtol (string1, &tmp, 10);
-                if (tmp == string1)
-                {
-                    FileTag->genre = g_strdup (string1);
-                }
-            }
-
-            if (!FileTag->genre)
-            {
-                if (id3_genre_index (genre))
-                {
-                    FileTag->genre = (gchar *)id3_ucs4_utf8duplicate (id3_genre_index (genre));
-                }
-                else if (strcmp (genre_no (genre),
-                                 genre_no (ID3_INVALID_GENRE)) != 0)
-                {
-                    /* If the integer genre is not found in the (outdated)
-                     * libid3tag index, try the EasyTAG index instead. */
-                    FileTag->genre = g_strdup (genre_no (genre));
-                }
-            }
+            /* Genres may be written as ID3v1 genre numbers, possibly with a
+             * refinement, such as "(3)EuroDance". */
+            FileTag->genre = et_genre_normalize (string1);
 
             g_free(string1);
         }
@@ -647,7 +600,7 @@ etag_guess_byteorder(const id3_ucs4_t *ustr, gchar **ret) /* XXX */
     }
 
     tmp = (gchar *)id3_ucs4_utf8duplicate(ustr);
-    str = g_convert(tmp, -1, charset, "UTF-8", NULL, NULL, NULL);
+    str = et_charset_convert (tmp, -1, charset, "UTF-8", NULL, NULL, NULL);
     if (str)
     {
         g_free(str);
@@ -687,7 +640,7 @@ etag_guess_byteorder(const id3_ucs4_t *ustr, gchar **ret) /* XXX */
         return 0;
     }
 
-    str2 = g_convert(str, -1, charset, "UTF-8", NULL, NULL, NULL);
+    str2 = et_charset_convert (str, -1, charset, "UTF-8", NULL, NULL, NULL);
 
     if (str2 && *str2)
     {
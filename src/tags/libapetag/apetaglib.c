@@ -1019,11 +1019,59 @@ apetag_save (const char *filename, apetag *mem_cnt, int flag)
         size_t fileSize;
         size_t newFileSize;
         size_t writedBytes;
+        size_t newTagSize;
         int fd;
         
+        newTagSize = (tagCount != 0) ? tagSSize + (saveApe2 ? 32 : 0) : 0;
         fseek (fp, 0, SEEK_END);
         fileSize = ftell (fp);
         fseek (fp, fileSize - skipBytes, SEEK_SET);
+
+        /* If the new tag has the same size as the old one, compare them and
+         * only write the bytes which changed, without truncating. */
+        if (newTagSize == (size_t) skipBytes) {
+            unsigned char *oldBuff;
+            size_t first, last;
+
+            oldBuff = (unsigned char *) malloc (skipBytes);
+            if (skipBytes != 0 && oldBuff == NULL) {
+                PRINT_ERR ("ERROR->libapetag->apetag_save::malloc");
+                fclose (fp);
+                free (buff);
+                return ATL_MALOC;
+            }
+            if (fread (oldBuff, 1, skipBytes, fp) != (size_t) skipBytes) {
+                PRINT_ERR ("ERROR->libapetag->apetag_save::fread");
+                fclose (fp);
+                free (oldBuff);
+                free (buff);
+                return ATL_FREAD;
+            }
+
+            for (first = 0; first < (size_t) skipBytes
+                 && oldBuff[first] == buff[first]; first++);
+            for (last = skipBytes; last > first
+                 && oldBuff[last - 1] == buff[last - 1]; last--);
+            free (oldBuff);
+
+            if (first != last) {
+                fseek (fp, fileSize - skipBytes + first, SEEK_SET);
+                writedBytes = fwrite (buff + first, 1, last - first, fp);
+                if (writedBytes != last - first) {
+                    PRINT_ERR ("FATAL_ERROR->libapetag->apetag_save::fwrite [data lost]");
+                    fclose (fp);
+                    free (buff);
+                    return ATL_FWRITE;
+                }
+            }
+            PRINT_D3 (">apetaglib>SAVE>> changed:%zu-%zu file: %zu\n",
+                first, last, fileSize);
+
+            fclose (fp);
+            free (buff);
+            return 0;
+        }
+
         if (tagCount != 0) {
             newFileSize = (fileSize - skipBytes + tagSSize + (saveApe2 ? 32 : 0));
             writedBytes = fwrite (buff, 1, tagSSize + (saveApe2 ? 32 : 0), fp);
@@ -28,10 +28,11 @@
 
 #ifdef ENABLE_SPEEX
 #include <speex/speex_header.h>
-#include "vcedit.h"
 #endif
 
 #include "ogg_header.h"
+#include "ogg_tag.h"
+#include "vcedit.h"
 #include "et_core.h"
 #include "misc.h"
 
@@ -297,6 +298,162 @@ et_ogg_header_read_file_info (GFile *file,
 }
 
 
+/*
+ * et_ogg_header_read_file:
+ * @file: the Ogg Vorbis, Speex or Opus file to read
+ * @FileTag: (out caller-allocates): the tag to fill from the comment header
+ * @ETFileInfo: (out caller-allocates): the header information to fill
+ * @error: a #GError to provide information on errors, or %NULL to ignore
+ *
+ * Read both the tag and the header information of @file with a single open:
+ * the identification and comment headers are parsed from the start of the
+ * file, and the duration is computed from the granule positions of the first
+ * audio page, which follows the headers, and of the last page, found with one
+ * bounded read of the end of the file. Fails for streams where that is not
+ * possible, such as chained streams, so that the caller can fall back to the
+ * codec-specific readers.
+ *
+ * Returns: %TRUE on success, %FALSE and sets @error otherwise, in which case
+ * neither @FileTag nor @ETFileInfo are modified
+ */
+gboolean
+et_ogg_header_read_file (GFile *file,
+                         File_Tag *FileTag,
+                         ET_File_Info *ETFileInfo,
+                         GError **error)
+{
+    EtOggState *state;
+    ogg_int64_t start_granulepos;
+    ogg_int64_t granulepos;
+    goffset size;
+
+    g_return_val_if_fail (file != NULL && FileTag != NULL
+                          && ETFileInfo != NULL, FALSE);
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    state = vcedit_new_state ();
+
+    if (!vcedit_probe (state, file, error))
+    {
+        g_assert (error == NULL || *error != NULL);
+        vcedit_clear (state);
+        return FALSE;
+    }
+
+    granulepos = vcedit_granulepos (state);
+
+    if (granulepos < 0)
+    {
+        /* FIXME: Translatable string. */
+        g_set_error (error, ET_OGG_ERROR, ET_OGG_ERROR_EOS,
+                     "Last page of the logical bitstream not found");
+        vcedit_clear (state);
+        return FALSE;
+    }
+
+    start_granulepos = vcedit_start_granulepos (state);
+
+    if (start_granulepos < 0 || start_granulepos > granulepos)
+    {
+        /* FIXME: Translatable string. */
+        g_set_error (error, ET_OGG_ERROR, ET_OGG_ERROR_PAGE,
+                     "First audio page of the logical bitstream not found");
+        vcedit_clear (state);
+        return FALSE;
+    }
+
+    /* The stream may not start at granule position 0, so only count the
+     * samples from its start, as ov_time_total() and op_pcm_total(). */
+    granulepos -= start_granulepos;
+
+    size = vcedit_file_size (state);
+
+    switch (vcedit_kind (state))
+    {
+        case ET_OGG_KIND_VORBIS:
+        {
+            const vorbis_info *vi = vcedit_vorbis_info (state);
+
+            ETFileInfo->version = vi->version;
+            ETFileInfo->bitrate = vi->bitrate_nominal / 1000;
+            ETFileInfo->samplerate = vi->rate;
+            ETFileInfo->mode = vi->channels;
+            ETFileInfo->duration = vi->rate > 0 ? granulepos / vi->rate : 0;
+            break;
+        }
+#ifdef ENABLE_SPEEX
+        case ET_OGG_KIND_SPEEX:
+        {
+            const SpeexHeader *si = vcedit_speex_header (state);
+
+            ETFileInfo->mpc_version = g_strdup (si->speex_version);
+            ETFileInfo->bitrate = si->bitrate / 1000;
+            ETFileInfo->samplerate = si->rate;
+            ETFileInfo->mode = si->nb_channels;
+            ETFileInfo->duration = si->rate > 0 ? granulepos / si->rate : 0;
+            break;
+        }
+#endif
+#ifdef ENABLE_OPUS
+        case ET_OGG_KIND_OPUS:
+        {
+            const OpusHead *oi = vcedit_opus_header (state);
+            /* Granule positions are always at 48 kHz for Opus, and include
+             * the samples to skip at the start of the stream. */
+            const ogg_int64_t samples = MAX (granulepos - oi->pre_skip, 0);
+
+            ETFileInfo->version = oi->version;
+            ETFileInfo->mode = oi->channel_count;
+
+            /* All Opus audio is encoded at 48 kHz, but the input sample rate
+             * can differ, and then input_sample_rate will be set. */
+            if (oi->input_sample_rate != 0)
+            {
+                ETFileInfo->samplerate = oi->input_sample_rate;
+            }
+            else
+            {
+                ETFileInfo->samplerate = 48000;
+            }
+
+            /* The average bitrate over the whole file, as op_bitrate(). */
+            ETFileInfo->bitrate = samples > 0 ? size * 8 * 48000 / samples
+                                                / 1000
+                                              : 0;
+            ETFileInfo->duration = samples / 48000;
+            break;
+        }
+#endif
+        case ET_OGG_KIND_UNKNOWN:
+        case ET_OGG_KIND_UNSUPPORTED:
+        default:
+            /* vcedit_open() only accepts supported streams. */
+            g_assert_not_reached ();
+            break;
+    }
+
+    ETFileInfo->size = size;
+
+    et_add_file_tags_from_vorbis_comments (vcedit_comments (state), FileTag);
+
+    if (vcedit_has_id3v2 (state))
+    {
+        gchar *path;
+
+        path = g_file_get_path (file);
+        g_debug ("Ogg file '%s' contains an ID3v2 tag", path);
+        g_free (path);
+
+        /* Mark the file as modified, so that the ID3 tag is removed upon
+         * saving. */
+        FileTag->saved = FALSE;
+    }
+
+    vcedit_clear (state);
+
+    return TRUE;
+}
+
 #ifdef ENABLE_SPEEX
 
 gboolean
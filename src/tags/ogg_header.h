@@ -71,6 +71,7 @@ typedef enum
 } EtOGGError;
 
 gboolean et_ogg_header_read_file_info (GFile *file, ET_File_Info *ETFileInfo, GError **error);
+gboolean et_ogg_header_read_file (GFile *file, File_Tag *FileTag, ET_File_Info *ETFileInfo, GError **error);
 EtFileHeaderFields * et_ogg_header_display_file_info_to_ui (const ET_File *ETFile);
 void et_ogg_file_header_fields_free (EtFileHeaderFields *fields);
 
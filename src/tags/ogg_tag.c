@@ -33,6 +33,7 @@
 #include "picture.h"
 #include "setting.h"
 #include "charset.h"
+#include "vorbis_comment.h"
 
 /* for mkstemp. */
 #include "win32/win32dep.h"
@@ -109,146 +110,127 @@ read_guint32_from_byte (guchar *str, gsize start)
 }
 
 /*
- * set_or_append_field:
- * @field: (inout): pointer to a location in which to store the field value
- * @field_value: (transfer full): the string to store in @field
+ * picture_from_metadata_block_picture:
+ * @value: the base64-encoded value of a METADATA_BLOCK_PICTURE field
  *
- * Set @field to @field_value if @field is empty, otherwise append to it.
- * Ownership of @field_value is transferred to this function.
+ * Decode the FLAC picture block in @value.
+ *
+ * Returns: a new picture, or %NULL if the picture block is invalid
  */
-static void
-set_or_append_field (gchar **field,
-                     gchar *field_value)
+static EtPicture *
+picture_from_metadata_block_picture (const gchar *value)
 {
-    if (*field == NULL)
-    {
-        *field = field_value;
-    }
-    else
+    EtPicture *pic;
+    gsize bytes_pos, mimelen, desclen;
+    guchar *decoded_ustr;
+    GBytes *bytes;
+    EtPictureType type;
+    gchar *description;
+    GBytes *pic_bytes;
+    gsize decoded_size;
+    gsize data_size;
+
+    /* Decode picture data. */
+    decoded_ustr = g_base64_decode (value, &decoded_size);
+
+    /* Check that the comment decoded to a long enough string to hold the
+     * whole structure (8 fields of 4 bytes each). */
+    if (decoded_size < 8 * 4)
     {
-        gchar *field_tmp = g_strconcat (*field, MULTIFIELD_SEPARATOR,
-                                        field_value, NULL);
-        g_free (*field);
-        *field = field_tmp;
-        g_free (field_value);
+        g_free (decoded_ustr);
+        return NULL;
     }
-}
 
-/*
- * validate_field_utf8:
- * @field_value: the string to validate
- * @field_len: the length of the string
- *
- * Validate a Vorbis comment field to ensure that it is UTF-8. Either return a
- * duplicate of the original (valid) string, or a converted equivalent (of an
- * invalid UTF-8 string).
- *
- * Returns: a valid UTF-8 represenation of @field_value
- */
-static gchar *
-validate_field_utf8 (const gchar *field_value,
-                     gint field_len)
-{
-    gchar *result;
+    bytes = g_bytes_new_take (decoded_ustr, decoded_size);
 
-    if (g_utf8_validate (field_value, field_len, NULL))
+    /* Reading picture type. */
+    type = read_guint32_from_byte (decoded_ustr, 0);
+    bytes_pos = 4;
+
+    /* TODO: Check that there is a maximum of 1 of each of
+     * ET_PICTURE_TYPE_FILE_ICON and ET_PICTURE_TYPE_OTHER_FILE_ICON types
+     * in the file. */
+    if (type >= ET_PICTURE_TYPE_UNDEFINED)
     {
-        result = g_strndup (field_value, field_len);
+        goto invalid_picture;
     }
-    else
+
+    /* Reading MIME data. */
+    mimelen = read_guint32_from_byte (decoded_ustr, bytes_pos);
+    bytes_pos += 4;
+
+    if (mimelen > decoded_size - bytes_pos - (6 * 4))
     {
-        gchar *field_value_tmp = g_strndup (field_value,
-                                            field_len);
-        /* Unnecessarily validates the field again, but this should not be the
-         * common case. */
-        result = Try_To_Validate_Utf8_String (field_value_tmp);
-        g_free (field_value_tmp);
+        goto invalid_picture;
     }
 
-    return result;
-}
-
-/*
- * populate_tag_hash_table:
- * @vc: a Vorbis comment block from which to read fields
- *
- * Add comments from the supplied @vc block to a newly-allocated hash table.
- * Normalise the field names to upper-case ASCII, taking care to ignore the
- * current locale. Validate the field values are UTF-8 before inserting them in
- * the hash table. Add the values as strings in a GSList.
- *
- * Returns: (transfer full): a newly-allocated hash table of tags
- */
-static GHashTable *
-populate_tag_hash_table (const vorbis_comment *vc)
-{
-    GHashTable *ret;
-    gint i;
+    /* Check for a valid MIME type. */
+    if (mimelen > 0)
+    {
+        const gchar *mime;
 
-    /* Free the string lists manually, to avoid having to duplicate them each
-     * time that an existing key is inserted. */
-    ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        mime = (const gchar *)&decoded_ustr[bytes_pos];
 
-    for (i = 0; i < vc->comments; i++)
-    {
-        const gchar *comment = vc->user_comments[i];
-        const gint len = vc->comment_lengths[i];
-        const gchar *separator;
-        gchar *field;
-        gchar *field_up;
-        gchar *value;
-        /* TODO: Use a GPtrArray instead? */
-        GSList *l;
-
-        separator = memchr (comment, '=', len);
-
-        if (!separator)
+        /* TODO: Check for "-->" when adding linked image support. */
+        if (strncmp (mime, "image/", mimelen) != 0
+            && strncmp (mime, "image/png", mimelen) != 0
+            && strncmp (mime, "image/jpeg", mimelen) != 0)
         {
-            g_warning ("Field separator not found when reading Vorbis tag: %s",
-                       comment);
-            continue;
-        }
+            gchar *mime_str;
 
-        field = g_strndup (comment, separator - comment);
-        field_up = g_ascii_strup (field, -1);
-        g_free (field);
+            mime_str = g_strndup (mime, mimelen);
+            g_debug ("Invalid Vorbis comment image MIME type: %s", mime_str);
 
-        l = g_hash_table_lookup (ret, field_up);
+            g_free (mime_str);
+            goto invalid_picture;
+        }
+    }
 
-        /* If the lookup failed, a new list is created. The list takes
-         * ownership of the field value. */
-        value = validate_field_utf8 (separator + 1, len - ((separator + 1) -
-                                                           comment));
+    /* Skip over the MIME type, as gdk-pixbuf does not use it. */
+    bytes_pos += mimelen;
 
-        /* Appending is slower, but much easier here (and the lists should be
-         * short). */
-        l = g_slist_append (l, value);
+    /* Reading description */
+    desclen = read_guint32_from_byte (decoded_ustr, bytes_pos);
+    bytes_pos += 4;
 
-        g_hash_table_insert (ret, field_up, l);
+    if (desclen > decoded_size - bytes_pos - (5 * 4))
+    {
+        goto invalid_picture;
     }
 
-    return ret;
-}
+    description = g_strndup ((const gchar *)&decoded_ustr[bytes_pos],
+                             desclen);
 
-/*
- * values_list_foreach
- * @data: (transfer full): the tag value
- * @user_data: (inout); a tag location to fill
- *
- * Called on each element in a GSList of tag values, to set or append the
- * string to the tag.
- */
-static void
-values_list_foreach (gpointer data,
-                     gpointer user_data)
-{
-    gchar *value = (gchar *)data;
-    gchar **tag = (gchar **)user_data;
+    /* Skip the width, height, color depth and number-of-colors fields. */
+    bytes_pos += desclen + 16;
+
+    /* Reading picture size */
+    data_size = read_guint32_from_byte (decoded_ustr, bytes_pos);
+    bytes_pos += 4;
 
-    if (!et_str_empty (value))
+    if (data_size > decoded_size - bytes_pos)
     {
-        set_or_append_field (tag, value);
+        g_free (description);
+        goto invalid_picture;
     }
+
+    /* Read only the image data into a new GBytes. */
+    pic_bytes = g_bytes_new_from_bytes (bytes, bytes_pos, data_size);
+
+    pic = et_picture_new (type, description, 0, 0, pic_bytes);
+
+    g_free (description);
+    g_bytes_unref (pic_bytes);
+
+    /* pic->bytes still holds a ref on the decoded data. */
+    g_bytes_unref (bytes);
+
+    return pic;
+
+invalid_picture:
+    g_bytes_unref (bytes);
+
+    return NULL;
 }
 
 /*
@@ -256,289 +238,141 @@ values_list_foreach (gpointer data,
  * @vc: Vorbis comment from which to fill @FileTag
  * @FileTag: tag to populate from @vc
  *
- * Reads Vorbis comments and copies them to file tag.
+ * Reads Vorbis comments and copies them to file tag, in a single pass over
+ * the fields. The comments in @vc are nul-terminated, as libvorbis and
+ * opusfile store them, so the values of the picture fields are read in place.
  */
 void
 et_add_file_tags_from_vorbis_comments (vorbis_comment *vc,
                                        File_Tag *FileTag)
 {
-    GHashTable *tags;
-    GSList *strings;
-    GHashTableIter tags_iter;
-    gchar *key;
+    EtVorbisCommentReader reader;
+    GPtrArray *cover_arts = NULL;
+    GPtrArray *types = NULL;
+    GPtrArray *descs = NULL;
+    EtPicture *block_pics = NULL;
+    EtPicture *prev_block_pic = NULL;
     EtPicture *prev_pic = NULL;
-
-    tags = populate_tag_hash_table (vc);
+    gint i;
 
     /* Note : don't forget to add any new field to 'Save unsupported fields' */
+    et_vorbis_comment_reader_init (&reader, FileTag, TRUE);
 
-    /* Title. */
-    if ((strings = g_hash_table_lookup (tags, ET_VORBIS_COMMENT_FIELD_TITLE)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->title);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TITLE);
-    }
-
-    /* Artist. */
-    if ((strings = g_hash_table_lookup (tags, ET_VORBIS_COMMENT_FIELD_ARTIST)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->artist);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ARTIST);
-    }
-
-    /* Album artist. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->album_artist);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST);
-    }
-
-    /* Album */
-    if ((strings = g_hash_table_lookup (tags, ET_VORBIS_COMMENT_FIELD_ALBUM)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->album);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ALBUM);
-    }
-
-    /* Disc number and total discs. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_DISC_TOTAL)))
-    {
-        /* Only take values from the first total discs field. */
-        if (!et_str_empty (strings->data))
-        {
-            FileTag->disc_total = et_disc_number_to_string (atoi (strings->data));
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DISC_TOTAL);
-    }
-
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_DISC_NUMBER)))
-    {
-        /* Only take values from the first disc number field. */
-        if (!et_str_empty (strings->data))
-        {
-            gchar *separator;
-
-            separator = strchr (strings->data, '/');
-
-            if (separator && !FileTag->disc_total)
-            {
-                FileTag->disc_total = et_disc_number_to_string (atoi (separator + 1));
-                *separator = '\0';
-            }
-
-            FileTag->disc_number = et_disc_number_to_string (atoi (strings->data));
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DISC_NUMBER);
-    }
-
-    /* Year. */
-    if ((strings = g_hash_table_lookup (tags, ET_VORBIS_COMMENT_FIELD_DATE)))
+    for (i = 0; i < vc->comments; i++)
     {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->year);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DATE);
-    }
+        const gchar *value;
+        gsize value_length;
+        EtPicture *pic;
 
-    /* Track number and total tracks. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL)))
-    {
-        /* Only take values from the first total tracks field. */
-        if (!et_str_empty (strings->data))
+        switch (et_vorbis_comment_reader_add (&reader, vc->user_comments[i],
+                                              vc->comment_lengths[i], &value,
+                                              &value_length))
         {
-            FileTag->track_total = et_track_number_to_string (atoi (strings->data));
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL);
-    }
-
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER)))
-    {
-        /* Only take values from the first track number field. */
-        if (!et_str_empty (strings->data))
-        {
-            gchar *separator;
-
-            separator = strchr (strings->data, '/');
-
-            if (separator && !FileTag->track_total)
-            {
-                FileTag->track_total = et_track_number_to_string (atoi (separator + 1));
-                *separator = '\0';
-            }
-
-            FileTag->track = et_track_number_to_string (atoi (strings->data));
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER);
-    }
-
-    /* Genre. */
-    if ((strings = g_hash_table_lookup (tags, ET_VORBIS_COMMENT_FIELD_GENRE)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->genre);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_GENRE);
-    }
-
-    /* Comment */
-    {
-        GSList *descs;
-        GSList *comments;
+            case ET_VORBIS_COMMENT_KEY_COVER_ART:
+                if (cover_arts == NULL)
+                {
+                    cover_arts = g_ptr_array_new ();
+                }
 
-        descs = g_hash_table_lookup (tags,
-                                     ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-        comments = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_COMMENT);
+                g_ptr_array_add (cover_arts, (gpointer)value);
+                break;
+            case ET_VORBIS_COMMENT_KEY_COVER_ART_TYPE:
+                if (types == NULL)
+                {
+                    types = g_ptr_array_new ();
+                }
 
-        if (descs && !comments)
-        {
-            g_slist_foreach (descs, values_list_foreach, &FileTag->comment);
-        }
-        else if (descs && comments)
-        {
-            /* Mark the file as modified, so that comments are written to the
-             * DESCRIPTION field on saving. */
-            FileTag->saved = FALSE;
+                g_ptr_array_add (types, (gpointer)value);
+                break;
+            case ET_VORBIS_COMMENT_KEY_COVER_ART_DESCRIPTION:
+                if (descs == NULL)
+                {
+                    descs = g_ptr_array_new ();
+                }
 
-            g_slist_foreach (descs, values_list_foreach, &FileTag->comment);
-            g_slist_foreach (comments, values_list_foreach, &FileTag->comment);
-        }
-        else if (comments)
-        {
-            FileTag->saved = FALSE;
+                g_ptr_array_add (descs, (gpointer)value);
+                break;
+            case ET_VORBIS_COMMENT_KEY_METADATA_BLOCK_PICTURE:
+                /* METADATA_BLOCK_PICTURE tag used for picture information. */
+                pic = picture_from_metadata_block_picture (value);
 
-            g_slist_foreach (comments, values_list_foreach, &FileTag->comment);
+                if (pic == NULL)
+                {
+                    /* Mark the file as modified, so that the invalid field is
+                     * removed upon saving. */
+                    FileTag->saved = FALSE;
+                }
+                else if (!prev_block_pic)
+                {
+                    block_pics = pic;
+                    prev_block_pic = pic;
+                }
+                else
+                {
+                    prev_block_pic->next = pic;
+                    prev_block_pic = pic;
+                }
+                break;
+            case ET_VORBIS_COMMENT_KEY_UNKNOWN:
+            case ET_VORBIS_COMMENT_KEY_TEXT:
+            default:
+                break;
         }
-
-        g_slist_free (descs);
-        g_slist_free (comments);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_DESCRIPTION);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COMMENT);
     }
 
-    /* Composer. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_COMPOSER)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->composer);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COMPOSER);
-    }
-
-    /* Original artist. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_PERFORMER)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->orig_artist);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_PERFORMER);
-    }
-
-    /* Copyright. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_COPYRIGHT)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->copyright);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COPYRIGHT);
-    }
-
-    /* URL. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_CONTACT)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->url);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_CONTACT);
-    }
-
-    /* Encoded by. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_ENCODED_BY)))
-    {
-        g_slist_foreach (strings, values_list_foreach, &FileTag->encoded_by);
-        g_slist_free (strings);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_ENCODED_BY);
-    }
+    et_vorbis_comment_reader_finish (&reader);
 
     /* Cover art. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_COVER_ART)))
+    if (cover_arts)
     {
-        GSList *l;
-        GSList *m;
-        GSList *n;
-        GSList *types;
-        GSList *descs;
+        guint j;
 
         /* Force marking the file as modified, so that the deprecated cover art
          * field is converted to a METADATA_PICTURE_BLOCK field. */
         FileTag->saved = FALSE;
 
-        types = g_hash_table_lookup (tags,
-                                     ET_VORBIS_COMMENT_FIELD_COVER_ART_TYPE);
-        descs = g_hash_table_lookup (tags,
-                                     ET_VORBIS_COMMENT_FIELD_COVER_ART_DESCRIPTION);
-
-        l = strings;
-        m = types;
-        n = descs;
-
-        while (l && !et_str_empty (l->data))
+        for (j = 0; j < cover_arts->len
+                    && !et_str_empty (g_ptr_array_index (cover_arts, j)); j++)
         {
             EtPicture *pic;
             guchar *data;
             gsize data_size;
             GBytes *bytes;
             EtPictureType type;
-            const gchar *description;
+            gchar *description;
 
             /* Decode picture data. */
-            data = g_base64_decode (l->data, &data_size);
+            data = g_base64_decode (g_ptr_array_index (cover_arts, j),
+                                    &data_size);
             bytes = g_bytes_new_take (data, data_size);
 
             /* It is only necessary for there to be image data, but the type
              * and description are optional. */
-            if (m)
+            if (types && j < types->len
+                && !et_str_empty (g_ptr_array_index (types, j)))
             {
-                type = !et_str_empty (m->data) ? atoi (m->data)
-                                               : ET_PICTURE_TYPE_FRONT_COVER;
-
-                m = g_slist_next (m);
+                type = atoi (g_ptr_array_index (types, j));
             }
             else
             {
                 type = ET_PICTURE_TYPE_FRONT_COVER;
             }
 
-            if (n)
+            if (descs && j < descs->len)
             {
-                description = !et_str_empty (n->data) ? n->data : "";
+                const gchar *desc = g_ptr_array_index (descs, j);
 
-                n = g_slist_next (n);
+                description = et_vorbis_comment_validate_value (desc,
+                                                                strlen (desc));
             }
             else
             {
-                description = "";
+                description = g_strdup ("");
             }
 
             pic = et_picture_new (type, description, 0, 0, bytes);
             g_bytes_unref (bytes);
+            g_free (description);
 
             if (!prev_pic)
             {
@@ -550,183 +384,34 @@ et_add_file_tags_from_vorbis_comments (vorbis_comment *vc,
             }
 
             prev_pic = pic;
-
-            l = g_slist_next (l);
         }
 
-        g_slist_free_full (strings, g_free);
-        g_slist_free_full (types, g_free);
-        g_slist_free_full (descs, g_free);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COVER_ART);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COVER_ART_DESCRIPTION);
-        g_hash_table_remove (tags, ET_VORBIS_COMMENT_FIELD_COVER_ART_TYPE);
+        g_ptr_array_free (cover_arts, TRUE);
     }
 
-    /* METADATA_BLOCK_PICTURE tag used for picture information. */
-    if ((strings = g_hash_table_lookup (tags,
-                                        ET_VORBIS_COMMENT_FIELD_METADATA_BLOCK_PICTURE)))
+    if (types)
     {
-        GSList *l;
-
-        for (l = strings; l != NULL; l = g_slist_next (l))
-        {
-            EtPicture *pic;
-            gsize bytes_pos, mimelen, desclen;
-            guchar *decoded_ustr;
-            GBytes *bytes = NULL;
-            EtPictureType type;
-            gchar *description;
-            GBytes *pic_bytes;
-            gsize decoded_size;
-            gsize data_size;
-
-            /* Decode picture data. */
-            decoded_ustr = g_base64_decode (l->data, &decoded_size);
-
-            /* Check that the comment decoded to a long enough string to hold the
-             * whole structure (8 fields of 4 bytes each). */
-            if (decoded_size < 8 * 4)
-            {
-                g_free (decoded_ustr);
-                goto invalid_picture;
-            }
-
-            bytes = g_bytes_new_take (decoded_ustr, decoded_size);
-
-            /* Reading picture type. */
-            type = read_guint32_from_byte (decoded_ustr, 0);
-            bytes_pos = 4;
-
-            /* TODO: Check that there is a maximum of 1 of each of
-             * ET_PICTURE_TYPE_FILE_ICON and ET_PICTURE_TYPE_OTHER_FILE_ICON types
-             * in the file. */
-            if (type >= ET_PICTURE_TYPE_UNDEFINED)
-            {
-                goto invalid_picture;
-            }
-
-            /* Reading MIME data. */
-            mimelen = read_guint32_from_byte (decoded_ustr, bytes_pos);
-            bytes_pos += 4;
-
-            if (mimelen > decoded_size - bytes_pos - (6 * 4))
-            {
-                goto invalid_picture;
-            }
-
-            /* Check for a valid MIME type. */
-            if (mimelen > 0)
-            {
-                const gchar *mime;
-
-                mime = (const gchar *)&decoded_ustr[bytes_pos];
-
-                /* TODO: Check for "-->" when adding linked image support. */
-                if (strncmp (mime, "image/", mimelen) != 0
-                    && strncmp (mime, "image/png", mimelen) != 0
-                    && strncmp (mime, "image/jpeg", mimelen) != 0)
-                {
-                    gchar *mime_str;
-
-                    mime_str = g_strndup (mime, mimelen);
-                    g_debug ("Invalid Vorbis comment image MIME type: %s",
-                             mime_str);
-
-                    g_free (mime_str);
-                    goto invalid_picture;
-                }
-            }
-
-            /* Skip over the MIME type, as gdk-pixbuf does not use it. */
-            bytes_pos += mimelen;
-
-            /* Reading description */
-            desclen = read_guint32_from_byte (decoded_ustr, bytes_pos);
-            bytes_pos += 4;
-
-            if (desclen > decoded_size - bytes_pos - (5 * 4))
-            {
-                goto invalid_picture;
-            }
-
-            description = g_strndup ((const gchar *)&decoded_ustr[bytes_pos],
-                                     desclen);
-
-            /* Skip the width, height, color depth and number-of-colors fields. */
-            bytes_pos += desclen + 16;
-
-            /* Reading picture size */
-            data_size = read_guint32_from_byte (decoded_ustr, bytes_pos);
-            bytes_pos += 4;
-
-            if (data_size > decoded_size - bytes_pos)
-            {
-                g_free (description);
-                goto invalid_picture;
-            }
-
-            /* Read only the image data into a new GBytes. */
-            pic_bytes = g_bytes_new_from_bytes (bytes, bytes_pos, data_size);
-
-            pic = et_picture_new (type, description, 0, 0, pic_bytes);
-
-            g_free (description);
-            g_bytes_unref (pic_bytes);
-
-            if (!prev_pic)
-            {
-                FileTag->picture = pic;
-            }
-            else
-            {
-                prev_pic->next = pic;
-            }
-
-            prev_pic = pic;
-
-            /* pic->bytes still holds a ref on the decoded data. */
-            g_bytes_unref (bytes);
-            continue;
-
-invalid_picture:
-            /* Mark the file as modified, so that the invalid field is removed upon
-             * saving. */
-            FileTag->saved = FALSE;
-
-            g_bytes_unref (bytes);
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_remove (tags,
-                             ET_VORBIS_COMMENT_FIELD_METADATA_BLOCK_PICTURE);
+        g_ptr_array_free (types, TRUE);
     }
 
-    /* Save unsupported fields. */
-    g_hash_table_iter_init (&tags_iter, tags);
-
-    while (g_hash_table_iter_next (&tags_iter, (gpointer *)&key,
-                                   (gpointer *)&strings))
+    if (descs)
     {
-        GSList *l;
-
-        for (l = strings; l != NULL; l = g_slist_next (l))
-        {
-            FileTag->other = g_list_prepend (FileTag->other,
-                                             g_strconcat (key, "=", l->data,
-                                                          NULL));
-        }
-
-        g_slist_free_full (strings, g_free);
-        g_hash_table_iter_remove (&tags_iter);
+        g_ptr_array_free (descs, TRUE);
     }
 
-    if (FileTag->other)
+    /* The pictures of the METADATA_BLOCK_PICTURE fields follow the cover art
+     * pictures. */
+    if (block_pics)
     {
-        FileTag->other = g_list_reverse (FileTag->other);
+        if (!prev_pic)
+        {
+            FileTag->picture = block_pics;
+        }
+        else
+        {
+            prev_pic->next = block_pics;
+        }
     }
-
-    /* The hash table should now only contain keys. */
-    g_hash_table_unref (tags);
 }
 
 /*
@@ -739,77 +424,36 @@ ogg_tag_read_file_tag (GFile *file,
                        File_Tag *FileTag,
                        GError **error)
 {
-    GFileInputStream *istream;
     EtOggState *state;
 
     g_return_val_if_fail (file != NULL && FileTag != NULL, FALSE);
     g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-    istream = g_file_read (file, NULL, error);
+    state = vcedit_new_state();    // Allocate memory for 'state'
 
-    if (!istream)
+    if (!vcedit_open (state, file, error))
     {
         g_assert (error == NULL || *error != NULL);
+        vcedit_clear(state);
         return FALSE;
     }
 
-    {
-    /* Check for an unsupported ID3v2 tag. */
-    guchar tmp_id3[4];
-
-    if (g_input_stream_read (G_INPUT_STREAM (istream), tmp_id3, 4, NULL,
-                             error) == 4)
-    {
-        /* Calculate ID3v2 length. */
-        if (tmp_id3[0] == 'I' && tmp_id3[1] == 'D' && tmp_id3[2] == '3'
-            && tmp_id3[3] < 0xFF)
-        {
-            /* ID3v2 tag skipper $49 44 33 yy yy xx zz zz zz zz [zz size]. */
-            /* Size is 6-9 position */
-            if (!g_seekable_seek (G_SEEKABLE (istream), 2, G_SEEK_CUR,
-                                  NULL, error))
-            {
-                goto err;
-            }
-
-            if (g_input_stream_read (G_INPUT_STREAM (istream), tmp_id3, 4,
-                                     NULL, error) == 4)
-            {
-                gchar *path;
-
-                path = g_file_get_path (file);
-                g_debug ("Ogg file '%s' contains an ID3v2 tag", path);
-                g_free (path);
-
-                /* Mark the file as modified, so that the ID3 tag is removed
-                 * upon saving. */
-                FileTag->saved = FALSE;
-            }
-        }
-    }
-
-    if (error && *error != NULL)
-    {
-        goto err;
-    }
-
-    }
-
     g_assert (error == NULL || *error == NULL);
 
-    g_object_unref (istream);
+    /* Check for an unsupported ID3v2 tag, found while opening the file. */
+    if (vcedit_has_id3v2 (state))
+    {
+        gchar *path;
 
-    state = vcedit_new_state();    // Allocate memory for 'state'
+        path = g_file_get_path (file);
+        g_debug ("Ogg file '%s' contains an ID3v2 tag", path);
+        g_free (path);
 
-    if (!vcedit_open (state, file, error))
-    {
-        g_assert (error == NULL || *error != NULL);
-        vcedit_clear(state);
-        return FALSE;
+        /* Mark the file as modified, so that the ID3 tag is removed upon
+         * saving. */
+        FileTag->saved = FALSE;
     }
 
-    g_assert (error == NULL || *error == NULL);
-
     /* Get data from tag */
     /*{
         gint i; 
@@ -821,11 +465,6 @@ ogg_tag_read_file_tag (GFile *file,
     vcedit_clear(state);
 
     return TRUE;
-
-err:
-    g_assert (error == NULL || *error != NULL);
-    g_object_unref (istream);
-    return FALSE;
 }
 
 /*
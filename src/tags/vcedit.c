@@ -32,6 +32,10 @@
 
 #define CHUNKSIZE 4096
 
+/* The maximum size of an Ogg page, with 255 segments of 255 bytes. The start
+ * of the last page of a stream is always within this many bytes of the end. */
+#define ET_OGG_MAX_PAGE_SIZE 65307
+
 struct _EtOggState
 {
     /*< private >*/
@@ -55,6 +59,10 @@ struct _EtOggState
     glong prevW;
     gboolean extrapage;
     gboolean eosin;
+    gboolean id3v2;
+    goffset size;
+    ogg_int64_t start_granulepos;
+    ogg_int64_t granulepos;
 };
 
 EtOggState *
@@ -62,6 +70,8 @@ vcedit_new_state (void)
 {
     EtOggState *state = g_slice_new0 (EtOggState);
     state->oggtype = ET_OGG_KIND_UNKNOWN;
+    state->start_granulepos = -1;
+    state->granulepos = -1;
 
     return state;
 }
@@ -72,6 +82,18 @@ vcedit_comments (EtOggState *state)
     return state->vc;
 }
 
+EtOggKind
+vcedit_kind (EtOggState *state)
+{
+    return state->oggtype;
+}
+
+const vorbis_info *
+vcedit_vorbis_info (EtOggState *state)
+{
+    return state->vi;
+}
+
 #ifdef ENABLE_SPEEX
 const SpeexHeader *
 vcedit_speex_header (EtOggState *state)
@@ -80,6 +102,73 @@ vcedit_speex_header (EtOggState *state)
 }
 #endif /* ENABLE_SPEEX */
 
+#ifdef ENABLE_OPUS
+const OpusHead *
+vcedit_opus_header (EtOggState *state)
+{
+    return state->oi;
+}
+#endif /* ENABLE_OPUS */
+
+/*
+ * vcedit_has_id3v2:
+ * @state: the state of a file opened with vcedit_open()
+ *
+ * Check whether the file starts with an (unsupported) ID3v2 tag, which
+ * ogg_sync_pageout() skips over as garbage before the first page.
+ *
+ * Returns: %TRUE if an ID3v2 tag was found, %FALSE otherwise
+ */
+gboolean
+vcedit_has_id3v2 (EtOggState *state)
+{
+    return state->id3v2;
+}
+
+/*
+ * vcedit_file_size:
+ * @state: the state of a file opened with vcedit_probe()
+ *
+ * Returns: the size of the file, in bytes
+ */
+goffset
+vcedit_file_size (EtOggState *state)
+{
+    return state->size;
+}
+
+/*
+ * vcedit_granulepos:
+ * @state: the state of a file opened with vcedit_probe()
+ *
+ * Get the granule position of the last page of the logical stream, which for
+ * all the supported codecs is the number of samples at the end of the stream.
+ *
+ * Returns: the granule position, or -1 if it was not found
+ */
+ogg_int64_t
+vcedit_granulepos (EtOggState *state)
+{
+    return state->granulepos;
+}
+
+/*
+ * vcedit_start_granulepos:
+ * @state: the state of a file opened with vcedit_probe()
+ *
+ * Get the granule position of the start of the audio of the logical stream,
+ * which is not 0 for streams cut from a longer stream, such as recordings of
+ * live streams. It is computed from the granule position of the first audio
+ * page, less the samples of the packets which end on that page.
+ *
+ * Returns: the granule position, or -1 if it was not found
+ */
+ogg_int64_t
+vcedit_start_granulepos (EtOggState *state)
+{
+    return state->start_granulepos;
+}
+
 static void
 vcedit_clear_internals (EtOggState *state)
 {
@@ -464,10 +553,21 @@ err:
     return result;
 }
 
-gboolean
-vcedit_open (EtOggState *state,
-             GFile *file,
-             GError **error)
+/*
+ * vcedit_open_stream:
+ * @state: the state to fill
+ * @istream: a stream at the start of the Ogg file
+ * @error: a #GError to set on failure
+ *
+ * Read the header packets, including the comment header, from the start of
+ * @istream. The stream is left open, just after the last header page.
+ *
+ * Returns: %TRUE on success, %FALSE and sets @error otherwise
+ */
+static gboolean
+vcedit_open_stream (EtOggState *state,
+                    GFileInputStream *istream,
+                    GError **error)
 {
     char *buffer;
     gssize bytes;
@@ -480,17 +580,6 @@ vcedit_open (EtOggState *state,
     ogg_packet  header_comments;
     ogg_packet  header_codebooks;
     ogg_page    og;
-    GFileInputStream *istream;
-
-    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-
-    istream = g_file_read (file, NULL, error);
-
-    if (!istream)
-    {
-        g_assert (error == NULL || *error != NULL);
-        return FALSE;
-    }
 
     state->oy = g_slice_new (ogg_sync_state);
     ogg_sync_init (state->oy);
@@ -505,6 +594,14 @@ vcedit_open (EtOggState *state,
             goto err;
         }
 
+        /* Check for an unsupported ID3v2 tag, $49 44 33 yy yy xx zz zz zz zz,
+         * which is later skipped over by the Ogg sync layer. */
+        if (chunks == 0 && bytes >= 10 && memcmp (buffer, "ID3", 3) == 0
+            && (guchar)buffer[3] < 0xFF)
+        {
+            state->id3v2 = TRUE;
+        }
+
         ogg_sync_wrote(state->oy, bytes);
 
         if(ogg_sync_pageout(state->oy, &og) == 1)
@@ -770,18 +867,328 @@ vcedit_open (EtOggState *state,
 
     /* Headers are done! */
     g_assert (error == NULL || *error == NULL);
-    /* TODO: Handle error during stream close. */
-    g_object_unref (istream);
 
     return TRUE;
 
 err:
     g_assert (error == NULL || *error != NULL);
-    g_object_unref (istream);
     vcedit_clear_internals (state);
     return FALSE;
 }
 
+gboolean
+vcedit_open (EtOggState *state,
+             GFile *file,
+             GError **error)
+{
+    GFileInputStream *istream;
+    gboolean success;
+
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    istream = g_file_read (file, NULL, error);
+
+    if (!istream)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
+
+    success = vcedit_open_stream (state, istream, error);
+
+    /* TODO: Handle error during stream close. */
+    g_object_unref (istream);
+
+    return success;
+}
+
+/*
+ * _packet_samples:
+ * @state: the state of a file with the headers already read
+ * @packet: an audio packet of the stream
+ * @prevW: (inout): for Vorbis, the block size of the previous packet, or 0
+ *
+ * Returns: the number of samples decoded from @packet, or -1 if it is not a
+ *          valid audio packet
+ */
+static gint64
+_packet_samples (EtOggState *state,
+                 ogg_packet *packet,
+                 glong *prevW)
+{
+    switch (state->oggtype)
+    {
+        case ET_OGG_KIND_VORBIS:
+        {
+            /* As _blocksize(), the first packet only primes the decoder. */
+            const glong this = vorbis_packet_blocksize (state->vi, packet);
+            gint64 samples;
+
+            if (this < 0)
+            {
+                return -1;
+            }
+
+            samples = *prevW ? (this + *prevW) / 4 : 0;
+            *prevW = this;
+
+            return samples;
+        }
+#ifdef ENABLE_SPEEX
+        case ET_OGG_KIND_SPEEX:
+            return (gint64)state->si->frame_size
+                   * MAX (state->si->frames_per_packet, 1);
+#endif
+#ifdef ENABLE_OPUS
+        case ET_OGG_KIND_OPUS:
+        {
+            /* Granule positions are always at 48 kHz for Opus. */
+            const int samples = opus_packet_get_nb_samples (packet->packet,
+                                                            packet->bytes,
+                                                            48000);
+
+            return samples < 0 ? -1 : samples;
+        }
+#endif
+#ifndef ENABLE_SPEEX
+        case ET_OGG_KIND_SPEEX:
+#endif
+#ifndef ENABLE_OPUS
+        case ET_OGG_KIND_OPUS:
+#endif
+        case ET_OGG_KIND_UNKNOWN:
+        case ET_OGG_KIND_UNSUPPORTED:
+        default:
+            return -1;
+    }
+}
+
+/*
+ * vcedit_read_start_granulepos:
+ * @state: the state of a file with the headers just read
+ * @istream: the stream of the file, just after the data read by the headers
+ * @error: a #GError to set on failure
+ *
+ * Find the granule position of the start of the audio, from the pages which
+ * follow the headers, reading at most two pages more. Stores the granule
+ * position in @state if it was found.
+ *
+ * Returns: %TRUE on success, even if the granule position was not found,
+ *          %FALSE and sets @error if the file could not be read
+ */
+static gboolean
+vcedit_read_start_granulepos (EtOggState *state,
+                              GFileInputStream *istream,
+                              GError **error)
+{
+    ogg_stream_state os;
+    ogg_page og;
+    ogg_packet op;
+    gint64 samples = 0;
+    glong prevW = 0;
+    gsize bytes_read = 0;
+
+    ogg_stream_init (&os, state->serial);
+
+    for (;;)
+    {
+        int result = ogg_sync_pageout (state->oy, &og);
+
+        if (result == 0)
+        {
+            gchar *buffer;
+            gssize bytes;
+
+            if (bytes_read >= 2 * ET_OGG_MAX_PAGE_SIZE)
+            {
+                break;
+            }
+
+            buffer = ogg_sync_buffer (state->oy, CHUNKSIZE);
+            bytes = g_input_stream_read (G_INPUT_STREAM (istream), buffer,
+                                         CHUNKSIZE, NULL, error);
+
+            if (bytes == -1)
+            {
+                g_assert (error == NULL || *error != NULL);
+                ogg_stream_clear (&os);
+                return FALSE;
+            }
+            else if (bytes == 0)
+            {
+                break;
+            }
+
+            ogg_sync_wrote (state->oy, bytes);
+            bytes_read += bytes;
+            continue;
+        }
+
+        if (result < 0 || ogg_page_serialno (&og) != state->serial)
+        {
+            continue;
+        }
+
+        ogg_stream_pagein (&os, &og);
+
+        while ((result = ogg_stream_packetout (&os, &op)) != 0)
+        {
+            const gint64 packet_samples = result > 0
+                                          ? _packet_samples (state, &op,
+                                                             &prevW)
+                                          : -1;
+
+            /* A hole in the data, or an invalid packet. */
+            if (packet_samples < 0)
+            {
+                ogg_stream_clear (&os);
+                return TRUE;
+            }
+
+            samples += packet_samples;
+        }
+
+        /* The granule position of a page is that of the last packet which
+         * ends on it, if any. */
+        if (ogg_page_granulepos (&og) >= 0)
+        {
+            state->start_granulepos = MAX (ogg_page_granulepos (&og)
+                                           - samples, 0);
+            break;
+        }
+    }
+
+    ogg_stream_clear (&os);
+
+    return TRUE;
+}
+
+/*
+ * vcedit_read_granulepos:
+ * @state: the state of a file with the headers already read
+ * @istream: the stream of the file
+ * @error: a #GError to set on failure
+ *
+ * Find the granule position of the last page of the logical stream with a
+ * single read of the end of the file, rather than bisecting the whole file.
+ * Stores the size of the file and the granule position in @state.
+ *
+ * Returns: %TRUE on success, %FALSE and sets @error otherwise
+ */
+static gboolean
+vcedit_read_granulepos (EtOggState *state,
+                        GFileInputStream *istream,
+                        GError **error)
+{
+    GFileInfo *info;
+    ogg_sync_state oy;
+    ogg_page og;
+    goffset offset;
+    gsize length;
+    gsize bytes;
+    gchar *buffer;
+    glong result;
+
+    info = g_file_input_stream_query_info (istream,
+                                           G_FILE_ATTRIBUTE_STANDARD_SIZE,
+                                           NULL, error);
+
+    if (!info)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
+
+    state->size = g_file_info_get_size (info);
+    g_object_unref (info);
+
+    offset = MAX (state->size - ET_OGG_MAX_PAGE_SIZE, 0);
+    length = state->size - offset;
+
+    if (!g_seekable_seek (G_SEEKABLE (istream), offset, G_SEEK_SET, NULL,
+                          error))
+    {
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
+
+    ogg_sync_init (&oy);
+    buffer = ogg_sync_buffer (&oy, length);
+
+    if (!g_input_stream_read_all (G_INPUT_STREAM (istream), buffer, length,
+                                  &bytes, NULL, error))
+    {
+        g_assert (error == NULL || *error != NULL);
+        ogg_sync_clear (&oy);
+        return FALSE;
+    }
+
+    ogg_sync_wrote (&oy, bytes);
+
+    /* Skip over the end of the page which straddles the offset, keeping the
+     * granule position of the last page which completes a packet. */
+    while ((result = ogg_sync_pageseek (&oy, &og)) != 0)
+    {
+        if (result > 0 && ogg_page_serialno (&og) == state->serial
+            && ogg_page_granulepos (&og) >= 0)
+        {
+            state->granulepos = ogg_page_granulepos (&og);
+        }
+    }
+
+    ogg_sync_clear (&oy);
+
+    return TRUE;
+}
+
+/*
+ * vcedit_probe:
+ * @state: the state to fill
+ * @file: the Ogg file to read
+ * @error: a #GError to set on failure
+ *
+ * Like vcedit_open(), but also find the size of the file and the granule
+ * positions of the start of the audio and of the last page, from which the
+ * duration can be computed, using the same stream.
+ *
+ * Returns: %TRUE on success, %FALSE and sets @error otherwise
+ */
+gboolean
+vcedit_probe (EtOggState *state,
+              GFile *file,
+              GError **error)
+{
+    GFileInputStream *istream;
+
+    g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+    istream = g_file_read (file, NULL, error);
+
+    if (!istream)
+    {
+        g_assert (error == NULL || *error != NULL);
+        return FALSE;
+    }
+
+    if (!vcedit_open_stream (state, istream, error))
+    {
+        g_object_unref (istream);
+        return FALSE;
+    }
+
+    if (!vcedit_read_start_granulepos (state, istream, error)
+        || !vcedit_read_granulepos (state, istream, error))
+    {
+        g_object_unref (istream);
+        vcedit_clear_internals (state);
+        return FALSE;
+    }
+
+    g_object_unref (istream);
+
+    return TRUE;
+}
+
 gboolean
 vcedit_write (EtOggState *state,
               GFile *file,
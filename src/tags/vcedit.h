@@ -116,10 +116,20 @@ typedef struct _EtOggState EtOggState;
 EtOggState *vcedit_new_state (void);
 void vcedit_clear (EtOggState *state);
 vorbis_comment * vcedit_comments (EtOggState *state);
+EtOggKind vcedit_kind (EtOggState *state);
+const vorbis_info * vcedit_vorbis_info (EtOggState *state);
 #ifdef ENABLE_SPEEX
 const SpeexHeader * vcedit_speex_header (EtOggState *state);
 #endif /* ENABLE_SPEEX */
+#ifdef ENABLE_OPUS
+const OpusHead * vcedit_opus_header (EtOggState *state);
+#endif /* ENABLE_OPUS */
+gboolean vcedit_has_id3v2 (EtOggState *state);
+goffset vcedit_file_size (EtOggState *state);
+ogg_int64_t vcedit_granulepos (EtOggState *state);
+ogg_int64_t vcedit_start_granulepos (EtOggState *state);
 int vcedit_open (EtOggState *state, GFile *in, GError **error);
+int vcedit_probe (EtOggState *state, GFile *file, GError **error);
 int vcedit_write (EtOggState *state, GFile *file, GError **error);
 
 #endif /* ENABLE_OGG */
@@ -0,0 +1,492 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#if defined ENABLE_OGG || defined ENABLE_FLAC
+
+#include "vorbis_comment.h"
+
+#include <string.h>
+
+#include "charset.h"
+#include "misc.h"
+#include "vcedit.h"
+
+#define MULTIFIELD_SEPARATOR " - "
+
+/*
+ * EtVorbisCommentField:
+ *
+ * How the value of a known field is read.
+ */
+typedef enum
+{
+    FIELD_STRING,
+    FIELD_DISC_NUMBER,
+    FIELD_DISC_TOTAL,
+    FIELD_TRACK_NUMBER,
+    FIELD_TRACK_TOTAL,
+    FIELD_COMMENT,
+    FIELD_PICTURE
+} EtVorbisCommentField;
+
+#define KNOWN_FIELD(name, field, offset, key) \
+    { name, sizeof (name) - 1, field, offset, key }
+
+/* The fields which are displayed, and the picture fields. The names are
+ * matched case-insensitively, as the specification requires. */
+static const struct
+{
+    const gchar *name;
+    gsize length;
+    EtVorbisCommentField field;
+    glong offset;
+    EtVorbisCommentKey key;
+} known_fields[] =
+{
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_TITLE, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, title),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_ARTIST, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, artist),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_ALBUM_ARTIST, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, album_artist),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_ALBUM, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, album),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_DISC_NUMBER, FIELD_DISC_NUMBER, 0,
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_DISC_TOTAL, FIELD_DISC_TOTAL, 0,
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_DATE, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, year),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_TRACK_NUMBER, FIELD_TRACK_NUMBER, 0,
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_TRACK_TOTAL, FIELD_TRACK_TOTAL, 0,
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_GENRE, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, genre),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_DESCRIPTION, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, comment),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COMMENT, FIELD_COMMENT, 0,
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COMPOSER, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, composer),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_PERFORMER, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, orig_artist),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COPYRIGHT, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, copyright),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_CONTACT, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, url),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_ENCODED_BY, FIELD_STRING,
+                 G_STRUCT_OFFSET (File_Tag, encoded_by),
+                 ET_VORBIS_COMMENT_KEY_TEXT),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COVER_ART, FIELD_PICTURE, 0,
+                 ET_VORBIS_COMMENT_KEY_COVER_ART),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COVER_ART_TYPE, FIELD_PICTURE, 0,
+                 ET_VORBIS_COMMENT_KEY_COVER_ART_TYPE),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_COVER_ART_DESCRIPTION, FIELD_PICTURE,
+                 0, ET_VORBIS_COMMENT_KEY_COVER_ART_DESCRIPTION),
+    KNOWN_FIELD (ET_VORBIS_COMMENT_FIELD_METADATA_BLOCK_PICTURE,
+                 FIELD_PICTURE, 0,
+                 ET_VORBIS_COMMENT_KEY_METADATA_BLOCK_PICTURE)
+};
+
+#undef KNOWN_FIELD
+
+/*
+ * set_or_append_field:
+ * @field: (inout): pointer to a location in which to store the field value
+ * @field_value: (transfer full): the string to store in @field
+ *
+ * Set @field to @field_value if @field is empty, otherwise append to it.
+ * Ownership of @field_value is transferred to this function.
+ */
+static void
+set_or_append_field (gchar **field,
+                     gchar *field_value)
+{
+    if (*field == NULL)
+    {
+        *field = field_value;
+    }
+    else
+    {
+        gchar *field_tmp = g_strconcat (*field, MULTIFIELD_SEPARATOR,
+                                        field_value, NULL);
+        g_free (*field);
+        *field = field_tmp;
+        g_free (field_value);
+    }
+}
+
+/*
+ * et_vorbis_comment_validate_value:
+ * @value: the string to validate, which need not be nul-terminated
+ * @length: the length of @value
+ *
+ * Validate a Vorbis comment field to ensure that it is UTF-8. Either return a
+ * copy of the original (valid) string, or a converted equivalent (of an
+ * invalid UTF-8 string).
+ *
+ * Returns: a valid UTF-8 represenation of @value
+ */
+gchar *
+et_vorbis_comment_validate_value (const gchar *value,
+                                  gsize length)
+{
+    gchar *result;
+
+    if (g_utf8_validate (value, length, NULL))
+    {
+        result = g_strndup (value, length);
+    }
+    else
+    {
+        gchar *value_tmp = g_strndup (value, length);
+        /* Unnecessarily validates the field again, but this should not be the
+         * common case. */
+        result = Try_To_Validate_Utf8_String (value_tmp);
+        g_free (value_tmp);
+    }
+
+    return result;
+}
+
+/*
+ * parse_number:
+ * @value: the string to parse, which need not be nul-terminated
+ * @length: the length of @value
+ *
+ * Parse the number at the start of @value, as atoi() does.
+ *
+ * Returns: the number
+ */
+static gint
+parse_number (const gchar *value,
+              gsize length)
+{
+    const gchar *p = value;
+    const gchar *value_end = value + length;
+    gboolean negative = FALSE;
+    gint number = 0;
+
+    while (p < value_end && g_ascii_isspace (*p))
+    {
+        p++;
+    }
+
+    if (p < value_end && (*p == '-' || *p == '+'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
+
+    while (p < value_end && g_ascii_isdigit (*p))
+    {
+        number = number * 10 + g_ascii_digit_value (*p);
+        p++;
+    }
+
+    return negative ? -number : number;
+}
+
+/*
+ * et_vorbis_comment_reader_init:
+ * @reader: the reader to initialize
+ * @file_tag: the tag to fill
+ * @read_pictures: %TRUE to return the picture fields from
+ *                 et_vorbis_comment_reader_add(), %FALSE to keep them as
+ *                 other fields
+ *
+ * Start reading the fields of a Vorbis comment block into @file_tag. Call
+ * et_vorbis_comment_reader_add() for each field, and then
+ * et_vorbis_comment_reader_finish().
+ */
+void
+et_vorbis_comment_reader_init (EtVorbisCommentReader *reader,
+                               File_Tag *file_tag,
+                               gboolean read_pictures)
+{
+    g_return_if_fail (reader != NULL);
+    g_return_if_fail (file_tag != NULL);
+
+    memset (reader, 0, sizeof (*reader));
+    reader->file_tag = file_tag;
+    reader->read_pictures = read_pictures;
+}
+
+/*
+ * add_other_field:
+ * @reader: the reader
+ * @comment: the field, as "KEY=value"
+ * @length: the length of @comment
+ * @key_length: the length of the key in @comment
+ *
+ * Keep a field which is not displayed, with its key in upper-case ASCII, so
+ * that it is written back on saving.
+ */
+static void
+add_other_field (EtVorbisCommentReader *reader,
+                 const gchar *comment,
+                 gsize length,
+                 gsize key_length)
+{
+    gchar *other;
+
+    if (g_utf8_validate (comment + key_length + 1, length - key_length - 1,
+                         NULL))
+    {
+        gsize i;
+
+        other = g_strndup (comment, length);
+
+        for (i = 0; i < key_length; i++)
+        {
+            other[i] = g_ascii_toupper (other[i]);
+        }
+    }
+    else
+    {
+        gchar *key;
+        gchar *value;
+
+        key = g_ascii_strup (comment, key_length);
+        value = et_vorbis_comment_validate_value (comment + key_length + 1,
+                                                  length - key_length - 1);
+        other = g_strconcat (key, "=", value, NULL);
+        g_free (value);
+        g_free (key);
+    }
+
+    reader->other = g_list_prepend (reader->other, other);
+}
+
+/*
+ * et_vorbis_comment_reader_add:
+ * @reader: the reader
+ * @comment: a field of the Vorbis comment block, as "KEY=value", which need
+ *           not be nul-terminated
+ * @length: the length of @comment
+ * @value: (out): location to store the start of the value of a picture field
+ * @value_length: (out): location to store the length of the value of a
+ *                picture field
+ *
+ * Read one field directly from the buffer of the Vorbis comment block. The
+ * key is matched against the known fields without copying it, and the value
+ * is only copied once it is validated, into the tag. Only the fields which are
+ * not displayed are kept in the other fields of the tag.
+ *
+ * Returns: %ET_VORBIS_COMMENT_KEY_TEXT or %ET_VORBIS_COMMENT_KEY_UNKNOWN if
+ * the field was read, or the key of a picture field to be read by the caller
+ * from @value
+ */
+EtVorbisCommentKey
+et_vorbis_comment_reader_add (EtVorbisCommentReader *reader,
+                              const gchar *comment,
+                              gsize length,
+                              const gchar **value,
+                              gsize *value_length)
+{
+    File_Tag *file_tag;
+    const gchar *separator;
+    const gchar *field_value;
+    gsize key_length;
+    gsize field_length;
+    gsize i;
+
+    g_return_val_if_fail (reader != NULL, ET_VORBIS_COMMENT_KEY_UNKNOWN);
+    g_return_val_if_fail (value != NULL && value_length != NULL,
+                          ET_VORBIS_COMMENT_KEY_UNKNOWN);
+
+    separator = memchr (comment, '=', length);
+
+    if (!separator)
+    {
+        g_warning ("Field separator not found when reading Vorbis comment: %.*s",
+                   (gint)length, comment);
+        return ET_VORBIS_COMMENT_KEY_UNKNOWN;
+    }
+
+    file_tag = reader->file_tag;
+    key_length = separator - comment;
+    field_value = separator + 1;
+    field_length = length - key_length - 1;
+
+    for (i = 0; i < G_N_ELEMENTS (known_fields); i++)
+    {
+        if (known_fields[i].length == key_length
+            && g_ascii_strncasecmp (known_fields[i].name, comment,
+                                    key_length) == 0)
+        {
+            break;
+        }
+    }
+
+    if (i == G_N_ELEMENTS (known_fields)
+        || (known_fields[i].field == FIELD_PICTURE && !reader->read_pictures))
+    {
+        add_other_field (reader, comment, length, key_length);
+        return ET_VORBIS_COMMENT_KEY_UNKNOWN;
+    }
+
+    switch (known_fields[i].field)
+    {
+        case FIELD_STRING:
+            if (field_length > 0)
+            {
+                set_or_append_field (&G_STRUCT_MEMBER (gchar *, file_tag,
+                                                       known_fields[i].offset),
+                                     et_vorbis_comment_validate_value (field_value,
+                                                                       field_length));
+            }
+            break;
+        case FIELD_COMMENT:
+            /* Mark the file as modified, so that comments are written to the
+             * DESCRIPTION field on saving. */
+            file_tag->saved = FALSE;
+
+            if (field_length > 0)
+            {
+                set_or_append_field (&reader->comment,
+                                     et_vorbis_comment_validate_value (field_value,
+                                                                       field_length));
+            }
+            break;
+        case FIELD_DISC_TOTAL:
+            /* Only take values from the first total discs field, which has
+             * priority over the total in the disc number field. */
+            if (!reader->disc_total_seen && field_length > 0)
+            {
+                g_free (file_tag->disc_total);
+                file_tag->disc_total = et_disc_number_to_string (parse_number (field_value,
+                                                                               field_length));
+            }
+
+            reader->disc_total_seen = TRUE;
+            break;
+        case FIELD_DISC_NUMBER:
+            /* Only take values from the first disc number field. */
+            if (!reader->disc_number_seen && field_length > 0)
+            {
+                const gchar *separator;
+
+                separator = memchr (field_value, '/', field_length);
+
+                if (separator)
+                {
+                    if (!file_tag->disc_total)
+                    {
+                        file_tag->disc_total = et_disc_number_to_string (parse_number (separator + 1,
+                                                                                       field_length - (separator + 1 - field_value)));
+                    }
+
+                    field_length = separator - field_value;
+                }
+
+                file_tag->disc_number = et_disc_number_to_string (parse_number (field_value,
+                                                                                field_length));
+            }
+
+            reader->disc_number_seen = TRUE;
+            break;
+        case FIELD_TRACK_TOTAL:
+            /* Only take values from the first total tracks field. */
+            if (!reader->track_total_seen && field_length > 0)
+            {
+                g_free (file_tag->track_total);
+                file_tag->track_total = et_track_number_to_string (parse_number (field_value,
+                                                                                 field_length));
+            }
+
+            reader->track_total_seen = TRUE;
+            break;
+        case FIELD_TRACK_NUMBER:
+            /* Only take values from the first track number field. */
+            if (!reader->track_number_seen && field_length > 0)
+            {
+                const gchar *separator;
+
+                separator = memchr (field_value, '/', field_length);
+
+                if (separator)
+                {
+                    if (!file_tag->track_total)
+                    {
+                        file_tag->track_total = et_track_number_to_string (parse_number (separator + 1,
+                                                                                         field_length - (separator + 1 - field_value)));
+                    }
+
+                    field_length = separator - field_value;
+                }
+
+                file_tag->track = et_track_number_to_string (parse_number (field_value,
+                                                                           field_length));
+            }
+
+            reader->track_number_seen = TRUE;
+            break;
+        case FIELD_PICTURE:
+            *value = field_value;
+            *value_length = field_length;
+            break;
+        default:
+            g_assert_not_reached ();
+    }
+
+    return known_fields[i].key;
+}
+
+/*
+ * et_vorbis_comment_reader_finish:
+ * @reader: the reader
+ *
+ * Complete the tag with the fields which were kept until all the fields were
+ * read, and free the state of @reader.
+ */
+void
+et_vorbis_comment_reader_finish (EtVorbisCommentReader *reader)
+{
+    g_return_if_fail (reader != NULL);
+
+    /* The COMMENT fields follow the DESCRIPTION fields. */
+    if (reader->comment)
+    {
+        set_or_append_field (&reader->file_tag->comment, reader->comment);
+        reader->comment = NULL;
+    }
+
+    if (reader->other)
+    {
+        reader->file_tag->other = g_list_concat (reader->file_tag->other,
+                                                 g_list_reverse (reader->other));
+        reader->other = NULL;
+    }
+}
+
+#endif /* ENABLE_OGG || ENABLE_FLAC */
@@ -0,0 +1,89 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef ET_VORBIS_COMMENT_H_
+#define ET_VORBIS_COMMENT_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#include "file_tag.h"
+
+/*
+ * EtVorbisCommentKey:
+ * @ET_VORBIS_COMMENT_KEY_UNKNOWN: a field which is not displayed, and which is
+ *                                 kept in the other fields of the tag
+ * @ET_VORBIS_COMMENT_KEY_TEXT: a field which is read into the tag
+ * @ET_VORBIS_COMMENT_KEY_COVER_ART: the unofficial COVERART field
+ * @ET_VORBIS_COMMENT_KEY_COVER_ART_TYPE: the unofficial COVERARTTYPE field
+ * @ET_VORBIS_COMMENT_KEY_COVER_ART_DESCRIPTION: the unofficial
+ *                                               COVERARTDESCRIPTION field
+ * @ET_VORBIS_COMMENT_KEY_METADATA_BLOCK_PICTURE: the METADATA_BLOCK_PICTURE
+ *                                                field
+ *
+ * How a field of a Vorbis comment was read by et_vorbis_comment_reader_add().
+ * The picture fields are read by the caller, the other fields are read into
+ * the tag directly.
+ */
+typedef enum
+{
+    ET_VORBIS_COMMENT_KEY_UNKNOWN,
+    ET_VORBIS_COMMENT_KEY_TEXT,
+    ET_VORBIS_COMMENT_KEY_COVER_ART,
+    ET_VORBIS_COMMENT_KEY_COVER_ART_TYPE,
+    ET_VORBIS_COMMENT_KEY_COVER_ART_DESCRIPTION,
+    ET_VORBIS_COMMENT_KEY_METADATA_BLOCK_PICTURE
+} EtVorbisCommentKey;
+
+/*
+ * EtVorbisCommentReader:
+ * @file_tag: the tag to fill
+ * @read_pictures: whether the picture fields are returned to the caller, or
+ *                 kept as other fields
+ * @disc_total_seen: whether a DISCTOTAL field was read
+ * @disc_number_seen: whether a DISCNUMBER field was read
+ * @track_total_seen: whether a TRACKTOTAL field was read
+ * @track_number_seen: whether a TRACKNUMBER field was read
+ * @comment: the values of the COMMENT fields, which follow the DESCRIPTION
+ *           fields in the tag
+ * @other: the fields which are not displayed, in reverse order
+ *
+ * State for reading the fields of a Vorbis comment block in a single pass.
+ */
+typedef struct
+{
+    File_Tag *file_tag;
+    gboolean read_pictures;
+    gboolean disc_total_seen;
+    gboolean disc_number_seen;
+    gboolean track_total_seen;
+    gboolean track_number_seen;
+    gchar *comment;
+    GList *other;
+} EtVorbisCommentReader;
+
+void et_vorbis_comment_reader_init (EtVorbisCommentReader *reader, File_Tag *file_tag, gboolean read_pictures);
+EtVorbisCommentKey et_vorbis_comment_reader_add (EtVorbisCommentReader *reader, const gchar *comment, gsize length, const gchar **value, gsize *value_length);
+void et_vorbis_comment_reader_finish (EtVorbisCommentReader *reader);
+
+gchar * et_vorbis_comment_validate_value (const gchar *value, gsize length);
+
+G_END_DECLS
+
+#endif /* !ET_VORBIS_COMMENT_H_ */
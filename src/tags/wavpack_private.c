@@ -168,19 +168,72 @@ wavpack_write_bytes (void *id,
                      int32_t bcount)
 {
     EtWavpackWriteState *state;
-    gssize bytes_written;
+    const guchar *bytes;
+    guchar *existing;
+    goffset start;
+    gsize bytes_read;
+    gsize bytes_written;
+    gsize first;
+    gsize last;
 
     state = (EtWavpackWriteState *)id;
+    bytes = data;
 
-    bytes_written = g_output_stream_write (G_OUTPUT_STREAM (state->ostream),
-                                           data, bcount, NULL, &state->error);
+    /* Compare with the bytes already in the file, so that writing an
+     * unchanged tag does not modify the file, and only the changed region of
+     * a tag is written. */
+    start = g_seekable_tell (state->seekable);
+    existing = g_malloc (bcount);
 
-    if (bytes_written == -1)
+    if (!g_input_stream_read_all (G_INPUT_STREAM (state->istream), existing,
+                                  bcount, &bytes_read, NULL, &state->error))
     {
+        g_free (existing);
         return 0;
     }
 
-    return bytes_written;
+    for (first = 0; first < bytes_read && existing[first] == bytes[first];
+         first++);
+
+    last = bcount;
+
+    if (bytes_read == (gsize)bcount)
+    {
+        while (last > first && existing[last - 1] == bytes[last - 1])
+        {
+            last--;
+        }
+    }
+
+    g_free (existing);
+
+    if (first == last)
+    {
+        /* Reading has already moved past the unchanged bytes. */
+        return bcount;
+    }
+
+    if (!g_seekable_seek (state->seekable, start + first, G_SEEK_SET, NULL,
+                          &state->error))
+    {
+        return 0;
+    }
+
+    if (!g_output_stream_write_all (G_OUTPUT_STREAM (state->ostream),
+                                    bytes + first, last - first,
+                                    &bytes_written, NULL, &state->error))
+    {
+        return first + bytes_written;
+    }
+
+    if (last != (gsize)bcount
+        && !g_seekable_seek (state->seekable, start + bcount, G_SEEK_SET, NULL,
+                             &state->error))
+    {
+        return last;
+    }
+
+    return bcount;
 }
 
 #endif /* ENABLE_WAVPACK */
@@ -0,0 +1,501 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "cddb_cache.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <utime.h>
+
+/* Lifetime of the responses in the cache, in seconds. */
+static const gint64 LIFETIME = 60 * 60;
+
+/*
+ * TestServer:
+ * @thread: the thread in which the server runs
+ * @loop: the main loop of the server thread
+ * @port: the port on which the server listens
+ * @n_requests: the number of requests handled
+ *
+ * A local stand-in for a CDDB server, running in a thread of its own so that
+ * synchronous requests can be sent from the test.
+ */
+typedef struct
+{
+    GThread *thread;
+    GMutex lock;
+    GCond cond;
+    GMainLoop *loop;
+    guint port;
+    gint n_requests;
+} TestServer;
+
+/*
+ * Answer read requests like a freedb server. Paths starting with "/missing"
+ * are not found, and those starting with "/error" give a CDDB error.
+ */
+static void
+server_callback (SoupServer *soup_server,
+                 SoupMessage *message,
+                 const char *path,
+                 GHashTable *query,
+                 SoupClientContext *client,
+                 gpointer user_data)
+{
+    TestServer *server = user_data;
+    gchar *body;
+
+    g_atomic_int_inc (&server->n_requests);
+
+    if (g_str_has_prefix (path, "/missing"))
+    {
+        soup_message_set_status (message, SOUP_STATUS_NOT_FOUND);
+        return;
+    }
+
+    if (g_str_has_prefix (path, "/error"))
+    {
+        body = g_strdup ("402 Server error.\r\n");
+    }
+    else
+    {
+        body = g_strdup_printf ("210 rock %s\r\n# xmcd\r\nDTITLE=%s\r\n.\r\n",
+                                path, path);
+    }
+
+    soup_message_set_status (message, SOUP_STATUS_OK);
+    soup_message_set_response (message, "text/plain", SOUP_MEMORY_TAKE, body,
+                               strlen (body));
+}
+
+static gpointer
+server_thread (gpointer user_data)
+{
+    TestServer *server = user_data;
+    GMainContext *context;
+    SoupServer *soup_server;
+    GMainLoop *loop;
+
+    context = g_main_context_new ();
+    g_main_context_push_thread_default (context);
+
+#if SOUP_CHECK_VERSION (2, 48, 0)
+    {
+        GSList *uris;
+        GError *error = NULL;
+
+        soup_server = soup_server_new (NULL, NULL);
+        soup_server_listen_local (soup_server, 0,
+                                  SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+        g_assert_no_error (error);
+
+        uris = soup_server_get_uris (soup_server);
+        g_assert (uris != NULL);
+        server->port = soup_uri_get_port (uris->data);
+        g_slist_free_full (uris, (GDestroyNotify)soup_uri_free);
+    }
+#else
+    {
+        SoupAddress *address;
+
+        address = soup_address_new ("127.0.0.1", SOUP_ADDRESS_ANY_PORT);
+        soup_address_resolve_sync (address, NULL);
+        soup_server = soup_server_new (SOUP_SERVER_INTERFACE, address,
+                                       SOUP_SERVER_ASYNC_CONTEXT, context,
+                                       NULL);
+        g_object_unref (address);
+        g_assert (soup_server != NULL);
+        soup_server_run_async (soup_server);
+        server->port = soup_server_get_port (soup_server);
+    }
+#endif
+
+    soup_server_add_handler (soup_server, NULL, server_callback, server,
+                             NULL);
+    loop = g_main_loop_new (context, FALSE);
+
+    g_mutex_lock (&server->lock);
+    server->loop = loop;
+    g_cond_signal (&server->cond);
+    g_mutex_unlock (&server->lock);
+
+    g_main_loop_run (loop);
+
+    soup_server_disconnect (soup_server);
+    g_object_unref (soup_server);
+    g_main_loop_unref (loop);
+    g_main_context_pop_thread_default (context);
+    g_main_context_unref (context);
+
+    return NULL;
+}
+
+static TestServer *
+test_server_new (void)
+{
+    TestServer *server;
+
+    server = g_slice_new0 (TestServer);
+    g_mutex_init (&server->lock);
+    g_cond_init (&server->cond);
+
+    server->thread = g_thread_new ("cddb-server", server_thread, server);
+
+    g_mutex_lock (&server->lock);
+
+    while (server->loop == NULL)
+    {
+        g_cond_wait (&server->cond, &server->lock);
+    }
+
+    g_mutex_unlock (&server->lock);
+
+    return server;
+}
+
+static void
+test_server_free (TestServer *server)
+{
+    g_main_loop_quit (server->loop);
+    g_thread_join (server->thread);
+    g_mutex_clear (&server->lock);
+    g_cond_clear (&server->cond);
+    g_slice_free (TestServer, server);
+}
+
+static gchar *
+test_server_get_uri (TestServer *server,
+                     const gchar *path)
+{
+    return g_strdup_printf ("http://127.0.0.1:%u%s", server->port, path);
+}
+
+static void
+remove_cache (const gchar *path)
+{
+    GDir *dir;
+    const gchar *name;
+
+    dir = g_dir_open (path, 0, NULL);
+
+    if (dir != NULL)
+    {
+        while ((name = g_dir_read_name (dir)) != NULL)
+        {
+            gchar *filename = g_build_filename (path, name, NULL);
+            g_assert_cmpint (g_unlink (filename), ==, 0);
+            g_free (filename);
+        }
+
+        g_dir_close (dir);
+    }
+
+    g_assert_cmpint (g_rmdir (path), ==, 0);
+}
+
+static void
+cddb_cache_store (void)
+{
+    gchar *path;
+    gchar *cache_path;
+    EtCddbCache *cache;
+    GBytes *bytes;
+    GBytes *cached;
+    GError *error = NULL;
+
+    path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    /* The cache directory is created when needed. */
+    cache_path = g_build_filename (path, "cddb", NULL);
+    cache = et_cddb_cache_new (cache_path, LIFETIME);
+    g_assert_cmpint (et_cddb_cache_get_lifetime (cache), ==, LIFETIME);
+
+    g_assert (et_cddb_cache_lookup (cache, "http://localhost/a") == NULL);
+
+    bytes = g_bytes_new_static ("210 rock 8f0dc00b\r\n.\r\n", 22);
+    g_assert (et_cddb_cache_store (cache, "http://localhost/a", bytes,
+                                   &error));
+    g_assert_no_error (error);
+
+    cached = et_cddb_cache_lookup (cache, "http://localhost/a");
+    g_assert (cached != NULL);
+    g_assert (g_bytes_equal (bytes, cached));
+    g_bytes_unref (cached);
+
+    g_assert (et_cddb_cache_lookup (cache, "http://localhost/b") == NULL);
+    g_assert_cmpuint (et_cddb_cache_purge (cache), ==, 0);
+
+    /* Expired responses are removed. */
+    {
+        gchar *checksum;
+        gchar *filename;
+        struct utimbuf times;
+
+        checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1,
+                                                  "http://localhost/a", -1);
+        filename = g_build_filename (cache_path, checksum, NULL);
+        times.actime = times.modtime = time (NULL) - LIFETIME - 1;
+        g_assert_cmpint (g_utime (filename, &times), ==, 0);
+
+        g_assert (g_file_test (filename, G_FILE_TEST_EXISTS));
+        g_assert_cmpuint (et_cddb_cache_purge (cache), ==, 1);
+        g_assert (!g_file_test (filename, G_FILE_TEST_EXISTS));
+
+        g_assert (et_cddb_cache_store (cache, "http://localhost/a", bytes,
+                                       &error));
+        g_assert_no_error (error);
+        g_assert_cmpint (g_utime (filename, &times), ==, 0);
+        g_assert (et_cddb_cache_lookup (cache, "http://localhost/a") == NULL);
+        g_assert (!g_file_test (filename, G_FILE_TEST_EXISTS));
+
+        g_free (filename);
+        g_free (checksum);
+    }
+
+    g_bytes_unref (bytes);
+    et_cddb_cache_free (cache);
+
+    remove_cache (cache_path);
+    g_assert_cmpint (g_rmdir (path), ==, 0);
+
+    g_free (cache_path);
+    g_free (path);
+}
+
+static void
+cddb_cache_fetch (void)
+{
+    TestServer *server;
+    SoupSession *session;
+    gchar *path;
+    EtCddbCache *cache;
+    SoupMessage *message;
+    gchar *uri;
+    GBytes *bytes;
+    GBytes *cached;
+    GError *error = NULL;
+
+    server = test_server_new ();
+    session = soup_session_new ();
+
+    path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    cache = et_cddb_cache_new (path, LIFETIME);
+
+    /* The response is only requested once. */
+    uri = test_server_get_uri (server, "/~cddb/cddb.cgi?cmd=cddb+read+rock+8f0dc00b");
+    message = soup_message_new (SOUP_METHOD_GET, uri);
+    bytes = et_cddb_cache_fetch (cache, session, message, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (bytes != NULL);
+    g_assert (g_str_has_prefix (g_bytes_get_data (bytes, NULL), "210 rock"));
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 1);
+    g_object_unref (message);
+
+    message = soup_message_new (SOUP_METHOD_GET, uri);
+    cached = et_cddb_cache_fetch (cache, session, message, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (g_bytes_equal (bytes, cached));
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 1);
+    g_object_unref (message);
+    g_bytes_unref (cached);
+    g_bytes_unref (bytes);
+    g_free (uri);
+
+    /* Without a cache, the request is always sent. */
+    uri = test_server_get_uri (server, "/uncached");
+    message = soup_message_new (SOUP_METHOD_GET, uri);
+    bytes = et_cddb_cache_fetch (NULL, session, message, NULL, &error);
+    g_assert_no_error (error);
+    g_bytes_unref (bytes);
+    g_object_unref (message);
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 2);
+    g_assert (et_cddb_cache_lookup (cache, uri) == NULL);
+    g_free (uri);
+
+    /* Failed requests are reported, and are not cached. */
+    uri = test_server_get_uri (server, "/missing");
+    message = soup_message_new (SOUP_METHOD_GET, uri);
+    g_assert (et_cddb_cache_fetch (cache, session, message, NULL,
+                                   &error) == NULL);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+    g_assert_cmpuint (message->status_code, ==, SOUP_STATUS_NOT_FOUND);
+    g_clear_error (&error);
+    g_object_unref (message);
+    g_assert (et_cddb_cache_lookup (cache, uri) == NULL);
+    g_free (uri);
+
+    uri = test_server_get_uri (server, "/error");
+    message = soup_message_new (SOUP_METHOD_GET, uri);
+    bytes = et_cddb_cache_fetch (cache, session, message, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (g_str_has_prefix (g_bytes_get_data (bytes, NULL), "402"));
+    g_bytes_unref (bytes);
+    g_object_unref (message);
+    g_assert (et_cddb_cache_lookup (cache, uri) == NULL);
+    g_free (uri);
+
+    et_cddb_cache_free (cache);
+    remove_cache (path);
+    g_free (path);
+
+    g_object_unref (session);
+    test_server_free (server);
+}
+
+static void
+on_prefetch_done (GObject *source,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+    GAsyncResult **result_out = user_data;
+
+    *result_out = g_object_ref (result);
+}
+
+static void
+cddb_cache_prefetch (void)
+{
+    TestServer *server;
+    SoupSession *session;
+    gchar *path;
+    EtCddbCache *cache;
+    GPtrArray *uris;
+    GAsyncResult *result = NULL;
+    guint n_fetched;
+    gsize i;
+    GError *error = NULL;
+
+    server = test_server_new ();
+    session = soup_session_new_with_options (SOUP_SESSION_MAX_CONNS_PER_HOST,
+                                             3, NULL);
+
+    path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    cache = et_cddb_cache_new (path, LIFETIME);
+
+    uris = g_ptr_array_new_with_free_func (g_free);
+
+    for (i = 0; i < 20; i++)
+    {
+        gchar *album = g_strdup_printf ("/album/%" G_GSIZE_FORMAT, i);
+
+        g_ptr_array_add (uris, test_server_get_uri (server, album));
+        g_free (album);
+    }
+
+    g_ptr_array_add (uris, test_server_get_uri (server, "/missing"));
+    g_ptr_array_add (uris, test_server_get_uri (server, "/error"));
+    g_ptr_array_add (uris, NULL);
+
+    /* Everything but the failures is cached. */
+    et_cddb_cache_prefetch_async (cache, session,
+                                  (const gchar * const *)uris->pdata, 3, NULL,
+                                  on_prefetch_done, &result);
+
+    while (result == NULL)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    g_assert (et_cddb_cache_prefetch_finish (result, &n_fetched, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (n_fetched, ==, 20);
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 22);
+    g_clear_object (&result);
+
+    for (i = 0; i < 20; i++)
+    {
+        SoupMessage *message;
+        GBytes *bytes;
+        gchar *expected;
+
+        message = soup_message_new (SOUP_METHOD_GET, uris->pdata[i]);
+        bytes = et_cddb_cache_fetch (cache, session, message, NULL, &error);
+        g_assert_no_error (error);
+        expected = g_strdup_printf ("210 rock /album/%" G_GSIZE_FORMAT "\r\n",
+                                    i);
+        g_assert (g_str_has_prefix (g_bytes_get_data (bytes, NULL),
+                                    expected));
+        g_free (expected);
+        g_bytes_unref (bytes);
+        g_object_unref (message);
+    }
+
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 22);
+
+    /* Only the responses which are not cached are requested again. */
+    et_cddb_cache_prefetch_async (cache, session,
+                                  (const gchar * const *)uris->pdata, 3, NULL,
+                                  on_prefetch_done, &result);
+
+    while (result == NULL)
+    {
+        g_main_context_iteration (NULL, TRUE);
+    }
+
+    g_assert (et_cddb_cache_prefetch_finish (result, &n_fetched, &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (n_fetched, ==, 0);
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 24);
+    g_clear_object (&result);
+
+    /* A cancelled prefetch is reported as such. */
+    {
+        GCancellable *cancellable = g_cancellable_new ();
+
+        g_cancellable_cancel (cancellable);
+        et_cddb_cache_prefetch_async (cache, session,
+                                      (const gchar * const *)uris->pdata, 3,
+                                      cancellable, on_prefetch_done, &result);
+
+        while (result == NULL)
+        {
+            g_main_context_iteration (NULL, TRUE);
+        }
+
+        g_assert (!et_cddb_cache_prefetch_finish (result, NULL, &error));
+        g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+        g_clear_error (&error);
+        g_clear_object (&result);
+        g_object_unref (cancellable);
+    }
+
+    g_assert_cmpint (g_atomic_int_get (&server->n_requests), ==, 24);
+
+    g_ptr_array_free (uris, TRUE);
+    et_cddb_cache_free (cache);
+    remove_cache (path);
+    g_free (path);
+
+    g_object_unref (session);
+    test_server_free (server);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/cddb_cache/store", cddb_cache_store);
+    g_test_add_func ("/cddb_cache/fetch", cddb_cache_fetch);
+    g_test_add_func ("/cddb_cache/prefetch", cddb_cache_prefetch);
+
+    return g_test_run ();
+}
@@ -0,0 +1,402 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "cddb_database.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+/* Number of entries in the dump for the benchmark. */
+static const guint PERF_ENTRIES = 20000;
+
+/* Number of lookups and searches for the benchmark. */
+static const guint PERF_ITERATIONS = 100000;
+
+static const gchar entry_format[] =
+    "# xmcd\n"
+    "#\n"
+    "# Track frame offsets:\n"
+    "#\t150\n"
+    "#\t17810\n"
+    "#\n"
+    "# Disc length: %u seconds\n"
+    "#\n"
+    "# Revision: 1\n"
+    "# Submitted via: EasyTAG\n"
+    "#\n"
+    "DISCID=%s\n"
+    "DTITLE=%s\n"
+    "DYEAR=1997\n"
+    "DGENRE=%s\n"
+    "TTITLE0=First Track\n"
+    "TTITLE1=Second Track\n"
+    "EXTD=\n"
+    "EXTT0=\n"
+    "EXTT1=\n"
+    "PLAYORDER=\n";
+
+static void
+write_entry (const gchar *dump_path,
+             const gchar *category,
+             const gchar *name,
+             const gchar *disc_ids,
+             const gchar *title)
+{
+    gchar *dir;
+    gchar *filename;
+    gchar *contents;
+    GError *error = NULL;
+
+    dir = g_build_filename (dump_path, category, NULL);
+    g_assert_cmpint (g_mkdir_with_parents (dir, 0700), ==, 0);
+    filename = g_build_filename (dir, name, NULL);
+    contents = g_strdup_printf (entry_format, 480, disc_ids, title, category);
+
+    g_file_set_contents (filename, contents, -1, &error);
+    g_assert_no_error (error);
+
+    g_free (contents);
+    g_free (filename);
+    g_free (dir);
+}
+
+static void
+remove_dump (const gchar *dump_path)
+{
+    GDir *dir;
+    const gchar *category;
+
+    dir = g_dir_open (dump_path, 0, NULL);
+    g_assert (dir != NULL);
+
+    while ((category = g_dir_read_name (dir)) != NULL)
+    {
+        gchar *path = g_build_filename (dump_path, category, NULL);
+        GDir *category_dir = g_dir_open (path, 0, NULL);
+        const gchar *name;
+
+        if (category_dir != NULL)
+        {
+            while ((name = g_dir_read_name (category_dir)) != NULL)
+            {
+                gchar *filename = g_build_filename (path, name, NULL);
+                g_assert_cmpint (g_unlink (filename), ==, 0);
+                g_free (filename);
+            }
+
+            g_dir_close (category_dir);
+            g_assert_cmpint (g_rmdir (path), ==, 0);
+        }
+        else
+        {
+            g_assert_cmpint (g_unlink (path), ==, 0);
+        }
+
+        g_free (path);
+    }
+
+    g_dir_close (dir);
+    g_assert_cmpint (g_rmdir (dump_path), ==, 0);
+}
+
+static void
+cddb_database_lookup (void)
+{
+    gchar *dump_path;
+    gchar *index_path;
+    EtCddbDatabase *database;
+    GArray *entries;
+    const EtCddbDatabaseEntry *entry;
+    gchar *contents;
+    GError *error = NULL;
+
+    dump_path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    index_path = g_strconcat (dump_path, ".index", NULL);
+
+    write_entry (dump_path, "rock", "7b0dd80b", "7b0dd80b,8f0dc00b",
+                 "Archive / Noise");
+    write_entry (dump_path, "jazz", "8f0dc00b", "8f0dc00b",
+                 "Miles Davis / Kind of Blue");
+    write_entry (dump_path, "rock", "0200a401", "0200a401",
+                 "Pink Floyd / The Dark Side of the Moon (Remastered");
+    /* Files which are not named by a disc ID are ignored. */
+    write_entry (dump_path, "rock", "README", "01234567", "Ignored / Ignored");
+
+    /* The index is built on the first open. */
+    database = et_cddb_database_open (index_path, dump_path, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (database != NULL);
+    g_assert_cmpuint (et_cddb_database_get_n_entries (database), ==, 3);
+
+    entries = et_cddb_database_lookup (database, 0x7b0dd80b);
+    g_assert_cmpuint (entries->len, ==, 1);
+    entry = &g_array_index (entries, EtCddbDatabaseEntry, 0);
+    g_assert_cmpstr (entry->category, ==, "rock");
+    g_assert_cmpuint (entry->disc_id, ==, 0x7b0dd80b);
+    g_assert_cmpstr (entry->title, ==, "Archive / Noise");
+    g_array_unref (entries);
+
+    /* Both entries which list the disc ID are found. */
+    entries = et_cddb_database_lookup (database, 0x8f0dc00b);
+    g_assert_cmpuint (entries->len, ==, 2);
+    g_array_unref (entries);
+
+    entries = et_cddb_database_lookup (database, 0x01234567);
+    g_assert_cmpuint (entries->len, ==, 0);
+    g_array_unref (entries);
+
+    /* All words must match, ignoring case and punctuation. */
+    entries = et_cddb_database_search (database, "the MOON, floyd", NULL, 10);
+    g_assert_cmpuint (entries->len, ==, 1);
+    entry = &g_array_index (entries, EtCddbDatabaseEntry, 0);
+    g_assert_cmpuint (entry->disc_id, ==, 0x0200a401);
+    g_array_unref (entries);
+
+    entries = et_cddb_database_search (database, "noise blue", NULL, 10);
+    g_assert_cmpuint (entries->len, ==, 0);
+    g_array_unref (entries);
+
+    entries = et_cddb_database_search (database, "unknown", NULL, 10);
+    g_assert_cmpuint (entries->len, ==, 0);
+    g_array_unref (entries);
+
+    {
+        static const gchar * const jazz[] = { "jazz", NULL };
+
+        entries = et_cddb_database_search (database, "of", NULL, 10);
+        g_assert_cmpuint (entries->len, ==, 2);
+        g_array_unref (entries);
+
+        entries = et_cddb_database_search (database, "of", jazz, 10);
+        g_assert_cmpuint (entries->len, ==, 1);
+        entry = &g_array_index (entries, EtCddbDatabaseEntry, 0);
+        g_assert_cmpstr (entry->category, ==, "jazz");
+        g_array_unref (entries);
+
+        entries = et_cddb_database_search (database, "of", NULL, 1);
+        g_assert_cmpuint (entries->len, ==, 1);
+        g_array_unref (entries);
+    }
+
+    /* The entry keeps what is needed to read the track list. */
+    contents = et_cddb_database_read_entry (database, "jazz", 0x8f0dc00b);
+    g_assert (contents != NULL);
+    g_assert (strstr (contents, "# Track frame offsets:\n#\t150\n#\t17810\n#\n")
+              != NULL);
+    g_assert (strstr (contents, "# Disc length: 480 seconds\n") != NULL);
+    g_assert (strstr (contents, "DTITLE=Miles Davis / Kind of Blue\n")
+              != NULL);
+    g_assert (strstr (contents, "TTITLE1=Second Track\n") != NULL);
+    g_assert (strstr (contents, "# Revision") == NULL);
+    g_free (contents);
+
+    g_assert (et_cddb_database_read_entry (database, "rock", 0x8f0dc00b)
+              == NULL);
+
+    et_cddb_database_free (database);
+
+    /* The index can be opened without the dump. */
+    database = et_cddb_database_open (index_path, NULL, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (et_cddb_database_get_n_entries (database), ==, 3);
+    et_cddb_database_free (database);
+
+    g_assert_cmpint (g_unlink (index_path), ==, 0);
+    remove_dump (dump_path);
+
+    g_free (index_path);
+    g_free (dump_path);
+}
+
+static void
+cddb_database_invalid (void)
+{
+    gchar *dump_path;
+    gchar *index_path;
+    gchar *contents;
+    gsize length;
+    EtCddbDatabase *database;
+    GCancellable *cancellable;
+    GError *error = NULL;
+
+    dump_path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    index_path = g_strconcat (dump_path, ".index", NULL);
+
+    /* A dump without entries is an error. */
+    g_assert (!et_cddb_database_import (dump_path, index_path, NULL, &error));
+    g_assert_error (error, ET_CDDB_DATABASE_ERROR,
+                    ET_CDDB_DATABASE_ERROR_EMPTY);
+    g_clear_error (&error);
+
+    write_entry (dump_path, "rock", "7b0dd80b", "7b0dd80b", "Archive / Noise");
+    g_assert (et_cddb_database_import (dump_path, index_path, NULL, &error));
+    g_assert_no_error (error);
+
+    /* A truncated index is rejected. */
+    g_file_get_contents (index_path, &contents, &length, &error);
+    g_assert_no_error (error);
+    g_file_set_contents (index_path, contents, length - 8, &error);
+    g_assert_no_error (error);
+
+    database = et_cddb_database_open (index_path, NULL, NULL, &error);
+    g_assert (database == NULL);
+    g_assert_error (error, ET_CDDB_DATABASE_ERROR,
+                    ET_CDDB_DATABASE_ERROR_INVALID);
+    g_clear_error (&error);
+
+    /* A corrupt index is rebuilt from the dump. */
+    memset (contents + length - 64, 0xff, 56);
+    g_file_set_contents (index_path, contents, length, &error);
+    g_assert_no_error (error);
+    g_free (contents);
+
+    database = et_cddb_database_open (index_path, NULL, NULL, &error);
+    g_assert (database == NULL);
+    g_assert_error (error, ET_CDDB_DATABASE_ERROR,
+                    ET_CDDB_DATABASE_ERROR_INVALID);
+    g_clear_error (&error);
+
+    /* A cancelled import leaves the corrupt index. */
+    cancellable = g_cancellable_new ();
+    g_cancellable_cancel (cancellable);
+    database = et_cddb_database_open (index_path, dump_path, cancellable,
+                                      &error);
+    g_assert (database == NULL);
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_clear_error (&error);
+    g_object_unref (cancellable);
+
+    database = et_cddb_database_open (index_path, dump_path, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpuint (et_cddb_database_get_n_entries (database), ==, 1);
+    et_cddb_database_free (database);
+
+    g_assert_cmpint (g_unlink (index_path), ==, 0);
+    remove_dump (dump_path);
+
+    g_free (index_path);
+    g_free (dump_path);
+}
+
+static void
+cddb_database_perf_lookup (void)
+{
+    gchar *dump_path;
+    gchar *index_path;
+    EtCddbDatabase *database;
+    guint i;
+    gsize found = 0;
+    gdouble import_time;
+    gdouble lookup_time;
+    gdouble search_time;
+    GError *error = NULL;
+
+    static const gchar * const artists[] =
+    {
+        "Archive", "Miles Davis", "Pink Floyd", "Björk", "Portishead",
+        "Massive Attack", "Radiohead", "Air"
+    };
+
+    dump_path = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    index_path = g_strconcat (dump_path, ".index", NULL);
+
+    for (i = 0; i < PERF_ENTRIES; i++)
+    {
+        gchar *disc_id = g_strdup_printf ("%08x", i * 2654435761u);
+        gchar *title = g_strdup_printf ("%s / Album %u",
+                                        artists[i % G_N_ELEMENTS (artists)],
+                                        i);
+
+        write_entry (dump_path, i % 2 ? "rock" : "jazz", disc_id, disc_id,
+                     title);
+
+        g_free (title);
+        g_free (disc_id);
+    }
+
+    g_test_timer_start ();
+    g_assert (et_cddb_database_import (dump_path, index_path, NULL, &error));
+    g_assert_no_error (error);
+    import_time = g_test_timer_elapsed ();
+
+    database = et_cddb_database_open (index_path, NULL, NULL, &error);
+    g_assert_no_error (error);
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        GArray *entries;
+
+        entries = et_cddb_database_lookup (database,
+                                           (i % PERF_ENTRIES) * 2654435761u);
+        found += entries->len;
+        g_array_unref (entries);
+    }
+
+    lookup_time = g_test_timer_elapsed ();
+    g_assert_cmpuint (found, ==, PERF_ITERATIONS);
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        GArray *entries;
+        gchar *words = g_strdup_printf ("%s album %u",
+                                        artists[i % G_N_ELEMENTS (artists)],
+                                        i % PERF_ENTRIES);
+
+        entries = et_cddb_database_search (database, words, NULL, 100);
+        g_free (words);
+        g_array_unref (entries);
+    }
+
+    search_time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (lookup_time,
+                             "%u entries: import %.3f s, %u lookups %.3f s, %u searches %.3f s",
+                             PERF_ENTRIES, import_time, PERF_ITERATIONS,
+                             lookup_time, PERF_ITERATIONS, search_time);
+
+    et_cddb_database_free (database);
+    g_assert_cmpint (g_unlink (index_path), ==, 0);
+    remove_dump (dump_path);
+
+    g_free (index_path);
+    g_free (dump_path);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/cddb_database/lookup", cddb_database_lookup);
+    g_test_add_func ("/cddb_database/invalid", cddb_database_invalid);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/cddb_database/perf/lookup",
+                         cddb_database_perf_lookup);
+    }
+
+    return g_test_run ();
+}
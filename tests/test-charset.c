@@ -0,0 +1,188 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "charset.h"
+
+#include <string.h>
+
+/* Number of conversions for the benchmark. */
+static const guint PERF_ITERATIONS = 200000;
+
+static const struct
+{
+    const gchar *string;
+    const gchar *to_codeset;
+    const gchar *from_codeset;
+} conversions[] =
+{
+    { "Title", "ISO-8859-1", "UTF-8" },
+    { "Title", "UTF-8", "ISO-8859-1" },
+    { "Caf\xc3\xa9", "ISO-8859-1", "UTF-8" },
+    { "Caf\xe9", "UTF-8", "ISO-8859-1" },
+    { "\xcf\xf0\xe8\xe2\xe5\xf2", "UTF-8", "windows-1251" },
+    { "Title", "UTF-16LE", "UTF-8" },
+    { "Title", "UTF-8", "Shift_JIS" },
+    { "Title", "ISO-8859-1//IGNORE", "UTF-8" },
+    { "", "ISO-8859-1", "UTF-8" }
+};
+
+static void
+check_conversions (void)
+{
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS (conversions); i++)
+    {
+        gchar *expected;
+        gchar *result;
+        gsize expected_length;
+        gsize length;
+        GError *error = NULL;
+
+        expected = g_convert (conversions[i].string, -1,
+                              conversions[i].to_codeset,
+                              conversions[i].from_codeset, NULL,
+                              &expected_length, &error);
+        g_assert_no_error (error);
+
+        result = et_charset_convert (conversions[i].string, -1,
+                                     conversions[i].to_codeset,
+                                     conversions[i].from_codeset, NULL,
+                                     &length, &error);
+        g_assert_no_error (error);
+
+        g_assert_cmpuint (length, ==, expected_length);
+        g_assert (memcmp (result, expected, length + 1) == 0);
+
+        g_free (result);
+        g_free (expected);
+    }
+}
+
+static void
+charset_convert (void)
+{
+    gchar *result;
+    GError *error = NULL;
+
+    check_conversions ();
+
+    /* A truncated multibyte sequence fails, and leaves the cached descriptor
+     * usable. */
+    result = et_charset_convert ("Caf\xc3", -1, "ISO-8859-1", "UTF-8", NULL,
+                                 NULL, &error);
+    g_assert (result == NULL);
+    g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_PARTIAL_INPUT);
+    g_clear_error (&error);
+
+    result = et_charset_convert ("\xff", -1, "ISO-8859-1", "UTF-8", NULL,
+                                 NULL, &error);
+    g_assert (result == NULL);
+    g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE);
+    g_clear_error (&error);
+
+    check_conversions ();
+
+    result = et_charset_convert ("Title", -1, "UTF-8", "not-a-charset", NULL,
+                                 NULL, &error);
+    g_assert (result == NULL);
+    g_assert_error (error, G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION);
+    g_clear_error (&error);
+}
+
+static gpointer
+convert_thread (gpointer user_data)
+{
+    guint i;
+
+    for (i = 0; i < 100; i++)
+    {
+        check_conversions ();
+    }
+
+    return NULL;
+}
+
+static void
+charset_convert_threads (void)
+{
+    GThread *threads[4];
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+        threads[i] = g_thread_new ("convert", convert_thread, NULL);
+    }
+
+    for (i = 0; i < G_N_ELEMENTS (threads); i++)
+    {
+        g_thread_join (threads[i]);
+    }
+}
+
+static void
+charset_perf_convert (void)
+{
+    guint i;
+    gdouble g_convert_time;
+    gdouble cached_time;
+
+    static const gchar * const strings[] =
+    {
+        "Title of Track 1",
+        "Caf\xc3\xa9 del Mar",
+    };
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        g_free (g_convert (strings[i % G_N_ELEMENTS (strings)], -1,
+                           "ISO-8859-1", "UTF-8", NULL, NULL, NULL));
+    }
+
+    g_convert_time = g_test_timer_elapsed ();
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        g_free (et_charset_convert (strings[i % G_N_ELEMENTS (strings)], -1,
+                                    "ISO-8859-1", "UTF-8", NULL, NULL, NULL));
+    }
+
+    cached_time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (cached_time, "%u conversions: %.3f s (g_convert(): %.3f s)",
+                             PERF_ITERATIONS, cached_time, g_convert_time);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/charset/convert", charset_convert);
+    g_test_add_func ("/charset/convert-threads", charset_convert_threads);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/charset/perf/convert", charset_perf_convert);
+    }
+
+    return g_test_run ();
+}
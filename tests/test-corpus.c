@@ -0,0 +1,1699 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Benchmarks of the load, save, sort, search, scanner and rename code paths,
+ * on a synthetic corpus of small but valid audio files with realistic tags and
+ * an embedded cover picture. Run with "make perf-report", or with "-m perf". */
+
+#include "config.h"
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <utime.h>
+
+#ifdef HAVE_MALLINFO2
+#include <malloc.h>
+#endif /* HAVE_MALLINFO2 */
+
+#if defined ENABLE_OGG || defined ENABLE_OPUS
+#include <ogg/ogg.h>
+#endif /* ENABLE_OGG || ENABLE_OPUS */
+
+#ifdef ENABLE_WAVPACK
+#include <wavpack/wavpack.h>
+#endif /* ENABLE_WAVPACK */
+
+#include "charset.h"
+#include "et_core.h"
+#include "file.h"
+#include "file_list.h"
+#include "picture.h"
+#include "rename_plan.h"
+#include "scan_mask.h"
+#include "setting.h"
+
+/* Number of files in the corpus used for the benchmarks. */
+static const guint PERF_FILES = 600;
+/* Number of times that the corpus is sorted by each column. */
+static const guint PERF_SORT_ITERATIONS = 20;
+
+/*
+ * Corpus:
+ * @dirname: the temporary directory holding the corpus
+ * @filenames: the paths of the files of the corpus
+ * @size: the total size of the files, in bytes
+ */
+typedef struct
+{
+    gchar *dirname;
+    GPtrArray *filenames;
+    guint64 size;
+} Corpus;
+
+/*
+ * CorpusFormat:
+ * @extension: the filename extension of the format
+ * @generate: function to generate an untagged file of the format
+ */
+typedef struct
+{
+    const gchar *extension;
+    void (*generate) (GByteArray *data);
+} CorpusFormat;
+
+static const gchar * const artists[] =
+{
+    "Bj\xc3\xb6rk",
+    "Sigur R\xc3\xb3s",
+    "The Beatles",
+    "Miles Davis",
+    "Nina Simone",
+    "\xe5\x9d\x82\xe6\x9c\xac\xe9\xbe\x8d\xe4\xb8\x80",
+    "Beyonc\xc3\xa9",
+    "Mot\xc3\xb6rhead",
+    "Radiohead",
+    "Daft Punk"
+};
+
+static const gchar * const genres[] =
+{
+    "Rock",
+    "Jazz",
+    "Electronic",
+    "Classical",
+    "Pop"
+};
+
+/* Number of tracks on each album of the corpus. */
+#define CORPUS_ALBUM_TRACKS 12
+
+static Corpus perf_corpus;
+
+static void
+append_be16 (GByteArray *data,
+             guint16 value)
+{
+    value = GUINT16_TO_BE (value);
+    g_byte_array_append (data, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_be24 (GByteArray *data,
+             guint32 value)
+{
+    const guint8 bytes[] = { value >> 16, value >> 8, value };
+
+    g_byte_array_append (data, bytes, sizeof (bytes));
+}
+
+static void
+append_be32 (GByteArray *data,
+             guint32 value)
+{
+    value = GUINT32_TO_BE (value);
+    g_byte_array_append (data, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_be64 (GByteArray *data,
+             guint64 value)
+{
+    value = GUINT64_TO_BE (value);
+    g_byte_array_append (data, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_le16 (GByteArray *data,
+             guint16 value)
+{
+    value = GUINT16_TO_LE (value);
+    g_byte_array_append (data, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_le32 (GByteArray *data,
+             guint32 value)
+{
+    value = GUINT32_TO_LE (value);
+    g_byte_array_append (data, (const guint8 *)&value, sizeof (value));
+}
+
+static void
+append_string (GByteArray *data,
+               const gchar *str)
+{
+    g_byte_array_append (data, (const guint8 *)str, strlen (str));
+}
+
+static void
+append_zeroes (GByteArray *data,
+               guint length)
+{
+    const guint offset = data->len;
+
+    g_byte_array_set_size (data, offset + length);
+    memset (data->data + offset, 0, length);
+}
+
+#if defined ENABLE_MP3 && defined ENABLE_ID3LIB
+/* One second of MPEG-1 Layer III frames, at 128 kb/s and 44.1 kHz. */
+static void
+generate_mpeg (GByteArray *data)
+{
+    guint i;
+
+    for (i = 0; i < 38; i++)
+    {
+        /* Joint stereo, original, no CRC and no padding, giving frames of
+         * 144 * 128000 / 44100 = 417 bytes. */
+        static const guint8 header[] = { 0xff, 0xfb, 0x90, 0x44 };
+
+        g_byte_array_append (data, header, sizeof (header));
+        append_zeroes (data, 417 - sizeof (header));
+    }
+}
+#endif /* ENABLE_MP3 && ENABLE_ID3LIB */
+
+#ifdef ENABLE_FLAC
+/* A FLAC stream header, with padding for the tag to be written into. The
+ * audio frames are never decoded, so they are left empty. */
+static void
+generate_flac (GByteArray *data)
+{
+    const guint64 sample_rate = 44100;
+    const guint64 channels = 2;
+    const guint64 bits_per_sample = 16;
+    const guint64 total_samples = sample_rate * 10;
+
+    append_string (data, "fLaC");
+
+    /* STREAMINFO. */
+    g_byte_array_append (data, (const guint8 *)"\x00", 1);
+    append_be24 (data, 34);
+    append_be16 (data, 4096);
+    append_be16 (data, 4096);
+    append_be24 (data, 0);
+    append_be24 (data, 0);
+    append_be64 (data, sample_rate << 44 | (channels - 1) << 41
+                       | (bits_per_sample - 1) << 36 | total_samples);
+    /* MD5 signature. */
+    append_zeroes (data, 16);
+
+    /* PADDING, as the last metadata block. */
+    g_byte_array_append (data, (const guint8 *)"\x81", 1);
+    append_be24 (data, 4096);
+    append_zeroes (data, 4096);
+
+    append_zeroes (data, 16384);
+}
+#endif /* ENABLE_FLAC */
+
+#if defined ENABLE_OGG || defined ENABLE_OPUS
+/* The Ogg streams start at this time, as if they were cut from a live stream,
+ * rather than at granule position 0. */
+static const guint OGG_START_SECONDS = 60;
+
+static void
+append_ogg_pages (GByteArray *data,
+                  ogg_stream_state *stream)
+{
+    ogg_page page;
+
+    while (ogg_stream_flush (stream, &page) != 0)
+    {
+        g_byte_array_append (data, page.header, page.header_len);
+        g_byte_array_append (data, page.body, page.body_len);
+    }
+}
+#endif /* ENABLE_OGG || ENABLE_OPUS */
+
+#ifdef ENABLE_OGG
+static void
+append_vorbis_packet (ogg_stream_state *stream,
+                      oggpack_buffer *opb,
+                      ogg_int64_t packetno)
+{
+    ogg_packet packet = { 0 };
+
+    packet.packet = oggpack_get_buffer (opb);
+    packet.bytes = oggpack_bytes (opb);
+    packet.b_o_s = (packetno == 0);
+    packet.packetno = packetno;
+    ogg_stream_packetin (stream, &packet);
+    oggpack_writeclear (opb);
+}
+
+static void
+write_vorbis_header_start (oggpack_buffer *opb,
+                           guint type)
+{
+    const gchar *c;
+
+    oggpack_writeinit (opb);
+    oggpack_write (opb, type, 8);
+
+    for (c = "vorbis"; *c != '\0'; c++)
+    {
+        oggpack_write (opb, *c, 8);
+    }
+}
+
+/* The Vorbis headers, with the smallest valid setup: one codebook, floor,
+ * residue, mapping and mode, and only blocks of 256 samples. They are
+ * followed by one second of packets at 6400 Hz, each of which is a single
+ * byte selecting the mode, and so gives 128 samples after the first. */
+static void
+generate_vorbis (GByteArray *data)
+{
+    ogg_stream_state stream;
+    ogg_packet packet = { 0 };
+    oggpack_buffer opb;
+    guchar audio = 0;
+    const ogg_int64_t start = (ogg_int64_t)OGG_START_SECONDS * 6400;
+    const gchar *c;
+    guint i;
+
+    ogg_stream_init (&stream, 1);
+
+    /* Identification: version, channels, rate, bitrates, block sizes. */
+    write_vorbis_header_start (&opb, 1);
+    oggpack_write (&opb, 0, 32);
+    oggpack_write (&opb, 1, 8);
+    oggpack_write (&opb, 6400, 32);
+    oggpack_write (&opb, 0, 32);
+    oggpack_write (&opb, 0, 32);
+    oggpack_write (&opb, 0, 32);
+    oggpack_write (&opb, 8, 4);
+    oggpack_write (&opb, 8, 4);
+    oggpack_write (&opb, 1, 1);
+    append_vorbis_packet (&stream, &opb, 0);
+    append_ogg_pages (data, &stream);
+
+    /* Comments: the vendor, and no comments. */
+    write_vorbis_header_start (&opb, 3);
+    oggpack_write (&opb, strlen (PACKAGE_NAME), 32);
+
+    for (c = PACKAGE_NAME; *c != '\0'; c++)
+    {
+        oggpack_write (&opb, *c, 8);
+    }
+
+    oggpack_write (&opb, 0, 32);
+    oggpack_write (&opb, 1, 1);
+    append_vorbis_packet (&stream, &opb, 1);
+
+    write_vorbis_header_start (&opb, 5);
+    /* A codebook of two entries of one bit, without lookup. */
+    oggpack_write (&opb, 0, 8);
+    oggpack_write (&opb, 0x564342, 24);
+    oggpack_write (&opb, 1, 16);
+    oggpack_write (&opb, 2, 24);
+    oggpack_write (&opb, 0, 1);
+    oggpack_write (&opb, 0, 1);
+    oggpack_write (&opb, 0, 5);
+    oggpack_write (&opb, 0, 5);
+    oggpack_write (&opb, 0, 4);
+    /* A time domain transform, which is always 0. */
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 0, 16);
+    /* A floor of type 1, without partitions. */
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 1, 16);
+    oggpack_write (&opb, 0, 5);
+    oggpack_write (&opb, 0, 2);
+    oggpack_write (&opb, 8, 4);
+    /* An empty residue of type 0, classified with the codebook. */
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 0, 16);
+    oggpack_write (&opb, 0, 24);
+    oggpack_write (&opb, 0, 24);
+    oggpack_write (&opb, 0, 24);
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 0, 8);
+    oggpack_write (&opb, 0, 3);
+    oggpack_write (&opb, 0, 1);
+    /* A mapping with a single submap, and no coupling. */
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 0, 16);
+    oggpack_write (&opb, 0, 1);
+    oggpack_write (&opb, 0, 1);
+    oggpack_write (&opb, 0, 2);
+    oggpack_write (&opb, 0, 8);
+    oggpack_write (&opb, 0, 8);
+    oggpack_write (&opb, 0, 8);
+    /* A mode of short blocks. */
+    oggpack_write (&opb, 0, 6);
+    oggpack_write (&opb, 0, 1);
+    oggpack_write (&opb, 0, 16);
+    oggpack_write (&opb, 0, 16);
+    oggpack_write (&opb, 0, 8);
+    oggpack_write (&opb, 1, 1);
+    append_vorbis_packet (&stream, &opb, 2);
+    append_ogg_pages (data, &stream);
+
+    for (i = 0; i <= 50; i++)
+    {
+        packet.packet = &audio;
+        packet.bytes = 1;
+        packet.granulepos = start + i * 128;
+        packet.e_o_s = (i == 50);
+        packet.packetno = i + 3;
+        ogg_stream_packetin (&stream, &packet);
+    }
+
+    append_ogg_pages (data, &stream);
+
+    ogg_stream_clear (&stream);
+}
+#endif /* ENABLE_OGG */
+
+#ifdef ENABLE_OPUS
+
+/* The Opus headers, followed by a little over two seconds of 20 ms packets,
+ * each of which is a single TOC byte, signalling a frame with no data. */
+static void
+generate_opus (GByteArray *data)
+{
+    ogg_stream_state stream;
+    ogg_packet packet = { 0 };
+    GByteArray *header;
+    guchar toc = 0xfc;
+    const ogg_int64_t start = (ogg_int64_t)OGG_START_SECONDS * 48000;
+    guint i;
+
+    ogg_stream_init (&stream, 1);
+
+    header = g_byte_array_new ();
+    append_string (header, "OpusHead");
+    g_byte_array_append (header, (const guint8 *)"\x01\x02", 2);
+    append_le16 (header, 312);
+    append_le32 (header, 48000);
+    append_le16 (header, 0);
+    g_byte_array_append (header, (const guint8 *)"\x00", 1);
+
+    packet.packet = header->data;
+    packet.bytes = header->len;
+    packet.b_o_s = 1;
+    ogg_stream_packetin (&stream, &packet);
+    append_ogg_pages (data, &stream);
+
+    g_byte_array_set_size (header, 0);
+    append_string (header, "OpusTags");
+    append_le32 (header, strlen (PACKAGE_NAME));
+    append_string (header, PACKAGE_NAME);
+    append_le32 (header, 0);
+
+    packet.packet = header->data;
+    packet.bytes = header->len;
+    packet.b_o_s = 0;
+    packet.packetno = 1;
+    ogg_stream_packetin (&stream, &packet);
+    append_ogg_pages (data, &stream);
+
+    for (i = 0; i < 101; i++)
+    {
+        packet.packet = &toc;
+        packet.bytes = 1;
+        packet.granulepos = start + (i + 1) * 960;
+        packet.e_o_s = (i == 100);
+        packet.packetno = i + 2;
+        ogg_stream_packetin (&stream, &packet);
+    }
+
+    append_ogg_pages (data, &stream);
+
+    g_byte_array_unref (header);
+    ogg_stream_clear (&stream);
+}
+#endif /* ENABLE_OPUS */
+
+#ifdef ENABLE_MP4
+static gsize
+mp4_atom_begin (GByteArray *data,
+                const gchar *type)
+{
+    const gsize offset = data->len;
+
+    append_be32 (data, 0);
+    g_byte_array_append (data, (const guint8 *)type, 4);
+
+    return offset;
+}
+
+/* A full atom, with a version of 0. */
+static gsize
+mp4_full_atom_begin (GByteArray *data,
+                     const gchar *type,
+                     guint32 flags)
+{
+    const gsize offset = mp4_atom_begin (data, type);
+
+    append_be32 (data, flags);
+
+    return offset;
+}
+
+static void
+mp4_atom_end (GByteArray *data,
+              gsize offset)
+{
+    const guint32 size = GUINT32_TO_BE (data->len - offset);
+
+    memcpy (data->data + offset, &size, sizeof (size));
+}
+
+static void
+append_mp4_matrix (GByteArray *data)
+{
+    append_be32 (data, 0x00010000);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0x00010000);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0x40000000);
+}
+
+/* An MPEG-4 audio file with a single AAC track of one second, without any
+ * metadata atoms. */
+static void
+generate_mp4 (GByteArray *data)
+{
+    const guint32 timescale = 44100;
+    const guint32 n_samples = 43;
+    const guint32 sample_size = 372;
+    gsize moov;
+    gsize trak;
+    gsize mdia;
+    gsize minf;
+    gsize dinf;
+    gsize dref;
+    gsize stbl;
+    gsize stsd;
+    gsize mp4a;
+    gsize offset;
+    gsize chunk_offset;
+    guint32 mdat_offset;
+
+    offset = mp4_atom_begin (data, "ftyp");
+    append_string (data, "M4A ");
+    append_be32 (data, 0x200);
+    append_string (data, "M4A mp42isom");
+    mp4_atom_end (data, offset);
+
+    moov = mp4_atom_begin (data, "moov");
+
+    offset = mp4_full_atom_begin (data, "mvhd", 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, timescale);
+    append_be32 (data, n_samples * 1024);
+    append_be32 (data, 0x00010000);
+    append_be16 (data, 0x0100);
+    append_zeroes (data, 10);
+    append_mp4_matrix (data);
+    append_zeroes (data, 24);
+    append_be32 (data, 2);
+    mp4_atom_end (data, offset);
+
+    trak = mp4_atom_begin (data, "trak");
+
+    offset = mp4_full_atom_begin (data, "tkhd", 0x7);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, 1);
+    append_be32 (data, 0);
+    append_be32 (data, n_samples * 1024);
+    append_zeroes (data, 8);
+    append_be16 (data, 0);
+    append_be16 (data, 0);
+    append_be16 (data, 0x0100);
+    append_be16 (data, 0);
+    append_mp4_matrix (data);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    mp4_atom_end (data, offset);
+
+    mdia = mp4_atom_begin (data, "mdia");
+
+    offset = mp4_full_atom_begin (data, "mdhd", 0);
+    append_be32 (data, 0);
+    append_be32 (data, 0);
+    append_be32 (data, timescale);
+    append_be32 (data, n_samples * 1024);
+    /* "und", as packed ISO-639-2/T. */
+    append_be16 (data, 0x55c4);
+    append_be16 (data, 0);
+    mp4_atom_end (data, offset);
+
+    offset = mp4_full_atom_begin (data, "hdlr", 0);
+    append_be32 (data, 0);
+    append_string (data, "soun");
+    append_zeroes (data, 12);
+    g_byte_array_append (data, (const guint8 *)"SoundHandler", 13);
+    mp4_atom_end (data, offset);
+
+    minf = mp4_atom_begin (data, "minf");
+
+    offset = mp4_full_atom_begin (data, "smhd", 0);
+    append_be16 (data, 0);
+    append_be16 (data, 0);
+    mp4_atom_end (data, offset);
+
+    dinf = mp4_atom_begin (data, "dinf");
+    dref = mp4_full_atom_begin (data, "dref", 0);
+    append_be32 (data, 1);
+    /* The media data is in the same file. */
+    offset = mp4_full_atom_begin (data, "url ", 0x1);
+    mp4_atom_end (data, offset);
+    mp4_atom_end (data, dref);
+    mp4_atom_end (data, dinf);
+
+    stbl = mp4_atom_begin (data, "stbl");
+
+    stsd = mp4_full_atom_begin (data, "stsd", 0);
+    append_be32 (data, 1);
+    mp4a = mp4_atom_begin (data, "mp4a");
+    append_zeroes (data, 6);
+    append_be16 (data, 1);
+    append_be16 (data, 0);
+    append_be16 (data, 0);
+    append_be32 (data, 0);
+    append_be16 (data, 2);
+    append_be16 (data, 16);
+    append_be16 (data, 0);
+    append_be16 (data, 0);
+    append_be32 (data, timescale << 16);
+
+    offset = mp4_full_atom_begin (data, "esds", 0);
+    {
+        /* ES descriptor, containing the decoder configuration for AAC LC at
+         * 128 kb/s, 44.1 kHz and two channels, and the sync layer
+         * configuration. */
+        static const guint8 descriptors[] =
+        {
+            0x03, 25, 0x00, 0x01, 0x00,
+            0x04, 17, 0x40, 0x15, 0x00, 0x00, 0x00,
+            0x00, 0x01, 0xf4, 0x00, 0x00, 0x01, 0xf4, 0x00,
+            0x05, 2, 0x12, 0x10,
+            0x06, 1, 0x02
+        };
+
+        g_byte_array_append (data, descriptors, sizeof (descriptors));
+    }
+    mp4_atom_end (data, offset);
+    mp4_atom_end (data, mp4a);
+    mp4_atom_end (data, stsd);
+
+    offset = mp4_full_atom_begin (data, "stts", 0);
+    append_be32 (data, 1);
+    append_be32 (data, n_samples);
+    append_be32 (data, 1024);
+    mp4_atom_end (data, offset);
+
+    offset = mp4_full_atom_begin (data, "stsc", 0);
+    append_be32 (data, 1);
+    append_be32 (data, 1);
+    append_be32 (data, n_samples);
+    append_be32 (data, 1);
+    mp4_atom_end (data, offset);
+
+    offset = mp4_full_atom_begin (data, "stsz", 0);
+    append_be32 (data, sample_size);
+    append_be32 (data, n_samples);
+    mp4_atom_end (data, offset);
+
+    offset = mp4_full_atom_begin (data, "stco", 0);
+    append_be32 (data, 1);
+    chunk_offset = data->len;
+    append_be32 (data, 0);
+    mp4_atom_end (data, offset);
+
+    mp4_atom_end (data, stbl);
+    mp4_atom_end (data, minf);
+    mp4_atom_end (data, mdia);
+    mp4_atom_end (data, trak);
+    mp4_atom_end (data, moov);
+
+    offset = mp4_atom_begin (data, "mdat");
+    mdat_offset = GUINT32_TO_BE (data->len);
+    memcpy (data->data + chunk_offset, &mdat_offset, sizeof (mdat_offset));
+    append_zeroes (data, n_samples * sample_size);
+    mp4_atom_end (data, offset);
+}
+#endif /* ENABLE_MP4 */
+
+#ifdef ENABLE_WAVPACK
+static int
+wavpack_write_block (void *id,
+                     void *block,
+                     int32_t size)
+{
+    g_byte_array_append (id, block, size);
+
+    return TRUE;
+}
+
+/* One second of silence, encoded with the WavPack library. */
+static void
+generate_wavpack (GByteArray *data)
+{
+    const guint n_samples = 44100;
+    WavpackContext *context;
+    WavpackConfig config = { 0 };
+    gint32 *samples;
+
+    context = WavpackOpenFileOutput (wavpack_write_block, data, NULL);
+    g_assert (context != NULL);
+
+    config.bytes_per_sample = 2;
+    config.bits_per_sample = 16;
+    config.channel_mask = 0x3;
+    config.num_channels = 2;
+    config.sample_rate = 44100;
+
+    g_assert (WavpackSetConfiguration (context, &config, n_samples));
+    g_assert (WavpackPackInit (context));
+
+    samples = g_new0 (gint32, n_samples * config.num_channels);
+    g_assert (WavpackPackSamples (context, samples, n_samples));
+    g_assert (WavpackFlushSamples (context));
+
+    g_free (samples);
+    WavpackCloseFile (context);
+}
+#endif /* ENABLE_WAVPACK */
+
+/* A Monkey's Audio header, as read by info_mac_read(). The frames are never
+ * decoded, so they are left empty. */
+static void
+generate_monkeys_audio (GByteArray *data)
+{
+    append_string (data, "MAC ");
+    append_le16 (data, 3990);
+    append_le16 (data, 2000);
+    append_le16 (data, 0);
+    append_le16 (data, 2);
+    append_le32 (data, 44100);
+    append_le32 (data, 44);
+    append_le32 (data, 0);
+    append_le32 (data, 1);
+    append_le32 (data, 44100);
+    append_zeroes (data, 4096);
+}
+
+static const CorpusFormat formats[] =
+{
+#if defined ENABLE_MP3 && defined ENABLE_ID3LIB
+    { "mp3", generate_mpeg },
+#endif /* ENABLE_MP3 && ENABLE_ID3LIB */
+#ifdef ENABLE_FLAC
+    { "flac", generate_flac },
+#endif /* ENABLE_FLAC */
+#ifdef ENABLE_OGG
+    { "ogg", generate_vorbis },
+#endif /* ENABLE_OGG */
+#ifdef ENABLE_OPUS
+    { "opus", generate_opus },
+#endif /* ENABLE_OPUS */
+#ifdef ENABLE_MP4
+    { "m4a", generate_mp4 },
+#endif /* ENABLE_MP4 */
+#ifdef ENABLE_WAVPACK
+    { "wv", generate_wavpack },
+#endif /* ENABLE_WAVPACK */
+    { "ape", generate_monkeys_audio }
+};
+
+/* A front cover of 300×300 pixels, of noise so that it does not compress to
+ * an unrealistically small size. */
+static EtPicture *
+create_picture (void)
+{
+    GdkPixbuf *pixbuf;
+    guchar *pixels;
+    gsize i;
+    gchar *buffer;
+    gsize size;
+    GBytes *bytes;
+    EtPicture *picture;
+    GRand *rand;
+    GError *error = NULL;
+
+    pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 300, 300);
+    pixels = gdk_pixbuf_get_pixels (pixbuf);
+    rand = g_rand_new_with_seed (0);
+
+    for (i = 0; i < (gsize)gdk_pixbuf_get_rowstride (pixbuf) * 300; i++)
+    {
+        pixels[i] = g_rand_int_range (rand, 0, 256);
+    }
+
+    gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &size, "jpeg", &error,
+                               "quality", "90", NULL);
+    g_assert_no_error (error);
+
+    bytes = g_bytes_new_take (buffer, size);
+    picture = et_picture_new (ET_PICTURE_TYPE_FRONT_COVER, "Cover", 300, 300,
+                              bytes);
+
+    g_bytes_unref (bytes);
+    g_rand_free (rand);
+    g_object_unref (pixbuf);
+
+    return picture;
+}
+
+static void
+set_tags (File_Tag *file_tag,
+          guint index,
+          const EtPicture *picture)
+{
+    gchar *string;
+
+    string = g_strdup_printf ("Title of Track %u", index);
+    et_file_tag_set_title (file_tag, string);
+    g_free (string);
+
+    et_file_tag_set_artist (file_tag, artists[index % G_N_ELEMENTS (artists)]);
+    et_file_tag_set_album_artist (file_tag,
+                                  artists[index % G_N_ELEMENTS (artists)]);
+
+    string = g_strdup_printf ("Album %u", index / CORPUS_ALBUM_TRACKS);
+    et_file_tag_set_album (file_tag, string);
+    g_free (string);
+
+    string = g_strdup_printf ("%02u", index % CORPUS_ALBUM_TRACKS + 1);
+    et_file_tag_set_track_number (file_tag, string);
+    g_free (string);
+
+    string = g_strdup_printf ("%02u", CORPUS_ALBUM_TRACKS);
+    et_file_tag_set_track_total (file_tag, string);
+    g_free (string);
+
+    string = g_strdup_printf ("%u", 1960 + index % 50);
+    et_file_tag_set_year (file_tag, string);
+    g_free (string);
+
+    et_file_tag_set_genre (file_tag, genres[index % G_N_ELEMENTS (genres)]);
+    et_file_tag_set_comment (file_tag, "Generated for benchmarking");
+    et_file_tag_set_picture (file_tag, picture);
+}
+
+static GList *
+corpus_load (const Corpus *corpus)
+{
+    GList *file_list = NULL;
+    guint i;
+
+    for (i = 0; i < corpus->filenames->len; i++)
+    {
+        GFile *file;
+
+        file = g_file_new_for_path (g_ptr_array_index (corpus->filenames, i));
+        file_list = et_file_list_add (file_list, file);
+        g_object_unref (file);
+    }
+
+    return file_list;
+}
+
+/*
+ * corpus_init:
+ * @corpus: the corpus to initialize
+ * @n_files: the number of files to create
+ *
+ * Create a corpus of @n_files files, cycling through the supported formats.
+ * The tags are written with the normal saving code.
+ */
+static void
+corpus_init (Corpus *corpus,
+             guint n_files)
+{
+    guint i;
+    GList *file_list;
+    GList *l;
+    EtPicture *picture;
+    GError *error = NULL;
+
+    corpus->dirname = g_dir_make_tmp ("EasyTAG-corpus-XXXXXX", &error);
+    g_assert_no_error (error);
+    corpus->filenames = g_ptr_array_new_with_free_func (g_free);
+    corpus->size = 0;
+
+    for (i = 0; i < n_files; i++)
+    {
+        const CorpusFormat *format = &formats[i % G_N_ELEMENTS (formats)];
+        GByteArray *data;
+        gchar *basename;
+        gchar *filename;
+
+        data = g_byte_array_new ();
+        format->generate (data);
+
+        basename = g_strdup_printf ("%04u - %s.%s", i,
+                                    artists[i % G_N_ELEMENTS (artists)],
+                                    format->extension);
+        filename = g_build_filename (corpus->dirname, basename, NULL);
+
+        g_file_set_contents (filename, (const gchar *)data->data, data->len,
+                             &error);
+        g_assert_no_error (error);
+
+        g_ptr_array_add (corpus->filenames, filename);
+
+        g_free (basename);
+        g_byte_array_unref (data);
+    }
+
+    picture = create_picture ();
+    file_list = corpus_load (corpus);
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        ET_File *ETFile = l->data;
+
+        set_tags ((File_Tag *)ETFile->FileTag->data, i, picture);
+
+        g_assert (ET_Save_File_Tag_To_HD (ETFile, &error));
+        g_assert_no_error (error);
+    }
+
+    et_file_list_free (file_list);
+    et_picture_free (picture);
+
+    for (i = 0; i < corpus->filenames->len; i++)
+    {
+        GStatBuf stat_buf;
+
+        g_assert_cmpint (g_stat (g_ptr_array_index (corpus->filenames, i),
+                                 &stat_buf), ==, 0);
+        corpus->size += stat_buf.st_size;
+    }
+}
+
+static void
+corpus_clear (Corpus *corpus)
+{
+    guint i;
+
+    if (corpus->filenames == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < corpus->filenames->len; i++)
+    {
+        g_assert_cmpint (g_unlink (g_ptr_array_index (corpus->filenames, i)),
+                         ==, 0);
+    }
+
+    g_assert_cmpint (g_rmdir (corpus->dirname), ==, 0);
+
+    g_ptr_array_unref (corpus->filenames);
+    corpus->filenames = NULL;
+    g_free (corpus->dirname);
+    corpus->dirname = NULL;
+}
+
+/* The number of bytes currently allocated on the heap, where available. */
+static gsize
+get_heap_size (void)
+{
+#ifdef HAVE_MALLINFO2
+    return mallinfo2 ().uordblks;
+#else /* !HAVE_MALLINFO2 */
+    return 0;
+#endif /* !HAVE_MALLINFO2 */
+}
+
+static void
+report_throughput (const gchar *operation,
+                   guint n_files,
+                   gdouble time,
+                   gsize heap_before)
+{
+    const gdouble files_per_second = n_files / MAX (time, 1e-9);
+    const gsize heap_after = get_heap_size ();
+
+    g_test_maximized_result (files_per_second, "%8.0f files/s (%s)",
+                             files_per_second, operation);
+    g_test_message ("%s: %u files in %.3f seconds, heap grew by %"
+                    G_GSSIZE_FORMAT " bytes", operation, n_files, time,
+                    (gssize)(heap_after - heap_before));
+}
+
+static gboolean
+settings_available (void)
+{
+    if (MainSettings == NULL)
+    {
+        g_test_skip ("The EasyTAG GSettings schema is not installed");
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+corpus_round_trip (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    GList *l;
+    guint i;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+    file_list = corpus_load (&corpus);
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        const ET_File *ETFile = l->data;
+        const File_Tag *file_tag = ETFile->FileTag->data;
+        File_Tag *expected;
+
+        expected = et_file_tag_new ();
+        set_tags (expected, i, NULL);
+
+        g_test_message ("Checking %s", formats[i].extension);
+        g_assert_cmpstr (file_tag->title, ==, expected->title);
+        g_assert_cmpstr (file_tag->artist, ==, expected->artist);
+        g_assert_cmpstr (file_tag->album, ==, expected->album);
+        g_assert_cmpstr (file_tag->track, ==, expected->track);
+        g_assert_cmpuint (ETFile->ETFileInfo->size, >, 0);
+
+        /* The durations of Ogg streams start from the first audio page,
+         * rather than from 0. */
+        if (strcmp (formats[i].extension, "ogg") == 0)
+        {
+            g_assert_cmpint (ETFile->ETFileInfo->mode, ==, 1);
+            g_assert_cmpint (ETFile->ETFileInfo->samplerate, ==, 6400);
+            g_assert_cmpint (ETFile->ETFileInfo->duration, ==, 1);
+        }
+        else if (strcmp (formats[i].extension, "opus") == 0)
+        {
+            /* From the identification header, read with the tag. */
+            g_assert_cmpint (ETFile->ETFileInfo->mode, ==, 2);
+            g_assert_cmpint (ETFile->ETFileInfo->samplerate, ==, 48000);
+            /* 101 packets of 960 samples, less the pre-skip of 312. */
+            g_assert_cmpint (ETFile->ETFileInfo->duration, ==, 2);
+        }
+
+        et_file_tag_free (expected);
+    }
+
+    g_assert_cmpuint (i, ==, G_N_ELEMENTS (formats));
+
+    et_file_list_free (file_list);
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_modified_externally (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    GList single = { NULL, NULL, NULL };
+    struct utimbuf times = { 1000000, 1000000 };
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+    file_list = corpus_load (&corpus);
+
+    /* The files were loaded after they were written. */
+    g_assert_cmpuint (et_file_list_count_modified_externally (file_list, TRUE),
+                      ==, 0);
+
+    g_assert_cmpint (g_utime (g_ptr_array_index (corpus.filenames, 0),
+                              &times), ==, 0);
+
+    /* The directory is enumerated, or the file queried on its own. */
+    g_assert_cmpuint (et_file_list_count_modified_externally (file_list, TRUE),
+                      ==, 1);
+    single.data = file_list->data;
+    g_assert_cmpuint (et_file_list_count_modified_externally (&single, TRUE),
+                      ==, 1);
+
+    /* Only the files with unsaved changes are checked otherwise. */
+    g_assert_cmpuint (et_file_list_count_modified_externally (file_list,
+                                                              FALSE),
+                      ==, 0);
+
+    et_file_list_free (file_list);
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_save_batch (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    GList *l;
+    GStatBuf stat_buf;
+    struct utimbuf times = { 1000000, 1000000 };
+    GError *error = NULL;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+    file_list = corpus_load (&corpus);
+    g_settings_set_boolean (MainSettings,
+                            "file-update-parent-modification-time", TRUE);
+
+    et_file_save_batch_begin ();
+
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        File_Tag *file_tag = ((ET_File *)l->data)->FileTag->data;
+
+        et_file_tag_set_title (file_tag, "Saved in a batch");
+        g_assert (ET_Save_File_Tag_To_HD (l->data, &error));
+        g_assert_no_error (error);
+    }
+
+    g_assert_cmpint (g_utime (corpus.dirname, &times), ==, 0);
+
+    /* All the files are in the same directory, which is updated once. */
+    g_assert_cmpuint (et_file_save_batch_end (), ==, 1);
+    g_assert_cmpint (g_stat (corpus.dirname, &stat_buf), ==, 0);
+    g_assert_cmpint (stat_buf.st_mtime, >, times.modtime);
+
+    g_settings_reset (MainSettings, "file-update-parent-modification-time");
+    et_file_list_free (file_list);
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_save_unchanged (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    GList *l;
+    guint i;
+    struct utimbuf times = { 1000000, 1000000 };
+    GError *error = NULL;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+
+    for (i = 0; i < corpus.filenames->len; i++)
+    {
+        g_assert_cmpint (g_utime (g_ptr_array_index (corpus.filenames, i),
+                                  &times), ==, 0);
+    }
+
+    file_list = corpus_load (&corpus);
+
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        g_assert (ET_Save_File_Tag_To_HD (l->data, &error));
+        g_assert_no_error (error);
+    }
+
+    /* The APEv2 writers do not touch a file if the tag is unchanged. */
+    for (i = 0; i < corpus.filenames->len; i++)
+    {
+        const gchar *filename = g_ptr_array_index (corpus.filenames, i);
+        GStatBuf stat_buf;
+
+        if (!g_str_has_suffix (filename, ".ape")
+            && !g_str_has_suffix (filename, ".wv"))
+        {
+            continue;
+        }
+
+        g_assert_cmpint (g_stat (filename, &stat_buf), ==, 0);
+        g_assert_cmpint (stat_buf.st_mtime, ==, times.modtime);
+    }
+
+    et_file_list_free (file_list);
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_changes (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    ET_File *ETFile;
+    EtFileTagEdit *edit;
+    GHashTable *changes;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+    file_list = corpus_load (&corpus);
+    ETFile = file_list->data;
+
+    /* The files are marked as changed when they are read. */
+    changes = et_file_list_take_changes ();
+    g_assert (changes != NULL);
+    g_hash_table_destroy (changes);
+    g_assert (et_file_list_take_changes () == NULL);
+
+    edit = et_file_tag_edit_new ();
+    et_file_tag_edit_set_field (edit, ETFile, ET_FILE_TAG_FIELD_TITLE,
+                                "Changed title");
+    g_assert_cmpuint (et_file_tag_edit_commit (edit), ==, 1);
+
+    /* Only the changed field is marked. */
+    changes = et_file_list_take_changes ();
+    g_assert (changes != NULL);
+    g_assert_cmpuint (g_hash_table_size (changes), ==, 1);
+    g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (changes, ETFile)),
+                      ==, ET_FILE_TAG_FIELD_TITLE | ET_FILE_CHANGE_STATE);
+    g_hash_table_destroy (changes);
+
+    g_assert (ET_Undo_File_Data (ETFile));
+    changes = et_file_list_take_changes ();
+    g_assert (changes != NULL);
+    g_assert_cmpuint (GPOINTER_TO_UINT (g_hash_table_lookup (changes, ETFile)),
+                      ==, ET_FILE_TAG_FIELD_TITLE | ET_FILE_CHANGE_STATE);
+    g_hash_table_destroy (changes);
+
+    /* Freed files are forgotten. */
+    et_file_list_mark_changed (ETFile, ET_FILE_CHANGE_FILENAME);
+    et_history_list_clear ();
+    et_file_list_free (file_list);
+    g_assert (et_file_list_take_changes () == NULL);
+
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_undo_edit (void)
+{
+    Corpus corpus = { 0 };
+    GList *file_list;
+    GList *l;
+    GPtrArray *old_names;
+    EtFileTagEdit *edit;
+    ET_File *first;
+    guint n_files;
+    guint n_undone;
+    guint i;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    corpus_init (&corpus, G_N_ELEMENTS (formats));
+    file_list = corpus_load (&corpus);
+    n_files = g_list_length (file_list);
+    g_assert_cmpuint (n_files, >, 1);
+    old_names = g_ptr_array_new_with_free_func (g_free);
+
+    /* Change the tags of all the files, and rename every other file, in a
+     * single change. */
+    edit = et_file_tag_edit_new ();
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        ET_File *ETFile = l->data;
+        const File_Name *current = ETFile->FileNameNew->data;
+
+        g_ptr_array_add (old_names, g_strdup (current->value_utf8));
+        et_file_tag_edit_set_field (edit, ETFile, ET_FILE_TAG_FIELD_TITLE,
+                                    "Edited title");
+
+        if (i % 2 == 0)
+        {
+            File_Name *FileName;
+            gchar *renamed;
+
+            renamed = g_strdup_printf ("%s.renamed", current->value_utf8);
+            FileName = et_file_name_new ();
+            ET_Set_Filename_File_Name_Item (FileName, renamed, NULL);
+            et_file_tag_edit_set_filename (edit, ETFile, FileName);
+            g_free (renamed);
+        }
+    }
+
+    g_assert_cmpuint (et_file_tag_edit_commit (edit), ==, n_files);
+
+    /* The tags and the filenames of all the files are undone at once. */
+    first = ET_Undo_History_File_Data (&n_undone);
+    g_assert (first == file_list->data);
+    g_assert_cmpuint (n_undone, ==, n_files);
+    g_assert (!et_history_list_has_undo (ETCore->ETHistoryFileList));
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        const ET_File *ETFile = l->data;
+        const File_Tag *file_tag = ETFile->FileTag->data;
+        const File_Name *file_name = ETFile->FileNameNew->data;
+
+        g_assert_cmpstr (file_tag->title, !=, "Edited title");
+        g_assert_cmpstr (file_name->value_utf8, ==,
+                         g_ptr_array_index (old_names, i));
+        g_assert (!ET_File_Data_Has_Undo_Data (ETFile));
+    }
+
+    /* And redone at once. */
+    first = ET_Redo_History_File_Data (&n_undone);
+    g_assert (first == file_list->data);
+    g_assert_cmpuint (n_undone, ==, n_files);
+    g_assert (!et_history_list_has_redo (ETCore->ETHistoryFileList));
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        const ET_File *ETFile = l->data;
+        const File_Tag *file_tag = ETFile->FileTag->data;
+        const File_Name *file_name = ETFile->FileNameNew->data;
+
+        g_assert_cmpstr (file_tag->title, ==, "Edited title");
+
+        if (i % 2 == 0)
+        {
+            g_assert (g_str_has_suffix (file_name->value_utf8, ".renamed"));
+        }
+        else
+        {
+            g_assert_cmpstr (file_name->value_utf8, ==,
+                             g_ptr_array_index (old_names, i));
+        }
+
+        g_assert (!ET_File_Data_Has_Redo_Data (ETFile));
+    }
+
+    g_ptr_array_free (old_names, TRUE);
+    et_history_list_clear ();
+    et_file_list_free (file_list);
+    corpus_clear (&corpus);
+}
+
+static void
+corpus_perf_load (gconstpointer user_data)
+{
+    const Corpus *corpus = user_data;
+    GList *file_list;
+    gsize heap_before;
+    gdouble time;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    file_list = corpus_load (corpus);
+
+    time = g_test_timer_elapsed ();
+    report_throughput ("load", corpus->filenames->len, time, heap_before);
+    g_test_message ("load: %.1f MiB/s", corpus->size / time / (1024 * 1024));
+
+    et_file_list_free (file_list);
+}
+
+/*
+ * corpus_save:
+ * @corpus: the corpus to save
+ * @grow: whether the tags should grow beyond the space available in the file
+ *
+ * Change a tag of every file, and measure how fast the files are saved. The
+ * title is changed without changing its length, while the comment can be
+ * grown so that the tags no longer fit in their padding.
+ */
+static void
+corpus_save (const Corpus *corpus,
+             gboolean grow)
+{
+    GList *file_list;
+    GList *l;
+    guint i;
+    gchar *comment;
+    gsize heap_before;
+    gdouble time;
+    GError *error = NULL;
+
+    file_list = corpus_load (corpus);
+    comment = grow ? g_strnfill (16384, 'c') : NULL;
+
+    for (l = file_list, i = 0; l != NULL; l = g_list_next (l), i++)
+    {
+        File_Tag *file_tag = ((ET_File *)l->data)->FileTag->data;
+
+        if (grow)
+        {
+            et_file_tag_set_comment (file_tag, comment);
+        }
+        else
+        {
+            gchar *title;
+
+            title = g_strdup_printf ("Track of Title %u", i);
+            et_file_tag_set_title (file_tag, title);
+            g_free (title);
+        }
+    }
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        g_assert (ET_Save_File_Tag_To_HD (l->data, &error));
+        g_assert_no_error (error);
+    }
+
+    time = g_test_timer_elapsed ();
+    report_throughput (grow ? "save, grown tags" : "save, same size",
+                       corpus->filenames->len, time, heap_before);
+
+    g_free (comment);
+    et_file_list_free (file_list);
+}
+
+static void
+corpus_perf_save_same_size (gconstpointer user_data)
+{
+    if (settings_available ())
+    {
+        corpus_save (user_data, FALSE);
+    }
+}
+
+static void
+corpus_perf_save_grown (gconstpointer user_data)
+{
+    if (settings_available ())
+    {
+        corpus_save (user_data, TRUE);
+    }
+}
+
+static void
+corpus_perf_sort (gconstpointer user_data)
+{
+    const Corpus *corpus = user_data;
+    GList *file_list;
+    guint i;
+    gsize j;
+    gsize heap_before;
+    gdouble time;
+
+    static const GCompareFunc sorts[] =
+    {
+        (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Title,
+        (GCompareFunc)ET_Comp_Func_Sort_File_By_Descending_Artist,
+        (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Album,
+        (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Track_Number,
+        (GCompareFunc)ET_Comp_Func_Sort_File_By_Ascending_Filename
+    };
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    file_list = corpus_load (corpus);
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_SORT_ITERATIONS; i++)
+    {
+        for (j = 0; j < G_N_ELEMENTS (sorts); j++)
+        {
+            file_list = g_list_sort (file_list, sorts[j]);
+        }
+    }
+
+    time = g_test_timer_elapsed ();
+    report_throughput ("sort",
+                       corpus->filenames->len * PERF_SORT_ITERATIONS
+                       * G_N_ELEMENTS (sorts), time, heap_before);
+
+    et_file_list_free (file_list);
+}
+
+/* Search the tags, in the same way as a case-insensitive search from the
+ * search dialog. */
+static void
+corpus_perf_search (gconstpointer user_data)
+{
+    const Corpus *corpus = user_data;
+    GList *file_list;
+    GList *l;
+    gchar *needle;
+    guint n_matches = 0;
+    gsize heap_before;
+    gdouble time;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    file_list = corpus_load (corpus);
+    needle = g_utf8_casefold ("BEATLES", -1);
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    /* As the search dialog does, without case sensitivity. */
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        if (et_file_tag_matches (((ET_File *)l->data)->FileTag->data, needle,
+                                 FALSE))
+        {
+            n_matches++;
+        }
+    }
+
+    time = g_test_timer_elapsed ();
+    report_throughput ("search", corpus->filenames->len, time, heap_before);
+
+    g_assert_cmpuint (n_matches, >, 0);
+
+    g_free (needle);
+    et_file_list_free (file_list);
+}
+
+static void
+corpus_perf_scan_mask (gconstpointer user_data)
+{
+    const Corpus *corpus = user_data;
+    GList *file_list;
+    GList *l;
+    EtScanMask *fill_mask;
+    EtScanMask *rename_mask;
+    gsize heap_before;
+    gdouble time;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    file_list = corpus_load (corpus);
+    fill_mask = et_scan_mask_new_fill_tag ("%n - %a",
+                                           ET_CONVERT_SPACES_NO_CHANGE);
+    rename_mask = et_scan_mask_new_rename_file ("%n - %a - %b - %t", FALSE,
+                                                ET_CONVERT_SPACES_NO_CHANGE,
+                                                TRUE);
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        const ET_File *ETFile = l->data;
+        const gchar *filename_utf8;
+        GArray *fields;
+        gchar *new_filename_utf8;
+
+        filename_utf8 = ((File_Name *)ETFile->FileNameNew->data)->value_utf8;
+
+        fields = et_scan_mask_fill_tag (fill_mask, filename_utf8, NULL);
+        g_array_unref (fields);
+
+        new_filename_utf8 = et_scan_mask_rename_file (rename_mask,
+                                                      ETFile->FileTag->data,
+                                                      filename_utf8);
+        g_free (new_filename_utf8);
+    }
+
+    time = g_test_timer_elapsed ();
+    report_throughput ("scanner masks", corpus->filenames->len, time,
+                       heap_before);
+
+    et_scan_mask_free (rename_mask);
+    et_scan_mask_free (fill_mask);
+    et_file_list_free (file_list);
+}
+
+/* Rename every file from a mask, then rename the files back. Only the first
+ * batch of renames is measured. */
+static void
+corpus_perf_rename (gconstpointer user_data)
+{
+    const Corpus *corpus = user_data;
+    GList *file_list;
+    GList *l;
+    EtScanMask *mask;
+    EtRenamePlan *plan;
+    EtRenamePlan *undo_plan;
+    gsize heap_before;
+    gdouble time;
+    GError *error = NULL;
+
+    if (!settings_available ())
+    {
+        return;
+    }
+
+    file_list = corpus_load (corpus);
+    mask = et_scan_mask_new_rename_file ("%n - %a - %b - %t", FALSE,
+                                         ET_CONVERT_SPACES_NO_CHANGE, TRUE);
+
+    heap_before = get_heap_size ();
+    g_test_timer_start ();
+
+    plan = et_rename_plan_new ();
+    undo_plan = et_rename_plan_new ();
+
+    for (l = file_list; l != NULL; l = g_list_next (l))
+    {
+        const ET_File *ETFile = l->data;
+        const File_Name *file_name = ETFile->FileNameNew->data;
+        gchar *new_filename_utf8;
+        gchar *new_path_utf8;
+        gchar *new_path;
+
+        new_filename_utf8 = et_scan_mask_rename_file (mask,
+                                                      ETFile->FileTag->data,
+                                                      file_name->value_utf8);
+        new_path_utf8 = et_file_generate_name (ETFile, new_filename_utf8);
+        new_path = filename_from_display (new_path_utf8);
+
+        et_rename_plan_add (plan, file_name->value, new_path);
+        et_rename_plan_add (undo_plan, new_path, file_name->value);
+
+        g_free (new_path);
+        g_free (new_path_utf8);
+        g_free (new_filename_utf8);
+    }
+
+    g_assert (et_rename_plan_execute (plan, &error));
+    g_assert_no_error (error);
+
+    time = g_test_timer_elapsed ();
+    report_throughput ("rename", et_rename_plan_get_length (plan), time,
+                       heap_before);
+
+    g_assert (et_rename_plan_execute (undo_plan, &error));
+    g_assert_no_error (error);
+
+    et_rename_plan_free (undo_plan);
+    et_rename_plan_free (plan);
+    et_scan_mask_free (mask);
+    et_file_list_free (file_list);
+}
+
+int
+main (int argc, char** argv)
+{
+    GSettingsSchemaSource *source;
+    GSettingsSchema *schema = NULL;
+    gint status;
+
+    g_test_init (&argc, &argv, NULL);
+
+    /* The tag readers and writers use the settings, so the schema must be
+     * available, as it is when running "make check". */
+    source = g_settings_schema_source_get_default ();
+
+    if (source != NULL)
+    {
+        schema = g_settings_schema_source_lookup (source, "org.gnome.EasyTAG",
+                                                  TRUE);
+    }
+
+    if (schema != NULL)
+    {
+        MainSettings = g_settings_new ("org.gnome.EasyTAG");
+        g_settings_schema_unref (schema);
+    }
+
+    ET_Core_Create ();
+
+    g_test_add_func ("/corpus/round-trip", corpus_round_trip);
+    g_test_add_func ("/corpus/modified-externally",
+                     corpus_modified_externally);
+    g_test_add_func ("/corpus/save-batch", corpus_save_batch);
+    g_test_add_func ("/corpus/save-unchanged", corpus_save_unchanged);
+    g_test_add_func ("/corpus/changes", corpus_changes);
+    g_test_add_func ("/corpus/undo-edit", corpus_undo_edit);
+
+    if (g_test_perf ())
+    {
+        if (MainSettings != NULL)
+        {
+            corpus_init (&perf_corpus, PERF_FILES);
+        }
+
+        g_test_add_data_func ("/corpus/perf/load", &perf_corpus,
+                              corpus_perf_load);
+        g_test_add_data_func ("/corpus/perf/save-same-size", &perf_corpus,
+                              corpus_perf_save_same_size);
+        g_test_add_data_func ("/corpus/perf/save-grown", &perf_corpus,
+                              corpus_perf_save_grown);
+        g_test_add_data_func ("/corpus/perf/sort", &perf_corpus,
+                              corpus_perf_sort);
+        g_test_add_data_func ("/corpus/perf/search", &perf_corpus,
+                              corpus_perf_search);
+        g_test_add_data_func ("/corpus/perf/scan-mask", &perf_corpus,
+                              corpus_perf_scan_mask);
+        g_test_add_data_func ("/corpus/perf/rename", &perf_corpus,
+                              corpus_perf_rename);
+    }
+
+    status = g_test_run ();
+
+    corpus_clear (&perf_corpus);
+    ET_Core_Free ();
+    g_clear_object (&MainSettings);
+
+    return status;
+}
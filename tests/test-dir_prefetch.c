@@ -0,0 +1,205 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "dir_prefetch.h"
+
+#include <glib/gstdio.h>
+
+GSettings *MainSettings;
+
+/* The tree which is prefetched, with the directories before the files that
+ * they contain. */
+static const gchar * const tree[] =
+{
+    "01 First/",
+    "01 First/a.ape",
+    "01 First/b.txt",
+    "02 Second/",
+    "02 Second/c.ape",
+    "03 Third/",
+    "03 Third/d.ape",
+    "03 Third/e.ape",
+    "03 Third/Disc 2/",
+    "03 Third/Disc 2/f.ape",
+    "03 Third/.hidden.ape",
+    "04 Fourth/",
+    "04 Fourth/g.ape",
+    ".hidden/",
+    ".hidden/h.ape"
+};
+
+typedef struct
+{
+    GMainLoop *loop;
+    gboolean success;
+    guint n_files;
+    GError *error;
+} PrefetchResult;
+
+static gchar *
+create_tree (void)
+{
+    gchar *dir;
+    gsize i;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    for (i = 0; i < G_N_ELEMENTS (tree); i++)
+    {
+        gchar *path;
+
+        path = g_build_filename (dir, tree[i], NULL);
+
+        if (g_str_has_suffix (tree[i], "/"))
+        {
+            g_assert_cmpint (g_mkdir (path, 0700), ==, 0);
+        }
+        else
+        {
+            g_assert (g_file_set_contents (path, "MAC ", -1, &error));
+            g_assert_no_error (error);
+        }
+
+        g_free (path);
+    }
+
+    return dir;
+}
+
+static void
+remove_tree (gchar *dir)
+{
+    gsize i;
+
+    /* In reverse, so that the directories are empty when removed. */
+    for (i = G_N_ELEMENTS (tree); i > 0; i--)
+    {
+        gchar *path;
+
+        path = g_build_filename (dir, tree[i - 1], NULL);
+        g_assert_cmpint (g_remove (path), ==, 0);
+        g_free (path);
+    }
+
+    g_assert_cmpint (g_rmdir (dir), ==, 0);
+    g_free (dir);
+}
+
+static void
+on_prefetch_done (GObject *source_object,
+                  GAsyncResult *result,
+                  gpointer user_data)
+{
+    PrefetchResult *prefetch_result = user_data;
+
+    prefetch_result->success = et_dir_prefetch_finish (result,
+                                                       &prefetch_result->n_files,
+                                                       &prefetch_result->error);
+    g_main_loop_quit (prefetch_result->loop);
+}
+
+static void
+run_prefetch (const gchar *dir,
+              gboolean recurse,
+              gboolean show_hidden,
+              GCancellable *cancellable,
+              PrefetchResult *result)
+{
+    gchar *path;
+    GFile *directory;
+
+    path = g_build_filename (dir, "02 Second", NULL);
+    directory = g_file_new_for_path (path);
+
+    result->loop = g_main_loop_new (NULL, FALSE);
+    result->success = FALSE;
+    result->n_files = 0;
+    result->error = NULL;
+
+    et_dir_prefetch_async (directory, recurse, show_hidden, cancellable,
+                           on_prefetch_done, result);
+    g_main_loop_run (result->loop);
+
+    g_main_loop_unref (result->loop);
+    g_object_unref (directory);
+    g_free (path);
+}
+
+static void
+dir_prefetch_siblings (void)
+{
+    gchar *dir;
+    PrefetchResult result;
+
+    dir = create_tree ();
+
+    /* Only the supported files of the next and previous directories. */
+    run_prefetch (dir, FALSE, FALSE, NULL, &result);
+    g_assert (result.success);
+    g_assert_no_error (result.error);
+    g_assert_cmpuint (result.n_files, ==, 3);
+
+    /* And their subdirectories. */
+    run_prefetch (dir, TRUE, FALSE, NULL, &result);
+    g_assert (result.success);
+    g_assert_no_error (result.error);
+    g_assert_cmpuint (result.n_files, ==, 4);
+
+    /* And hidden files, in the siblings which are read. */
+    run_prefetch (dir, FALSE, TRUE, NULL, &result);
+    g_assert (result.success);
+    g_assert_no_error (result.error);
+    g_assert_cmpuint (result.n_files, ==, 4);
+
+    remove_tree (dir);
+}
+
+static void
+dir_prefetch_cancel (void)
+{
+    gchar *dir;
+    GCancellable *cancellable;
+    PrefetchResult result;
+
+    dir = create_tree ();
+
+    cancellable = g_cancellable_new ();
+    g_cancellable_cancel (cancellable);
+
+    run_prefetch (dir, TRUE, FALSE, cancellable, &result);
+    g_assert (!result.success);
+    g_assert_error (result.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_assert_cmpuint (result.n_files, ==, 0);
+    g_clear_error (&result.error);
+
+    g_object_unref (cancellable);
+    remove_tree (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/dir_prefetch/siblings", dir_prefetch_siblings);
+    g_test_add_func ("/dir_prefetch/cancel", dir_prefetch_cancel);
+
+    return g_test_run ();
+}
@@ -18,6 +18,89 @@
 
 #include "dlm.h"
 
+#include <string.h>
+
+/*
+ * dlm_matrix:
+ * Compute the similarity value of two ASCII strings by filling in the full
+ * distance matrix, as a reference and as a baseline for the benchmark.
+ */
+static gint
+dlm_matrix (const gchar *s,
+            const gchar *t)
+{
+    const gsize n = strlen (s);
+    const gsize m = strlen (t);
+    gsize *d;
+    gsize i;
+    gsize j;
+    gsize distance;
+
+    if (n == 0 || m == 0)
+    {
+        return -1;
+    }
+
+    d = g_new (gsize, (n + 1) * (m + 1));
+
+    for (i = 0; i <= n; i++)
+    {
+        d[i * (m + 1)] = i;
+    }
+
+    for (j = 0; j <= m; j++)
+    {
+        d[j] = j;
+    }
+
+    for (i = 1; i <= n; i++)
+    {
+        for (j = 1; j <= m; j++)
+        {
+            const gsize cost = g_ascii_tolower (s[i - 1])
+                               == g_ascii_tolower (t[j - 1]) ? 0 : 1;
+            gsize value = d[(i - 1) * (m + 1) + j - 1] + cost;
+
+            value = MIN (value, d[(i - 1) * (m + 1) + j] + 1);
+            value = MIN (value, d[i * (m + 1) + j - 1] + 1);
+
+            if (i > 1 && j > 1
+                && g_ascii_tolower (s[i - 1]) == g_ascii_tolower (t[j - 2])
+                && g_ascii_tolower (s[i - 2]) == g_ascii_tolower (t[j - 1]))
+            {
+                value = MIN (value, d[(i - 2) * (m + 1) + j - 2] + 1);
+            }
+
+            d[i * (m + 1) + j] = value;
+        }
+    }
+
+    distance = d[n * (m + 1) + m];
+    g_free (d);
+
+    return 1000 - (gint)((1000 * (distance * 2)) / (n + m));
+}
+
+static gchar *
+random_string (GRand *rand,
+               gsize max_length,
+               gint n_letters)
+{
+    const gsize length = g_rand_int_range (rand, 1, max_length + 1);
+    gchar *result = g_malloc (length + 1);
+    gsize i;
+
+    for (i = 0; i < length; i++)
+    {
+        result[i] = (g_rand_boolean (rand) ? 'a' : 'A')
+                    + g_rand_int_range (rand, 0, n_letters);
+    }
+
+    result[length] = '\0';
+
+    return result;
+}
+
 static void
 dlm_dlm (void)
 {
@@ -41,6 +124,13 @@ dlm_dlm (void)
         { "foobarbaz", "zabraboof", 223 },
         { "foobarbaz", "iiiiiiiii", 0 },
         { "1234567890", "abcdefghij", 0 },
+        { "ccc", "bcc", 667 },
+        { "abc", "acb", 667 },
+        { "Foo", "fOO", 1000 },
+        { "\xc3\x89T\xc3\x89", "\xc3\xa9t\xc3\xa9", 1000 },
+        { "01 - The First Track Of This Rather Long Album Title.ogg",
+          "01 - The First Track of This Rather Long Album Title (Remastered)",
+          /* Distance 13, over 64 bytes. */ 786 },
         { "", "", -1 },
         { "foo", "", -1 },
         { "", "foo", -1 },
@@ -55,6 +145,70 @@ dlm_dlm (void)
     }
 }
 
+static void
+dlm_random (void)
+{
+    GRand *rand;
+    gsize i;
+
+    rand = g_rand_new_with_seed (42);
+
+    /* Few distinct letters give many transpositions, and strings of up to 200
+     * bytes use several words of the bit vectors. */
+    for (i = 0; i < 20000; i++)
+    {
+        gchar *s = random_string (rand, i % 2 ? 10 : 200, 3);
+        gchar *t = random_string (rand, i % 3 ? 10 : 200, 3);
+
+        g_assert_cmpint (dlm (s, t), ==, dlm_matrix (s, t));
+
+        g_free (t);
+        g_free (s);
+    }
+
+    g_rand_free (rand);
+}
+
+static void
+dlm_find_best_matches (void)
+{
+    gssize best[4];
+    gint metrics[4];
+
+    static const gchar * const queries[] =
+    {
+        "bar",
+        "ZZZ",
+        "",
+        "qqq"
+    };
+
+    static const gchar * const candidates[] =
+    {
+        "",
+        "BAZ",
+        "bar",
+        "bar",
+        "foo"
+    };
+
+    et_dlm_find_best_matches (queries, G_N_ELEMENTS (queries), candidates,
+                              G_N_ELEMENTS (candidates), best, metrics);
+
+    /* The first of equally good matches is chosen. */
+    g_assert_cmpint (best[0], ==, 2);
+    g_assert_cmpint (metrics[0], ==, 1000);
+    g_assert_cmpint (best[1], ==, 1);
+    g_assert_cmpint (metrics[1], ==, 334);
+    g_assert_cmpint (best[2], ==, -1);
+    g_assert_cmpint (metrics[2], ==, 0);
+    g_assert_cmpint (best[3], ==, -1);
+    g_assert_cmpint (metrics[3], ==, 0);
+
+    et_dlm_find_best_matches (queries, 1, NULL, 0, best, NULL);
+    g_assert_cmpint (best[0], ==, -1);
+}
+
 static void
 dlm_perf_dlm (void)
 {
@@ -74,16 +228,106 @@ dlm_perf_dlm (void)
     g_test_minimized_result (time, "%6.1f seconds", time);
 }
 
+static void
+dlm_perf_find_best_matches (void)
+{
+    const gsize N_QUERIES = 50;
+    const gsize N_CANDIDATES = 2000;
+    GRand *rand;
+    gchar **queries;
+    gchar **candidates;
+    gssize *best;
+    gsize i;
+    gsize j;
+    gdouble matrix_time;
+    gdouble time;
+
+    rand = g_rand_new_with_seed (42);
+    queries = g_new (gchar *, N_QUERIES);
+    candidates = g_new (gchar *, N_CANDIDATES);
+    best = g_new (gssize, N_QUERIES);
+
+    for (i = 0; i < N_QUERIES; i++)
+    {
+        queries[i] = random_string (rand, 40, 26);
+    }
+
+    for (j = 0; j < N_CANDIDATES; j++)
+    {
+        candidates[j] = random_string (rand, 40, 26);
+    }
+
+    /* One full matrix per comparison, as dlm() used to do. */
+    g_test_timer_start ();
+
+    for (i = 0; i < N_QUERIES; i++)
+    {
+        gint max = 0;
+
+        best[i] = -1;
+
+        for (j = 0; j < N_CANDIDATES; j++)
+        {
+            const gint metric = dlm_matrix (candidates[j], queries[i]);
+
+            if (metric > max)
+            {
+                max = metric;
+                best[i] = j;
+            }
+        }
+    }
+
+    matrix_time = g_test_timer_elapsed ();
+
+    g_test_timer_start ();
+
+    for (i = 0; i < N_QUERIES; i++)
+    {
+        gssize match;
+
+        et_dlm_find_best_matches ((const gchar * const *)&queries[i], 1,
+                                  (const gchar * const *)candidates,
+                                  N_CANDIDATES, &match, NULL);
+        g_assert_cmpint (match, ==, best[i]);
+    }
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time,
+                             "%" G_GSIZE_FORMAT " queries over %" G_GSIZE_FORMAT " candidates: %.3f s (matrix: %.3f s)",
+                             N_QUERIES, N_CANDIDATES, time, matrix_time);
+
+    for (i = 0; i < N_QUERIES; i++)
+    {
+        g_free (queries[i]);
+    }
+
+    for (j = 0; j < N_CANDIDATES; j++)
+    {
+        g_free (candidates[j]);
+    }
+
+    g_free (best);
+    g_free (candidates);
+    g_free (queries);
+    g_rand_free (rand);
+}
+
 int
 main (int argc, char** argv)
 {
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/dlm/dlm", dlm_dlm);
+    g_test_add_func ("/dlm/random", dlm_random);
+    g_test_add_func ("/dlm/find-best-matches", dlm_find_best_matches);
 
     if (g_test_perf ())
     {
         g_test_add_func ("/dlm/perf/dlm", dlm_perf_dlm);
+        g_test_add_func ("/dlm/perf/find-best-matches",
+                         dlm_perf_find_best_matches);
     }
 
     return g_test_run ();
@@ -99,6 +99,35 @@ file_tag_copy_other (void)
     et_file_tag_free (tag1);
 }
 
+static void
+file_tag_matches (void)
+{
+    File_Tag *file_tag;
+    gchar *needle;
+
+    file_tag = et_file_tag_new ();
+    et_file_tag_set_title (file_tag, "Yesterday");
+    et_file_tag_set_encoded_by (file_tag, "The Beatles");
+
+    needle = g_utf8_casefold ("BEATLES", -1);
+    g_assert (et_file_tag_matches (file_tag, needle, FALSE));
+    g_free (needle);
+
+    needle = g_utf8_normalize ("BEATLES", -1, G_NORMALIZE_DEFAULT);
+    g_assert (!et_file_tag_matches (file_tag, needle, TRUE));
+    g_free (needle);
+
+    /* Only the fields which are set are searched. */
+    needle = g_utf8_normalize ("Yesterday", -1, G_NORMALIZE_DEFAULT);
+    et_file_tag_set_disc_number (file_tag, "1");
+    g_assert (et_file_tag_matches (file_tag, needle, TRUE));
+    et_file_tag_set_title (file_tag, NULL);
+    g_assert (!et_file_tag_matches (file_tag, needle, TRUE));
+    g_free (needle);
+
+    et_file_tag_free (file_tag);
+}
+
 static void
 file_tag_difference (void)
 {
@@ -159,6 +188,100 @@ file_tag_difference (void)
     et_file_tag_free (tag1);
 }
 
+static void
+file_tag_delta (void)
+{
+    File_Tag *tag1;
+    File_Tag *tag2;
+    GBytes *bytes;
+    EtPicture *picture;
+    gsize size1;
+
+    tag1 = et_file_tag_new ();
+    et_file_tag_set_title (tag1, "foo");
+    et_file_tag_set_artist (tag1, "bar");
+    tag1->other = g_list_prepend (tag1->other, g_strdup ("baz"));
+
+    bytes = g_bytes_new_static ("foobar", 6);
+    picture = et_picture_new (ET_PICTURE_TYPE_FRONT_COVER, "", 640, 480,
+                              bytes);
+    et_file_tag_set_picture (tag1, picture);
+    et_picture_free (picture);
+    g_bytes_unref (bytes);
+
+    /* The next change in the history only modifies the title. */
+    tag2 = et_file_tag_new ();
+    et_file_tag_copy_into (tag2, tag1);
+    et_file_tag_set_title (tag2, "qux");
+
+    size1 = et_file_tag_get_size (tag1);
+    et_file_tag_delta_encode (tag1, tag2);
+
+    g_assert_cmpstr (tag1->title, ==, "foo");
+    g_assert_cmpuint (et_file_tag_get_size (tag1), <, size1);
+    g_assert_cmpuint (et_file_tag_get_size (tag1), <,
+                      et_file_tag_get_size (tag2));
+
+    /* Undo, so that the first tag is current. */
+    et_file_tag_delta_swap (tag1, tag2);
+
+    g_assert_cmpstr (tag1->title, ==, "foo");
+    g_assert_cmpstr (tag1->artist, ==, "bar");
+    g_assert_cmpstr (tag1->other->data, ==, "baz");
+    g_assert (tag1->picture != NULL);
+    g_assert_cmpuint (tag1->picture->width, ==, 640);
+    g_assert_cmpuint (et_file_tag_get_size (tag1), ==, size1);
+    g_assert_cmpstr (tag2->title, ==, "qux");
+
+    /* Redo. */
+    et_file_tag_delta_swap (tag2, tag1);
+
+    g_assert_cmpstr (tag2->title, ==, "qux");
+    g_assert_cmpstr (tag2->artist, ==, "bar");
+    g_assert_cmpstr (tag2->other->data, ==, "baz");
+    g_assert (tag2->picture != NULL);
+    g_assert_cmpstr (tag1->title, ==, "foo");
+
+    /* Both the delta-encoded and the current tag can be freed. */
+    et_file_tag_free (tag1);
+    et_file_tag_free (tag2);
+}
+
+static void
+file_tag_take_unchanged (void)
+{
+    File_Tag *current;
+    File_Tag *tag;
+
+    current = et_file_tag_new ();
+    et_file_tag_set_title (current, "foo");
+    et_file_tag_set_artist (current, "bar");
+    current->other = g_list_prepend (current->other, g_strdup ("baz"));
+
+    /* A change of the artist only. */
+    tag = et_file_tag_new ();
+    et_file_tag_set_field_value (tag, ET_FILE_TAG_FIELD_ARTIST, "qux");
+    g_assert_cmpstr (et_file_tag_get_field_value (tag,
+                                                  ET_FILE_TAG_FIELD_ARTIST),
+                     ==, "qux");
+    et_file_tag_take_unchanged (tag, current, ET_FILE_TAG_FIELD_ARTIST);
+
+    g_assert_cmpstr (tag->title, ==, "foo");
+    g_assert_cmpstr (tag->artist, ==, "qux");
+    g_assert_cmpstr (tag->other->data, ==, "baz");
+
+    /* The previous tag is delta-encoded, and can be restored by an undo. */
+    et_file_tag_delta_swap (current, tag);
+
+    g_assert_cmpstr (current->title, ==, "foo");
+    g_assert_cmpstr (current->artist, ==, "bar");
+    g_assert_cmpstr (current->other->data, ==, "baz");
+    g_assert_cmpstr (tag->artist, ==, "qux");
+
+    et_file_tag_free (current);
+    et_file_tag_free (tag);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -168,7 +291,10 @@ main (int argc, char** argv)
     g_test_add_func ("/file_tag/new", file_tag_new);
     g_test_add_func ("/file_tag/copy", file_tag_copy);
     g_test_add_func ("/file_tag/copy-other", file_tag_copy_other);
+    g_test_add_func ("/file_tag/matches", file_tag_matches);
     g_test_add_func ("/file_tag/difference", file_tag_difference);
+    g_test_add_func ("/file_tag/delta", file_tag_delta);
+    g_test_add_func ("/file_tag/take-unchanged", file_tag_take_unchanged);
 
     return g_test_run ();
 }
@@ -38,12 +38,111 @@ genres_genre_no (void)
     }
 }
 
+static void
+genres_lookup (void)
+{
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS (id3_genres); i++)
+    {
+        gchar *upper;
+
+        g_assert_cmpuint (et_genre_lookup (id3_genres[i]), ==, i);
+
+        upper = g_ascii_strup (id3_genres[i], -1);
+        g_assert_cmpuint (et_genre_lookup (upper), ==, i);
+        g_free (upper);
+    }
+
+    g_assert_cmpuint (et_genre_lookup (NULL), ==, 0xFF);
+    g_assert_cmpuint (et_genre_lookup (""), ==, 0xFF);
+    g_assert_cmpuint (et_genre_lookup ("Rock and Roll and Rock"), ==, 0xFF);
+    g_assert_cmpuint (et_genre_lookup ("Unknown"), ==, 0xFF);
+}
+
+static void
+genres_normalize (void)
+{
+    gsize i;
+
+    static const struct
+    {
+        const gchar *genre;
+        const gchar *result;
+    } genres[] =
+    {
+        { "(17)", "Rock" },
+        { "17", "Rock" },
+        { "Rock", "Rock" },
+        { "rock", "rock" },
+        { "(3)EuroDance", "EuroDance" },
+        { "(3a)", "(3a)" },
+        { "(255)", NULL },
+        { "1000", NULL },
+        { "Free text", "Free text" },
+        { "(Free text)", "(Free text)" },
+        { "", "" }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (genres); i++)
+    {
+        gchar *first;
+        gchar *second;
+
+        /* The second time, the remembered result is used. */
+        first = et_genre_normalize (genres[i].genre);
+        second = et_genre_normalize (genres[i].genre);
+        g_assert_cmpstr (first, ==, genres[i].result);
+        g_assert_cmpstr (second, ==, genres[i].result);
+
+        /* Each caller gets its own copy. */
+        if (first != NULL)
+        {
+            g_assert (first != second);
+        }
+
+        g_free (first);
+        g_free (second);
+    }
+}
+
+static void
+genres_perf_lookup (void)
+{
+    gsize i;
+    gdouble time;
+    guint found = 0;
+
+    g_test_timer_start ();
+
+    for (i = 0; i < 1000000; i++)
+    {
+        if (et_genre_lookup (id3_genres[i % G_N_ELEMENTS (id3_genres)])
+            != 0xFF)
+        {
+            found++;
+        }
+    }
+
+    time = g_test_timer_elapsed ();
+    g_assert_cmpuint (found, ==, 1000000);
+
+    g_test_minimized_result (time, "1000000 genre lookups: %.3f s", time);
+}
+
 int
 main (int argc, char** argv)
 {
     g_test_init (&argc, &argv, NULL);
 
     g_test_add_func ("/genres/genre_no", genres_genre_no);
+    g_test_add_func ("/genres/lookup", genres_lookup);
+    g_test_add_func ("/genres/normalize", genres_normalize);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/genres/perf/lookup", genres_perf_lookup);
+    }
 
     return g_test_run ();
 }
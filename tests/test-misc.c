@@ -115,6 +115,69 @@ misc_normalized_strcmp0 (void)
     g_assert_cmpint (et_normalized_strcmp0 (str2, str3), >, 0);
 }
 
+/* Compare the sign of the result against normalizing both strings. */
+static void
+misc_normalized_strcmp0_unicode (void)
+{
+    gsize i;
+    gsize j;
+
+    static const gchar * const strings[] =
+    {
+        "",
+        "e",
+        "f",
+        "caf\xc3\xa9", /* NFC é. */
+        "cafe\xcc\x81", /* NFD é. */
+        "cafe\xcc\x81s",
+        "caf\xc3\xa9s",
+        "cafe\xcc\x80", /* NFD è. */
+        "cafe",
+        "cafes",
+        "\xe2\x84\xab", /* ANGSTROM SIGN. */
+        "\xc3\x85", /* LATIN CAPITAL LETTER A WITH RING ABOVE. */
+        "A\xcc\x8a",
+        "a\xcc\xa3\xcc\x81", /* Dot below, then acute. */
+        "a\xcc\x81\xcc\xa3", /* Acute, then dot below. */
+        "\xe1\xba\xa5", /* LATIN SMALL LETTER A WITH CIRCUMFLEX AND ACUTE. */
+        "\xed\x95\x9c", /* HANGUL SYLLABLE HAN. */
+        "\xe1\x84\x92\xe1\x85\xa1\xe1\x86\xab",
+        "\xe6\x97\xa5\xe6\x9c\xac",
+        "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e",
+        "A long ASCII prefix to be compared a word at a time, then \xc3\xa9",
+        "A long ASCII prefix to be compared a word at a time, then e\xcc\x81",
+        "A long ASCII prefix to be compared a word at a time, then f",
+        "A long ASCII prefix to be compared a word at a time", /* A prefix. */
+        "A long ASCII prefix to be compared a word at a tim"
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (strings); i++)
+    {
+        gchar *normalized1;
+
+        normalized1 = g_utf8_normalize (strings[i], -1, G_NORMALIZE_DEFAULT);
+
+        for (j = 0; j < G_N_ELEMENTS (strings); j++)
+        {
+            gchar *normalized2;
+            gint expected;
+            gint result;
+
+            normalized2 = g_utf8_normalize (strings[j], -1,
+                                            G_NORMALIZE_DEFAULT);
+            expected = g_strcmp0 (normalized1, normalized2);
+            result = et_normalized_strcmp0 (strings[i], strings[j]);
+
+            g_assert_cmpint ((result > 0) - (result < 0), ==,
+                             (expected > 0) - (expected < 0));
+
+            g_free (normalized2);
+        }
+
+        g_free (normalized1);
+    }
+}
+
 static void
 misc_normalized_strcasecmp0 (void)
 {
@@ -144,6 +207,40 @@ misc_normalized_strcasecmp0 (void)
     }
 }
 
+static void
+misc_perf_normalized_strcmp0 (void)
+{
+    gsize i;
+    const gsize PERF_ITERATIONS = 1000000;
+    gdouble time;
+
+    static const struct
+    {
+        const gchar *str1;
+        const gchar *str2;
+    } strings[] =
+    {
+        { "01 - The Title of the Track.ogg", "01 - The Title of the Track.ogg" },
+        { "01 - The Title of the Track.ogg", "02 - The Title of the Track.ogg" },
+        { "Caf\xc3\xa9 del Mar", "Cafe\xcc\x81 del Mar" },
+        { "\xe6\x97\xa5\xe6\x9c\xac", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e" }
+    };
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        const gsize j = i % G_N_ELEMENTS (strings);
+
+        et_normalized_strcmp0 (strings[j].str1, strings[j].str2);
+        et_normalized_strcasecmp0 (strings[j].str1, strings[j].str2);
+    }
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.1f seconds", time);
+}
+
 static void
 misc_rename_file (void)
 {
@@ -263,11 +360,19 @@ main (int argc, char** argv)
     g_test_add_func ("/misc/convert-duration", misc_convert_duration);
     g_test_add_func ("/misc/filename-prepare", misc_filename_prepare);
     g_test_add_func ("/misc/normalized-strcmp0", misc_normalized_strcmp0);
+    g_test_add_func ("/misc/normalized-strcmp0-unicode",
+                     misc_normalized_strcmp0_unicode);
     g_test_add_func ("/misc/normalized-strcasecmp0",
                      misc_normalized_strcasecmp0);
     g_test_add_func ("/misc/rename-file", misc_rename_file);
     g_test_add_func ("/misc/str-empty", misc_str_empty);
     g_test_add_func ("/misc/undo-key", misc_undo_key);
 
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/misc/perf/normalized-strcmp0",
+                         misc_perf_normalized_strcmp0);
+    }
+
     return g_test_run ();
 }
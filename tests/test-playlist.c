@@ -0,0 +1,309 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "playlist.h"
+
+#include <glib/gstdio.h>
+
+GSettings *MainSettings;
+
+/* Number of playlists and of files in each playlist for the benchmark. */
+static const guint PERF_PLAYLISTS = 100;
+static const guint PERF_FILES = 1000;
+
+static gchar *
+read_playlist (const gchar *filename)
+{
+    gchar *contents;
+    GError *error = NULL;
+
+    g_assert (g_file_get_contents (filename, &contents, NULL, &error));
+    g_assert_no_error (error);
+
+    return contents;
+}
+
+static EtPlaylistBatch *
+new_batch (const gchar *dir,
+           EtPlaylistContent content,
+           EtScanMask *mask,
+           gboolean relative,
+           gboolean dos_separator)
+{
+    EtPlaylistBatch *batch;
+    File_Tag *file_tag;
+    gchar *playlist;
+    gchar *filename;
+    guint index;
+
+    batch = et_playlist_batch_new (content, mask, relative, dos_separator);
+    playlist = g_build_filename (dir, "test.m3u", NULL);
+    index = et_playlist_batch_add_playlist (batch, playlist);
+    g_assert_cmpuint (index, ==, 0);
+    g_free (playlist);
+
+    file_tag = et_file_tag_new ();
+    et_file_tag_set_artist (file_tag, "Artist");
+    et_file_tag_set_title (file_tag, "First");
+
+    filename = g_build_filename (dir, "Album", "01.ogg", NULL);
+    et_playlist_batch_add_file (batch, index, filename, filename, file_tag,
+                                61);
+    g_free (filename);
+
+    /* Outside of the directory of the playlist, but with the same prefix. */
+    filename = g_strconcat (dir, "-other", G_DIR_SEPARATOR_S, "02.ogg", NULL);
+    et_file_tag_set_title (file_tag, "Second");
+    et_playlist_batch_add_file (batch, index, filename, filename, file_tag,
+                                122);
+    g_free (filename);
+
+    et_file_tag_free (file_tag);
+
+    return batch;
+}
+
+static void
+playlist_write (void)
+{
+    gchar *dir;
+    gchar *playlist;
+    gchar *contents;
+    gchar *expected;
+    EtPlaylistBatch *batch;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    playlist = g_build_filename (dir, "test.m3u", NULL);
+
+    /* Relative paths, only filenames. */
+    batch = new_batch (dir, ET_PLAYLIST_CONTENT_FILENAMES, NULL, TRUE, FALSE);
+    g_assert_cmpuint (et_playlist_batch_get_n_playlists (batch), ==, 1);
+    g_assert_cmpstr (et_playlist_batch_get_filename (batch, 0), ==, playlist);
+    g_assert (et_playlist_batch_write (batch, NULL, NULL, NULL, &error));
+    g_assert_no_error (error);
+    et_playlist_batch_free (batch);
+
+    contents = read_playlist (playlist);
+    g_assert_cmpstr (contents, ==, "Album/01.ogg\r\n");
+    g_free (contents);
+
+    /* Relative paths, extended information and DOS separators. */
+    batch = new_batch (dir, ET_PLAYLIST_CONTENT_EXTENDED, NULL, TRUE, TRUE);
+    g_assert (et_playlist_batch_write (batch, NULL, NULL, NULL, &error));
+    g_assert_no_error (error);
+    et_playlist_batch_free (batch);
+
+    contents = read_playlist (playlist);
+    g_assert_cmpstr (contents, ==,
+                     "#EXTM3U\r\n#EXTINF:61,01.ogg\r\nAlbum\\01.ogg\r\n");
+    g_free (contents);
+
+    /* Full paths, information generated from a mask. */
+    batch = new_batch (dir, ET_PLAYLIST_CONTENT_EXTENDED_MASK,
+                       et_scan_mask_new_rename_file ("%a - %t", TRUE,
+                                                     ET_CONVERT_SPACES_NO_CHANGE,
+                                                     FALSE),
+                       FALSE, FALSE);
+    g_assert (et_playlist_batch_write (batch, NULL, NULL, NULL, &error));
+    g_assert_no_error (error);
+    et_playlist_batch_free (batch);
+
+    contents = read_playlist (playlist);
+    expected = g_strdup_printf ("#EXTM3U\r\n"
+                                "#EXTINF:61,Artist - First\r\n"
+                                "%s" G_DIR_SEPARATOR_S "Album"
+                                G_DIR_SEPARATOR_S "01.ogg\r\n"
+                                "#EXTINF:122,Artist - Second\r\n"
+                                "%s-other" G_DIR_SEPARATOR_S "02.ogg\r\n",
+                                dir, dir);
+    g_assert_cmpstr (contents, ==, expected);
+    g_free (expected);
+    g_free (contents);
+
+    g_assert_cmpint (g_unlink (playlist), ==, 0);
+    g_assert_cmpint (g_rmdir (dir), ==, 0);
+
+    g_free (playlist);
+    g_free (dir);
+}
+
+static void
+on_progress (guint n_written,
+             guint n_playlists,
+             gpointer user_data)
+{
+    guint *n_calls = user_data;
+
+    g_assert_cmpuint (n_written, ==, ++(*n_calls));
+    g_assert_cmpuint (n_playlists, ==, 3);
+}
+
+static void
+playlist_batch (void)
+{
+    gchar *dir;
+    gchar *missing;
+    EtPlaylistBatch *batch;
+    GCancellable *cancellable;
+    guint n_calls = 0;
+    guint i;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    batch = et_playlist_batch_new (ET_PLAYLIST_CONTENT_EXTENDED, NULL, FALSE,
+                                   FALSE);
+
+    for (i = 0; i < 3; i++)
+    {
+        gchar *name;
+        gchar *playlist;
+        gchar *filename;
+
+        name = g_strdup_printf ("%u.m3u", i);
+        playlist = g_build_filename (dir, name, NULL);
+        g_assert_cmpuint (et_playlist_batch_add_playlist (batch, playlist),
+                          ==, i);
+        filename = g_build_filename (dir, "file.ogg", NULL);
+        et_playlist_batch_add_file (batch, i, filename, NULL, NULL, i);
+
+        g_free (filename);
+        g_free (playlist);
+        g_free (name);
+    }
+
+    /* Cancelled before any playlist is written. */
+    cancellable = g_cancellable_new ();
+    g_cancellable_cancel (cancellable);
+    g_assert (!et_playlist_batch_write (batch, cancellable, on_progress,
+                                        &n_calls, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+    g_clear_error (&error);
+    g_assert_cmpuint (n_calls, ==, 0);
+    g_assert (!g_file_test (et_playlist_batch_get_filename (batch, 0),
+                            G_FILE_TEST_EXISTS));
+    g_object_unref (cancellable);
+
+    g_assert (et_playlist_batch_write (batch, NULL, on_progress, &n_calls,
+                                       &error));
+    g_assert_no_error (error);
+    g_assert_cmpuint (n_calls, ==, 3);
+
+    for (i = 0; i < 3; i++)
+    {
+        g_assert_cmpint (g_unlink (et_playlist_batch_get_filename (batch, i)),
+                         ==, 0);
+    }
+
+    et_playlist_batch_free (batch);
+
+    /* The directory of the playlist does not exist. */
+    missing = g_build_filename (dir, "missing", "test.m3u", NULL);
+    batch = et_playlist_batch_new (ET_PLAYLIST_CONTENT_FILENAMES, NULL, FALSE,
+                                   FALSE);
+    et_playlist_batch_add_playlist (batch, missing);
+    g_assert (!et_playlist_batch_write (batch, NULL, NULL, NULL, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+    g_clear_error (&error);
+    et_playlist_batch_free (batch);
+
+    g_assert_cmpint (g_rmdir (dir), ==, 0);
+
+    g_free (missing);
+    g_free (dir);
+}
+
+static void
+playlist_perf_write (void)
+{
+    gchar *dir;
+    EtPlaylistBatch *batch;
+    gdouble elapsed;
+    guint i;
+    guint j;
+    GError *error = NULL;
+
+    dir = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    batch = et_playlist_batch_new (ET_PLAYLIST_CONTENT_EXTENDED, NULL, TRUE,
+                                   FALSE);
+
+    for (i = 0; i < PERF_PLAYLISTS; i++)
+    {
+        gchar *name;
+        gchar *playlist;
+        guint index;
+
+        name = g_strdup_printf ("%u.m3u", i);
+        playlist = g_build_filename (dir, name, NULL);
+        index = et_playlist_batch_add_playlist (batch, playlist);
+
+        for (j = 0; j < PERF_FILES; j++)
+        {
+            gchar *filename;
+
+            filename = g_strdup_printf ("%s" G_DIR_SEPARATOR_S "Album %u"
+                                        G_DIR_SEPARATOR_S "%04u - Title.ogg",
+                                        dir, i, j);
+            et_playlist_batch_add_file (batch, index, filename, NULL, NULL,
+                                        j);
+            g_free (filename);
+        }
+
+        g_free (playlist);
+        g_free (name);
+    }
+
+    g_test_timer_start ();
+    g_assert (et_playlist_batch_write (batch, NULL, NULL, NULL, &error));
+    elapsed = g_test_timer_elapsed ();
+    g_assert_no_error (error);
+
+    g_test_minimized_result (elapsed, "%u playlists of %u files: %.3f s",
+                             PERF_PLAYLISTS, PERF_FILES, elapsed);
+
+    for (i = 0; i < PERF_PLAYLISTS; i++)
+    {
+        g_assert_cmpint (g_unlink (et_playlist_batch_get_filename (batch, i)),
+                         ==, 0);
+    }
+
+    et_playlist_batch_free (batch);
+    g_assert_cmpint (g_rmdir (dir), ==, 0);
+    g_free (dir);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/playlist/write", playlist_write);
+    g_test_add_func ("/playlist/batch", playlist_batch);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/playlist/perf/write", playlist_perf_write);
+    }
+
+    return g_test_run ();
+}
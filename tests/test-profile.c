@@ -0,0 +1,110 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "profile.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+static void
+profile_operation (void)
+{
+    gchar *dirname;
+    gchar *trace;
+    gchar **lines;
+    gchar *contents;
+    gint64 span;
+    guint i;
+    GStatBuf stat_buf;
+    GError *error = NULL;
+
+    dirname = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+    trace = g_build_filename (dirname, "trace.json", NULL);
+
+    /* Timing is disabled by default. */
+    et_profile_operation_begin ("Disabled");
+    g_assert (et_profile_operation_end () == NULL);
+
+    et_profile_init (FALSE, trace);
+
+    et_profile_operation_begin ("Outer \"operation\"");
+
+    span = et_profile_span_begin ();
+    g_assert_cmpint (span, !=, 0);
+    et_profile_span_end (ET_PROFILE_PHASE_READ_TAG, span);
+    et_profile_count_file ();
+
+    /* Nested operations are part of the outer operation. */
+    et_profile_operation_begin ("Inner");
+    span = et_profile_span_begin ();
+    et_profile_span_end (ET_PROFILE_PHASE_READ_TAG, span);
+    et_profile_count_file ();
+    g_assert (et_profile_operation_end () == NULL);
+
+    lines = et_profile_operation_end ();
+    g_assert (lines != NULL);
+    g_assert (strstr (lines[0], "Outer \"operation\"") != NULL);
+    g_assert (strstr (lines[0], " 2 files ") != NULL);
+    g_assert (lines[1] != NULL);
+    g_assert (strstr (lines[1], "2 calls") != NULL);
+    g_strfreev (lines);
+
+    /* The spans are appended to the trace once enough are buffered. */
+    et_profile_operation_begin ("Many spans");
+
+    for (i = 0; i < 4096; i++)
+    {
+        span = et_profile_span_begin ();
+        et_profile_span_end (ET_PROFILE_PHASE_UNDO, span);
+    }
+
+    lines = et_profile_operation_end ();
+    g_assert (lines != NULL);
+    g_strfreev (lines);
+
+    g_assert_cmpint (g_stat (trace, &stat_buf), ==, 0);
+    g_assert_cmpint (stat_buf.st_size, >, 0);
+
+    et_profile_shutdown ();
+
+    g_file_get_contents (trace, &contents, NULL, &error);
+    g_assert_no_error (error);
+    g_assert (g_str_has_prefix (contents, "{\"traceEvents\":["));
+    g_assert (strstr (contents, "\"Outer \\\"operation\\\"\"") != NULL);
+    g_assert (strstr (contents, "\"Tag reading\"") != NULL);
+    g_assert (strstr (contents, "\"Undo generation\"") != NULL);
+    g_assert (g_str_has_suffix (contents, "],\"displayTimeUnit\":\"ms\"}\n"));
+    g_free (contents);
+
+    g_assert_cmpint (g_unlink (trace), ==, 0);
+    g_assert_cmpint (g_rmdir (dirname), ==, 0);
+
+    g_free (trace);
+    g_free (dirname);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/profile/operation", profile_operation);
+
+    return g_test_run ();
+}
@@ -0,0 +1,278 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "rename_plan.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+static gchar *
+make_test_dir (void)
+{
+    gchar *dirname;
+    GError *error = NULL;
+
+    dirname = g_dir_make_tmp ("EasyTAG-test-XXXXXX", &error);
+    g_assert_no_error (error);
+
+    return dirname;
+}
+
+static gchar *
+create_file (const gchar *dirname,
+             const gchar *basename)
+{
+    gchar *filename;
+    GError *error = NULL;
+
+    filename = g_build_filename (dirname, basename, NULL);
+    g_file_set_contents (filename, basename, -1, &error);
+    g_assert_no_error (error);
+
+    return filename;
+}
+
+/* Check that the file @basename contains the name of the file it was created
+ * as. */
+static void
+assert_file_contents (const gchar *dirname,
+                      const gchar *basename,
+                      const gchar *contents)
+{
+    gchar *filename;
+    gchar *result;
+    GError *error = NULL;
+
+    filename = g_build_filename (dirname, basename, NULL);
+    g_file_get_contents (filename, &result, NULL, &error);
+    g_assert_no_error (error);
+    g_assert_cmpstr (result, ==, contents);
+
+    g_assert_cmpint (g_unlink (filename), ==, 0);
+
+    g_free (result);
+    g_free (filename);
+}
+
+static void
+rename_plan_swap (void)
+{
+    gchar *dirname;
+    gchar *a;
+    gchar *b;
+    EtRenamePlan *plan;
+    GError *error = NULL;
+
+    dirname = make_test_dir ();
+    a = create_file (dirname, "01 - A");
+    b = create_file (dirname, "02 - B");
+
+    plan = et_rename_plan_new ();
+    et_rename_plan_add (plan, a, b);
+    et_rename_plan_add (plan, b, a);
+    g_assert_cmpuint (et_rename_plan_get_length (plan), ==, 2);
+
+    g_assert (et_rename_plan_execute (plan, &error));
+    g_assert_no_error (error);
+    et_rename_plan_free (plan);
+
+    assert_file_contents (dirname, "01 - A", "02 - B");
+    assert_file_contents (dirname, "02 - B", "01 - A");
+
+    g_assert_cmpint (g_rmdir (dirname), ==, 0);
+
+    g_free (b);
+    g_free (a);
+    g_free (dirname);
+}
+
+static void
+rename_plan_chains (void)
+{
+    gsize i;
+    gchar *dirname;
+    EtRenamePlan *plan;
+    GError *error = NULL;
+
+    static const struct
+    {
+        const gchar *old_name;
+        const gchar *new_name;
+    } renames[] =
+    {
+        /* A cycle of three files. */
+        { "c1", "c2" },
+        { "c2", "c3" },
+        { "c3", "c1" },
+        /* A chain, which must be executed from the end. */
+        { "x", "y" },
+        { "y", "z" },
+        /* Into a new directory. */
+        { "d", "new/dir/d" },
+        /* Unchanged. */
+        { "u", "u" }
+    };
+
+    static const struct
+    {
+        const gchar *name;
+        const gchar *contents;
+    } results[] =
+    {
+        { "c1", "c3" },
+        { "c2", "c1" },
+        { "c3", "c2" },
+        { "y", "x" },
+        { "z", "y" },
+        { "new/dir/d", "d" },
+        { "u", "u" }
+    };
+
+    dirname = make_test_dir ();
+    plan = et_rename_plan_new ();
+
+    for (i = 0; i < G_N_ELEMENTS (renames); i++)
+    {
+        gchar *old_filename;
+        gchar *new_filename;
+
+        old_filename = create_file (dirname, renames[i].old_name);
+        new_filename = g_build_filename (dirname, renames[i].new_name, NULL);
+
+        et_rename_plan_add (plan, old_filename, new_filename);
+
+        g_free (new_filename);
+        g_free (old_filename);
+    }
+
+    /* The unchanged file is not part of the plan. */
+    g_assert_cmpuint (et_rename_plan_get_length (plan), ==,
+                      G_N_ELEMENTS (renames) - 1);
+
+    g_assert (et_rename_plan_execute (plan, &error));
+    g_assert_no_error (error);
+    et_rename_plan_free (plan);
+
+    for (i = 0; i < G_N_ELEMENTS (results); i++)
+    {
+        assert_file_contents (dirname, results[i].name, results[i].contents);
+    }
+
+    {
+        gchar *subdir;
+
+        subdir = g_build_filename (dirname, "new", "dir", NULL);
+        g_assert_cmpint (g_rmdir (subdir), ==, 0);
+        g_free (subdir);
+
+        subdir = g_build_filename (dirname, "new", NULL);
+        g_assert_cmpint (g_rmdir (subdir), ==, 0);
+        g_free (subdir);
+    }
+
+    g_assert_cmpint (g_rmdir (dirname), ==, 0);
+    g_free (dirname);
+}
+
+static void
+rename_plan_rollback (void)
+{
+    gchar *dirname;
+    gchar *a;
+    gchar *b;
+    gchar *c;
+    gchar *d;
+    gchar *new_a;
+    gchar *new_dir;
+    EtRenamePlan *plan;
+    GError *error = NULL;
+
+    dirname = make_test_dir ();
+    a = create_file (dirname, "a");
+    b = create_file (dirname, "b");
+    c = create_file (dirname, "c");
+    d = create_file (dirname, "d");
+    new_a = g_build_filename (dirname, "new", "a", NULL);
+    new_dir = g_path_get_dirname (new_a);
+
+    plan = et_rename_plan_new ();
+    et_rename_plan_add (plan, a, new_a);
+    et_rename_plan_add (plan, b, c);
+    et_rename_plan_add (plan, c, b);
+    et_rename_plan_add (plan, c, d);
+
+    /* Renaming the same file twice is not allowed, and the error names the
+     * file which is renamed twice. */
+    g_assert (!et_rename_plan_execute (plan, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+    g_assert (strstr (error->message, c) != NULL);
+    g_assert (strstr (error->message, d) == NULL);
+    g_clear_error (&error);
+    et_rename_plan_free (plan);
+
+    /* Neither is renaming two files to the same path. */
+    plan = et_rename_plan_new ();
+    et_rename_plan_add (plan, a, d);
+    et_rename_plan_add (plan, b, d);
+    g_assert (!et_rename_plan_execute (plan, &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT);
+    g_assert (strstr (error->message, d) != NULL);
+    g_clear_error (&error);
+    et_rename_plan_free (plan);
+
+    plan = et_rename_plan_new ();
+    et_rename_plan_add (plan, b, c);
+    et_rename_plan_add (plan, c, b);
+    et_rename_plan_add (plan, a, new_a);
+    /* Fails, as the directory is created for the previous rename. */
+    et_rename_plan_add (plan, d, new_dir);
+
+    /* Everything is restored when a rename fails. */
+    g_assert (!et_rename_plan_execute (plan, &error));
+    g_assert (error != NULL);
+    g_clear_error (&error);
+    et_rename_plan_free (plan);
+
+    g_assert (!g_file_test (new_dir, G_FILE_TEST_EXISTS));
+    assert_file_contents (dirname, "a", "a");
+    assert_file_contents (dirname, "b", "b");
+    assert_file_contents (dirname, "c", "c");
+    assert_file_contents (dirname, "d", "d");
+
+    g_assert_cmpint (g_rmdir (dirname), ==, 0);
+
+    g_free (new_dir);
+    g_free (new_a);
+    g_free (d);
+    g_free (c);
+    g_free (b);
+    g_free (a);
+    g_free (dirname);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/rename_plan/swap", rename_plan_swap);
+    g_test_add_func ("/rename_plan/chains", rename_plan_chains);
+    g_test_add_func ("/rename_plan/rollback", rename_plan_rollback);
+
+    return g_test_run ();
+}
@@ -0,0 +1,264 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015 David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "scan_mask.h"
+
+GtkWidget *MainWindow;
+GSettings *MainSettings;
+
+static const gsize PERF_ITERATIONS = 100000;
+
+static void
+scan_mask_fill_tag (void)
+{
+    gsize i;
+
+    static const struct
+    {
+        const gchar *mask;
+        EtConvertSpaces convert_mode;
+        const gchar *filename;
+        const gchar *result;
+        guint n_errors;
+    } fills[] =
+    {
+        { "%a - %b/%n - %t", ET_CONVERT_SPACES_NO_CHANGE,
+          "/music/Artist - Album/01 - Title", "a=Artist|b=Album|n=01|t=Title|",
+          0 },
+        { "%n - %t", ET_CONVERT_SPACES_NO_CHANGE,
+          "/music/Artist - Album/01 - Title", "n=01|t=Title|", 0 },
+        { "%a/%b/%n. %t", ET_CONVERT_SPACES_NO_CHANGE, "Album/01. Title",
+          "b=Album|n=01|t=Title|", 0 },
+        { "(%y) %b", ET_CONVERT_SPACES_NO_CHANGE, "(1999) Album",
+          "y=1999|b=Album|", 0 },
+        { "%n - %t", ET_CONVERT_SPACES_NO_CHANGE, "01_Title", "n=01_Title|t=|",
+          1 },
+        { "%n - %t", ET_CONVERT_SPACES_SPACES, "01_-_Some_Title",
+          "n=01|t=Some Title|", 0 },
+        { "%n_-_%t", ET_CONVERT_SPACES_UNDERSCORES, "01 - Some Title",
+          "n=01|t=Some_Title|", 0 },
+        { "%n%t", ET_CONVERT_SPACES_NO_CHANGE, "01Title", "n=|t=01Title|", 0 }
+    };
+
+    for (i = 0; i < G_N_ELEMENTS (fills); i++)
+    {
+        EtScanMask *mask;
+        GArray *fields;
+        GPtrArray *errors;
+        GString *result;
+        guint j;
+
+        mask = et_scan_mask_new_fill_tag (fills[i].mask,
+                                          fills[i].convert_mode);
+        errors = g_ptr_array_new_with_free_func (g_free);
+        fields = et_scan_mask_fill_tag (mask, fills[i].filename, errors);
+        result = g_string_new ("");
+
+        for (j = 0; j < fields->len; j++)
+        {
+            const EtScanMaskField *field = &g_array_index (fields,
+                                                           EtScanMaskField,
+                                                           j);
+
+            g_string_append_printf (result, "%c=%s|", field->code,
+                                    field->string);
+        }
+
+        g_assert_cmpstr (result->str, ==, fills[i].result);
+        g_assert_cmpuint (errors->len, ==, fills[i].n_errors);
+
+        g_string_free (result, TRUE);
+        g_array_unref (fields);
+        g_ptr_array_unref (errors);
+        et_scan_mask_free (mask);
+    }
+}
+
+static void
+scan_mask_rename_file (void)
+{
+    gsize i;
+    File_Tag *file_tag;
+    File_Tag *copy;
+
+    static const struct
+    {
+        const gchar *mask;
+        const gchar *result;
+    } renames[] =
+    {
+        { "%n - %a - %t", "01 - Artist - Title" },
+        { "%n - %c - %t", "01 - Title" },
+        { "%c - %n - %t", "01 - Title" },
+        { "%n - %t%c", "01 - Title" },
+        { "[%n] %t", "[01] Title" },
+        { "%n %p", "01 A-B- C" },
+        { "Prefix", "Prefix" },
+        { "/music/%a/%b/%n %t", "/music/Artist/Album/01 Title" },
+        { "%a/%n %t", "/music/old/Artist/01 Title" }
+    };
+
+    file_tag = et_file_tag_new ();
+    et_file_tag_set_title (file_tag, "Title");
+    et_file_tag_set_artist (file_tag, "Artist");
+    et_file_tag_set_album (file_tag, "Album");
+    et_file_tag_set_track_number (file_tag, "01");
+    et_file_tag_set_composer (file_tag, "A/B: C");
+
+    for (i = 0; i < G_N_ELEMENTS (renames); i++)
+    {
+        EtScanMask *mask;
+        gchar *filename;
+
+        mask = et_scan_mask_new_rename_file (renames[i].mask, FALSE,
+                                             ET_CONVERT_SPACES_SPACES, TRUE);
+        filename = et_scan_mask_rename_file (mask, file_tag,
+                                             "/music/old/file.mp3");
+
+        g_assert_cmpstr (filename, ==, renames[i].result);
+        g_free (filename);
+
+        /* The fields which the mask references are enough to rename. */
+        copy = et_file_tag_new ();
+        et_scan_mask_copy_fields (mask, copy, file_tag);
+        filename = et_scan_mask_rename_file (mask, copy,
+                                             "/music/old/file.mp3");
+
+        g_assert_cmpstr (filename, ==, renames[i].result);
+
+        g_free (filename);
+        et_file_tag_free (copy);
+        et_scan_mask_free (mask);
+    }
+
+    et_file_tag_free (file_tag);
+}
+
+static void
+scan_mask_copy_fields (void)
+{
+    File_Tag *file_tag;
+    File_Tag *copy;
+    EtPicture *picture;
+    EtScanMask *mask;
+    GBytes *bytes;
+
+    file_tag = et_file_tag_new ();
+    et_file_tag_set_title (file_tag, "Title");
+    et_file_tag_set_artist (file_tag, "Artist");
+    et_file_tag_set_track_number (file_tag, "01");
+    et_file_tag_set_encoded_by (file_tag, "Encoder");
+    bytes = g_bytes_new_static ("picture", 7);
+    picture = et_picture_new (ET_PICTURE_TYPE_FRONT_COVER, "", 0, 0, bytes);
+    et_file_tag_set_picture (file_tag, picture);
+    et_picture_free (picture);
+    g_bytes_unref (bytes);
+    file_tag->other = g_list_prepend (NULL, g_strdup ("OTHER=value"));
+
+    /* Only the fields of the mask. */
+    mask = et_scan_mask_new_rename_file ("%n - %t", FALSE,
+                                         ET_CONVERT_SPACES_SPACES, TRUE);
+    copy = et_file_tag_new ();
+    et_scan_mask_copy_fields (mask, copy, file_tag);
+
+    g_assert_cmpstr (copy->title, ==, "Title");
+    g_assert_cmpstr (copy->track, ==, "01");
+    g_assert (copy->artist == NULL);
+    g_assert (copy->encoded_by == NULL);
+    g_assert (copy->picture == NULL);
+    g_assert (copy->other == NULL);
+
+    et_file_tag_free (copy);
+    et_scan_mask_free (mask);
+
+    /* Every field which any mask can reference, but never the pictures. */
+    copy = et_file_tag_new ();
+    et_scan_mask_copy_fields (NULL, copy, file_tag);
+
+    g_assert_cmpstr (copy->title, ==, "Title");
+    g_assert_cmpstr (copy->artist, ==, "Artist");
+    g_assert_cmpstr (copy->track, ==, "01");
+    g_assert_cmpstr (copy->encoded_by, ==, "Encoder");
+    g_assert (copy->picture == NULL);
+    g_assert (copy->other == NULL);
+
+    et_file_tag_free (copy);
+    et_file_tag_free (file_tag);
+}
+
+static void
+scan_mask_perf (void)
+{
+    gsize i;
+    gdouble time;
+    EtScanMask *fill_mask;
+    EtScanMask *rename_mask;
+    File_Tag *file_tag;
+
+    fill_mask = et_scan_mask_new_fill_tag ("%a - %b (%y)/%n - %t",
+                                           ET_CONVERT_SPACES_NO_CHANGE);
+    rename_mask = et_scan_mask_new_rename_file ("%n - %a - %t", FALSE,
+                                                ET_CONVERT_SPACES_SPACES,
+                                                TRUE);
+    file_tag = et_file_tag_new ();
+    et_file_tag_set_title (file_tag, "Title");
+    et_file_tag_set_artist (file_tag, "Artist");
+    et_file_tag_set_track_number (file_tag, "01");
+
+    g_test_timer_start ();
+
+    for (i = 0; i < PERF_ITERATIONS; i++)
+    {
+        GArray *fields;
+        gchar *filename;
+
+        fields = et_scan_mask_fill_tag (fill_mask,
+                                        "/music/Artist - Album (1999)/01 - Title",
+                                        NULL);
+        g_array_unref (fields);
+
+        filename = et_scan_mask_rename_file (rename_mask, file_tag,
+                                             "/music/01.mp3");
+        g_free (filename);
+    }
+
+    time = g_test_timer_elapsed ();
+
+    g_test_minimized_result (time, "%6.1f seconds", time);
+
+    et_file_tag_free (file_tag);
+    et_scan_mask_free (rename_mask);
+    et_scan_mask_free (fill_mask);
+}
+
+int
+main (int argc, char** argv)
+{
+    g_test_init (&argc, &argv, NULL);
+
+    g_test_add_func ("/scan_mask/fill-tag", scan_mask_fill_tag);
+    g_test_add_func ("/scan_mask/rename-file", scan_mask_rename_file);
+    g_test_add_func ("/scan_mask/copy-fields", scan_mask_copy_fields);
+
+    if (g_test_perf ())
+    {
+        g_test_add_func ("/scan_mask/perf", scan_mask_perf);
+    }
+
+    return g_test_run ();
+}
@@ -0,0 +1,206 @@
+/* EasyTAG - tag editor for audio files
+ * Copyright (C) 2015  David King <amigadave@amigadave.com>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include "config.h"
+
+#include "vorbis_comment.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "misc.h"
+
+GSettings *MainSettings;
+
+#if defined ENABLE_OGG || defined ENABLE_FLAC
+
+static EtVorbisCommentKey
+add_comment (EtVorbisCommentReader *reader,
+             const gchar *comment,
+             const gchar **value)
+{
+    gsize value_length;
+
+    return et_vorbis_comment_reader_add (reader, comment, strlen (comment),
+                                         value, &value_length);
+}
+
+static void
+vorbis_comment_read (void)
+{
+    static const gchar * const comments[] =
+    {
+        "title=First",
+        "TITLE=Second",
+        "Artist=Artist",
+        "TRACKNUMBER=3/12",
+        "TRACKTOTAL=10",
+        "DISCNUMBER=1/2",
+        "DISCNUMBER=5",
+        "COMMENT=Comment",
+        "DESCRIPTION=Description",
+        "replaygain_track_gain=-1.5 dB",
+        "ARTIST=",
+        "LANGUAGE=en"
+    };
+    EtVorbisCommentReader reader;
+    File_Tag *file_tag;
+    const gchar *value;
+    gchar *number;
+    gsize i;
+
+    /* The track and disc numbers are padded according to the settings. */
+    if (MainSettings == NULL)
+    {
+        g_test_skip ("The EasyTAG GSettings schema is not installed");
+        return;
+    }
+
+    file_tag = et_file_tag_new ();
+    file_tag->saved = TRUE;
+    et_vorbis_comment_reader_init (&reader, file_tag, FALSE);
+
+    for (i = 0; i < G_N_ELEMENTS (comments); i++)
+    {
+        add_comment (&reader, comments[i], &value);
+    }
+
+    et_vorbis_comment_reader_finish (&reader);
+
+    /* Keys are matched case-insensitively, and empty values are skipped. */
+    g_assert_cmpstr (file_tag->title, ==, "First - Second");
+    g_assert_cmpstr (file_tag->artist, ==, "Artist");
+
+    /* The total field has priority over the total in the number field. */
+    number = et_track_number_to_string (3);
+    g_assert_cmpstr (file_tag->track, ==, number);
+    g_free (number);
+    number = et_track_number_to_string (10);
+    g_assert_cmpstr (file_tag->track_total, ==, number);
+    g_free (number);
+    number = et_disc_number_to_string (1);
+    g_assert_cmpstr (file_tag->disc_number, ==, number);
+    g_free (number);
+    number = et_disc_number_to_string (2);
+    g_assert_cmpstr (file_tag->disc_total, ==, number);
+    g_free (number);
+
+    /* Comments follow descriptions, and are written back as descriptions. */
+    g_assert_cmpstr (file_tag->comment, ==, "Description - Comment");
+    g_assert (!file_tag->saved);
+
+    /* Other fields are kept in order, with upper-case keys. */
+    g_assert_cmpuint (g_list_length (file_tag->other), ==, 2);
+    g_assert_cmpstr (file_tag->other->data, ==,
+                     "REPLAYGAIN_TRACK_GAIN=-1.5 dB");
+    g_assert_cmpstr (file_tag->other->next->data, ==, "LANGUAGE=en");
+
+    et_file_tag_free (file_tag);
+}
+
+static void
+vorbis_comment_pictures (void)
+{
+    EtVorbisCommentReader reader;
+    File_Tag *file_tag;
+    const gchar *value = NULL;
+
+    /* Picture fields are returned to the caller. */
+    file_tag = et_file_tag_new ();
+    et_vorbis_comment_reader_init (&reader, file_tag, TRUE);
+
+    g_assert_cmpint (add_comment (&reader, "coverarttype=3", &value), ==,
+                     ET_VORBIS_COMMENT_KEY_COVER_ART_TYPE);
+    g_assert_cmpstr (value, ==, "3");
+    g_assert_cmpint (add_comment (&reader, "METADATA_BLOCK_PICTURE=AAAA",
+                                  &value),
+                     ==, ET_VORBIS_COMMENT_KEY_METADATA_BLOCK_PICTURE);
+    g_assert_cmpstr (value, ==, "AAAA");
+    g_assert_cmpint (add_comment (&reader, "TITLE=Title", &value), ==,
+                     ET_VORBIS_COMMENT_KEY_TEXT);
+
+    et_vorbis_comment_reader_finish (&reader);
+    g_assert (file_tag->other == NULL);
+    et_file_tag_free (file_tag);
+
+    /* Or kept as other fields. */
+    file_tag = et_file_tag_new ();
+    et_vorbis_comment_reader_init (&reader, file_tag, FALSE);
+
+    g_assert_cmpint (add_comment (&reader, "coverarttype=3", &value), ==,
+                     ET_VORBIS_COMMENT_KEY_UNKNOWN);
+
+    et_vorbis_comment_reader_finish (&reader);
+    g_assert_cmpuint (g_list_length (file_tag->other), ==, 1);
+    g_assert_cmpstr (file_tag->other->data, ==, "COVERARTTYPE=3");
+    et_file_tag_free (file_tag);
+}
+
+static void
+vorbis_comment_validate (void)
+{
+    /* The value need not be nul-terminated. */
+    static const gchar value[] = { 'T', 'i', 't', 'l', 'e', '=' };
+    gchar *result;
+
+    result = et_vorbis_comment_validate_value (value, 5);
+    g_assert_cmpstr (result, ==, "Title");
+    g_free (result);
+
+    result = et_vorbis_comment_validate_value ("Caf\xe9", 4);
+    g_assert (g_utf8_validate (result, -1, NULL));
+    g_free (result);
+}
+
+#endif /* ENABLE_OGG || ENABLE_FLAC */
+
+int
+main (int argc, char** argv)
+{
+    GSettingsSchemaSource *source;
+    GSettingsSchema *schema = NULL;
+    gint status;
+
+    g_test_init (&argc, &argv, NULL);
+
+    source = g_settings_schema_source_get_default ();
+
+    if (source != NULL)
+    {
+        schema = g_settings_schema_source_lookup (source, "org.gnome.EasyTAG",
+                                                  TRUE);
+    }
+
+    if (schema != NULL)
+    {
+        MainSettings = g_settings_new ("org.gnome.EasyTAG");
+        g_settings_schema_unref (schema);
+    }
+
+#if defined ENABLE_OGG || defined ENABLE_FLAC
+    g_test_add_func ("/vorbis_comment/read", vorbis_comment_read);
+    g_test_add_func ("/vorbis_comment/pictures", vorbis_comment_pictures);
+    g_test_add_func ("/vorbis_comment/validate", vorbis_comment_validate);
+#endif /* ENABLE_OGG || ENABLE_FLAC */
+
+    status = g_test_run ();
+
+    g_clear_object (&MainSettings);
+
+    return status;
+}